@@ -1,6 +1,7 @@
 #ifndef __SYLAR_HTTP_H__
 #define __SYLAR_HTTP_H__
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <map>
@@ -10,6 +11,7 @@
 
 #include "http/http11_parser.hh"
 #include "http/httpclient_parser.hh"
+#include "http/stream.hh"
 
 namespace sylar {
 
@@ -346,6 +348,24 @@ class HttpRequest {
      */
     void setBody(const std::string &v) { m_body = v; }
 
+    /**
+     * @brief     设置 HTTP 请求的消息体, 接管传入的内存
+     * @param[in] v 消息体
+     */
+    void setBody(std::string &&v) { m_body = std::move(v); }
+
+    /**
+     * @brief 返回按需读取的请求体, 只有 HttpSession::recvRequestHead 接收的请求才有,
+     *        此时 getBody() 为空
+     */
+    const Stream::ptr &getBodyStream() const { return m_bodyStream; }
+
+    /**
+     * @brief     设置按需读取的请求体
+     * @param[in] v 请求体流, 读完时 read 返回 0
+     */
+    void setBodyStream(Stream::ptr v) { m_bodyStream = v; }
+
     /**
      * @brief     设置 HTTP 请求的头部 MAP
      * @param[in] v map
@@ -497,6 +517,7 @@ class HttpRequest {
     std::string m_path;     /**< 请求路径 */
     std::string m_query;    /**< 原始查询字符串 */
     std::string m_body;     /**< 请求体 */
+    Stream::ptr m_bodyStream; /**< 按需读取的请求体, 设置时 m_body 为空 */
     std::string m_fragment; /**< 请求 fragment */
 
     MapType m_headers; /**< 请求头部字段 */
@@ -504,6 +525,19 @@ class HttpRequest {
     MapType m_cookies; /**< 请求 COOKIE */
 };
 
+/**
+ * @brief 文件响应体, 由 HttpSession 用 sendfile 直接从文件发送
+ */
+struct HttpFileBody {
+    using ptr = std::shared_ptr<HttpFileBody>;
+
+    ~HttpFileBody();
+
+    int fd          = -1;
+    uint64_t offset = 0; /**< 文件内的起始偏移 */
+    uint64_t length = 0; /**< 发送的字节数 */
+};
+
 /**
  * @brief HTTP 响应结构体
  */
@@ -512,6 +546,11 @@ class HttpResponse {
     using MapType = std::map<std::string, std::string, CaseInsensitiveLess>;
     using ptr     = std::shared_ptr<HttpResponse>;
 
+    /**
+     * @brief 边生成边发送的响应体, 通过 writer 写出, 返回 false 表示生成失败
+     */
+    using BodyProducer = std::function<bool(Stream::ptr writer)>;
+
     /**
      * @brief     构造函数
      * @param[in] version 版本
@@ -564,7 +603,77 @@ class HttpResponse {
      * @brief     设置响应消息体
      * @param[in] v 消息体
      */
-    void setBody(const std::string &body) { m_body = body; }
+    void setBody(const std::string &body)
+    {
+        m_body = body;
+        m_file.reset();
+        m_producer = nullptr;
+    }
+
+    /**
+     * @brief     设置响应消息体, 接管传入的内存
+     * @param[in] v 消息体
+     */
+    void setBody(std::string &&body)
+    {
+        m_body = std::move(body);
+        m_file.reset();
+        m_producer = nullptr;
+    }
+
+    /**
+     * @brief     由 cb 边生成边发送响应体, 代替 m_body 和文件响应体
+     * @details   HttpSession 先发出响应头, 再在发送响应时调用 cb; HTTP/1.1 用
+     *            chunked 编码, 每次写入是一个 chunk; HTTP/1.0 原样发送并在结束后
+     *            关闭连接. cb 返回 false 时响应不完整, 连接会被关闭
+     * @param[in] cb 响应体生成函数
+     */
+    void setBodyProducer(const BodyProducer &cb)
+    {
+        m_producer = cb;
+        m_body.clear();
+        m_file.reset();
+    }
+
+    /**
+     * @brief 返回响应体生成函数, 未设置时为空
+     */
+    const BodyProducer &getBodyProducer() const { return m_producer; }
+
+    /**
+     * @brief     以文件的一段作为响应消息体
+     * @param[in] path 文件路径
+     * @param[in] offset 起始偏移
+     * @param[in] length 长度, 小于 0 表示到文件末尾
+     * @return    文件打开失败或范围越界时返回 false, 响应体不变
+     */
+    bool setBodyFile(const std::string &path, uint64_t offset = 0,
+                     int64_t length = -1);
+
+    /**
+     * @brief 返回文件响应体, 未设置时为空
+     */
+    const HttpFileBody::ptr &getBodyFile() const { return m_file; }
+
+    /**
+     * @brief 返回按需读取的响应体, 只有 HttpConnection::recvResponseHead 接收的响应才有,
+     *        此时 getBody() 为空
+     */
+    const Stream::ptr &getBodyStream() const { return m_bodyStream; }
+
+    /**
+     * @brief     设置按需读取的响应体
+     * @param[in] v 响应体流, 读完时 read 返回 0
+     */
+    void setBodyStream(Stream::ptr v) { m_bodyStream = v; }
+
+    /**
+     * @brief 返回响应消息体的长度
+     */
+    uint64_t getContentLength() const
+    {
+        return m_file ? m_file->length : m_body.size();
+    }
 
     /**
      * @brief     设置响应原因
@@ -644,18 +753,27 @@ class HttpResponse {
      */
     std::ostream &dump(std::ostream &os) const;
 
+    /**
+     * @brief          把响应行和响应头(含结尾空行)追加到 buf, 不含消息体
+     * @param[in, out] buf 输出缓冲, 可重复使用以免每次分配
+     */
+    void dumpHead(std::string &buf) const;
+
     /**
      * @brief 转成字符串
      */
     std::string toString() const;
 
   private:
-    HttpStatus m_status;  /**< 响应码 */
-    uint8_t m_version;    /**< 版本 */
-    bool m_close;         /**< 是否自动关闭 */
-    std::string m_body;   /**< 响应体 */
-    std::string m_reason; /**< 响应原因 */
-    MapType m_headers;    /**< 响应头 */
+    HttpStatus m_status;      /**< 响应码 */
+    uint8_t m_version;        /**< 版本 */
+    bool m_close;             /**< 是否自动关闭 */
+    std::string m_body;       /**< 响应体 */
+    HttpFileBody::ptr m_file; /**< 文件响应体, 设置时代替 m_body */
+    BodyProducer m_producer;  /**< 响应体生成函数, 设置时代替 m_body */
+    Stream::ptr m_bodyStream; /**< 接收时按需读取的响应体 */
+    std::string m_reason;     /**< 响应原因 */
+    MapType m_headers;        /**< 响应头 */
 };
 
 /**
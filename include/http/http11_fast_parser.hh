@@ -0,0 +1,30 @@
+#ifndef __SYLAR_HTTP11_FAST_PARSER_H__
+#define __SYLAR_HTTP11_FAST_PARSER_H__
+
+#include "http/http11_parser.hh"
+
+/* 快速路径扫描使用的指令集 */
+enum http_fast_isa {
+  HTTP_FAST_SCALAR = 0, /* 查表, 逐字节 */
+  HTTP_FAST_SSE42  = 1, /* pcmpestri 按字符范围一次扫 16 字节 */
+  HTTP_FAST_AVX2   = 2  /* 头部值一次扫 32 字节, 其余同 SSE4.2 */
+};
+
+/*
+ * 常见请求的快速解析: 方法、以 "/" 开头的路径和查询串、HTTP/1.0 或 1.1、
+ * 以 CRLF 结尾且不折行的头部. 先校验整个请求头, 全部符合时才按 ragel 的顺序
+ * 调用 parser 上的回调并把 parser 置为完成; 否则不调用任何回调.
+ *
+ * 返回 >0 时为请求头的长度; 返回 -1 表示请求头不完整或含有快速路径不处理的
+ * 输入(非法字符、fragment、折行、超过 64 个头部等), 调用者应改用
+ * http_parser_execute 从头解析, 由 ragel 判断是否合法.
+ */
+ssize_t http_parser_fast_execute(http_parser *parser, const char *data, size_t len);
+
+/* 选择指令集, 超出 CPU 支持的会降级, 返回实际使用的; 默认使用 CPU 支持的最高的.
+ * 不是线程安全的, 只在启动或基准测试时调用 */
+int http_parser_fast_set_isa(int isa);
+
+int http_parser_fast_get_isa();
+
+#endif // __SYLAR_HTTP11_FAST_PARSER_H__
@@ -34,6 +34,8 @@ int http_parser_finish(http_parser *parser);
 size_t http_parser_execute(http_parser *parser, const char *data, size_t len, size_t off);
 int http_parser_has_error(http_parser *parser);
 int http_parser_is_finished(http_parser *parser);
+/* 由 http_parser_fast_execute 在解析出完整请求头后调用, 把状态置为完成 */
+void http_parser_set_finished(http_parser *parser, size_t body_start);
 
 #define http_parser_nread(parser) (parser)->nread
 
@@ -0,0 +1,203 @@
+#ifndef __SYLAR_HTTP_BODY_STREAM_H__
+#define __SYLAR_HTTP_BODY_STREAM_H__
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include "http/stream.hh"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief   按需从连接读取的 HTTP 消息体
+ * @details 支持 Content-Length 和 chunked 两种分帧. 每次 read 最多从连接取
+ *          调用者要的字节数, 不读到下一个消息, 调用者不读时也不会把数据
+ *          攒在内存里, 发送方由 TCP 的流量控制限速.
+ *          read 返回 0 表示消息体已经读完; 消息体结束前连接关闭或分帧错误时
+ *          返回 -1, 之后 hasError() 为 true
+ */
+class HttpBodyStream : public Stream {
+  public:
+    using ptr = std::shared_ptr<HttpBodyStream>;
+
+    /**
+     * @brief 从连接读取原始字节, 语义同 Stream::read; 会话先交出已读入缓冲的字节
+     */
+    using ReadCallback = std::function<int(void *buffer, size_t length)>;
+
+    /**
+     * @brief     构造函数
+     * @param[in] cb 读取连接的回调, 在消息体流的整个生命周期内有效
+     * @param[in] chunked 是否按 chunked 分帧
+     * @param[in] content_length 非 chunked 时消息体的长度
+     */
+    HttpBodyStream(const ReadCallback &cb, bool chunked,
+                   uint64_t content_length = 0);
+
+    /**
+     * @brief  读消息体
+     * @return >0 读到的字节数, =0 消息体已读完, <0 连接提前关闭、分帧错误或已关闭
+     */
+    virtual int read(void *buffer, size_t length) override;
+
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * @brief 消息体只读, 总是返回 -1
+     */
+    virtual int write(const void *buffer, size_t length) override;
+
+    virtual int write(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * @brief   不再读取, 之后 read 返回 -1
+     * @details 不关闭连接; 没读完的消息体还留在连接上, 由连接的所有者决定
+     *          丢弃还是断开
+     */
+    virtual void close() override;
+
+    /**
+     * @brief   与连接解除绑定, 由连接的所有者在析构时调用
+     * @details 之后的 read、discard 和 readAll 都返回失败, 不再调用读取回调,
+     *          调用者手里的消息体流可以比连接活得更久
+     */
+    void detach();
+
+    /**
+     * @brief     读完剩余的消息体并丢弃, close() 之后也可以调用
+     * @param[in] max_size 最多丢弃的字节数, 超过时返回 false
+     */
+    bool discard(uint64_t max_size);
+
+    /**
+     * @brief      读完剩余的消息体, 追加到 out
+     * @param[in]  max_size 最多追加的字节数, 超过时返回 false
+     * @return     连接提前关闭、分帧错误或超过 max_size 时返回 false
+     */
+    bool readAll(std::string &out, uint64_t max_size);
+
+    bool isChunked() const { return m_chunked; }
+
+    /**
+     * @brief 消息体是否已完整读完, 包括 chunked 的结束块和 trailer
+     */
+    bool isFinished() const { return m_finished; }
+
+    bool hasError() const { return m_error; }
+
+    /**
+     * @brief 已读出的消息体字节数, 不含 chunked 的分帧
+     */
+    uint64_t getReadSize() const { return m_readSize; }
+
+  private:
+    /**
+     * @brief 按分帧读取, 不检查 m_closed
+     */
+    int readSome(void *buffer, size_t length);
+
+    /**
+     * @brief 读下一个 chunk 的长度行, 遇到结束块时读完 trailer 并置为完成
+     */
+    bool readChunkHead();
+
+    /**
+     * @brief 读一行到 m_line, 去掉结尾的 CRLF, 超过 MAX_CHUNK_LINE 时失败
+     */
+    bool readLine();
+
+    int setError();
+
+  private:
+    /**
+     * @brief chunk 长度行和 trailer 每行的最大长度
+     */
+    static const size_t MAX_CHUNK_LINE = 4096;
+
+    ReadCallback m_cb;
+    bool m_chunked;
+    bool m_finished  = false;
+    bool m_error     = false;
+    bool m_closed    = false;
+    bool m_chunkCrlf = false; /**< 上一个 chunk 的数据之后还有 CRLF 未读 */
+    uint64_t m_left  = 0;     /**< 当前 chunk 或整个消息体剩余的字节数 */
+    uint64_t m_readSize = 0;
+    std::string m_line; /**< 长度行缓冲, 在多个 chunk 间复用 */
+};
+
+/**
+ * @brief   流式发送的 HTTP 消息体
+ * @details chunked 时每次 write 发出一个 chunk, 长度行、数据和结尾的 CRLF
+ *          用一次 writev 发送, close() 发送结束块; 否则原样发送, 由关闭连接
+ *          表示消息体结束. 写失败后 hasError() 为 true, 之后的写都返回 -1
+ */
+class HttpBodyWriter : public Stream {
+  public:
+    using ptr = std::shared_ptr<HttpBodyWriter>;
+
+    /**
+     * @brief 发送 iov 中的全部数据, 可以修改 iov; >0 成功, =0 对方关闭, <0 出错
+     */
+    using WriteCallback = std::function<int(iovec *iov, int count)>;
+
+    /**
+     * @brief     构造函数
+     * @param[in] cb 发送回调, 在写入者的整个生命周期内有效
+     * @param[in] chunked 是否按 chunked 分帧
+     */
+    HttpBodyWriter(const WriteCallback &cb, bool chunked);
+
+    /**
+     * @brief 只写, 总是返回 -1
+     */
+    virtual int read(void *buffer, size_t length) override;
+
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * @brief  发送一段消息体, chunked 时作为一个 chunk; length 为 0 时不发送
+     * @return 成功时返回 length, 失败返回 -1
+     */
+    virtual int write(const void *buffer, size_t length) override;
+
+    virtual int write(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * @brief 结束消息体, chunked 时发送结束块; 不关闭连接
+     */
+    virtual void close() override;
+
+    bool isChunked() const { return m_chunked; }
+
+    bool isClosed() const { return m_closed; }
+
+    bool hasError() const { return m_error; }
+
+    /**
+     * @brief 已发送的消息体字节数, 不含 chunked 的分帧
+     */
+    uint64_t getWriteSize() const { return m_writeSize; }
+
+  private:
+    /**
+     * @brief 发送 data 中共 length 字节, chunked 时在前后加上分帧
+     */
+    int writeChunk(const iovec *data, size_t count, size_t length);
+
+  private:
+    WriteCallback m_cb;
+    bool m_chunked;
+    bool m_closed        = false;
+    bool m_error         = false;
+    uint64_t m_writeSize = 0;
+    std::vector<iovec> m_iovs; /**< 每次发送的 iovec, 复用以免分配 */
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif // __SYLAR_HTTP_BODY_STREAM_H__
@@ -3,10 +3,12 @@
 
 #include <list>
 #include <memory>
+#include <vector>
 
 #include "sylar/thread.hh"
 #include "http/socketstream.hh"
 #include "http/http.hh"
+#include "http/http_body_stream.hh"
 #include "http/uri.hh"
 
 namespace sylar {
@@ -163,10 +165,20 @@ class HttpConnection : public SocketStream { //
     HttpConnection(Socket::ptr sock, bool owner = true);
 
     /**
-     * @brief 响应
+     * @brief  接收响应, 整个响应体读入 HttpResponse::getBody()
+     * @return 失败时关闭连接并返回 nullptr
      */
     HttpResponse::ptr recvResponse();
 
+    /**
+     * @brief   只接收响应头, 响应体通过 HttpResponse::getBodyStream() 按需读取
+     * @details 调用者每次读多少就从连接取多少, 不读时发送方被 TCP 流量控制挡住,
+     *          内存占用只有接收缓冲; 响应体流指向连接, 下一次接收响应时失效.
+     *          要复用连接必须把响应体读到 read 返回 0
+     * @return  失败时关闭连接并返回 nullptr
+     */
+    HttpResponse::ptr recvResponseHead();
+
     /**
      * @brief     发送 HTTP 请求
      * @param[in] req HTTP 请求结构
@@ -174,9 +186,19 @@ class HttpConnection : public SocketStream { //
      */
     int sendRequest(HttpRequest::ptr req);
 
+  private:
+    /**
+     * @brief 响应体流的数据来源: 先取接收缓冲中的字节, 再读 socket
+     */
+    int readBody(void *buffer, size_t length);
+
   private:
     uint64_t m_createTime = 0; /**< 创建时间 */
     uint64_t m_request    = 0; /**< 请求次数 */
+    HttpBodyStream::ptr m_bodyStream; /**< recvResponseHead 的响应体 */
+    std::vector<char> m_recvBuf; /**< 接收缓冲, 大小为 http.response.buffer_size + 1 */
+    size_t m_recvBegin = 0; /**< 缓冲中未处理数据的起始位置 */
+    size_t m_recvEnd   = 0; /**< 缓冲中已读入数据的结束位置 */
 };
 
 /**
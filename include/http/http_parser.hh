@@ -23,13 +23,19 @@ namespace sylar {
        */
 			HttpRequestParser();
 
+      /**
+       * @brief 重置解析状态并换上新的 HttpRequest, 用于同一连接上的下一个请求
+       */
+			void reset();
+
       /**
        * @brief          解析协议
        * @param[in, out] data 协议文本内存
        * @param[in]      len 协议文本内存长度
-       * @return         返回实际解析的长度,并且将已解析的数据移除
+       * @param[in]      move 是否将已解析的数据移除, 为 false 时由调用者跳过返回的长度
+       * @return         返回实际解析的长度
        */
-			size_t execute(char* data, size_t len);
+			size_t execute(char* data, size_t len, bool move = true);
 
       /**
        * @brief  是否解析完成
@@ -79,10 +85,16 @@ namespace sylar {
        */
 			static uint64_t GetHttpRequestMaxBodySize();
 
+      /**
+       * @brief 是否先用 http_parser_fast_execute 解析, 配置项 http.request.fast_parser
+       */
+			static bool IsFastParserEnabled();
+
 		private:
 			http_parser m_parser; /**< http_parser */
 			HttpRequest::ptr m_data; /**< data */
 			int m_error;
+			bool m_started; /**< 是否已解析过当前请求的数据, 快速解析只用于第一次 */
 			};
 
     /**
@@ -0,0 +1,245 @@
+#ifndef __SYLAR_HTTP_REQUEST_VIEW_H__
+#define __SYLAR_HTTP_REQUEST_VIEW_H__
+
+#include "http/http.hh"
+#include "http/http11_parser.hh"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief 指向外部内存的只读字符串, 不持有内存
+ */
+class StringView {
+  public:
+    StringView() : m_data(""), m_size(0) {}
+
+    StringView(const char *data, size_t size) : m_data(data), m_size(size) {}
+
+    StringView(const char *str) : m_data(str), m_size(strlen(str)) {}
+
+    StringView(const std::string &str) : m_data(str.data()), m_size(str.size())
+    {}
+
+    const char *data() const { return m_data; }
+
+    size_t size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+    /**
+     * @brief 拷贝出 std::string
+     */
+    std::string toString() const { return std::string(m_data, m_size); }
+
+    bool operator==(const StringView &rhs) const
+    {
+        return m_size == rhs.m_size && memcmp(m_data, rhs.m_data, m_size) == 0;
+    }
+
+    bool operator!=(const StringView &rhs) const { return !(*this == rhs); }
+
+    /**
+     * @brief 忽略大小写比较
+     */
+    bool equalsIgnoreCase(const StringView &rhs) const
+    {
+        return m_size == rhs.m_size && strncasecmp(m_data, rhs.m_data, m_size) == 0;
+    }
+
+  private:
+    const char *m_data;
+    size_t m_size;
+};
+
+/**
+ * @brief   HTTP 请求的视图
+ * @details 请求行和头部字段都指向接收缓冲中的原始字节, 解析时不做拷贝;
+ *          头部按出现顺序存放在数组里, 名字的哈希在解析时算好, 查找时先比哈希.
+ *          视图只在接收缓冲不变时有效, 需要长期持有时用 toRequest 转成 HttpRequest
+ */
+class HttpRequestView {
+  public:
+    /**
+     * @brief 一个头部字段
+     */
+    struct Header {
+        uint32_t hash;    /**< 小写名字的哈希 */
+        StringView name;  /**< 字段名, 保留原始大小写 */
+        StringView value; /**< 字段值 */
+    };
+
+    HttpRequestView();
+
+    /**
+     * @brief 清空内容, 保留头部数组的容量供下一个请求复用
+     */
+    void clear();
+
+    HttpMethod getMethod() const { return m_method; }
+
+    uint8_t getVersion() const { return m_version; }
+
+    const StringView &getPath() const { return m_path; }
+
+    const StringView &getQuery() const { return m_query; }
+
+    const StringView &getFragment() const { return m_fragment; }
+
+    const StringView &getBody() const { return m_body; }
+
+    const std::vector<Header> &getHeaders() const { return m_headers; }
+
+    /**
+     * @brief 是否在响应后关闭连接, 只有 Connection: keep-alive 且没有被
+     *        setClose(true) 强制关闭时保持连接
+     */
+    bool isClose() const;
+
+    /**
+     * @brief 强制在响应后关闭连接, 不论 Connection 字段
+     */
+    void setClose(bool v) { m_close = v; }
+
+    void setMethod(HttpMethod v) { m_method = v; }
+
+    void setVersion(uint8_t v) { m_version = v; }
+
+    void setPath(const StringView &v) { m_path = v; }
+
+    void setQuery(const StringView &v) { m_query = v; }
+
+    void setFragment(const StringView &v) { m_fragment = v; }
+
+    void setBody(const StringView &v) { m_body = v; }
+
+    /**
+     * @brief 追加头部字段, 同名字段都会保留, 查找时返回第一个
+     */
+    void addHeader(const StringView &name, const StringView &value);
+
+    /**
+     * @brief     查找头部字段, 忽略大小写
+     * @param[out] value 找到时保存字段值
+     * @return    是否存在
+     */
+    bool findHeader(const StringView &name, StringView &value) const;
+
+    /**
+     * @brief  获取头部字段的值, 不存在时返回 def
+     */
+    StringView getHeader(const StringView &name,
+                         const StringView &def = StringView()) const;
+
+    bool hasHeader(const StringView &name) const
+    {
+        StringView v;
+        return findHeader(name, v);
+    }
+
+    /**
+     * @brief     获取头部字段并转换类型
+     * @return    如果存在且转换成功返回对应的值,否则返回 def
+     */
+    template <class T>
+    T getHeaderAs(const StringView &name, const T &def = T()) const
+    {
+        StringView v;
+        if (!findHeader(name, v)) {
+            return def;
+        }
+        try {
+            return boost::lexical_cast<T>(v.data(), v.size());
+        } catch (...) {
+        }
+        return def;
+    }
+
+    /**
+     * @brief     拷贝成 HttpRequest, 兼容原有的接口
+     * @param[in] body 是否拷贝请求体
+     */
+    HttpRequest::ptr toRequest(bool body = true) const;
+
+    /**
+     * @brief 忽略大小写的字段名哈希
+     */
+    static uint32_t HashName(const char *name, size_t len);
+
+  private:
+    HttpMethod m_method;          /**< HTTP 方法 */
+    uint8_t m_version;            /**< HTTP 版本 */
+    StringView m_path;            /**< 请求路径 */
+    StringView m_query;           /**< 原始查询字符串 */
+    StringView m_fragment;        /**< 请求 fragment */
+    StringView m_body;            /**< 请求体 */
+    std::vector<Header> m_headers; /**< 按出现顺序存放的头部字段 */
+    bool m_close = false;          /**< 强制关闭连接 */
+};
+
+/**
+ * @brief   把请求头解析到 HttpRequestView
+ * @details 与 HttpRequestParser 使用同样的快速解析和 ragel 状态机, 但回调只记录位置;
+ *          输入需要包含完整的请求头, 解析结果指向输入内存
+ */
+class HttpRequestViewParser {
+  public:
+    /**
+     * @brief     构造函数
+     * @param[in] view 解析结果, 生命周期需长于解析器
+     */
+    explicit HttpRequestViewParser(HttpRequestView *view);
+
+    /**
+     * @brief 重置解析状态并清空 view, 用于下一个请求
+     */
+    void reset();
+
+    /**
+     * @brief     解析协议, 不移动输入数据
+     * @param[in] data 协议文本内存, 解析结果指向这里
+     * @param[in] len 协议文本内存长度
+     * @return    返回实际解析的长度, 请求头完整时为请求头的长度
+     */
+    size_t execute(const char *data, size_t len);
+
+    /**
+     * @brief 是否解析完成
+     */
+    int isFinished();
+
+    /**
+     * @brief 是否有错误
+     */
+    int hasError();
+
+    /**
+     * @brief     设置错误, 错误码同 HttpRequestParser
+     */
+    void setError(int v) { m_error = v; }
+
+    HttpRequestView *getView() const { return m_view; }
+
+    /**
+     * @brief 获取消息体长度
+     */
+    uint64_t getContentLength() const
+    {
+        return m_view->getHeaderAs<uint64_t>("content-length", 0);
+    }
+
+  private:
+    http_parser m_parser;    /**< http_parser */
+    HttpRequestView *m_view; /**< 解析结果 */
+    int m_error;
+    bool m_started; /**< 是否已解析过当前请求的数据, 快速解析只用于第一次 */
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif // __SYLAR_HTTP_REQUEST_VIEW_H__
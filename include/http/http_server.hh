@@ -38,6 +38,19 @@ class HttpServer : public TcpServer {
         m_dispatcher = dispatcher;
     }
 
+    /**
+     * @brief 请求体是否交给处理函数按需读取
+     */
+    bool isStreamBody() const { return m_streamBody; }
+
+    /**
+     * @brief     设置请求体是否交给处理函数按需读取
+     * @details   为 true 时用 HttpSession::recvRequestHead 接收请求, 处理函数从
+     *            HttpRequest::getBodyStream() 读取请求体, getBody() 为空;
+     *            处理函数没读完的请求体在发送响应前丢弃, 剩余太多时关闭连接
+     */
+    void setStreamBody(bool v) { m_streamBody = v; }
+
   protected:
     virtual void handleClient(Socket::ptr client) override;
 
@@ -45,6 +58,7 @@ class HttpServer : public TcpServer {
 
   private:
     bool m_isKeepAlive; /**< 是否支持长连接 */
+    bool m_streamBody = false; /**< 请求体是否按需读取 */
 };
 } // namespace http
 } // namespace sylar
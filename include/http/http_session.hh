@@ -3,6 +3,11 @@
 
 #include "http/socketstream.hh"
 #include "http/http.hh"
+#include "http/http_body_stream.hh"
+#include "http/http_parser.hh"
+#include "http/http_request_view.hh"
+
+#include <vector>
 
 namespace sylar {
 namespace http {
@@ -23,18 +28,114 @@ class HttpSession : public SocketStream {
     HttpSession(Socket::ptr sock, bool owner = true);
 
     /**
-     * @brief 接收HTTP请求
+     * @brief 析构函数, 解除当前消息体流与会话的绑定
+     */
+    ~HttpSession();
+
+    /**
+     * @brief   接收HTTP请求
+     * @details 接收缓冲和解析器属于会话, 在同一连接的多个请求间复用;
+     *          读到的下一个请求的字节留在缓冲中, 支持 HTTP/1.1 管线化.
+     *          请求体按 Content-Length 或 chunked 接收, chunked 解码后放入请求体
+     * @return  失败时关闭连接并返回 nullptr
      */
     HttpRequest::ptr recvRequest();
 
+    /**
+     * @brief   接收HTTP请求, 不拷贝请求行和头部
+     * @details 返回的视图属于会话, 指向接收缓冲, 下一次接收请求前有效
+     * @return  失败时关闭连接并返回 nullptr
+     */
+    const HttpRequestView *recvRequestView();
+
+    /**
+     * @brief   只接收请求头, 请求体由处理函数通过 getBodyStream() 按需读取
+     * @details 请求体不受 http.request.max_body_size 限制, 内存占用只有接收缓冲;
+     *          请求体流指向会话, 下一次接收请求时失效
+     * @return  失败时关闭连接并返回 nullptr
+     */
+    HttpRequest::ptr recvRequestHead();
+
+    /**
+     * @brief   丢弃 recvRequestHead 的请求体中处理函数没有读完的部分
+     * @details 剩余部分不超过 http.request.buffer_size 时读完丢弃, 连接可以继续复用
+     * @return  false 表示请求体读取出错或剩余太多, 连接不能再接收下一个请求
+     */
+    bool skipRequestBody();
+
     /**
      * @brief     发送HTTP 响应
+     * @details   响应头序列化到会话内复用的缓冲中, 与消息体一起用一次 writev 发出,
+     *            不再拷贝消息体; 文件响应体在响应头之后用 sendfile 发送,
+     *            不超过 SMALL_FILE_SIZE 的文件读入响应头缓冲一起发送;
+     *            设置了 HttpResponse::setBodyProducer 的响应见 sendProducedBody
      * @param[in] rsp HTTP 响应
      * @return    >0 发送成功
      *         =0 对方关闭
      *         <0 Socket 异常
      */
     int sendResponse(HttpResponse::ptr rsp);
+
+  private:
+    /**
+     * @brief   把下一个请求头读入接收缓冲并解析, 成功后 m_recvBegin 指向请求体
+     * @tparam  Parser HttpRequestParser 或 HttpRequestViewParser
+     * @return  失败时已关闭连接
+     */
+    template <class Parser> bool recvHead(Parser &parser);
+
+    /**
+     * @brief      接收请求体, 已在缓冲中的直接指向缓冲, 否则读入 m_body
+     * @param[in]  framing 0 按 content_size, 1 chunked 解码进 m_body, -1 不支持
+     * @param[out] body 请求体
+     * @return     失败时已关闭连接
+     */
+    bool recvBody(uint64_t content_size, int framing, StringView &body);
+
+    /**
+     * @brief 请求体流的数据来源: 先取接收缓冲中的字节, 再读 socket
+     */
+    int readBody(void *buffer, size_t length);
+
+    /**
+     * @brief   发送由生成函数产生的响应体
+     * @details 先发出响应头, 再把 HttpBodyWriter 交给生成函数; HTTP/1.1 用 chunked,
+     *          HTTP/1.0 原样发送并把响应置为关闭连接. 对 HEAD 请求的响应和
+     *          204/304 响应只发响应头, 不调用生成函数
+     * @return  >0 发送成功, <=0 发送或生成失败, 响应已置为关闭连接
+     */
+    int sendProducedBody(HttpResponse::ptr rsp);
+
+    /**
+     * @brief     发送 iov 中的全部数据, 处理部分写
+     * @param[in] flags 传给 sendmsg 的标志
+     * @return    >0 发送成功, =0 对方关闭, <0 Socket 异常
+     */
+    int sendFixSize(iovec *iov, int count, int flags = 0);
+
+    /**
+     * @brief  用 sendfile 发送文件响应体
+     * @return >0 发送成功, =0 对方关闭, <0 Socket 异常或文件被截断
+     */
+    int sendFile(const HttpFileBody &file);
+
+  private:
+    /**
+     * @brief 不超过该大小的文件响应体直接读入响应头缓冲发送
+     */
+    static const size_t SMALL_FILE_SIZE = 16 * 1024;
+
+    std::string m_head; /**< 响应头缓冲, 在同一连接的多个响应间复用 */
+    HttpRequestParser m_parser; /**< recvRequest 的解析器, 每个请求前 reset */
+    HttpRequestView m_view; /**< recvRequestView 返回的请求, 指向接收缓冲 */
+    HttpRequestViewParser m_viewParser; /**< 解析到 m_view, 每个请求前 reset */
+    std::string m_body; /**< 接收缓冲装不下的请求体 */
+    HttpBodyStream::ptr m_bodyStream; /**< recvRequestHead 的请求体 */
+    bool m_headRequest = false; /**< 最近接收的请求是 HEAD, 响应不带响应体 */
+    std::vector<char> m_recvBuf; /**< 接收缓冲, 大小为 http.request.buffer_size */
+    size_t m_recvBegin = 0; /**< 缓冲中未处理数据的起始位置 */
+    size_t m_recvEnd   = 0; /**< 缓冲中已读入数据的结束位置 */
+    size_t m_recvFloor = 0; /**< readBody 补充缓冲时的起始位置, 之前是视图指向的请求头 */
 };
 
 }; // namespace http
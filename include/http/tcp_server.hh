@@ -39,6 +39,16 @@ class TcpServer : public std::enable_shared_from_this<TcpServer>, Noncopyable {
     void setRecvTimeout(uint64_t v) { m_recvTimeout = v; }
     bool isStop() const { return m_isStop; }
 
+    /**
+     * @brief   设置是否按工作线程分片监听
+     * @details 开启后 bind 为 worker 的每个线程各创建一个 SO_REUSEPORT 的监听 socket,
+     *          start 时把各自的 accept 协程固定到对应线程, 新连接也在该线程处理,
+     *          不再经过 accept_worker 转交. 需在 bind 之前设置
+     */
+    void setReusePort(bool v) { m_reusePort = v; }
+
+    bool isReusePort() const { return m_reusePort; }
+
     /**
      * @brief 析构函数
      */
@@ -83,11 +93,13 @@ class TcpServer : public std::enable_shared_from_this<TcpServer>, Noncopyable {
 
   private:
     std::vector<Socket::ptr> m_socks; /**< 监听 Socket 数组 */
+    std::vector<int> m_sockThreads;   /**< 监听 Socket 固定的线程, -1 表示不固定 */
     IOManager *m_worker;              /**< 新连接的 Socket 工作的调度器 */
     IOManager *m_acceptWorker;        /**< 服务器 Socket 接受连接的调度器 */
     uint64_t m_recvTimeout;           /**< 接受超时时间 */
     std::string m_name;               /**< 服务器名称 */
     bool m_isStop;                    /**< 服务是否停止 */
+    bool m_reusePort = false;         /**< 是否按工作线程分片监听 */
 };
 }; // namespace sylar
 
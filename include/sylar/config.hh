@@ -17,13 +17,17 @@
 #include <list>
 #include <yaml-cpp/yaml.h>
 #include "sylar/log.hh"
+#include <atomic>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 #include <map>
 #include <functional>
+#include <vector>
 
 #include "sylar/thread.hh"
 #include "sylar/log.hh"
+#include "sylar/rcu.hh"
 
 namespace sylar {
 
@@ -363,6 +367,12 @@ class LexicalCast<std::unordered_map<std::string, T>, std::string> {
 
 // FROMSTRING T operator(const std::string&);
 // TOString T operator() (const T&);
+/**
+ * @brief   配置变量
+ * @details 当前值是一份不可变的 RCU 快照, getValue 在读侧临界区内拷贝一份, 不加锁.
+ *          setValue 在写锁内比较、通知监听者并发布新快照, 解锁后等读者退出再释放旧快照,
+ *          任何时候只保留当前这一份
+ */
 template <class T, class FromStr = LexicalCast<std::string, T>,
           class ToStr = LexicalCast<T, std::string>>
 class ConfigVar : public ConfigVarBase {
@@ -375,7 +385,7 @@ class ConfigVar : public ConfigVarBase {
 
     ConfigVar(const std::string &name, const T &default_value,
               const std::string &description = "")
-        : ConfigVarBase(name, description), m_val(default_value)
+        : ConfigVarBase(name, description), m_val(new T(default_value))
     {}
 
     /*
@@ -386,12 +396,11 @@ class ConfigVar : public ConfigVarBase {
     {
         try {
             // return boost::lexical_cast<std::string>(m_val);
-            RWMutexType::ReadLock lock(m_mutex);
-            return ToStr()(m_val);
+            return ToStr()(getValue());
         } catch (std::exception &e) {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT())
                 << "<< ConfigVar::toString exception: " << e.what()
-                << " convert: " << typeid(m_val).name() << " to string >>";
+                << " convert: " << typeid(T).name() << " to string >>";
         }
 
         return "";
@@ -410,31 +419,56 @@ class ConfigVar : public ConfigVarBase {
         } catch (std::exception &e) {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT())
                 << "ConfigVar::toString exception" << e.what()
-                << " convert string to " << typeid(m_val).name() << "- " << val;
+                << " convert string to " << typeid(T).name() << "- " << val;
         }
         return false;
     }
 
-    const T& getValue()
+    /**
+     * @brief   返回当前值的拷贝, 无锁
+     * @details 快照在 setValue 之后会被释放, 所以按值返回, 不返回引用;
+     *          热路径上读较大的类型时用 getSnapshot 避免拷贝
+     */
+    const T getValue() const
+    {
+        RcuReadLock lock;
+        return *m_val.get();
+    }
+
+    /**
+     * @brief   返回当前值的只读句柄, 一次原子读取, 不拷贝
+     * @details 句柄存在期间快照不会被释放, 持有期间的限制见 RcuSnapshot.
+     *          只在一次调用内使用, 不要跨越 IO 或保存起来
+     */
+    RcuSnapshot<const T> getSnapshot() const
     {
-        RWMutex::ReadLock lock(m_mutex);
-        return m_val;
+        return RcuSnapshot<const T>(m_val);
     }
 
+    /**
+     * @brief   设置新值, 与当前值相等时什么也不做
+     * @details 比较、监听回调和发布在同一把写锁内, 并发的 setValue 依次进行,
+     *          回调看到的旧值就是被替换的值. 回调中不能再修改本变量或增删监听
+     */
     void setValue(const T &v)
     {
+        const T *old = nullptr;
         {
-            RWMutex::ReadLock lock(m_mutex);
-            if (v == m_val) {
+            RWMutexType::WriteLock lock(m_mutex);
+            // 写者持有写锁, 快照不会在这期间被释放
+            const T &cur = *m_val.get();
+            if (v == cur) {
                 return;
             }
             for (auto &i : m_cbs)
             { // 在设置变量的时候, 进行函数的回调, 提示属性修改. 观察者
-                i.second(m_val, v);
+                i.second(cur, v);
             }
+            old = m_val.exchange(new T(v));
         }
-        RWMutex::WriteLock lock(m_mutex);
-        m_val = v;
+        // 等还在读旧快照的 getValue 退出后释放
+        RcuSynchronize();
+        delete old;
     }
 
     std::string getTypeName() const override { return typeid(T).name(); };
@@ -468,7 +502,7 @@ class ConfigVar : public ConfigVarBase {
     }
 
   private:
-    T m_val;
+    RcuPtr<const T> m_val; /**< 当前快照, 发布由写锁保护 */
     RWMutexType m_mutex;
 
     // 变更回调函数, key 要唯一, 用map将回调函数包装, 可以方便的添加或删除
@@ -559,12 +593,36 @@ class Config {
     */
     static void LoadFromYaml(const YAML::Node &root);
 
+    /**
+     * @brief     按与上次加载的配置树的差异加载配置
+     * @details   内容未变的子树直接跳过, 只对值变化或新出现的配置项调用 fromString,
+     *            从而只触发这些配置项的监听回调. 从配置树中删除的键保持原值
+     * @param[in] root 新的配置树
+     * @param[in] old  上次加载的配置树, 未定义时等同于 LoadFromYaml
+     * @return    调用了 fromString 的配置项个数
+     */
+    static size_t LoadFromYamlDiff(const YAML::Node &root, const YAML::Node &old);
+
     /**
      * @brief     加载 path 文件夹内的配置文件
+     * @details   只重新解析修改时间变化的文件, 并与该文件上次加载的内容做差异加载
      * @param[in] path 加载的路径
      */
     static void LoadFromConfDir(const std::string& path);
 
+    /**
+     * @brief     用 inotify 监视配置文件夹, 文件变化后在后台线程调用 LoadFromConfDir
+     * @details   连续的修改合并为一次加载, 监听回调在后台线程中执行
+     * @param[in] path 监视的路径, 包括子文件夹
+     * @return    已在监视或 inotify 初始化失败时返回 false
+     */
+    static bool WatchConfDir(const std::string &path);
+
+    /**
+     * @brief 停止监视配置文件夹
+     */
+    static void UnwatchConfDir();
+
     /**
     * @brief     从底层的存储结构中查找指定字符串
     * @param[in] name 待查找的字符串
@@ -1,16 +1,21 @@
 #ifndef __SYLAR_FD_MANAGER_H__
 #define __SYLAR_FD_MANAGER_H__
 
+#include "sylar/segmented_array.hh"
 #include "sylar/singleton.hh"
 #include "sylar/thread.hh"
-#include <vector>
-#include <memory>
+#include <atomic>
+#include <stdint.h>
 
 namespace sylar {
 
-class FdCtx : public std::enable_shared_from_this<FdCtx> {
+/**
+ * @brief   文件句柄上下文
+ * @details 由 FdManager 持有且从不释放, 句柄号被复用时原地重新初始化,
+ *          因此拿到的指针在进程内始终有效
+ */
+class FdCtx {
   public:
-    using ptr = std::shared_ptr<FdCtx>;
     FdCtx(int fd);
     ~FdCtx();
 
@@ -71,6 +76,9 @@ class FdCtx : public std::enable_shared_from_this<FdCtx> {
     uint64_t getTimeout(int type);
 
   private:
+    friend class FdManager;
+
+    std::atomic<bool> m_inUse{false}; /**< 句柄是否打开, del 后为 false 直到句柄号被复用 */
     bool m_isInit      :1;  /**< 是否初始化完成 */
     bool m_isSocket    :1;  /**< 是否是 socket 类型的 fd */
     bool m_sysNonblock :1;  /**< 系统是否设置非阻塞 */
@@ -83,7 +91,7 @@ class FdCtx : public std::enable_shared_from_this<FdCtx> {
 
 class FdManager {
   public:
-    using RWMutexType = RWMutex;
+    using MutexType = Mutex;
 
     /**
      * @brief 无参构造函数
@@ -94,9 +102,10 @@ class FdManager {
      * @brief     获取/创建文件句柄类FdCtx
      * @param[in] fd 文件句柄
      * @param[in] auto_create 是否自动创建
-     * @return    返回对应文件句柄类FdCtx::ptr
+     * @return    返回对应文件句柄类, 不存在且不创建时返回 nullptr
+     * @details   查找不加锁, 也不增加引用计数
      */
-    FdCtx::ptr get(int fd, bool auto_create = false);
+    FdCtx *get(int fd, bool auto_create = false);
 
     /**
      * @brief     删除文件句柄类
@@ -105,8 +114,8 @@ class FdManager {
     void del(int fd);
 
   private:
-    RWMutexType m_mutex;
-    std::vector<FdCtx::ptr> m_datas;
+    MutexType m_mutex;             /**< 串行化句柄上下文的创建与复用 */
+    SegmentedArray<FdCtx> m_datas; /**< 以句柄为下标的上下文 */
 };
 
 using FdMgr = Singleton<FdManager>;
@@ -2,13 +2,15 @@
 #define __SYLAR_FIBER_H__
 
 #include "sylar/thread.hh"
+#include "sylar/fiber_context.hh"
 #include <functional>
 #include <memory>
-#include <ucontext.h>
 
 namespace sylar {
 
 class Scheduler;
+class StackAllocator;
+struct FiberSharedStack;
 
 class Fiber : public std::enable_shared_from_this<Fiber> {
 friend class Scheduler;
@@ -31,8 +33,13 @@ friend class Scheduler;
      * @param[in] cb 协程执行的函数
      * @param[in] stacksize 协程栈大小
      * @param[in] return_to_mainFiber 是否在MainFiber上调度
+     * @param[in] shared_stack 是否运行在线程共享栈上
+     * @details   共享栈协程首次 swapIn 时绑定到当前线程的一个共享栈, 之后只能在该线程上执行;
+     *            被其他协程挤出共享栈时只拷贝栈上实际使用的部分, 挂起时每个协程只占用 KB 级内存.
+     *            协程挂起期间其栈上的地址会被其他协程覆盖, 不能交给其他协程或内核异步访问
      */
-    Fiber(std::function<void()> cb, size_t stacksize = 0, bool return_to_mainFiber = false);
+    Fiber(std::function<void()> cb, size_t stacksize = 0,
+          bool return_to_mainFiber = false, bool shared_stack = false);
 	~Fiber();
 
 	// 重置协程相关内容
@@ -54,6 +61,16 @@ friend class Scheduler;
    */
 	State getState() { return m_state; }
 
+  /**
+   * @brief 是否运行在共享栈上
+   */
+	bool isSharedStack() const { return m_sharedStack; }
+
+  /**
+   * @brief 共享栈协程绑定的线程 ID, 未绑定或普通协程返回 -1
+   */
+	int getSharedStackThread() const { return m_sharedThread; }
+
 	/**
 	 * @brief  获得实际中的 fiber id
 	 * @return fiber id
@@ -114,12 +131,31 @@ friend class Scheduler;
   private:
     Fiber();
 
+	/**
+	 * @brief 切入前占用共享栈: 保存原占用者的栈, 恢复自己的栈
+	 */
+	void acquireSharedStack();
+
+	/**
+	 * @brief 将共享栈上实际使用的部分拷贝到私有缓冲区
+	 */
+	void saveSharedStack();
+
 	uint64_t m_id = 0; /**< 协程 ID */
 	uint32_t m_stacksize = 0; /**< 协程运行栈大小 */
 	State m_state = INIT; /**< 协程状态 */
 
-	ucontext_t m_ctx; /**< 协程上下文 */
+	FiberContext m_ctx; /**< 协程上下文 */
 	void * m_stack = nullptr; /**< 协程运行栈指针 */
+	StackAllocator * m_allocator = nullptr; /**< 分配运行栈的分配器 */
+
+	bool m_sharedStack = false; /**< 是否运行在共享栈上 */
+	bool m_ctxPending = false; /**< 共享栈上下文是否尚未创建 */
+	int m_sharedThread = -1; /**< 共享栈所属线程 ID */
+	std::shared_ptr<FiberSharedStack> m_shared; /**< 绑定的共享栈 */
+	char * m_savedStack = nullptr; /**< 被挤出时保存的栈内容 */
+	size_t m_savedSize = 0; /**< 保存的栈内容大小 */
+	size_t m_savedCapacity = 0; /**< 保存缓冲区容量 */
 
 	std::function<void()> m_cb;  /**< 协程运行函数 */
 };
@@ -0,0 +1,102 @@
+/**
+ * @file      fiber_context.hh
+ * @brief     协程上下文切换封装
+ * @details   默认使用 ucontext; 编译时打开 SYLAR_FIBER_ASM_CONTEXT 且平台为
+ *            x86-64/aarch64 时, 使用手写汇编只保存 callee-saved 寄存器,
+ *            不保存信号掩码, 切换时没有系统调用
+ * @author    edward
+ * @copyright BSD-3-Clause
+ */
+#ifndef __SYLAR_FIBER_CONTEXT_H__
+#define __SYLAR_FIBER_CONTEXT_H__
+
+#include <cstddef>
+
+#if defined(SYLAR_FIBER_ASM_CONTEXT) && (defined(__x86_64__) || defined(__aarch64__))
+#define SYLAR_FIBER_USE_ASM 1
+#else
+#include <ucontext.h>
+#endif
+
+#ifdef SYLAR_FIBER_USE_ASM
+extern "C" {
+/**
+ * @brief     保存当前寄存器到 *from_sp 指向的栈, 并切换到 to_sp 对应的上下文
+ * @param[out] from_sp 保存当前上下文栈指针的位置
+ * @param[in] to_sp 目标上下文的栈指针
+ */
+void sylar_fctx_swap(void **from_sp, void *to_sp);
+}
+#endif
+
+namespace sylar {
+
+/**
+ * @brief 协程上下文
+ */
+class FiberContext {
+  public:
+    using EntryFunc = void (*)();
+
+    /**
+     * @brief 以当前执行流初始化上下文(线程主协程使用)
+     * @return 是否成功
+     */
+    bool init();
+
+    /**
+     * @brief     在指定栈上创建一个新的上下文, 首次切入时执行 fn
+     * @param[in] stack 栈底地址
+     * @param[in] size 栈大小
+     * @param[in] fn 入口函数, 不允许返回
+     * @return    是否成功
+     */
+    bool make(void *stack, size_t size, EntryFunc fn);
+
+    /**
+     * @brief     保存当前上下文到 from, 切换到 to
+     * @return    是否成功
+     */
+    static bool Swap(FiberContext &from, FiberContext &to)
+    {
+#ifdef SYLAR_FIBER_USE_ASM
+        sylar_fctx_swap(&from.m_sp, to.m_sp);
+        return true;
+#else
+        return !swapcontext(&from.m_ctx, &to.m_ctx);
+#endif
+    }
+
+    /**
+     * @brief 返回上下文切出时的栈指针, 未知平台返回 nullptr
+     * @details 共享栈协程据此只拷贝栈上实际使用的部分
+     */
+    void *getStackPointer() const
+    {
+#ifdef SYLAR_FIBER_USE_ASM
+        return m_sp;
+#elif defined(__x86_64__)
+        return (void *)m_ctx.uc_mcontext.gregs[REG_RSP];
+#elif defined(__aarch64__)
+        return (void *)m_ctx.uc_mcontext.sp;
+#else
+        return nullptr;
+#endif
+    }
+
+    /**
+     * @brief 返回编译时选择的切换实现名称
+     */
+    static const char *BackendName();
+
+  private:
+#ifdef SYLAR_FIBER_USE_ASM
+    void *m_sp = nullptr; /**< 切出时保存的栈指针, 寄存器保存在栈上 */
+#else
+    ucontext_t m_ctx; /**< ucontext 上下文 */
+#endif
+};
+
+} // namespace sylar
+
+#endif // __SYLAR_FIBER_CONTEXT_H__
@@ -68,6 +68,10 @@ extern sendto_fun sendto_f;
 typedef int (*sendmsg_fun)(int s, const struct msghdr *msg, int flags);
 extern sendmsg_fun sendmsg_f;
 
+typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset,
+                                size_t count);
+extern sendfile_fun sendfile_f;
+
 typedef int (*fcntl_fun)(int fd, int op, ...);
 extern fcntl_fun fcntl_f;
 
@@ -0,0 +1,127 @@
+/**
+ * @file      io_uring.hh
+ * @brief     io_uring 提交/完成队列的最小封装
+ * @details   直接使用 io_uring_setup/io_uring_enter 系统调用和 mmap 的环形队列,
+ *            不依赖 liburing. 每次提交后立即 io_uring_enter, 提交队列中不会积压请求;
+ *            完成通知通过注册的 eventfd 交给 IOManager 的 epoll 循环
+ * @author    edward
+ * @copyright BSD-3-Clause
+ */
+#ifndef __SYLAR_IO_URING_H__
+#define __SYLAR_IO_URING_H__
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include "sylar/noncopyable.hh"
+#include "sylar/thread.hh"
+
+namespace sylar {
+
+/**
+ * @brief io_uring 实例
+ */
+class IoUring : Noncopyable {
+  public:
+    using MutexType = Mutex;
+
+    IoUring() = default;
+
+    /**
+     * @brief 析构函数, 解除队列映射并关闭 io_uring 句柄
+     */
+    ~IoUring();
+
+    /**
+     * @brief     创建 io_uring 实例并映射提交/完成队列
+     * @param[in] entries 提交队列长度, 内核会向上取整到 2 的幂
+     * @return    内核不支持(含不支持按句柄取消)或资源不足时返回 false
+     */
+    bool init(uint32_t entries);
+
+    /**
+     * @brief     注册 eventfd, 每产生一个 CQE 内核都会对其计数加一
+     * @param[in] efd eventfd 句柄
+     */
+    bool registerEventfd(int efd);
+
+    /**
+     * @brief     提交一个请求, 可选地链接一个超时请求
+     * @param[in] sqe 已填充操作码/句柄/参数的请求, user_data 由 user_data 参数覆盖
+     * @param[in] user_data 请求完成时 CQE 携带的数据
+     * @param[in] ts 超时时间, 为 nullptr 时不链接超时请求
+     * @param[in] timeout_user_data 超时请求 CQE 携带的数据
+     * @return    提交队列已满或 io_uring_enter 没有取走请求时返回 false,
+     *            此时请求已从队列撤回
+     * @attention 超时时间在提交时已被内核拷贝, 调用返回后 ts 可以释放
+     */
+    bool submit(const io_uring_sqe &sqe, uint64_t user_data,
+                const __kernel_timespec *ts = nullptr,
+                uint64_t timeout_user_data = 0);
+
+    /**
+     * @brief     取走全部已完成的 CQE
+     * @param[in] cb 对每个 CQE 调用 cb(user_data, res)
+     * @return    处理的 CQE 数量
+     */
+    template <class Callback>
+    size_t reap(Callback cb)
+    {
+        MutexType::Lock lock(m_cqMutex);
+        if (__atomic_load_n(m_sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+            flushOverflow();
+        }
+
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        size_t count  = 0;
+        while (head != tail) {
+            const io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+            cb(cqe.user_data, cqe.res);
+            ++head;
+            ++count;
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+  private:
+    /**
+     * @brief   确认内核支持按句柄取消全部请求(IORING_ASYNC_CANCEL_FD, 5.19+)
+     * @details IOManager::cancelAll 依赖它唤醒关闭句柄上等待的协程; 旧内核对
+     *          未知的 cancel_flags 返回 -EINVAL. 在注册 eventfd 之前同步完成
+     */
+    bool probeCancelFd();
+
+    /**
+     * @brief 完成队列溢出时让内核把暂存的 CQE 写回队列
+     */
+    void flushOverflow();
+
+  private:
+    int m_fd = -1; /**< io_uring 句柄 */
+
+    void *m_ring       = nullptr; /**< 提交/完成队列共用的映射 */
+    size_t m_ringSize  = 0;       /**< m_ring 映射长度 */
+    io_uring_sqe *m_sqes = nullptr; /**< SQE 数组 */
+    size_t m_sqesSize  = 0;       /**< m_sqes 映射长度 */
+
+    unsigned *m_sqHead  = nullptr;
+    unsigned *m_sqTail  = nullptr;
+    unsigned *m_sqFlags = nullptr;
+    unsigned *m_sqArray = nullptr;
+    unsigned m_sqMask    = 0;
+    unsigned m_sqEntries = 0;
+
+    unsigned *m_cqHead    = nullptr;
+    unsigned *m_cqTail    = nullptr;
+    io_uring_cqe *m_cqes  = nullptr;
+    unsigned m_cqMask     = 0;
+
+    MutexType m_sqMutex; /**< 保护提交队列尾部 */
+    MutexType m_cqMutex; /**< 保护完成队列头部 */
+};
+
+} // namespace sylar
+
+#endif // __SYLAR_IO_URING_H__
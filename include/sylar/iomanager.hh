@@ -2,12 +2,19 @@
 #define __SYLAR_IMANAGER_H__
 
 #include "sylar/scheduler.hh"
+#include "sylar/segmented_array.hh"
 #include "sylar/timer.hh"
 
+struct io_uring_sqe;
+
 namespace sylar {
 
+class IoUring;
+
 /**
- * @brief 基于Epoll的IO协程调度器
+ * @brief   基于Epoll的IO协程调度器
+ * @details 配置 iomanager.backend 为 io_uring 时, hook 的 socket IO 直接提交给 io_uring,
+ *          完成通知经 eventfd 汇入 epoll 循环; 内核不支持时回退到 epoll
  */
 class IOManager : public Scheduler, public TimerManager {
   public:
@@ -44,6 +51,19 @@ class IOManager : public Scheduler, public TimerManager {
             Scheduler *scheduler = nullptr;     /**< 事件执行的scheduler */
             Fiber::ptr fiber;                   /**< 事件协程 */
             std::function<void()> cb;           /**< 事件的回调函数 */
+            int thread           = -1;          /**< 等待方固定的线程, 触发后回到该线程执行 */
+
+            uint64_t seq        = 0; /**< 等待序号, 每次 addEvent 加一 */
+            uint64_t timedoutSeq = 0; /**< 最近一次因超时结束的等待序号 */
+
+            // 以下字段由 IOManager::m_deadlineLock 保护
+            FdContext *owner      = nullptr; /**< 所属的句柄上下文 */
+            Event event           = NONE;    /**< 对应的事件类型 */
+            uint64_t deadline     = 0;       /**< 超时时间点(毫秒) */
+            uint64_t deadlineSeq  = 0;       /**< deadline 对应的等待序号 */
+            EventContext *dlPrev  = nullptr; /**< 超时槽链表 */
+            EventContext *dlNext  = nullptr; /**< 超时槽链表 */
+            bool dlLinked         = false;   /**< 是否在超时槽中 */
         };
 
         /**
@@ -69,10 +89,22 @@ class IOManager : public Scheduler, public TimerManager {
         EventContext write;  /**< 写事件 */
         int fd       = 0;    /**< 事件关联的句柄 */
         Event events = NONE; /**< 已经注册的事件 */
+        Event readyEvents = NONE; /**< 持久注册时, 没有等待者期间到达的就绪边沿 */
+        bool registered   = false; /**< 持久注册时, 句柄是否已加入 epoll */
         MutexType mutex;     /**< 锁 */
     };
 
   public:
+    /**
+     * @brief 系统调用计数, 用于衡量事件注册的开销
+     */
+    struct Stats {
+        uint64_t epollWait = 0; /**< epoll_wait 调用次数 */
+        uint64_t epollCtl  = 0; /**< epoll_ctl 调用次数 */
+        uint64_t addEvent  = 0; /**< addEvent 调用次数, hook 中每次对应一次返回 EAGAIN 的系统调用 */
+        uint64_t readyHit  = 0; /**< addEvent 消费已记录的就绪边沿, 无需挂起的次数 */
+    };
+
     /**
      * @brief     构造函数
      * @param[in] threads 线程数量
@@ -92,10 +124,32 @@ class IOManager : public Scheduler, public TimerManager {
      * @param[in] fd socket句柄
      * @param[in] event 事件类型
      * @param[in] cb 事件回调函数
-     * @return    添加成功返回0, 失败返回-1
+     * @return    添加成功返回0, 失败返回-1;
+     *            持久注册模式下事件已经就绪时返回1, 此时不会挂起协程,
+     *            调用方应直接重试 IO(指定了 cb 时 cb 已被调度, 仍返回0)
      */
     int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
 
+    /**
+     * @brief      添加带超时的事件, 挂起当前协程
+     * @details    超时时间点直接记在事件上下文中, 由 idle 扫描超时槽取消事件,
+     *             不创建 Timer, 每次等待没有堆分配
+     * @param[in]  fd socket句柄
+     * @param[in]  event 事件类型
+     * @param[in]  timeout_ms 超时时间(毫秒), ~0ull 表示不超时
+     * @param[out] seq 本次等待的序号, 协程恢复后交给 isTimedOut
+     * @return     同 addEvent
+     */
+    int addEvent(int fd, Event event, uint64_t timeout_ms, uint64_t &seq);
+
+    /**
+     * @brief     序号为 seq 的等待是否因超时而结束
+     * @param[in] fd socket句柄
+     * @param[in] event 事件类型
+     * @param[in] seq addEvent 返回的等待序号
+     */
+    bool isTimedOut(int fd, Event event, uint64_t seq);
+
   /**
    * @brief     删除事件
    * @param[in] fd socket 句柄
@@ -119,11 +173,44 @@ class IOManager : public Scheduler, public TimerManager {
    */
 	bool cancelAll(int fd);
 
+  /**
+   * @brief     句柄被新建(socket/accept)时清除同号旧句柄遗留的持久注册状态
+   * @param[in] fd socket 句柄
+   * @details   旧句柄若未经 hook 的 close 关闭, epoll 中的注册已随之消失, 而这里的标记仍在
+   */
+	void resetFd(int fd);
+
+  /**
+   * @brief 是否使用持久注册: 句柄在整个生命周期内以 EPOLLIN|EPOLLOUT|EPOLLET 注册一次
+   */
+	bool isPersistentEvents() const { return m_persistentEvents; }
+
+  /**
+   * @brief 返回系统调用计数
+   */
+	Stats getStats() const;
+
   /**
    * @brief 返回当前的 IOManager
    */
 	static IOManager* GetThis();
 
+    /**
+     * @brief 是否启用了 io_uring 后端
+     */
+    bool isUringEnabled() const { return m_uring != nullptr; }
+
+    /**
+     * @brief      通过 io_uring 提交一个 IO 请求, 挂起当前协程直到请求完成
+     * @param[in]  sqe 已填充操作码/句柄/参数的请求, user_data 由内部设置
+     * @param[in]  timeout_ms 超时时间(毫秒), ~0ull 表示不超时
+     * @param[out] res 请求结果, 与 CQE 的 res 相同: 失败为 -errno, 超时为 -ETIMEDOUT
+     * @return     请求未能提交(未启用 io_uring、提交队列已满、io_uring_enter 失败
+     *             或当前是共享栈协程)时返回 false, 调用方应回退到 epoll
+     * @attention  请求引用的缓冲区必须在协程恢复前保持有效
+     */
+    bool uringSubmit(const io_uring_sqe &sqe, uint64_t timeout_ms, int &res);
+
 protected:
 	void tickle() override;
 
@@ -139,21 +226,62 @@ protected:
 	void onTimerInsertedAtFront() override;
 
   /**
-   * @brief     重置 socket 句柄上下文容器大小
-   * @param[in] size 容量大小
+   * @brief     获取句柄上下文, 不加锁
+   * @param[in] fd socket 句柄
+   * @param[in] auto_create 不存在时是否创建
+   * @return    不存在且不创建, 或句柄超出容量时返回 nullptr
    */
-	void contextResize(size_t size);
+	FdContext *getFdContext(int fd, bool auto_create = false);
 	void onTimerInsertedAtFront(uint64_t timeout);
 
+  /**
+   * @brief 取走 io_uring 的全部 CQE 并唤醒对应的协程
+   */
+	void uringReap();
+
+  /**
+   * @brief 添加事件的实现, cb 与 timeout_ms 不能同时指定
+   */
+	int doAddEvent(int fd, Event event, std::function<void()> *cb,
+	               uint64_t timeout_ms, uint64_t *seq);
+
+  /**
+   * @brief 已持有 fd_ctx->mutex 时取消事件, 同 cancelEvent
+   */
+	bool cancelEventLocked(FdContext *fd_ctx, Event event);
+
+  /**
+   * @brief 取消到期的 IO 等待
+   */
+	void expireDeadlines();
+
 private:
     int m_epfd {0}; /**< epoll 文件句柄 */
 	int m_tickleFds[2]; /**< pipe 文件句柄 */
 
 	std::atomic<size_t> m_pendingEventCount {0}; /**< 全局待处理事件计数 */
-	RWMutexType m_mutex;
 
 	// fd 的事件上下文数组,每个 fd 对应一个读/写事件上下文(EventContext)
-	std::vector<FdContext*> m_fdContexts; /**< socket 事件上下文容器 */
+	SegmentedArray<FdContext> m_fdContexts; /**< socket 事件上下文容器 */
+
+    bool m_persistentEvents = false; /**< 是否使用持久注册 */
+    std::atomic<uint64_t> m_epollWaitCount{0};
+    std::atomic<uint64_t> m_epollCtlCount{0};
+    std::atomic<uint64_t> m_addEventCount{0};
+    std::atomic<uint64_t> m_readyHitCount{0};
+
+    std::unique_ptr<IoUring> m_uring; /**< io_uring 实例, 未启用时为空 */
+    int m_uringEventFd = -1;          /**< io_uring 完成通知的 eventfd */
+
+    /**
+     * IO 等待的超时槽: 1ms 一个槽, 按超时时间点取模散列, 链表节点就是 EventContext.
+     * 已经结束的等待不立即摘除, 扫描到时再根据序号丢弃
+     */
+    static const size_t DEADLINE_SLOTS = 4096;
+    Spinlock m_deadlineLock;
+    std::vector<FdContext::EventContext*> m_deadlineSlots;
+    uint64_t m_deadlineTick = 0;                  /**< 下一个待扫描的时间点 */
+    std::atomic<uint64_t> m_nextDeadline{~0ull};  /**< 最近的非空槽的时间点 */
 };
 
 } // namespace sylar
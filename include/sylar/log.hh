@@ -1,6 +1,7 @@
 #ifndef __SYLAR_LOG_H__
 #define __SYLAR_LOG_H__
 
+#include <atomic>
 #include <memory>
 #include <stdint.h>
 #include <iostream>
@@ -9,22 +10,25 @@
 #include <map>
 #include <vector>
 #include <sstream>
+#include <stdarg.h>
+#include <string.h>
 #include "util.hh"
+#include "noncopyable.hh"
 #include <fstream>
 #include "singleton.hh"
 #include "thread.hh"
 
 #include "fiber.hh"
+#include "bytearray.hh"
+#include "rcu.hh"
+#include <unordered_map>
 
 // std::cout << logger->getLevel() << ", and " << level << std::endl;
 // 当前的日志级别必须大于日志器的日志级别才会构建原子日志
+// 日志行构建在栈上, 内容写入定长缓冲区, 整个过程不分配内存也不增减引用计数
 #define SYLAR_LOG_LEVEL(logger, level)                                  \
     if (logger->getLevel() <= level)                                    \
-    sylar::LogEventWrap(logger,                                         \
-        sylar::LogEvent::ptr(new sylar::LogEvent(                       \
-            level, __FILE__, __LINE__, 0, sylar::GetThreadId(), \
-            sylar::GetFiberId(), time(0), sylar::Thread::GetName())))   \
-        .getSS()
+    sylar::LogLineWrap(logger, level, __FILE__, __LINE__).getSS()
 
 #define SYLAR_LOG_DEBUG(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::DEBUG)
 #define SYLAR_LOG_INFO(logger)  SYLAR_LOG_LEVEL(logger, sylar::LogLevel::INFO)
@@ -32,6 +36,55 @@
 #define SYLAR_LOG_ERROR(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::ERROR)
 #define SYLAR_LOG_FATAL(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::FATAL)
 
+// 按调用点采样的日志: 每个周期内先输出前 first 条, 之后每 every 条输出一条,
+// 被跳过的条数附在下一条输出的日志末尾. 策略取自日志器, 可在 logs 配置的 sample 中修改.
+// 调用点状态是宏内 lambda 的静态变量, 被跳过时只有几次原子操作, 不构建日志行.
+// 被跳过的条数只随本调用点的下一条日志输出, 调用点之后不再被调用时最后一批跳过的
+// 条数不会出现在日志中(下一个周期的第一次调用一定会输出, 会带上之前的条数)
+#define SYLAR_LOG_SAMPLE_LEVEL(logger, level)                               \
+    for (uint32_t sylar_log_sup = 0,                                        \
+                  sylar_log_go  = logger->getLevel() <= level               \
+                                 && []() -> sylar::LogSampler & {           \
+                                        static sylar::LogSampler s_sampler; \
+                                        return s_sampler;                   \
+                                    }().sample(*logger, sylar_log_sup);     \
+         sylar_log_go; sylar_log_go = 0)                                    \
+    sylar::LogLineWrap(logger, level, __FILE__, __LINE__, sylar_log_sup).getSS()
+
+#define SYLAR_LOG_SAMPLE_DEBUG(logger) \
+    SYLAR_LOG_SAMPLE_LEVEL(logger, sylar::LogLevel::DEBUG)
+#define SYLAR_LOG_SAMPLE_INFO(logger) \
+    SYLAR_LOG_SAMPLE_LEVEL(logger, sylar::LogLevel::INFO)
+#define SYLAR_LOG_SAMPLE_WARN(logger) \
+    SYLAR_LOG_SAMPLE_LEVEL(logger, sylar::LogLevel::WARN)
+#define SYLAR_LOG_SAMPLE_ERROR(logger) \
+    SYLAR_LOG_SAMPLE_LEVEL(logger, sylar::LogLevel::ERROR)
+#define SYLAR_LOG_SAMPLE_FATAL(logger) \
+    SYLAR_LOG_SAMPLE_LEVEL(logger, sylar::LogLevel::FATAL)
+
+// 二进制结构化日志: 调用点(文件/行号/格式串)静态注册一次, 之后每条日志只记录
+// 调用点编号和原始参数, 由 BinaryLogAppender 编码, 其他输出器照常输出文本.
+// 格式串使用 printf 语法, 参数支持整数/浮点数/字符串/指针
+#define SYLAR_LOG_BIN_LEVEL(logger, level, fmt, ...)                        \
+    do {                                                                    \
+        if (logger->getLevel() <= level) {                                  \
+            static const sylar::LogSite sylar_log_site(level, __FILE__,     \
+                                                       __LINE__, fmt);      \
+            sylar::LogBinary(*logger, sylar_log_site, ##__VA_ARGS__);       \
+        }                                                                   \
+    } while (0)
+
+#define SYLAR_LOG_BIN_DEBUG(logger, fmt, ...) \
+    SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_BIN_INFO(logger, fmt, ...) \
+    SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_BIN_WARN(logger, fmt, ...) \
+    SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_BIN_ERROR(logger, fmt, ...) \
+    SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_BIN_FATAL(logger, fmt, ...) \
+    SYLAR_LOG_BIN_LEVEL(logger, sylar::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
 // 返回 logger 指针
 #define SYLAR_LOG_ROOT()     sylar::LoggerMgr::GetInstance()->getRoot()
 #define SYLAR_LOG_NAME(name) sylar::LoggerMgr::GetInstance()->getLogger(name)
@@ -39,12 +92,9 @@
 // 通过可变参数将格式内容写入到字符串流中
 #define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...)                    \
     if (logger->getLevel() <= level)                                    \
-    sylar::LogEventWrap(                                                \
-        sylar::LogEvent::ptr(logger,new sylar::LogEvent(                \
-            level, __FILE__, __LINE__, 0, sylar::GetThreadId(),         \
-            sylar::GetFiberId(), time(0), sylar::Thread::GetName())))   \
-        .getEvent()                                                     \
-        ->format(fmt, __VA_ARGS__)
+    sylar::LogLineWrap(logger, level, __FILE__, __LINE__)               \
+        .getSS()                                                        \
+        .format(fmt, __VA_ARGS__)
 
 // 手动指定可变参数的输出格式
 #define SYLAR_LOG_FMT_DEBUG(logger, fmt, ...) \
@@ -83,6 +133,319 @@ class LogLevel {
     static LogLevel::Level FromString(const std::string &str);
 };
 
+/**
+ * @class   日志内容缓冲区
+ * @details 提供与 std::ostream 相同的 << 用法, 常用类型直接转换写入内置的定长缓冲区,
+ *          超出时才转到堆上. 其它类型借助临时的 std::ostringstream 输出
+ */
+class LogStream : Noncopyable {
+  public:
+    static const size_t INLINE_SIZE = 4000; /**< 内置缓冲区大小 */
+
+    LogStream() : m_data(m_inline), m_capacity(INLINE_SIZE) {}
+    ~LogStream();
+
+    const char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    std::string toString() const { return std::string(m_data, m_size); }
+
+    /**
+     * @brief 清空内容和操纵符设置的格式, 保留已分配的空间
+     */
+    void clear()
+    {
+        m_size    = 0;
+        m_osState = false;
+        m_os.reset();
+    }
+
+    void append(const char *str, size_t len)
+    {
+        if (m_size + len > m_capacity) {
+            grow(len);
+        }
+        memcpy(m_data + m_size, str, len);
+        m_size += len;
+    }
+
+    void append(const std::string &str) { append(str.data(), str.size()); }
+
+    /**
+     * @brief     按 printf 格式追加内容
+     * @param[in] fmt 格式化字符串
+     */
+    void format(const char *fmt, ...);
+    void format(const char *fmt, va_list al);
+
+    /**
+     * @brief   经内部的 std::ostringstream 输出, 操纵符设置的格式在本行内一直有效
+     * @details 格式不是默认值(如 std::hex、std::setw、std::setprecision)时,
+     *          内置类型也改走这里, 输出与 std::ostream 相同; 恢复默认后回到直接转换
+     */
+    template <class T> LogStream &stream(const T &val)
+    {
+        if (!m_os) {
+            m_os.reset(new std::ostringstream);
+        }
+        m_os->str(std::string());
+        *m_os << val;
+        append(m_os->str());
+        m_osState = hasStreamState();
+        return *this;
+    }
+
+    LogStream &operator<<(const char *str);
+    LogStream &operator<<(char *str) { return *this << (const char *)str; }
+    LogStream &operator<<(const std::string &str)
+    {
+        if (m_osState) {
+            return stream(str);
+        }
+        append(str);
+        return *this;
+    }
+    LogStream &operator<<(char c)
+    {
+        if (m_osState) {
+            return stream(c);
+        }
+        append(&c, 1);
+        return *this;
+    }
+    LogStream &operator<<(bool val)
+    {
+        return m_osState ? stream(val) : *this << (val ? '1' : '0');
+    }
+    LogStream &operator<<(short val)
+    {
+        return m_osState ? stream(val) : *this << (long long)val;
+    }
+    LogStream &operator<<(unsigned short val)
+    {
+        return m_osState ? stream(val) : *this << (unsigned long long)val;
+    }
+    LogStream &operator<<(int val)
+    {
+        return m_osState ? stream(val) : *this << (long long)val;
+    }
+    LogStream &operator<<(unsigned int val)
+    {
+        return m_osState ? stream(val) : *this << (unsigned long long)val;
+    }
+    LogStream &operator<<(long val)
+    {
+        return m_osState ? stream(val) : *this << (long long)val;
+    }
+    LogStream &operator<<(unsigned long val)
+    {
+        return m_osState ? stream(val) : *this << (unsigned long long)val;
+    }
+    LogStream &operator<<(long long val);
+    LogStream &operator<<(unsigned long long val);
+    LogStream &operator<<(float val)
+    {
+        return m_osState ? stream(val) : *this << (double)val;
+    }
+    LogStream &operator<<(double val);
+    LogStream &operator<<(const void *ptr);
+
+    /**
+     * @brief 支持 std::endl 等操纵符
+     */
+    LogStream &operator<<(std::ostream &(*manip)(std::ostream &))
+    {
+        return stream(manip);
+    }
+
+    /**
+     * @brief 支持 std::hex、std::fixed、std::boolalpha 等操纵符
+     */
+    LogStream &operator<<(std::ios_base &(*manip)(std::ios_base &))
+    {
+        return stream(manip);
+    }
+
+  private:
+    void grow(size_t len);
+
+    /**
+     * @brief m_os 的格式是否不同于新建的流
+     */
+    bool hasStreamState() const;
+
+  private:
+    char *m_data;              /**< 当前使用的缓冲区 */
+    size_t m_size = 0;         /**< 已写入的长度 */
+    size_t m_capacity;         /**< 当前缓冲区容量 */
+    bool m_osState = false;    /**< m_os 带有操纵符设置的格式, 内置类型也经 m_os 输出 */
+    std::unique_ptr<std::ostringstream> m_os; /**< 首次用到时创建 */
+    char m_inline[INLINE_SIZE]; /**< 内置缓冲区 */
+};
+
+/**
+ * @brief 未直接支持的类型和 std::setw 等操纵符通过 std::ostream 的 << 输出
+ */
+template <class T>
+LogStream &operator<<(LogStream &os, const T &val)
+{
+    return os.stream(val);
+}
+
+/**
+ * @class   栈上的日志行
+ * @details 与 LogEvent 携带相同的信息, 但不在堆上分配, 线程名只引用线程局部的字符串,
+ *          内容写入 LogStream. 只在构造它的线程上、析构之前有效
+ */
+class LogLine : Noncopyable {
+  public:
+    LogLine(LogLevel::Level level,
+            const char *file,
+            int32_t line,
+            uint32_t elapse,
+            uint32_t thread_id,
+            uint32_t fiber_id,
+            uint64_t time,
+            const std::string &thread_name)
+        : m_level(level), m_file(file), m_line(line), m_elapse(elapse),
+          m_threadId(thread_id), m_fiberId(fiber_id), m_time(time),
+          m_threadName(thread_name)
+    {}
+
+    LogLevel::Level getLevel() const { return m_level; }
+    const char *getFile() const { return m_file; }
+    int32_t getLine() const { return m_line; }
+    uint32_t getElapse() const { return m_elapse; }
+    uint32_t getThreadId() const { return m_threadId; }
+    uint32_t getFiberId() const { return m_fiberId; }
+    uint64_t getTime() const { return m_time; }
+    const std::string &getThreadName() const { return m_threadName; }
+
+    const char *getContent() const { return m_ss.data(); }
+    size_t getContentSize() const { return m_ss.size(); }
+
+    LogStream &getSS() { return m_ss; }
+
+  private:
+    LogLevel::Level m_level;
+    const char *m_file;
+    int32_t m_line;
+    uint32_t m_elapse;
+    uint32_t m_threadId;
+    uint32_t m_fiberId;
+    uint64_t m_time;
+    const std::string &m_threadName; /**< 引用 Thread::GetName() */
+    LogStream m_ss;                  /**< 日志内容 */
+};
+
+/**
+ * @brief   日志调用点
+ * @details 由 SYLAR_LOG_BIN_* 宏在调用处定义为静态变量, 构造时分配进程内唯一的编号
+ */
+struct LogSite : Noncopyable {
+    LogSite(LogLevel::Level level, const char *file, int32_t line,
+            const char *fmt);
+
+    uint32_t id;           /**< 调用点编号, 从 0 开始连续分配 */
+    LogLevel::Level level; /**< 日志级别 */
+    const char *file;      /**< 文件名 */
+    int32_t line;          /**< 行号 */
+    const char *fmt;       /**< printf 风格的格式串 */
+};
+
+/**
+ * @brief   二进制日志的一个参数, 只保存原始值, 不做格式化
+ * @details 字符串参数只引用调用方的内存, 只在本次日志调用内有效
+ */
+struct LogArg {
+    enum Type : uint8_t {
+        NONE   = 0,
+        INT    = 'i', /**< 有符号整数, 编码为 zigzag varint */
+        UINT   = 'u', /**< 无符号整数和指针, 编码为 varint */
+        DOUBLE = 'd', /**< 浮点数, 编码为定长 8 字节 */
+        STRING = 's', /**< 字符串, 编码为 varint 长度 + 内容 */
+    };
+
+    LogArg() : type(NONE), u(0) {}
+    LogArg(int v) : type(INT), i(v) {}
+    LogArg(long v) : type(INT), i(v) {}
+    LogArg(long long v) : type(INT), i(v) {}
+    LogArg(unsigned v) : type(UINT), u(v) {}
+    LogArg(unsigned long v) : type(UINT), u(v) {}
+    LogArg(unsigned long long v) : type(UINT), u(v) {}
+    LogArg(double v) : type(DOUBLE), d(v) {}
+    LogArg(const void *v) : type(UINT), u((uintptr_t)v) {}
+    // 空指针按 printf 的习惯输出 "(null)"
+    LogArg(const char *v)
+        : type(STRING), len(v ? strlen(v) : 6), s(v ? v : "(null)") {}
+    LogArg(std::nullptr_t) : type(STRING), len(6), s("(null)") {}
+    LogArg(const std::string &v) : type(STRING), len(v.size()), s(v.c_str()) {}
+
+    Type type;
+    size_t len = 0; /**< 字符串长度 */
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char *s; /**< 以 '\0' 结尾 */
+    };
+};
+
+/**
+ * @class   二进制日志记录
+ * @details 调用点加上原始参数, 与 LogLine 一样只在构造它的线程上、析构之前有效
+ */
+class LogRecord : Noncopyable {
+  public:
+    LogRecord(const LogSite &site,
+              const LogArg *args,
+              size_t count,
+              uint32_t thread_id,
+              uint32_t fiber_id,
+              uint64_t time,
+              const std::string &thread_name)
+        : m_site(site), m_args(args), m_count(count), m_threadId(thread_id),
+          m_fiberId(fiber_id), m_time(time), m_threadName(thread_name)
+    {}
+
+    /**
+     * @brief     按 printf 格式串把参数格式化为文本
+     * @details   长度修饰符(h/l/ll/z 等)被忽略, 按参数实际保存的类型输出;
+     *            参数不足或无法识别的转换说明原样输出
+     * @param[out] os 输出缓冲区
+     * @param[in] fmt 格式串
+     * @param[in] args 参数
+     * @param[in] count 参数个数
+     */
+    static void FormatMessage(LogStream &os, const char *fmt,
+                              const LogArg *args, size_t count);
+
+    const LogSite &getSite() const { return m_site; }
+    LogLevel::Level getLevel() const { return m_site.level; }
+    const LogArg *getArgs() const { return m_args; }
+    size_t getArgCount() const { return m_count; }
+    uint32_t getThreadId() const { return m_threadId; }
+    uint32_t getFiberId() const { return m_fiberId; }
+    uint64_t getTime() const { return m_time; }
+    const std::string &getThreadName() const { return m_threadName; }
+
+    /**
+     * @brief 把消息内容格式化为文本
+     */
+    void formatMessage(LogStream &os) const
+    {
+        FormatMessage(os, m_site.fmt, m_args, m_count);
+    }
+
+  private:
+    const LogSite &m_site;
+    const LogArg *m_args;
+    size_t m_count;
+    uint32_t m_threadId;
+    uint32_t m_fiberId;
+    uint64_t m_time;
+    const std::string &m_threadName; /**< 引用 Thread::GetName() */
+};
+
 /**
  * @class 日志事件, 定义了一些和日志属性相关的内容信息. 日志的原子信息
  */
@@ -131,7 +494,7 @@ class LogEvent {
 
     uint32_t getTime() const { return m_time; }
 
-    const std::string &getThreadName() { return m_threadName; }
+    const std::string &getThreadName() const { return m_threadName; }
 
     std::string getContent() const { return m_ss.str(); }
 
@@ -181,8 +544,27 @@ class LogFormatter {
   public:
     using ptr = std::shared_ptr<LogFormatter>;
 
+    /**
+     * @brief 编译期展开的格式化函数, 见 CompiledLogPattern
+     */
+    using CompiledFunc = void (*)(LogStream &os,
+                                  const Logger &logger,
+                                  const LogLine &line);
+
+    /**
+     * @brief   构造函数
+     * @details 模式串与已注册的编译期模式完全相同时, 格式化直接调用对应的编译期函数,
+     *          不再遍历 FormatItem
+     */
     LogFormatter(const std::string &pattern);
 
+    /**
+     * @brief     注册编译期模式, 之后以相同模式串构造的 LogFormatter 都会使用它
+     * @param[in] pattern 模式串
+     * @param[in] func 格式化函数
+     */
+    static void RegisterCompiled(const std::string &pattern, CompiledFunc func);
+
     /**
      * @brief     日志格式
      * @details   获取事件, 并将其进行输出
@@ -206,27 +588,75 @@ class LogFormatter {
         // FormatItem(const std::string& fmt = "") {}
 
         virtual ~FormatItem() {}
-        virtual void format(std::ostream &ofs,
-                            std::shared_ptr<Logger> logger,
-                            LogLevel::Level level,
-                            LogEvent::ptr event) = 0;
+        virtual void format(LogStream &os,
+                            const Logger &logger,
+                            const LogLine &line) = 0;
     };
     void init();
 
     bool isError() const { return m_error; }
     const std::string getPatrtern() const { return m_pattern; }
 
+    /**
+     * @brief 是否使用编译期模式
+     */
+    bool isCompiled() const { return m_compiled != nullptr; }
+
     std::ostream &format(std::ostream &ofs,
                          std::shared_ptr<Logger> logger,
                          LogLevel::Level level,
                          LogEvent::ptr event);
 
+    /**
+     * @brief     把日志行格式化到缓冲区, 不分配内存
+     * @param[out] os 输出缓冲区
+     * @param[in] logger 日志器
+     * @param[in] line 日志行
+     */
+    void format(LogStream &os, const Logger &logger, const LogLine &line)
+    {
+        if (m_compiled) {
+            m_compiled(os, logger, line);
+            return;
+        }
+        for (auto &i : m_items) {
+            i->format(os, logger, line);
+        }
+    }
+
+    /**
+     * @brief 把 LogEvent 转成 LogLine 后格式化到缓冲区
+     */
+    void format(LogStream &os,
+                const Logger &logger,
+                LogLevel::Level level,
+                const LogEvent &event);
+
   private:
     std::string m_pattern;
     std::vector<FormatItem::ptr> m_items;
-    bool m_error = false;
+    bool m_error              = false;
+    CompiledFunc m_compiled   = nullptr; /**< 编译期模式, 为空时遍历 m_items */
 };
 
+/**
+ * @brief  返回 strftime 格式在时间缓存中的编号, 相同的格式字符串得到相同的编号
+ * @details "%Y-%m-%d %H:%M:%S" 固定为 0. 加锁查表, 只在创建格式项时调用
+ */
+uint64_t InternLogTimeFormat(const std::string &fmt);
+
+/**
+ * @brief     按 strftime 格式输出时间, 每个线程按格式缓存最近一次的结果
+ * @details   同一秒内对同一格式重复调用时直接复制缓存, 不再 localtime_r + strftime.
+ *            缓存有几个槽, 按编号直接映射
+ * @param[out] os 输出缓冲区
+ * @param[in] time 时间戳(秒)
+ * @param[in] fmt strftime 格式
+ * @param[in] cache_id InternLogTimeFormat(fmt) 返回的编号
+ */
+void FormatLogTime(LogStream &os, uint64_t time, const char *fmt,
+                   uint64_t cache_id);
+
 /**
  * @class 日志输出器
  */
@@ -244,6 +674,18 @@ class LogAppender {
                      LogLevel::Level level,
                      LogEvent::ptr event) = 0;
 
+    /**
+     * @brief   输出栈上的日志行
+     * @details 默认实现把日志行转换成 LogEvent 后交给上面的 log
+     */
+    virtual void log(Logger &logger, const LogLine &line);
+
+    /**
+     * @brief   输出二进制日志记录
+     * @details 默认实现把消息格式化为文本后交给 log(Logger &, const LogLine &)
+     */
+    virtual void log(Logger &logger, const LogRecord &record);
+
     virtual std::string toYamlString() = 0;
 
     void setFormatter(LogFormatter::ptr val);
@@ -262,9 +704,25 @@ class LogAppender {
     LogFormatter::ptr m_formatter; /**< 日志输出器所属的格式器 */
 };
 
+/**
+ * @brief 日志器的采样策略, 用于 SYLAR_LOG_SAMPLE_* 宏
+ */
+struct LogSamplePolicy {
+    uint32_t first    = 10;  /**< 每个周期内无条件输出的条数 */
+    uint32_t every    = 100; /**< 超过 first 后每 every 条输出一条, 0 表示不再输出 */
+    uint32_t interval = 1;   /**< 周期(秒), 0 表示不重置计数 */
+
+    bool operator==(const LogSamplePolicy &oth) const
+    {
+        return first == oth.first && every == oth.every
+               && interval == oth.interval;
+    }
+};
+
 /**
  * @brief   Logger 日志器类
- * @details 管理日志级别, 输出器以及格式解析器, 是日志系统的核心类
+ * @details 管理日志级别, 输出器以及格式解析器, 是日志系统的核心类.
+ *          输出器列表是 RCU 快照, 输出日志时不加锁; 增删输出器时复制一份新列表再替换
  */
 class Logger : public std::enable_shared_from_this<Logger> {
     friend class LoggerManager;
@@ -272,6 +730,7 @@ class Logger : public std::enable_shared_from_this<Logger> {
   public:
     using ptr       = std::shared_ptr<Logger>;
     using MutexType = Spinlock;
+    using Appenders = std::vector<LogAppender::ptr>;
 
     Logger(const std::string &name = "root");
 
@@ -283,6 +742,16 @@ class Logger : public std::enable_shared_from_this<Logger> {
 
     void log(LogLevel::Level level, LogEvent::ptr event);
 
+    /**
+     * @brief 输出栈上的日志行, 不持有自身的 shared_ptr
+     */
+    void log(const LogLine &line);
+
+    /**
+     * @brief 输出二进制日志记录
+     */
+    void log(const LogRecord &record);
+
     void debug(LogEvent::ptr event);
     void info(LogEvent::ptr event);
     void warn(LogEvent::ptr event);
@@ -293,12 +762,18 @@ class Logger : public std::enable_shared_from_this<Logger> {
     void delAppender(LogAppender::ptr appender);
     void clearAppenders();
 
-    void setLevel(LogLevel::Level val) { m_level = val; }
-    LogLevel::Level getLevel() const { return m_level; }
+    void setLevel(LogLevel::Level val)
+    {
+        m_level.store(val, std::memory_order_relaxed);
+    }
+    LogLevel::Level getLevel() const
+    {
+        return m_level.load(std::memory_order_relaxed);
+    }
 
     const std::string &getName() const { return m_name; }
 
-    int getAppenderSize() { return m_appenders.size(); }
+    int getAppenderSize();
 
     /**
      * @brief     设置日志器的 formatter
@@ -310,13 +785,166 @@ class Logger : public std::enable_shared_from_this<Logger> {
     LogFormatter::ptr getFormatter();
     std::string toYamlString();
 
+    /**
+     * @brief 设置 SYLAR_LOG_SAMPLE_* 的采样策略
+     */
+    void setSample(const LogSamplePolicy &val);
+    LogSamplePolicy getSample() const;
+
+    uint32_t getSampleFirst() const
+    {
+        return m_sampleFirst.load(std::memory_order_relaxed);
+    }
+    uint32_t getSampleEvery() const
+    {
+        return m_sampleEvery.load(std::memory_order_relaxed);
+    }
+    uint32_t getSampleInterval() const
+    {
+        return m_sampleInterval.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::string m_name;                   /**< 日志名 */
+    std::atomic<LogLevel::Level> m_level; /**< Logger 的日志级别 */
+    RcuPtr<const Appenders> m_appenders;  /**< 输出器集合, 只读快照 */
+    LogFormatter::ptr m_formatter;        /**< 日志器所属的格式解析器 */
+    Logger::ptr m_root;                   /**<  root 指针*/
+    MutexType m_mutex; /**< 保护 m_formatter, 串行化输出器列表的替换 */
+    std::atomic<uint32_t> m_sampleFirst{LogSamplePolicy().first};
+    std::atomic<uint32_t> m_sampleEvery{LogSamplePolicy().every};
+    std::atomic<uint32_t> m_sampleInterval{LogSamplePolicy().interval};
+};
+
+/**
+ * @class   调用点的采样状态
+ * @details 由 SYLAR_LOG_SAMPLE_* 宏在调用处定义为静态变量. 周期切换时多个线程可能
+ *          同时清零计数, 只会多输出几条, 不影响正确性. 不定时汇报, 也不在析构时
+ *          汇报: 调用点不知道自己的日志器和位置, 跳过的条数只能由下一次输出带出
+ */
+class LogSampler : Noncopyable {
+  public:
+    /**
+     * @brief      判断本次调用是否输出
+     * @param[in]  logger 日志器, 提供采样策略
+     * @param[out] suppressed 输出时返回上次输出以来被跳过的条数
+     */
+    bool sample(const Logger &logger, uint32_t &suppressed)
+    {
+        uint32_t interval = logger.getSampleInterval();
+        if (interval) {
+            uint64_t window = (uint64_t)time(0) / interval;
+            uint64_t old    = m_window.load(std::memory_order_relaxed);
+            if (window != old
+                && m_window.compare_exchange_strong(old, window,
+                                                    std::memory_order_relaxed))
+            {
+                m_count.store(0, std::memory_order_relaxed);
+            }
+        }
+        uint32_t n     = m_count.fetch_add(1, std::memory_order_relaxed);
+        uint32_t first = logger.getSampleFirst();
+        uint32_t every = logger.getSampleEvery();
+        if (n < first || (every && (n - first) % every == 0)) {
+            suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
   private:
-    std::string m_name;                      /**< 日志名 */
-    LogLevel::Level m_level;                 /**< Logger 的日志级别 */
-    std::list<LogAppender::ptr> m_appenders; /**< 输出器集合 */
-    LogFormatter::ptr m_formatter;           /**< 日志器所属的格式解析器 */
-    Logger::ptr m_root;                      /**<  root 指针*/
-    MutexType m_mutex;                       /**< 系统层面上的自旋锁 */
+    std::atomic<uint64_t> m_window{0};     /**< 当前周期编号 */
+    std::atomic<uint32_t> m_count{0};      /**< 本周期内的调用次数 */
+    std::atomic<uint32_t> m_suppressed{0}; /**< 上次输出以来跳过的条数 */
+};
+
+/**
+ * @brief 编译期日志模式的组成项, 每一项对应运行期模式串中的一个占位符
+ */
+namespace logfmt {
+
+/**
+ * @brief %d{%Y-%m-%d %H:%M:%S}, 使用线程缓存的时间字符串
+ */
+struct DateTime {
+    static const char *Pattern() { return "%d{%Y-%m-%d %H:%M:%S}"; }
+    static void Format(LogStream &os, const Logger &, const LogLine &line)
+    {
+        FormatLogTime(os, line.getTime(), "%Y-%m-%d %H:%M:%S", 0);
+    }
+};
+
+#define SYLAR_LOG_FMT_ITEM(Name, pattern, expr)                             \
+    struct Name {                                                           \
+        static const char *Pattern() { return pattern; }                    \
+        static void Format(LogStream &os, const Logger &logger,             \
+                           const LogLine &line)                             \
+        {                                                                   \
+            expr;                                                           \
+        }                                                                   \
+    };
+
+SYLAR_LOG_FMT_ITEM(Message, "%m",
+                   os.append(line.getContent(), line.getContentSize()))
+SYLAR_LOG_FMT_ITEM(Level, "%p", os << LogLevel::ToString(line.getLevel()))
+SYLAR_LOG_FMT_ITEM(Elapse, "%r", os << line.getElapse())
+SYLAR_LOG_FMT_ITEM(Name, "%c", os << logger.getName())
+SYLAR_LOG_FMT_ITEM(ThreadId, "%t", os << line.getThreadId())
+SYLAR_LOG_FMT_ITEM(NewLine, "%n", os << '\n')
+SYLAR_LOG_FMT_ITEM(File, "%f", os << line.getFile())
+SYLAR_LOG_FMT_ITEM(Line, "%l", os << line.getLine())
+SYLAR_LOG_FMT_ITEM(Tab, "%T", os << '\t')
+SYLAR_LOG_FMT_ITEM(FiberId, "%F", os << line.getFiberId())
+SYLAR_LOG_FMT_ITEM(ThreadName, "%N", os << line.getThreadName())
+#undef SYLAR_LOG_FMT_ITEM
+
+/**
+ * @brief 普通字符, 不能是 '%'
+ */
+template <char C>
+struct Char {
+    static const char *Pattern()
+    {
+        static const char s_pattern[2] = {C, 0};
+        return s_pattern;
+    }
+    static void Format(LogStream &os, const Logger &, const LogLine &)
+    {
+        os << C;
+    }
+};
+
+} // namespace logfmt
+
+/**
+ * @brief   编译期日志模式
+ * @details 组成项在编译期确定, 格式化时逐项内联展开, 没有虚函数调用. 例如
+ *          CompiledLogPattern<logfmt::DateTime, logfmt::Tab, logfmt::Message,
+ *          logfmt::NewLine> 等价于 "%d{%Y-%m-%d %H:%M:%S}%T%m%n".
+ *          调用 Register() 后, 以等价模式串构造的 LogFormatter 都会使用它
+ */
+template <class... Items>
+class CompiledLogPattern {
+  public:
+    /**
+     * @brief 返回等价的运行期模式串
+     */
+    static std::string Pattern()
+    {
+        std::string pattern;
+        int expand[] = {0, (pattern += Items::Pattern(), 0)...};
+        (void)expand;
+        return pattern;
+    }
+
+    static void Format(LogStream &os, const Logger &logger, const LogLine &line)
+    {
+        int expand[] = {0, (Items::Format(os, logger, line), 0)...};
+        (void)expand;
+    }
+
+    static void Register() { LogFormatter::RegisterCompiled(Pattern(), &Format); }
 };
 
 /**
@@ -335,6 +963,45 @@ class LogEventWrap {
     LogEvent::ptr m_event;
 };
 
+/**
+ * @class   LogLineWrap 栈上日志行的输出包装类
+ * @details RAII, 析构时输出. 只保存日志器的裸指针, 日志器由调用处的 shared_ptr 保活
+ */
+class LogLineWrap {
+  public:
+    /**
+     * @param[in] suppressed 采样跳过的条数, 不为 0 时附在日志末尾
+     */
+    LogLineWrap(const Logger::ptr &logger,
+                LogLevel::Level level,
+                const char *file,
+                int32_t line,
+                uint32_t suppressed = 0);
+    ~LogLineWrap();
+
+    LogStream &getSS() { return m_line.getSS(); }
+    LogLine &getLine() { return m_line; }
+
+  private:
+    Logger *m_logger;
+    uint32_t m_suppressed;
+    LogLine m_line;
+};
+
+/**
+ * @brief     输出一条二进制日志, 由 SYLAR_LOG_BIN_* 宏调用
+ * @param[in] logger 日志器
+ * @param[in] site 调用点
+ * @param[in] args 参数, 类型须能构造 LogArg
+ */
+template <class... Args>
+void LogBinary(Logger &logger, const LogSite &site, const Args &...args)
+{
+    const LogArg list[sizeof...(Args) + 1] = {LogArg(args)...};
+    logger.log(LogRecord(site, list, sizeof...(Args), GetThreadId(),
+                         GetFiberId(), time(0), Thread::GetName()));
+}
+
 /**
  * @class 输出到控制台的Appender
  */
@@ -346,6 +1013,8 @@ class StdoutLogAppender : public LogAppender {
              LogLevel::Level level,
              LogEvent::ptr event) override;
 
+    void log(Logger &logger, const LogLine &line) override;
+
     std::string toYamlString() override;
 };
 
@@ -361,6 +1030,8 @@ class FileLogAppender : public LogAppender {
              LogLevel::Level level,
              LogEvent::ptr event) override;
 
+    void log(Logger &logger, const LogLine &line) override;
+
     FileLogAppender(const std::string &filename);
 
     std::string toYamlString() override;
@@ -371,32 +1042,396 @@ class FileLogAppender : public LogAppender {
      */
     bool reopen();
 
+  private:
+    /**
+     * @brief 定期重新打开文件并写入一行, 调用方需持有 m_mutex
+     */
+    void write(uint64_t now, const char *data, size_t len);
+
   private:
     std::string m_filename;
     std::ofstream m_filestream;
     uint64_t m_lastTime = 0;
 };
 
-class LoggerManager {
+/**
+ * @class   异步输出的Appender
+ * @details 生产线程只把事件放入本线程独占的无锁环形队列(单生产者单消费者),
+ *          由后台刷盘线程批量格式化后用 writev 写入文件. 不同线程的日志按批次交错,
+ *          同一线程内的顺序不变. 文件名为空时输出到标准输出
+ */
+class AsyncLogAppender : public LogAppender {
+  public:
+    using ptr = std::shared_ptr<AsyncLogAppender>;
+
+    /**
+     * @brief 队列满时的处理策略
+     */
+    enum OverflowPolicy {
+        BLOCK            = 0, /**< 等待刷盘线程腾出空间 */
+        DROP_NEWEST      = 1, /**< 丢弃当前事件 */
+        DROP_DEBUG_FIRST = 2, /**< 按级别提前丢弃: DEBUG 在半满时, INFO 在 3/4 满时,
+                                   WARN 及以上等待 */
+    };
+
+    static const char *PolicyToString(OverflowPolicy policy);
+    static OverflowPolicy PolicyFromString(const std::string &str);
+
+    /**
+     * @brief     构造函数, 启动刷盘线程
+     * @param[in] filename 输出文件, 为空时输出到标准输出
+     * @param[in] policy 队列满时的处理策略
+     * @details   每个线程的队列长度和空闲时的刷盘间隔分别取自配置
+     *            log.async_queue_size 和 log.async_flush_interval
+     */
+    AsyncLogAppender(const std::string &filename,
+                     OverflowPolicy policy = BLOCK);
+
+    /**
+     * @brief 析构函数, 停止刷盘线程并写出队列中剩余的事件
+     */
+    ~AsyncLogAppender();
+
+    void log(std::shared_ptr<Logger> logger,
+             LogLevel::Level level,
+             LogEvent::ptr event) override;
+
+    /**
+     * @brief   把日志行的字段拷贝进当前线程的队列, 由刷盘线程格式化
+     * @details 不加锁; 队列槽位中的字符串会复用容量, 稳定后不再分配内存
+     */
+    void log(Logger &logger, const LogLine &line) override;
+
+    std::string toYamlString() override;
+
+    /**
+     * @brief 在当前线程同步写出所有队列中的事件
+     */
+    void flush();
+
+    /**
+     * @brief 返回因队列满而丢弃的事件数
+     */
+    uint64_t getDropped() const { return m_dropped; }
+
+    OverflowPolicy getPolicy() const { return m_policy; }
+
+  private:
+    struct Ring;
+
+    /**
+     * @brief 获取当前线程对应的队列, 首次调用时创建并注册
+     */
+    Ring *getRing();
+
+    /**
+     * @brief     按溢出策略把一个槽位放入当前线程的队列
+     * @param[in] level 日志级别
+     * @param[in] fill 填充槽位的函数
+     */
+    template <class Fill>
+    void enqueue(LogLevel::Level level, Fill fill);
+
+    /**
+     * @brief 唤醒处于等待中的刷盘线程
+     */
+    void wakeup();
+
+    /**
+     * @brief 刷盘线程主循环
+     */
+    void run();
+
+    /**
+     * @brief  取出所有队列中的事件, 格式化后写入文件
+     * @return 写出的事件数
+     */
+    size_t drain();
+
+    bool reopen();
+
+    void writeChunks();
+
+  private:
+    std::string m_filename;
+    OverflowPolicy m_policy;
+    uint64_t m_id;                /**< 实例编号, 用于线程局部的队列查找 */
+    size_t m_ringCapacity;        /**< 每个线程的队列长度, 2 的幂 */
+    uint64_t m_flushInterval;     /**< 空闲时的刷盘间隔(毫秒) */
+    int m_fd = -1;                /**< 输出文件句柄 */
+    uint64_t m_lastOpen = 0;      /**< 上次打开文件的时间(秒) */
+
+    Mutex m_ringsMutex;                        /**< 保护 m_rings */
+    std::vector<std::shared_ptr<Ring>> m_rings; /**< 已注册的线程队列 */
+    std::atomic<uint64_t> m_ringsVersion{0};    /**< m_rings 变更计数 */
+
+    Mutex m_drainMutex;                           /**< 保证同时只有一个消费者 */
+    std::vector<std::shared_ptr<Ring>> m_drainRings; /**< 消费者持有的 m_rings 快照 */
+    uint64_t m_drainVersion = ~0ull;              /**< 快照对应的 m_ringsVersion */
+    std::vector<std::string> m_chunks;            /**< 待写出的数据块 */
+    uint64_t m_reportedDropped = 0;               /**< 已写入文件提示的丢弃数 */
+
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<bool> m_sleeping{false}; /**< 刷盘线程是否在等待 */
+    std::atomic<bool> m_stopping{false};
+    Semaphore m_wakeup;
+    Thread::ptr m_thread; /**< 刷盘线程 */
+};
+
+/**
+ * @class   输出二进制结构化日志的Appender
+ * @details 文件以 "SYLB" 和版本号开头, 之后是一串记录, 每条记录以一个字节的类型开头,
+ *          整数都用 ByteArray 的 varint 编码. 每次打开文件或格式器变化时先写一条
+ *          SESSION, 其后的调用点/线程/日志器在首次出现时各写一次定义,
+ *          日志记录只包含编号、与上一条记录的时间差和原始参数.
+ *          SYLAR_LOG_* 等文本日志写为 TEXT 记录. 数据在内存中累积,
+ *          满 64KB、遇到 ERROR 及以上级别、距上次写出超过 1 秒或析构时用 writev 写出.
+ *          同一文件只能有一个写入者, 用 sylar_logdecode 还原为文本
+ */
+class BinaryLogAppender : public LogAppender {
+  public:
+    using ptr = std::shared_ptr<BinaryLogAppender>;
+
+    static const char MAGIC[4];       /**< 文件头 "SYLB" */
+    static const uint8_t VERSION = 1; /**< 文件格式版本 */
+
+    /**
+     * @brief 记录类型
+     */
+    enum RecordType : uint8_t {
+        SESSION = 1, /**< 格式器模式串, 之后的编号与时间差重新开始 */
+        SITE    = 2, /**< 调用点: 编号, 级别, 行号, 文件名, 格式串, 参数类型 */
+        THREAD  = 3, /**< 线程: 线程id, 线程名 */
+        LOGGER  = 4, /**< 日志器: 编号, 名称 */
+        RECORD  = 5, /**< 日志: 调用点, 日志器, 时间差, 线程id, 协程id, 参数 */
+        TEXT    = 6, /**< 文本日志: 级别, 日志器, 时间差, 线程id, 协程id, 行号,
+                          文件名, 内容 */
+    };
+
+    BinaryLogAppender(const std::string &filename);
+
+    /**
+     * @brief 析构函数, 写出缓冲的数据
+     */
+    ~BinaryLogAppender();
+
+    void log(std::shared_ptr<Logger> logger,
+             LogLevel::Level level,
+             LogEvent::ptr event) override;
+
+    void log(Logger &logger, const LogLine &line) override;
+
+    void log(Logger &logger, const LogRecord &record) override;
+
+    std::string toYamlString() override;
+
+    /**
+     * @brief 写出缓冲的数据
+     */
+    void flush();
+
+  private:
+    /**
+     * @brief 写记录前的准备: 检查文件是否被删除或改名, 必要时写 SESSION.
+     *        调用方需持有 m_mutex, 下同
+     */
+    void prepare(uint64_t now);
+
+    /**
+     * @brief  返回日志器的编号, 首次出现时写 LOGGER 定义
+     */
+    uint32_t defineLogger(const Logger &logger);
+
+    /**
+     * @brief 线程首次出现或改名时写 THREAD 定义
+     */
+    void defineThread(uint32_t thread_id, const std::string &name);
+
+    /**
+     * @brief 写一条记录的公共头部: 日志器, 时间差, 线程id, 协程id
+     */
+    void writeHead(uint32_t logger_id, uint64_t time, uint32_t thread_id,
+                   uint32_t fiber_id);
+
+    /**
+     * @brief 按写出条件决定是否写出缓冲的数据
+     */
+    void commit(LogLevel::Level level, uint64_t now);
+
+    bool reopen();
+
+    void writeBuffer();
+
+  private:
+    std::string m_filename;
+    int m_fd             = -1;
+    ByteArray m_buf;                 /**< 待写出的数据 */
+    std::vector<iovec> m_iovs;       /**< 写出时复用的 iovec */
+    uint64_t m_lastCheck = 0;        /**< 上次检查文件的时间(秒) */
+    uint64_t m_lastFlush = 0;        /**< 上次写出的时间(秒) */
+    uint64_t m_lastTime  = 0;        /**< 上一条记录的时间, 用于时间差编码 */
+    const LogFormatter *m_sessionFormatter = nullptr; /**< 当前 SESSION 的格式器 */
+    bool m_sessionStarted = false;   /**< 本次打开后是否已写过 SESSION */
+    std::vector<bool> m_sites;       /**< 已定义的调用点 */
+    std::unordered_map<uint32_t, std::string> m_threads; /**< 已定义的线程 */
+    std::unordered_map<const Logger *, uint32_t> m_loggers; /**< 已定义的日志器 */
+};
+
+/**
+ * @class   通过内存映射写文件的Appender
+ * @details 文件按窗口(配置 log.mmap_window_size)预先扩展并映射, 输出日志只是一次 memcpy,
+ *          不再有系统调用. 后台线程提前映射下一个窗口, 负责按大小/时间轮转,
+ *          并用 inotify 监视文件, 只在文件被删除或改名后才换新文件, 不再定期重新打开.
+ *          轮转时旧文件改名为 "文件名.年月日-时分秒", 生产者在下一行日志时切换到已准备好的
+ *          新文件, 不会等待. 文件关闭时截断到实际长度; 运行中文件末尾是预扩展的 '\0',
+ *          进程异常退出后重新打开时会从最后一个非 '\0' 字节处继续写.
+ * @attention 不支持 copytruncate 这类从外部截断文件的轮转方式, 截断后写映射区会触发 SIGBUS
+ */
+class MmapFileLogAppender : public LogAppender {
+  public:
+    using ptr = std::shared_ptr<MmapFileLogAppender>;
+
+    /**
+     * @brief     构造函数, 打开文件并启动后台线程
+     * @param[in] filename 文件名
+     * @param[in] max_size 文件超过该大小(字节)后轮转, 0 表示不按大小轮转
+     * @param[in] rotate_interval 按该间隔(秒)轮转, 按整数倍对齐, 0 表示不按时间轮转
+     */
+    MmapFileLogAppender(const std::string &filename,
+                        uint64_t max_size        = 0,
+                        uint32_t rotate_interval = 0);
+
+    /**
+     * @brief 析构函数, 停止后台线程, 把文件截断到实际长度
+     */
+    ~MmapFileLogAppender();
+
+    void log(std::shared_ptr<Logger> logger,
+             LogLevel::Level level,
+             LogEvent::ptr event) override;
+
+    void log(Logger &logger, const LogLine &line) override;
+
+    std::string toYamlString() override;
+
+    uint64_t getMaxSize() const { return m_maxSize; }
+    uint32_t getRotateInterval() const { return m_rotateInterval; }
+
+  private:
+    /**
+     * @brief 文件中的一段映射
+     */
+    struct Window {
+        int fd          = -1;
+        char *base      = nullptr;
+        uint64_t offset = 0; /**< 窗口在文件中的起始位置 */
+        size_t size     = 0;
+        size_t pos      = 0;     /**< 窗口内已写入的长度 */
+        bool last       = false; /**< 释放时截断到 offset + pos 并关闭文件 */
+    };
+
+    /**
+     * @brief 把一行写入映射区, 调用方需持有 m_mutex
+     */
+    void write(const char *data, size_t len);
+
+    /**
+     * @brief  映射文件中 offset 开始的一个窗口, 必要时先扩展文件
+     * @return 失败时 base 为空
+     */
+    Window map(int fd, uint64_t offset);
+
+    /**
+     * @brief 释放窗口, 设置了 last 时截断并关闭文件
+     */
+    static void Unmap(const Window &win);
+
+    /**
+     * @brief     打开文件并映射写入位置所在的窗口, 由构造函数和后台线程调用
+     * @param[in] rotate 是否先把现有文件改名
+     * @return    失败时 base 为空
+     */
+    Window openFile(bool rotate);
+
+    /**
+     * @brief 唤醒后台线程
+     */
+    void wakeup();
+
+    /**
+     * @brief 后台线程主循环
+     */
+    void run();
+
+  private:
+    std::string m_filename;
+    uint64_t m_maxSize;
+    uint32_t m_rotateInterval;
+    size_t m_windowSize; /**< 窗口大小, 页大小的整数倍 */
+
+    // 以下由 m_mutex 保护
+    Window m_cur;                  /**< 当前写入的窗口 */
+    size_t m_pos = 0;              /**< 当前窗口内的写入位置 */
+    Window m_nextWindow;           /**< 当前文件的下一个窗口 */
+    Window m_nextFile;             /**< 轮转后新文件的第一个窗口 */
+    std::vector<Window> m_retired; /**< 待后台线程释放的窗口 */
+    bool m_rotateRequested = false; /**< 已达到 m_maxSize, 等待新文件 */
+
+    // 以下只由后台线程访问
+    uint64_t m_rotateAt = 0;     /**< 下次按时间轮转的时间(秒) */
+    int m_inotifyFd     = -1;
+    int m_watch         = -1;    /**< 当前文件的 inotify 监视 */
+    uint64_t m_ino      = 0;     /**< 当前文件的 inode */
+    bool m_fileGone     = false; /**< 文件已被删除或改名, 等待新文件 */
+
+    int m_eventFd = -1;
+    std::atomic<bool> m_stopping{false};
+    Thread::ptr m_thread;
+};
+
+/**
+ * @brief   日志器管理类
+ * @details 日志器创建后不会删除, 因此按名字查找用一张只增不删的无锁哈希表,
+ *          命中时不加锁; 未命中才加锁创建并挂到桶链表头部
+ */
+class LoggerManager : Noncopyable {
   public:
     using MutexType = Spinlock;
 
     LoggerManager();
+    ~LoggerManager();
 
-    Logger::ptr getLogger(const std::string &name);
+    /**
+     * @brief  按名字查找日志器, 不存在时创建
+     * @return 返回的引用在管理器的生命周期内一直有效
+     */
+    const Logger::ptr &getLogger(const std::string &name);
 
     /**
      * @brief  返回当前管理器的根指针
      * @return m_root : Logger::ptr
      */
-    Logger::ptr getRoot() const { return m_root; }
+    const Logger::ptr &getRoot() const { return m_root; }
 
     std::string toYamlString();
 
   private:
-    std::map<std::string, Logger::ptr> m_loggers; // 日志器集
+    struct Node {
+        std::string name;
+        Logger::ptr logger;
+        Node *next;
+    };
+
+    static const size_t BUCKETS = 1024;
+
+    const Logger::ptr *find(const std::string &name, size_t hash) const;
+    void insert(const Logger::ptr &logger, size_t hash);
+
+  private:
+    std::map<std::string, Logger::ptr> m_loggers; // 日志器集, 按名字有序, 用于导出
+    std::atomic<Node *> m_buckets[BUCKETS];      /**< 查找用的哈希表 */
     Logger::ptr m_root;
-    MutexType m_mutex;
+    MutexType m_mutex; /**< 保护 m_loggers, 串行化插入 */
 };
 
 using LoggerMgr = sylar::Singleton<LoggerManager>;
@@ -0,0 +1,147 @@
+/**
+ * @file      rcu.hh
+ * @brief     读多写少数据的 RCU 式快照
+ * @details   读者在 RcuReadLock 内读取快照指针, 只写本线程的一个计数, 不加锁也不修改共享缓存行;
+ *            写者复制一份新快照后原子替换指针, 再由 RcuSynchronize 等待替换前进入的读者全部退出,
+ *            之后释放旧快照. 适合配置变更才写、每次调用都读的数据, 例如日志器的输出器列表
+ * @author    edward
+ * @copyright BSD-3-Clause
+ */
+#ifndef __SYLAR_RCU_H__
+#define __SYLAR_RCU_H__
+
+#include <atomic>
+#include <stdint.h>
+
+#include "sylar/noncopyable.hh"
+
+namespace sylar {
+
+/**
+ * @brief   读侧临界区, RAII, 可以嵌套
+ * @details 临界区内读到的快照在退出前不会被释放. 临界区内不能调用 RcuSynchronize,
+ *          也不应长时间阻塞, 否则写者会一直等待.
+ *          进出临界区内联展开, 只读写本线程的状态; 内核支持 membarrier 时读者只需编译器屏障,
+ *          由写者负责让所有线程执行内存屏障
+ */
+class RcuReadLock : Noncopyable {
+  public:
+    RcuReadLock()
+    {
+        ThreadState &state = t_state;
+        if (state.depth++ == 0) {
+            if (!state.epoch) {
+                RegisterThread();
+            }
+            state.epoch->store(s_epoch.load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+            // 先公布纪元再读取快照指针, 与 RcuSynchronize 中的屏障配对
+            if (s_membarrier) {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            }
+            else {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+    }
+
+    ~RcuReadLock()
+    {
+        ThreadState &state = t_state;
+        if (--state.depth == 0) {
+            state.epoch->store(0, std::memory_order_release);
+        }
+    }
+
+  private:
+    friend void RcuSynchronize();
+    friend struct RcuSlotHolder;
+
+    /**
+     * @brief 线程的读侧状态, 零初始化
+     */
+    struct ThreadState {
+        std::atomic<uint64_t> *epoch; /**< 本线程槽位中的纪元, 0 表示不在临界区内 */
+        uint32_t depth;               /**< 临界区嵌套深度 */
+    };
+
+    /**
+     * @brief 线程首次进入临界区时分配槽位, 线程退出时归还
+     */
+    static void RegisterThread();
+
+    // 用 initial-exec 模型按线程指针偏移直接寻址, 不经过 __tls_get_addr;
+    // 因此库须随程序启动加载, 不支持 dlopen
+    static __thread ThreadState t_state __attribute__((tls_model("initial-exec")));
+    static std::atomic<uint64_t> s_epoch; /**< 全局纪元, 每次 RcuSynchronize 加一 */
+    static bool s_membarrier;             /**< 写者是否使用 membarrier */
+};
+
+/**
+ * @brief 等待调用之前进入的所有读侧临界区退出
+ * @pre   当前线程不在读侧临界区内
+ */
+void RcuSynchronize();
+
+/**
+ * @brief   指向不可变快照的指针
+ * @tparam  T 快照类型, 发布后不再修改
+ * @details 读者在 RcuReadLock 内调用 get; 写者之间需要自行互斥, 通过 exchange 发布新快照
+ */
+template <class T>
+class RcuPtr : Noncopyable {
+  public:
+    explicit RcuPtr(T *ptr = nullptr) : m_ptr(ptr) {}
+
+    ~RcuPtr() { delete m_ptr.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 读取当前快照, 读者须在 RcuReadLock 内, 写者须持有自己的互斥锁
+     */
+    T *get() const { return m_ptr.load(std::memory_order_acquire); }
+
+    /**
+     * @brief     发布新快照
+     * @details   返回的旧快照可能仍有读者, 须在 RcuSynchronize 之后释放.
+     *            写者通常在自己的锁内 exchange, 解锁后再 RcuSynchronize, 避免读者等写者的锁
+     * @param[in] ptr 新快照, 由 RcuPtr 接管
+     * @return    旧快照, 由调用方接管
+     */
+    T *exchange(T *ptr) { return m_ptr.exchange(ptr, std::memory_order_acq_rel); }
+
+  private:
+    std::atomic<T *> m_ptr;
+};
+
+/**
+ * @brief   RcuPtr 当前快照的只读句柄, 持有期间处在读侧临界区内
+ * @details 构造时进入临界区并读取快照指针, 析构时退出; 访问快照不拷贝.
+ *          可以按值返回, 移动时在同一线程上嵌套进入临界区.
+ *          持有期间协程不能切换(包括 hook 的 IO 和 sleep), 否则可能在其他线程上退出
+ *          临界区; 也不能调用或等待其他线程调用会 RcuSynchronize 的函数,
+ *          例如 ConfigVar::setValue, 否则会死锁. 移动后原句柄仍在临界区内, 直到析构
+ */
+template <class T>
+class RcuSnapshot {
+  public:
+    explicit RcuSnapshot(const RcuPtr<T> &ptr) : m_ptr(ptr.get()) {}
+
+    RcuSnapshot(RcuSnapshot &&other) : m_ptr(other.m_ptr) {}
+
+    RcuSnapshot(const RcuSnapshot &)            = delete;
+    RcuSnapshot &operator=(const RcuSnapshot &) = delete;
+
+    T &operator*() const { return *m_ptr; }
+
+    T *operator->() const { return m_ptr; }
+
+    T *get() const { return m_ptr; }
+
+  private:
+    RcuReadLock m_lock; /**< 先于 m_ptr 构造, 读取指针时已在临界区内 */
+    T *m_ptr;
+};
+
+} // namespace sylar
+
+#endif // __SYLAR_RCU_H__
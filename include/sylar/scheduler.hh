@@ -26,6 +26,8 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
     using ptr       = std::shared_ptr<Scheduler>;
     using MutexType = Mutex;
 
+    struct WorkQueue; /**< 工作线程本地任务队列, 定义见 scheduler.cc */
+
     /**
      * @brief     构造函数
      * @param[in] threads 线程数量
@@ -42,6 +44,11 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
    */
 	const std::string& getName() const { return m_name; }
 
+  /**
+   * @brief 返回参与调度的线程 ID(包括 use_caller 时的调用线程), start 之后有效
+   */
+	const std::vector<int>& getThreadIds() const { return m_threadIds; }
+
   /**
    * @brief 启动协程调度器
    */
@@ -64,6 +71,12 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
    */
 	static Fiber*     GetMainFiber();
 
+  /**
+   * @brief   返回当前任务固定执行的线程 id, 未固定时为 -1
+   * @details 任务挂起后由事件或定时器重新调度时用它回到原来的线程
+   */
+	static int        GetTaskThread();
+
 
   /**
    * @brief     调度协程
@@ -72,6 +85,14 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
    */
 	template<class FiberOrCb>
 	void schedule(FiberOrCb fc, int thread = -1) {
+		if(m_workStealing) {
+			FiberAndThread ft(fc, thread);
+			if(ft.fiber || ft.cb) {
+				scheduleStealing(ft);
+			}
+			return;
+		}
+
 		bool need_tickle = false;
 		{
 				MutexType::Lock lock(m_mutex);
@@ -90,6 +111,17 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
     */
 	template<class InputIterator>
 	void schedule(InputIterator begin, InputIterator end) {
+		if(m_workStealing) {
+			while(begin != end) {
+				FiberAndThread ft(&*begin, -1);
+				if(ft.fiber || ft.cb) {
+					scheduleStealing(ft);
+				}
+				++begin;
+			}
+			return;
+		}
+
 		bool need_tickle = false;
 		{
 			MutexType::Lock lock(m_mutex);
@@ -104,6 +136,19 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
 		}
 	}
 
+  /**
+   * @brief 设置是否启用工作窃取调度(需在 start 之前调用)
+   * @details 启用后每个工作线程拥有一个有界无锁双端队列,
+   *          工作线程内产生的任务优先压入本线程队列, 空闲线程从其他线程队列窃取任务;
+   *          指定线程的任务直接投递到目标线程的收件箱
+   */
+	void setWorkStealing(bool v);
+
+  /**
+   * @brief 是否启用了工作窃取调度
+   */
+	bool isWorkStealing() const { return m_workStealing; }
+
   protected:
     std::vector<int>    m_threadIds;            /**< 协程下的线程 ID 数组 */
     std::atomic<size_t> m_activeThreadCount{0}; /**< 工作线程数量 */
@@ -145,6 +190,23 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
     virtual bool stopping();
 
   private:
+    struct FiberAndThread;
+
+    /**
+     * @brief 工作窃取模式下投递任务
+     * @details 指定线程的任务进入目标线程收件箱;
+     *          工作线程内的任务压入本线程队列, 队列满或非工作线程时进入全局队列
+     */
+    void scheduleStealing(FiberAndThread& ft);
+
+    /**
+     * @brief     工作窃取模式下获取任务
+     * @details   依次尝试本线程队列, 本线程收件箱, 全局队列, 最后窃取其他线程队列
+     * @param[out] ft 取到的任务
+     * @param[out] tickle_me 是否存在需要唤醒其他线程执行的任务
+     * @return    是否取到任务
+     */
+    bool takeStealing(FiberAndThread& ft, bool& tickle_me);
 
     /**
      * @brief 协程调度启动(无锁)
@@ -175,7 +237,7 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
          * @param[in] f 协程
          * @param[in] thr 线程id
          */
-        FiberAndThread(Fiber::ptr f, int thr) :thread(thr), fiber(f)  {}
+        FiberAndThread(Fiber::ptr f, int thr) :thread(thr), fiber(f)  { pinSharedStack(); }
 
         /**
          * @brief     构造函数
@@ -183,7 +245,11 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
          * @param[in] thr 线程id
          * @post      *f = nullptr
          */
-        FiberAndThread(Fiber::ptr *f, int thr) : thread(thr) { fiber.swap(*f); }
+        FiberAndThread(Fiber::ptr *f, int thr) : thread(thr)
+        {
+            fiber.swap(*f);
+            pinSharedStack();
+        }
 
         /**
          * @brief     构造函数
@@ -208,6 +274,16 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
          */
         FiberAndThread() : thread(-1) {}
 
+        /**
+         * @brief 共享栈协程只能回到其栈所属的线程执行
+         */
+        void pinSharedStack()
+        {
+            if (thread == -1 && fiber) {
+                thread = fiber->getSharedStackThread();
+            }
+        }
+
         /**
          * @brief 重置数据
          */
@@ -224,6 +300,10 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
     std::list<FiberAndThread> m_fibers; /**< 待执行的协程队列 */
     Fiber::ptr m_rootFiber;             /**< use_caller 为 true 时有效, 调度协程 */
     std::string m_name;                 /**< 协程调度器名称 */
+
+    bool m_workStealing = false;                     /**< 是否启用工作窃取 */
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; /**< 每个工作线程的本地队列 */
+    std::atomic<size_t> m_queuedCount{0};            /**< 本地队列与收件箱中的任务数 */
 };
 
 } // namespace sylar
@@ -0,0 +1,125 @@
+/**
+ * @file      segmented_array.hh
+ * @brief     按下标无锁访问的两级分段数组
+ * @details   第一级是定长的段指针数组, 第二级是按需分配的定长段, 扩容只增加新段,
+ *            已有元素的地址不会改变. 查找是两次 acquire 读取, 不加锁;
+ *            元素一旦放入就不再移除, 由数组在析构时统一释放
+ * @author    edward
+ * @copyright BSD-3-Clause
+ */
+#ifndef __SYLAR_SEGMENTED_ARRAY_H__
+#define __SYLAR_SEGMENTED_ARRAY_H__
+
+#include <atomic>
+#include <stddef.h>
+
+#include "sylar/noncopyable.hh"
+
+namespace sylar {
+
+/**
+ * @brief 两级分段数组
+ * @tparam T 元素类型, 数组中保存 T*
+ * @tparam SEGMENT_BITS 每段 2^SEGMENT_BITS 个元素
+ * @tparam SEGMENTS 段的最大数量, 容量为 SEGMENTS << SEGMENT_BITS
+ */
+template <class T, size_t SEGMENT_BITS = 10, size_t SEGMENTS = 4096>
+class SegmentedArray : Noncopyable {
+  public:
+    static const size_t SEGMENT_SIZE = (size_t)1 << SEGMENT_BITS;
+    static const size_t CAPACITY     = SEGMENTS << SEGMENT_BITS;
+
+    SegmentedArray()
+    {
+        for (size_t i = 0; i < SEGMENTS; ++i) {
+            m_segments[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief 析构函数, 释放全部元素和段
+     */
+    ~SegmentedArray()
+    {
+        for (size_t i = 0; i < SEGMENTS; ++i) {
+            Segment *seg = m_segments[i].load(std::memory_order_relaxed);
+            if (!seg) {
+                continue;
+            }
+            for (size_t j = 0; j < SEGMENT_SIZE; ++j) {
+                delete seg->items[j].load(std::memory_order_relaxed);
+            }
+            delete seg;
+        }
+    }
+
+    /**
+     * @brief     获取元素
+     * @param[in] index 下标
+     * @return    元素不存在或下标越界时返回 nullptr
+     */
+    T *get(size_t index) const
+    {
+        if (index >= CAPACITY) {
+            return nullptr;
+        }
+        Segment *seg = m_segments[index >> SEGMENT_BITS].load(std::memory_order_acquire);
+        if (!seg) {
+            return nullptr;
+        }
+        return seg->items[index & (SEGMENT_SIZE - 1)].load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief     获取元素, 不存在时调用 create(index) 创建
+     * @param[in] index 下标
+     * @param[in] create 创建元素的函数, 返回 new 出来的 T*
+     * @return    下标越界时返回 nullptr
+     * @attention 多个线程同时创建同一个元素时只有一个会被放入, 其余的被 delete
+     */
+    template <class Factory>
+    T *getOrCreate(size_t index, Factory create)
+    {
+        T *item = get(index);
+        if (item || index >= CAPACITY) {
+            return item;
+        }
+
+        std::atomic<Segment *> &slot = m_segments[index >> SEGMENT_BITS];
+        Segment *seg = slot.load(std::memory_order_acquire);
+        if (!seg) {
+            Segment *fresh = new Segment;
+            if (slot.compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+                seg = fresh;
+            }
+            else {
+                delete fresh;
+            }
+        }
+
+        std::atomic<T *> &cell = seg->items[index & (SEGMENT_SIZE - 1)];
+        T *fresh = create(index);
+        if (cell.compare_exchange_strong(item, fresh, std::memory_order_acq_rel)) {
+            return fresh;
+        }
+        delete fresh;
+        return item;
+    }
+
+  private:
+    struct Segment {
+        Segment()
+        {
+            for (size_t i = 0; i < SEGMENT_SIZE; ++i) {
+                items[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        std::atomic<T *> items[SEGMENT_SIZE];
+    };
+
+    std::atomic<Segment *> m_segments[SEGMENTS]; /**< 段指针 */
+};
+
+} // namespace sylar
+
+#endif // __SYLAR_SEGMENTED_ARRAY_H__
@@ -138,6 +138,13 @@ class Socket : public std::enable_shared_from_this<Socket>, Noncopyable {
         return setOption(level, option, &value, sizeof(T));
     }
 
+    /**
+     * @brief     设置 SO_REUSEPORT, 多个 socket 可以绑定同一地址, 由内核在它们之间分发新连接
+     * @param[in] v 是否开启
+     * @pre       必须在 bind 之前调用
+     */
+    bool setReusePort(bool v);
+
     /**
      * @brief     绑定地址
      * @param[in] addr 地址
@@ -0,0 +1,133 @@
+/**
+ * @file      stack_allocator.hh
+ * @brief     协程栈分配器
+ * @details   提供 malloc / mmap(带保护页) / 线程本地池化 三种实现,
+ *            通过配置 fiber.stack_allocator 选择新建协程使用的分配器
+ * @author    edward
+ * @copyright BSD-3-Clause
+ */
+#ifndef __SYLAR_STACK_ALLOCATOR_H__
+#define __SYLAR_STACK_ALLOCATOR_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sylar {
+
+/**
+ * @brief 协程栈分配器基类
+ */
+class StackAllocator {
+  public:
+    /**
+     * @brief 栈内存统计
+     */
+    struct Stats {
+        uint64_t allocated = 0; /**< 正在被协程使用的栈数量 */
+        uint64_t pooled    = 0; /**< 缓存在线程池中的空闲栈数量 */
+        uint64_t resident  = 0; /**< 未被归还给系统的栈字节数(估算值) */
+    };
+
+    virtual ~StackAllocator() {}
+
+    /**
+     * @brief     分配协程栈
+     * @param[in] size 栈大小
+     * @return    栈底地址, 失败返回 nullptr
+     */
+    virtual void *alloc(size_t size) = 0;
+
+    /**
+     * @brief     释放协程栈
+     * @param[in] vp alloc 返回的地址
+     * @param[in] size 分配时的栈大小
+     */
+    virtual void dealloc(void *vp, size_t size) = 0;
+
+    /**
+     * @brief 分配器名称
+     */
+    virtual const char *getName() const = 0;
+
+    /**
+     * @brief     按名称获取分配器
+     * @param[in] name malloc / mmap / pool
+     * @return    未知名称返回 nullptr
+     */
+    static StackAllocator *Get(const std::string &name);
+
+    /**
+     * @brief 返回配置 fiber.stack_allocator 选择的分配器
+     */
+    static StackAllocator *GetDefault();
+
+    /**
+     * @brief 返回全部分配器的栈内存统计
+     */
+    static Stats GetStats();
+
+  protected:
+    static std::atomic<uint64_t> s_allocated; /**< 使用中的栈数量 */
+    static std::atomic<uint64_t> s_pooled;    /**< 池中空闲栈数量 */
+    static std::atomic<uint64_t> s_resident;  /**< 常驻栈字节数 */
+};
+
+/**
+ * @brief malloc 分配栈, 没有溢出保护
+ */
+class MallocStackAllocator : public StackAllocator {
+  public:
+    void *alloc(size_t size) override;
+    void dealloc(void *vp, size_t size) override;
+    const char *getName() const override { return "malloc"; }
+};
+
+/**
+ * @brief   mmap 分配栈, 栈的最低页设置为 PROT_NONE 保护页
+ * @details 栈溢出会触发 SIGSEGV, 而不是悄悄改写相邻内存
+ */
+class MmapStackAllocator : public StackAllocator {
+  public:
+    void *alloc(size_t size) override;
+    void dealloc(void *vp, size_t size) override;
+    const char *getName() const override { return "mmap"; }
+
+    /**
+     * @brief 向上取整到页大小后的栈大小
+     */
+    static size_t RoundSize(size_t size);
+
+    /**
+     * @brief 映射一块带保护页的栈, 不计入统计
+     */
+    static void *Map(size_t size);
+
+    /**
+     * @brief 解除 Map 得到的栈映射, 不计入统计
+     */
+    static void Unmap(void *vp, size_t size);
+};
+
+/**
+ * @brief   线程本地池化的 mmap 栈分配器
+ * @details 释放的栈放入当前线程的空闲链表, 分配时优先复用;
+ *          超过 fiber.stack_pool.max_resident 的空闲栈用 MADV_DONTNEED 归还物理内存,
+ *          超过 fiber.stack_pool.max_cached 的空闲栈直接 munmap
+ */
+class PooledStackAllocator : public StackAllocator {
+  public:
+    void *alloc(size_t size) override;
+    void dealloc(void *vp, size_t size) override;
+    const char *getName() const override { return "pool"; }
+
+    /**
+     * @brief 释放当前线程池中缓存的全部空闲栈
+     */
+    static void Trim();
+};
+
+} // namespace sylar
+
+#endif // __SYLAR_STACK_ALLOCATOR_H__
@@ -23,6 +23,14 @@ public:
 	~Semaphore();
 
 	void wait();
+
+	/**
+	 * @brief     带超时的等待
+	 * @param[in] timeout_ms 超时时间(毫秒)
+	 * @return    超时返回 false
+	 */
+	bool waitFor(uint64_t timeout_ms);
+
 	void notify();
 
 
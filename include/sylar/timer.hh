@@ -1,10 +1,12 @@
 #ifndef __SYLAR_TIMER_H__
 #define __SYLAR_TIMER_H__
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <set>
 #include "sylar/thread.hh"
+#include "sylar/util.hh"
 
 namespace sylar {
 class TimerManager;
@@ -46,6 +48,16 @@ class Timer : public std::enable_shared_from_this<Timer> {
     std::function<void()> m_cb;        /**< 定时器的回调函数 */
     TimerManager *m_manager = nullptr; /**< 定时器管理器 */
 
+    // 以下成员只在时间轮模式下使用
+    Spinlock m_lock;                /**< 保护 m_cb/m_ms/m_next/m_queued/m_linked */
+    bool m_queued         = false;  /**< 是否在待处理队列中 */
+    bool m_linked         = false;  /**< 是否挂在时间轮的槽上 */
+    Timer *m_pendingNext  = nullptr; /**< 待处理队列中的下一个定时器 */
+    Timer *m_slotPrev     = nullptr; /**< 时间轮槽链表的前一个定时器 */
+    Timer *m_slotNext     = nullptr; /**< 时间轮槽链表的后一个定时器 */
+    Timer **m_slot        = nullptr; /**< 所在的时间轮槽 */
+    Timer::ptr m_self;               /**< 在时间轮或待处理队列中时持有自身引用 */
+
   private:
     struct Comparator {
         bool operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const;
@@ -53,8 +65,11 @@ class Timer : public std::enable_shared_from_this<Timer> {
 };
 
 /**
- * @class TimerManager
- * @brief 定时器管理对象
+ * @class   TimerManager
+ * @brief   定时器管理对象
+ * @details 默认使用按触发时间排序的 std::set; 配置 timer.use_wheel 为 true 时改用分层时间轮:
+ *          添加/取消/刷新只把定时器压入无锁的待处理队列, 由处理到期定时器的线程统一挂到槽上,
+ *          插入与删除都是 O(1)
  */
 class TimerManager {
     friend class Timer;
@@ -62,6 +77,9 @@ class TimerManager {
   public:
     using RWMutexType = RWMutex;
 
+    /**
+     * @brief 构造函数, 由配置 timer.use_wheel 决定是否使用时间轮
+     */
     TimerManager();
 
     virtual ~TimerManager();
@@ -100,8 +118,68 @@ class TimerManager {
      */
     virtual void onTimerInsertedAtFront() = 0;
 
+    /**
+     * @brief     指定是否使用时间轮, 不读取配置
+     * @param[in] use_wheel 为 true 时使用时间轮
+     */
+    explicit TimerManager(bool use_wheel);
+
+    /**
+     * @brief 当前时间(毫秒), 定时器的触发时间都按它计算; 测试可以覆盖它控制时间
+     */
+    virtual uint64_t getCurrentMS() const { return sylar::GetCurrentMS(); }
+
     void addTimer(Timer::ptr val, RWMutexType::WriteLock &lock);
 
+  private:
+    struct TimerWheel;
+
+    /**
+     * @brief 把定时器压入待处理队列, 调用方需持有 timer->m_lock 且 m_queued 为 false
+     */
+    void wheelPush(Timer *timer);
+
+    /**
+     * @brief 新的触发时间早于预计唤醒时间时通知事件循环
+     */
+    void wheelNotify(uint64_t next);
+
+    /**
+     * @brief 处理待处理队列, 调用方需持有时间轮的锁
+     */
+    void wheelDrain();
+
+    /**
+     * @brief 按触发时间把定时器挂到时间轮的槽上
+     */
+    void wheelLink(Timer *timer);
+
+    /**
+     * @brief 把定时器从所在的槽上摘下
+     */
+    void wheelUnlink(Timer *timer);
+
+    /**
+     * @brief 把高层槽中的定时器重新分配到低层, 返回槽下标
+     */
+    size_t wheelCascade(size_t level, size_t index);
+
+    /**
+     * @brief 处理一个槽中的到期定时器
+     */
+    void wheelExpire(Timer *head, uint64_t now_ms, bool all,
+                     std::vector<std::function<void()>> &cbs);
+
+    /**
+     * @brief 计算下一个需要处理的时间(毫秒时间戳), 没有定时器时返回 ~0ull
+     */
+    uint64_t wheelNextExpire();
+
+    /**
+     * @brief 时间轮模式的 listExpiredCb
+     */
+    void wheelListExpiredCb(std::vector<std::function<void()>> &cbs);
+
   private:
     /**
      * @berif 判断系统时间是否跳变
@@ -116,6 +194,10 @@ class TimerManager {
 
     bool m_tickled          = false; /**< 标记是否需要通知主事件循环 */
     uint64_t m_previousTime = 0;     /**< 上一次时间记录,用于检测系统时间回拨 */
+
+    std::unique_ptr<TimerWheel> m_wheel;        /**< 时间轮, 未启用时为空 */
+    std::atomic<Timer *> m_pending{nullptr};    /**< 待处理队列(无锁栈) */
+    std::atomic<uint64_t> m_wheelWakeup{~0ull}; /**< 事件循环预计的下一次唤醒时间 */
 };
 
 }; // namespace sylar
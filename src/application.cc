@@ -17,10 +17,15 @@ static sylar::ConfigVar<std::string>::ptr g_server_pid_file =
     sylar::Config::Lookup("server.pid_file", std::string("sylar.pid"),
                           "server pid file");
 
+static sylar::ConfigVar<bool>::ptr g_server_conf_watch =
+    sylar::Config::Lookup("server.conf_watch", false,
+                          "reload changed config files automatically");
+
 struct HttpServerConf {
     std::vector<std::string> address;
-    int keepalive = 0;
-    int timeout   = 1000 * 2 * 60;
+    int keepalive  = 0;
+    int timeout    = 1000 * 2 * 60;
+    int reuse_port = 0; /**< 每个工作线程一个 SO_REUSEPORT 监听 socket */
     std::string name;
 
     bool isVaild() const { return !address.empty(); }
@@ -28,7 +33,7 @@ struct HttpServerConf {
     bool operator==(const HttpServerConf &oth) const
     {
         return address == oth.address && keepalive == oth.keepalive
-               && name == oth.name;
+               && reuse_port == oth.reuse_port && name == oth.name;
     }
 };
 
@@ -41,6 +46,7 @@ class LexicalCast<std::string, HttpServerConf> {
         HttpServerConf conf;
         conf.keepalive = node["keepalive"].as<int>(conf.keepalive);
         conf.timeout   = node["timeout"].as<int>(conf.timeout);
+        conf.reuse_port = node["reuse_port"].as<int>(conf.reuse_port);
         conf.name      = node["name"].as<std::string>(conf.name);
         if (node["address"].IsDefined()) {
             for (size_t i = 0; i < node["address"].size(); ++i) {
@@ -60,6 +66,7 @@ class LexicalCast<HttpServerConf, std::string> {
         node["name"]      = conf.name;
         node["timeout"]   = conf.timeout;
         node["keepalive"] = conf.keepalive;
+        node["reuse_port"] = conf.reuse_port;
         for (auto &i : conf.address) {
             node["address"].push_back(i);
         }
@@ -165,6 +172,12 @@ auto Application::main(int argc, char **argv) -> int
         ofs << getpid();
     }
 
+    // 监视线程需在 fork 之后启动
+    if (g_server_conf_watch->getValue()) {
+        sylar::Config::WatchConfDir(sylar::EnvMgr::GetInstance()->getAbsolutePath(
+            sylar::EnvMgr::GetInstance()->get("c", "../conf")));
+    }
+
     sylar::IOManager iom(1);
     iom.schedule([this]() { this->run_fiber(); });
     iom.stop(); // 在停止前,主动去执行这个任务
@@ -222,6 +235,7 @@ auto Application::run_fiber() -> int
         // 启动 httpserver 服务器
         sylar::http::HttpServer::ptr server(
             new sylar::http::HttpServer(i.keepalive));
+        server->setReusePort(i.reuse_port);
 
         // 将服务器和地址进行绑定
         std::vector<Address::ptr> fails;
@@ -0,0 +1,110 @@
+/**
+ * @file      bench_accept.cc
+ * @brief     短连接建连吞吐: 单个 accept 协程转交 vs 每线程 SO_REUSEPORT 分片监听
+ * @details   用法: bench_accept [server_threads] [concurrency] [seconds]
+ *            同一进程内的 HttpServer(非 keep-alive) 与负载生成器, 负载生成器的每个协程
+ *            循环 建连 -> 发送请求 -> 读到对端关闭 -> 关闭, 统计每秒完成的连接数
+ */
+#include "sylar/sylar.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/socket.hh"
+#include "http/http_server.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+static std::atomic<uint64_t> s_conns{0};
+static std::atomic<uint64_t> s_fails{0};
+static std::atomic<bool> s_running{false};
+
+static const std::string s_http_req = "GET /ping HTTP/1.1\r\n"
+                                      "Host: 127.0.0.1\r\n"
+                                      "Connection: close\r\n\r\n";
+
+static void load_client(sylar::Address::ptr addr)
+{
+    char buf[4096];
+    while (s_running) {
+        sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+        if (!sock->connect(addr)
+            || sock->send(s_http_req.c_str(), s_http_req.size())
+                   != (int)s_http_req.size())
+        {
+            ++s_fails;
+            continue;
+        }
+        while (sock->recv(buf, sizeof(buf)) > 0)
+            ;
+        sock->close();
+        ++s_conns;
+    }
+}
+
+static double run_once(bool reuse_port, size_t threads, size_t concurrency,
+                       int seconds, uint16_t port)
+{
+    s_conns   = 0;
+    s_fails   = 0;
+    s_running = true;
+
+    sylar::IOManager server_iom(threads, false, "server");
+    sylar::IOManager client_iom(1, false, "client");
+
+    sylar::Address::ptr addr =
+        sylar::Address::LookupAny("127.0.0.1:" + std::to_string(port));
+    sylar::http::HttpServer::ptr server(
+        new sylar::http::HttpServer(false, &server_iom, &server_iom));
+    server->setReusePort(reuse_port);
+    server->getServletDispatcher()->addServlet(
+        "/ping", [](sylar::http::HttpRequest::ptr req,
+                    sylar::http::HttpResponse::ptr rsp,
+                    sylar::http::HttpSession::ptr session) {
+            rsp->setBody("pong");
+            return 0;
+        });
+    server_iom.schedule([server, addr]() {
+        while (!server->bind(addr)) {
+            sleep(1);
+        }
+        server->start();
+    });
+    sleep(1);
+
+    for (size_t i = 0; i < concurrency; ++i) {
+        client_iom.schedule(std::bind(&load_client, addr));
+    }
+
+    uint64_t begin = sylar::GetCurrentUS();
+    sleep(seconds);
+    uint64_t cost  = sylar::GetCurrentUS() - begin;
+    uint64_t done  = s_conns;
+    s_running      = false;
+
+    client_iom.stop();
+    server->stop();
+    if (s_fails) {
+        printf("  (%lu failed connections)\n", (unsigned long)s_fails.load());
+    }
+    return done * 1000000.0 / (cost ? cost : 1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t threads     = argc > 1 ? atoi(argv[1]) : 4;
+    size_t concurrency = argc > 2 ? atoi(argv[2]) : 64;
+    int seconds        = argc > 3 ? atoi(argv[3]) : 3;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::FATAL);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::FATAL);
+
+    printf("server_threads=%zu concurrency=%zu seconds=%d\n", threads,
+           concurrency, seconds);
+    double single = run_once(false, threads, concurrency, seconds, 18060);
+    double shard  = run_once(true, threads, concurrency, seconds, 18061);
+    printf("%-16s %12s\n", "accept", "conn/s");
+    printf("%-16s %12.0f\n", "single", single);
+    printf("%-16s %12.0f\n", "reuse_port", shard);
+    printf("speedup %.2fx\n", shard / single);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file      bench_config_get.cc
+ * @brief     多线程并发读取同一个配置变量的开销
+ * @details   用法: bench_config_get [ops] [max_threads]
+ *            u32/string 分别读取整数和字符串配置, string_snap 用 getSnapshot 读取
+ *            字符串不拷贝, u32_set 在读取的同时由另一个线程
+ *            不停修改该配置并触发监听回调. ops 为所有线程的总次数,
+ *            线程数从 1 翻倍到 max_threads
+ */
+#include "sylar/sylar.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static sylar::ConfigVar<uint32_t>::ptr g_bench_u32 =
+    sylar::Config::Lookup("bench.config.u32", (uint32_t)128 * 1024,
+                          "bench u32 value");
+
+static sylar::ConfigVar<std::string>::ptr g_bench_string =
+    sylar::Config::Lookup("bench.config.string",
+                          std::string("/var/log/sylar/access.log"),
+                          "bench string value");
+
+enum Mode { U32, STRING, STRING_SNAP, U32_SET };
+
+static const char *s_names[] = {"u32", "string", "string_snap", "u32_set"};
+
+static std::atomic<uint64_t> s_sink{0};
+
+static void worker(Mode mode, size_t ops, std::atomic<bool> &go)
+{
+    while (!go.load(std::memory_order_acquire)) {
+        sched_yield();
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < ops; ++i) {
+        if (mode == STRING) {
+            sum += g_bench_string->getValue().size();
+        }
+        else if (mode == STRING_SNAP) {
+            sum += g_bench_string->getSnapshot()->size();
+        }
+        else {
+            sum += g_bench_u32->getValue();
+        }
+    }
+    s_sink += sum;
+}
+
+static void run(Mode mode, size_t ops, int threads)
+{
+    std::atomic<bool> go{false};
+    std::atomic<bool> done{false};
+    uint64_t sets = 0;
+
+    std::vector<sylar::Thread::ptr> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(sylar::Thread::ptr(new sylar::Thread(
+            std::bind(worker, mode, ops / threads, std::ref(go)),
+            "config_" + std::to_string(i))));
+    }
+    sylar::Thread::ptr writer;
+    if (mode == U32_SET) {
+        writer.reset(new sylar::Thread(
+            [&]() {
+                while (!done.load(std::memory_order_acquire)) {
+                    g_bench_u32->setValue(64 * 1024 + sets % 2);
+                    ++sets;
+                    usleep(100);
+                }
+            },
+            "config_writer"));
+    }
+
+    uint64_t begin = sylar::GetCurrentUS();
+    go.store(true, std::memory_order_release);
+    for (auto &i : workers) {
+        i->join();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    done.store(true, std::memory_order_release);
+    if (writer) {
+        writer->join();
+    }
+
+    size_t total = ops / threads * threads;
+    printf("%-11s %8d %14.0f %10.2f %8lu\n", s_names[mode], threads,
+           total * 1000000.0 / (cost ? cost : 1), cost * 1000.0 / total,
+           (unsigned long)sets);
+}
+
+int main(int argc, char **argv)
+{
+    size_t ops      = argc > 1 ? atoi(argv[1]) : 20000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 64;
+
+    uint64_t changes = 0;
+    g_bench_u32->addListener(
+        [&changes](const uint32_t &, const uint32_t &) { ++changes; });
+
+    printf("ops=%zu cpus=%ld\n", ops, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-11s %8s %14s %10s %8s\n", "mode", "threads", "ops/s", "ns/op",
+           "sets");
+    for (int mode = U32; mode <= U32_SET; ++mode) {
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            run((Mode)mode, ops, threads);
+        }
+    }
+    printf("listener calls=%lu\n", (unsigned long)changes);
+    return 0;
+}
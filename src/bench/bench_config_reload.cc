@@ -0,0 +1,84 @@
+/**
+ * @file      bench_config_reload.cc
+ * @brief     配置重新加载的开销: 全量 LoadFromYaml vs 差异加载 LoadFromYamlDiff
+ * @details   用法: bench_config_reload [keys] [rounds]
+ *            注册 keys 个整数配置项和 keys/16 个 map 配置项, 每轮修改一个整数并恢复
+ *            上一轮修改的整数, 统计每轮的加载耗时以及触发的监听回调次数
+ */
+#include "sylar/sylar.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+static uint64_t s_changes = 0;
+
+static std::string build(size_t keys, size_t round)
+{
+    std::stringstream ss;
+    ss << "bench:\n";
+    for (size_t g = 0; g < keys / 16; ++g) {
+        ss << "  group" << g << ":\n";
+        for (size_t k = 0; k < 16; ++k) {
+            size_t idx = g * 16 + k;
+            ss << "    key" << k << ": " << (idx == round % keys ? idx + keys : idx)
+               << "\n";
+        }
+        ss << "    map:\n      host: 10.0.0." << g % 256
+           << "\n      port: 8080\n";
+    }
+    return ss.str();
+}
+
+int main(int argc, char **argv)
+{
+    size_t keys   = argc > 1 ? atoi(argv[1]) : 4096;
+    size_t rounds = argc > 2 ? atoi(argv[2]) : 50;
+    keys          = std::max<size_t>(keys / 16, 1) * 16;
+
+    for (size_t g = 0; g < keys / 16; ++g) {
+        std::string prefix = "bench.group" + std::to_string(g);
+        for (size_t k = 0; k < 16; ++k) {
+            sylar::Config::Lookup(prefix + ".key" + std::to_string(k), 0, "")
+                ->addListener([](const int &, const int &) { ++s_changes; });
+        }
+        sylar::Config::Lookup(prefix + ".map", std::map<std::string, std::string>(),
+                              "")
+            ->addListener([](const std::map<std::string, std::string> &,
+                             const std::map<std::string, std::string> &) {
+                ++s_changes;
+            });
+    }
+
+    std::vector<YAML::Node> trees;
+    for (size_t i = 0; i <= rounds; ++i) {
+        trees.push_back(YAML::Load(build(keys, i)));
+    }
+    sylar::Config::LoadFromYaml(trees[0]);
+
+    printf("keys=%zu maps=%zu rounds=%zu (one key changed, one restored per round)\n",
+           keys,
+           keys / 16, rounds);
+    printf("%-6s %12s %14s\n", "mode", "ms/reload", "listeners/run");
+
+    s_changes      = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t i = 1; i <= rounds; ++i) {
+        sylar::Config::LoadFromYaml(trees[i]);
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    printf("%-6s %12.3f %14.1f\n", "full", cost / 1000.0 / rounds,
+           (double)s_changes / rounds);
+
+    sylar::Config::LoadFromYaml(trees[0]);
+    s_changes = 0;
+    begin     = sylar::GetCurrentUS();
+    for (size_t i = 1; i <= rounds; ++i) {
+        sylar::Config::LoadFromYamlDiff(trees[i], trees[i - 1]);
+    }
+    cost = sylar::GetCurrentUS() - begin;
+    printf("%-6s %12.3f %14.1f\n", "diff", cost / 1000.0 / rounds,
+           (double)s_changes / rounds);
+    return 0;
+}
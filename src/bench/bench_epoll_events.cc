@@ -0,0 +1,133 @@
+/**
+ * @file      bench_epoll_events.cc
+ * @brief     epoll 事件注册方式对比: 每次事件 MOD/DEL vs 持久注册
+ * @details   用法: bench_epoll_events [connections] [seconds]
+ *            同一进程内的 echo 服务器与 connections 个长连接客户端互相收发,
+ *            输出吞吐以及每个请求平均的 epoll_wait / epoll_ctl / EAGAIN 次数
+ */
+#include "sylar/sylar.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/socket.hh"
+#include "http/tcp_server.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+static std::atomic<uint64_t> s_requests{0};
+static std::atomic<bool> s_running{false};
+
+class EchoServer : public sylar::TcpServer {
+  public:
+    EchoServer(sylar::IOManager *worker) : sylar::TcpServer(worker, worker) {}
+
+  protected:
+    void handleClient(sylar::Socket::ptr client) override
+    {
+        char buf[4096];
+        while (true) {
+            int rt = client->recv(buf, sizeof(buf));
+            if (rt <= 0) {
+                break;
+            }
+            if (client->send(buf, rt) != rt) {
+                break;
+            }
+        }
+        client->close();
+    }
+};
+
+static void echo_client(sylar::Address::ptr addr)
+{
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        return;
+    }
+    char msg[64] = "sylar epoll benchmark payload";
+    char buf[sizeof(msg)];
+    while (s_running) {
+        if (sock->send(msg, sizeof(msg)) != sizeof(msg)) {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(buf)) {
+            int rt = sock->recv(buf + got, sizeof(buf) - got);
+            if (rt <= 0) {
+                return;
+            }
+            got += rt;
+        }
+        ++s_requests;
+    }
+    sock->close();
+}
+
+static void run_once(bool persistent, size_t conns, int seconds, uint16_t port)
+{
+    sylar::Config::Lookup<bool>("iomanager.persistent_events")->setValue(persistent);
+
+    s_requests = 0;
+    s_running  = true;
+
+    sylar::IOManager server_iom(1, false, "server");
+    sylar::IOManager client_iom(1, false, "client");
+
+    sylar::Address::ptr addr =
+        sylar::Address::LookupAny("127.0.0.1:" + std::to_string(port));
+    sylar::TcpServer::ptr server(new EchoServer(&server_iom));
+    server_iom.schedule([server, addr]() {
+        while (!server->bind(addr)) {
+            sleep(1);
+        }
+        server->start();
+    });
+    sleep(1);
+
+    for (size_t i = 0; i < conns; ++i) {
+        client_iom.schedule(std::bind(&echo_client, addr));
+    }
+
+    // 跳过建连阶段, 只统计稳定收发期间的系统调用
+    sleep(1);
+    sylar::IOManager::Stats s0 = server_iom.getStats();
+    sylar::IOManager::Stats c0 = client_iom.getStats();
+    uint64_t r0    = s_requests;
+    uint64_t begin = sylar::GetCurrentUS();
+
+    sleep(seconds);
+
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    uint64_t done = s_requests - r0;
+    sylar::IOManager::Stats s1 = server_iom.getStats();
+    sylar::IOManager::Stats c1 = client_iom.getStats();
+    s_running = false;
+
+    double n = done ? (double)done : 1.0;
+    printf("%-12s %12.0f %10.3f %10.3f %10.3f %10.3f\n",
+           persistent ? "persistent" : "per-event", done * 1000000.0 / (cost ? cost : 1),
+           (s1.epollWait - s0.epollWait + c1.epollWait - c0.epollWait) / n,
+           (s1.epollCtl - s0.epollCtl + c1.epollCtl - c0.epollCtl) / n,
+           (s1.addEvent - s0.addEvent + c1.addEvent - c0.addEvent) / n,
+           (s1.readyHit - s0.readyHit + c1.readyHit - c0.readyHit) / n);
+
+    client_iom.stop();
+    server->stop();
+}
+
+int main(int argc, char **argv)
+{
+    size_t conns = argc > 1 ? atoi(argv[1]) : 1000;
+    int seconds  = argc > 2 ? atoi(argv[2]) : 3;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::FATAL);
+
+    printf("connections=%zu seconds=%d (syscalls per request, client + server)\n",
+           conns, seconds);
+    printf("%-12s %12s %10s %10s %10s %10s\n", "mode", "req/s", "epoll_wait",
+           "epoll_ctl", "EAGAIN", "ready_hit");
+    run_once(false, conns, seconds, 18040);
+    run_once(true, conns, seconds, 18041);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file      bench_fd_table.cc
+ * @brief     句柄表查找的并发吞吐: FdManager::get 与 IOManager::addEvent/cancelEvent
+ * @details   用法: bench_fd_table [threads] [ops_per_thread]
+ *            每个线程使用自己的 socketpair, 反复查找句柄上下文以及注册/取消读事件,
+ *            所有线程都要经过全局的句柄表
+ */
+#include "sylar/sylar.hh"
+#include "sylar/fd_manager.hh"
+#include "sylar/iomanager.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static std::atomic<size_t> s_done{0};
+
+static void fd_lookup(int fd, size_t ops, std::atomic<uint64_t> *sink)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < ops; ++i) {
+        auto ctx = sylar::FdMgr::GetInstance()->get(fd);
+        sum += ctx->isSocket();
+    }
+    *sink += sum;
+    ++s_done;
+}
+
+static void event_churn(sylar::IOManager *iom, int fd, size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        iom->addEvent(fd, sylar::IOManager::READ, []() {});
+        iom->cancelEvent(fd, sylar::IOManager::READ);
+        // 取消会调度回调, 定期让出以免任务队列无限增长
+        if ((i & 63) == 63) {
+            sylar::Fiber::YieldToReady();
+        }
+    }
+    ++s_done;
+}
+
+static double run_once(bool lookup, size_t threads, size_t ops)
+{
+    std::vector<int> fds;
+    for (size_t i = 0; i < threads; ++i) {
+        int sv[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+        // 不在 hook 中创建, 手动登记, 使句柄号分散到整张表上
+        sylar::FdMgr::GetInstance()->get(sv[0], true);
+        fds.push_back(sv[0]);
+        fds.push_back(sv[1]);
+    }
+
+    std::atomic<uint64_t> sink{0};
+    s_done = 0;
+    uint64_t begin = 0;
+    uint64_t cost  = 0;
+    {
+        sylar::IOManager iom(threads, false, "bench");
+        begin = sylar::GetCurrentUS();
+        for (size_t i = 0; i < threads; ++i) {
+            if (lookup) {
+                iom.schedule(std::bind(&fd_lookup, fds[i * 2], ops, &sink));
+            }
+            else {
+                iom.schedule(std::bind(&event_churn, &iom, fds[i * 2], ops));
+            }
+        }
+        while (s_done != threads) {
+            usleep(1000);
+        }
+        cost = sylar::GetCurrentUS() - begin;
+    }
+
+    for (int fd : fds) {
+        sylar::FdMgr::GetInstance()->del(fd);
+        close(fd);
+    }
+    return threads * ops * 1000000.0 / (cost ? cost : 1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t threads = argc > 1 ? atoi(argv[1]) : 32;
+    size_t ops     = argc > 2 ? atoi(argv[2]) : 200000;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::ERROR);
+
+    printf("threads=%zu ops_per_thread=%zu\n", threads, ops);
+    printf("%-24s %16.0f op/s\n", "FdManager::get", run_once(true, threads, ops));
+    printf("%-24s %16.0f op/s\n", "addEvent+cancelEvent", run_once(false, threads, ops));
+    return 0;
+}
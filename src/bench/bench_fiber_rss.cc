@@ -0,0 +1,84 @@
+/**
+ * @file      bench_fiber_rss.cc
+ * @brief     挂起协程的内存占用测试
+ * @details   用法: bench_fiber_rss [shared|normal] [count...]
+ *            创建 count 个执行后挂起(HOLD)的协程, 输出进程 RSS 及每个协程的平均占用;
+ *            shared 默认测试 10k/100k/1M, normal 默认只测 10k(每个协程独占 1MB 栈,
+ *            更多的数量会超过 vm.max_map_count 或虚拟内存限制)
+ */
+#include "sylar/sylar.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+static size_t rss_bytes()
+{
+    long pages = 0;
+    FILE *fp   = fopen("/proc/self/statm", "r");
+    if (fp) {
+        long size = 0;
+        if (fscanf(fp, "%ld %ld", &size, &pages) != 2) {
+            pages = 0;
+        }
+        fclose(fp);
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+// 模拟一个连接处理协程: 栈上有少量状态, 然后挂起等待
+static void parked()
+{
+    char state[256];
+    memset(state, 0x5a, sizeof(state));
+    sylar::Fiber::YieldToHold();
+    SYLAR_ASSERT(state[0] == 0x5a && state[sizeof(state) - 1] == 0x5a);
+}
+
+static void run_once(bool shared, size_t count)
+{
+    size_t base = rss_bytes();
+    std::vector<sylar::Fiber::ptr> fibers;
+    fibers.reserve(count);
+
+    uint64_t begin = sylar::GetCurrentMS();
+    for (size_t i = 0; i < count; ++i) {
+        fibers.emplace_back(new sylar::Fiber(&parked, 0, false, shared));
+        fibers.back()->swapIn();
+    }
+    uint64_t cost = sylar::GetCurrentMS() - begin;
+
+    size_t used = rss_bytes() - base;
+    printf("%-7s %9zu fibers  rss=%9.1f MB  %8.2f KB/fiber  park=%lums\n",
+           shared ? "shared" : "normal", count, used / 1048576.0,
+           used / 1024.0 / count, (unsigned long)cost);
+
+    // 恢复全部协程, 校验栈内容被正确换入
+    for (auto &fiber : fibers) {
+        fiber->swapIn();
+        SYLAR_ASSERT(fiber->getState() == sylar::Fiber::TERM);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool shared = !(argc > 1 && strcmp(argv[1], "normal") == 0);
+
+    std::vector<size_t> counts;
+    for (int i = 2; i < argc; ++i) {
+        counts.push_back(strtoull(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = shared ? std::vector<size_t>{10000, 100000, 1000000}
+                        : std::vector<size_t>{10000};
+    }
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    sylar::Scheduler sc;
+
+    for (auto count : counts) {
+        run_once(shared, count);
+    }
+    return 0;
+}
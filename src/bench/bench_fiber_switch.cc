@@ -0,0 +1,47 @@
+/**
+ * @file      bench_fiber_switch.cc
+ * @brief     协程切换速度测试
+ * @details   用法: bench_fiber_switch [rounds]
+ *            主协程与子协程来回切换 rounds 次, 输出当前编译选择的切换实现的每秒切换次数;
+ *            分别以 -DSYLAR_FIBER_ASM_CONTEXT=ON/OFF 编译后对比
+ */
+#include "sylar/sylar.hh"
+
+#include <cstdio>
+#include <cstdlib>
+
+static uint64_t s_rounds = 10000000;
+static sylar::Fiber *s_fiber = nullptr;
+
+static void ping()
+{
+    for (uint64_t i = 0; i < s_rounds; ++i) {
+        s_fiber->back();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    s_rounds = argc > 1 ? strtoull(argv[1], nullptr, 10) : s_rounds;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    sylar::Fiber::GetThis();
+
+    sylar::Fiber::ptr fiber(new sylar::Fiber(&ping, 0, true));
+    s_fiber = fiber.get();
+
+    uint64_t begin = sylar::GetCurrentUS();
+    // 最后一次 call 让 ping 返回, 协程结束
+    for (uint64_t i = 0; i <= s_rounds; ++i) {
+        fiber->call();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(fiber->getState() == sylar::Fiber::TERM);
+
+    uint64_t switches = (s_rounds + 1) * 2;
+    printf("backend=%s switches=%lu cost=%.3fs rate=%.0f switch/s %.1f ns/switch\n",
+           sylar::FiberContext::BackendName(), (unsigned long)switches,
+           cost / 1000000.0, switches * 1000000.0 / (cost ? cost : 1),
+           cost * 1000.0 / switches);
+    return 0;
+}
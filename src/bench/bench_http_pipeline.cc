@@ -0,0 +1,164 @@
+/**
+ * @file      bench_http_pipeline.cc
+ * @brief     HttpServer 长连接上的请求吞吐, 逐个请求 vs 管线化
+ * @details   用法: bench_http_pipeline [requests] [conns]
+ *            本机 TCP 上启动 HttpServer, conns 个客户端协程各自一条长连接,
+ *            每轮一次性写出 depth 个请求, 再读回 depth 个响应. depth=1 即普通长连接,
+ *            depth=16 为管线化; post 模式的请求带 32 字节的请求体.
+ *            requests 为所有连接的总请求数
+ */
+#include "sylar/sylar.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/socket.hh"
+#include "http/http_server.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const std::string s_get = "GET /bench HTTP/1.1\r\n"
+                                 "Host: 127.0.0.1\r\n"
+                                 "Connection: keep-alive\r\n\r\n";
+
+static const std::string s_post = "POST /bench HTTP/1.1\r\n"
+                                  "Host: 127.0.0.1\r\n"
+                                  "Connection: keep-alive\r\n"
+                                  "Content-Length: 32\r\n\r\n" +
+                                  std::string(32, 'p');
+
+/**
+ * @brief   读一个响应, 返回整个响应的字节数, 失败返回 0
+ * @details 所有响应大小相同, 之后按这个大小计数
+ */
+static size_t probe(sylar::Socket::ptr sock, const std::string &req)
+{
+    if (sock->send(req.data(), req.size()) <= 0) {
+        return 0;
+    }
+    std::string data;
+    char buf[4096];
+    for (;;) {
+        size_t pos = data.find("\r\n\r\n");
+        if (pos != std::string::npos) {
+            const char *cl = strcasestr(data.c_str(), "content-length:");
+            size_t total   = pos + 4 + (cl ? atoi(cl + 15) : 0);
+            if (data.size() >= total) {
+                return total;
+            }
+        }
+        int rt = sock->recv(buf, sizeof(buf));
+        if (rt <= 0) {
+            return 0;
+        }
+        data.append(buf, rt);
+    }
+}
+
+static void client(sylar::Address::ptr addr, const std::string &req, int depth,
+                   size_t batches, std::atomic<int> &running,
+                   std::atomic<size_t> &done, sylar::http::HttpServer::ptr server)
+{
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        printf("connect failed\n");
+    }
+    else {
+        // 收不到完整的响应说明服务端丢了管线化的请求
+        sock->setRecvTimeout(2000);
+        size_t rsp_size = probe(sock, req);
+
+        std::string batch;
+        for (int i = 0; i < depth; ++i) {
+            batch += req;
+        }
+        std::vector<char> buf(64 * 1024);
+        for (size_t i = 0; rsp_size && i < batches; ++i) {
+            if (sock->send(batch.data(), batch.size()) <= 0) {
+                printf("send failed\n");
+                break;
+            }
+            size_t left = rsp_size * depth;
+            while (left > 0) {
+                int rt = sock->recv(buf.data(), std::min(buf.size(), left));
+                if (rt <= 0) {
+                    break;
+                }
+                left -= rt;
+            }
+            if (left > 0) {
+                printf("recv timeout, %zu of %d responses missing\n",
+                       (left + rsp_size - 1) / rsp_size, depth);
+                break;
+            }
+            done += depth;
+        }
+        sock->close();
+    }
+    if (--running == 0) {
+        server->stop();
+    }
+}
+
+static void run(const char *name, const std::string &req, int depth,
+                size_t requests, int conns, uint16_t port)
+{
+    sylar::IOManager iom(1, true, "bench");
+    std::atomic<size_t> done{0};
+    uint64_t cost = 0;
+
+    iom.schedule([&]() {
+        sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true));
+        sylar::Address::ptr addr =
+            sylar::Address::LookupAny("127.0.0.1:" + std::to_string(port));
+        if (!server->bind(addr)) {
+            printf("bind %s failed\n", addr->toString().c_str());
+            return;
+        }
+        server->getServletDispatcher()->addServlet(
+            "/bench", [](sylar::http::HttpRequest::ptr req,
+                         sylar::http::HttpResponse::ptr rsp,
+                         sylar::http::HttpSession::ptr session) {
+                rsp->setBody("hello " + std::to_string(req->getBody().size()));
+                return 0;
+            });
+        server->start();
+
+        std::shared_ptr<std::atomic<int>> running(new std::atomic<int>(conns));
+        size_t batches = std::max<size_t>(requests / conns / depth, 1);
+        uint64_t begin = sylar::GetCurrentUS();
+        for (int i = 0; i < conns; ++i) {
+            sylar::IOManager::GetThis()->schedule(
+                [addr, &req, depth, batches, running, &done, &cost, begin,
+                 server]() {
+                    client(addr, req, depth, batches, *running, done, server);
+                    if (*running == 0) {
+                        cost = sylar::GetCurrentUS() - begin;
+                    }
+                });
+        }
+    });
+    iom.stop();
+
+    printf("%-5s %6d %6d %10zu %12.0f\n", name, conns, depth, done.load(),
+           done * 1000000.0 / (cost ? cost : 1));
+}
+
+int main(int argc, char **argv)
+{
+    size_t requests = argc > 1 ? atoi(argv[1]) : 200000;
+    int conns       = argc > 2 ? atoi(argv[2]) : 4;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::ERROR);
+
+    printf("requests=%zu (loopback TCP, 1 thread)\n", requests);
+    printf("%-5s %6s %6s %10s %12s\n", "mode", "conns", "depth", "done",
+           "req/s");
+    uint16_t port = 18700;
+    for (int depth : {1, 16}) {
+        run("get", s_get, depth, requests, conns, port++);
+        run("post", s_post, depth, requests, conns, port++);
+    }
+    return 0;
+}
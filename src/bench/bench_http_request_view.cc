@@ -0,0 +1,107 @@
+/**
+ * @file      bench_http_request_view.cc
+ * @brief     请求头解析加字段查找的开销: HttpRequest vs HttpRequestView
+ * @details   用法: bench_http_request_view [rounds]
+ *            解析一个典型的浏览器 GET 请求(17 个头部, 带 cookie), 再查 5 个字段,
+ *            其中一个不存在. request 是原来的 HttpRequestParser, 每个字段拷贝进 map;
+ *            view 只记录位置; view_compat 在 view 之后再 toRequest 转成 HttpRequest
+ */
+#include "sylar/sylar.hh"
+#include "http/http_parser.hh"
+#include "http/http_request_view.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
+
+static const std::string s_request =
+    "GET /api/v1/items?page=3&sort=desc HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", "
+    "\"Not=A?Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, "
+    "like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,"
+    "image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Referer: https://www.example.com/api/v1/items?page=2&sort=desc\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9,zh-CN;q=0.8,zh;q=0.7\r\n"
+    "Cookie: session=9f8e7d6c5b4a39281706f5e4d3c2b1a0; theme=dark; "
+    "_ga=GA1.2.1234567890.1697000000; _gid=GA1.2.987654321.1697000000\r\n"
+    "\r\n";
+
+enum Mode { REQUEST, VIEW, VIEW_COMPAT };
+
+static const char *s_names[] = {"request", "view", "view_compat"};
+
+static void run(Mode mode, size_t rounds)
+{
+    std::string buf = s_request;
+    sylar::http::HttpRequestParser parser;
+    sylar::http::HttpRequestView view;
+    sylar::http::HttpRequestViewParser view_parser(&view);
+    uint64_t sum = 0;
+
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < rounds; ++i) {
+        if (mode == REQUEST) {
+            parser.reset();
+            parser.execute(&buf[0], buf.size());
+            sylar::http::HttpRequest::ptr req = parser.getData();
+            sum += req->getHeader("host").size();
+            sum += req->getHeader("user-agent").size();
+            sum += req->getHeader("accept-encoding").size();
+            sum += req->getHeader("cookie").size();
+            sum += req->getHeaderAs<uint64_t>("content-length", 0);
+            // 与原来 recvRequest 判断长连接的方式相同
+            sum += strcasecmp(req->getHeader("connection").c_str(),
+                              "keep-alive") != 0;
+        }
+        else {
+            view_parser.reset();
+            view_parser.execute(buf.data(), buf.size());
+            sum += view.getHeader("host").size();
+            sum += view.getHeader("user-agent").size();
+            sum += view.getHeader("accept-encoding").size();
+            sum += view.getHeader("cookie").size();
+            sum += view.getHeaderAs<uint64_t>("content-length", 0);
+            sum += view.isClose();
+            if (mode == VIEW_COMPAT) {
+                sum += view.toRequest()->getHeaders().size();
+            }
+        }
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    if (cost == 0) {
+        cost = 1;
+    }
+
+    printf("%-12s %10zu %10.1f %10.1f %8lu\n", s_names[mode], rounds,
+           cost * 1000.0 / rounds,
+           s_request.size() * rounds / 1048576.0 * 1000000.0 / cost,
+           (unsigned long)(sum / rounds));
+}
+
+int main(int argc, char **argv)
+{
+    size_t rounds = argc > 1 ? atoi(argv[1]) : 500000;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+
+    printf("request=%zu bytes\n", s_request.size());
+    printf("%-12s %10s %10s %10s %8s\n", "mode", "rounds", "ns/req", "MB/s",
+           "check");
+    for (int mode = REQUEST; mode <= VIEW_COMPAT; ++mode) {
+        run((Mode)mode, rounds);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file      bench_http_response.cc
+ * @brief     HTTP 响应的发送开销: stringstream 拷贝 vs writev vs sendfile
+ * @details   用法: bench_http_response [total_mb]
+ *            本机 TCP 连接上, 服务端协程用 HttpSession 连续发送同样的响应,
+ *            客户端协程只读走字节. copy 按原来的方式把整个响应拷进 stringstream
+ *            后 writeFixSize; writev 是 sendResponse 的内存响应体;
+ *            sendfile 是 sendResponse 的文件响应体. 每种大小发送约 total_mb 的数据
+ */
+#include "sylar/sylar.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/socket.hh"
+#include "http/http_session.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+enum Mode { COPY, WRITEV, SENDFILE };
+
+static const char *s_names[] = {"copy", "writev", "sendfile"};
+
+static const std::string s_file = "/tmp/sylar_bench_http_body";
+
+static void run(Mode mode, size_t body_size, size_t count, uint16_t port)
+{
+    sylar::IOManager iom(1, true, "bench");
+    uint64_t cost  = 0;
+    uint64_t bytes = 0;
+
+    iom.schedule([&]() {
+        sylar::Address::ptr addr =
+            sylar::Address::LookupAny("127.0.0.1:" + std::to_string(port));
+        sylar::Socket::ptr listener = sylar::Socket::CreateTCP(addr);
+        if (!listener->bind(addr) || !listener->listen()) {
+            printf("bind %s failed\n", addr->toString().c_str());
+            return;
+        }
+
+        sylar::http::HttpResponse::ptr rsp(
+            new sylar::http::HttpResponse(0x11, false));
+        rsp->setHeader("content-type", "application/octet-stream");
+        if (mode == SENDFILE) {
+            rsp->setBodyFile(s_file, 0, body_size);
+        }
+        else {
+            rsp->setBody(std::string(body_size, 'x'));
+        }
+        std::string head;
+        rsp->dumpHead(head);
+        bytes = (head.size() + body_size) * count;
+
+        sylar::IOManager::GetThis()->schedule([addr, bytes]() {
+            sylar::Socket::ptr client = sylar::Socket::CreateTCP(addr);
+            if (!client->connect(addr)) {
+                printf("connect failed\n");
+                return;
+            }
+            std::vector<char> buf(256 * 1024);
+            uint64_t left = bytes;
+            while (left > 0) {
+                int rt = client->recv(buf.data(), buf.size());
+                if (rt <= 0) {
+                    printf("recv failed left=%lu\n", (unsigned long)left);
+                    return;
+                }
+                left -= rt;
+            }
+        });
+
+        sylar::Socket::ptr sock = listener->accept();
+        sylar::http::HttpSession::ptr session(
+            new sylar::http::HttpSession(sock));
+        uint64_t begin = sylar::GetCurrentUS();
+        for (size_t i = 0; i < count; ++i) {
+            int rt;
+            if (mode == COPY) {
+                std::stringstream ss;
+                ss << *rsp;
+                std::string data = ss.str();
+                rt = session->writeFixSize(data.c_str(), data.size());
+            }
+            else {
+                rt = session->sendResponse(rsp);
+            }
+            if (rt <= 0) {
+                printf("send failed rt=%d\n", rt);
+                break;
+            }
+        }
+        cost = sylar::GetCurrentUS() - begin;
+    });
+    iom.stop();
+
+    printf("%-9s %9zu %9zu %12.0f %10.1f\n", s_names[mode], body_size, count,
+           count * 1000000.0 / (cost ? cost : 1),
+           bytes / 1048576.0 * 1000000.0 / (cost ? cost : 1));
+}
+
+int main(int argc, char **argv)
+{
+    size_t total_mb = argc > 1 ? atoi(argv[1]) : 512;
+    size_t sizes[]  = {1024, 64 * 1024, 4 * 1024 * 1024};
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::ERROR);
+
+    {
+        std::ofstream ofs(s_file);
+        ofs << std::string(sizes[2], 'x');
+    }
+
+    printf("total=%zuMB per run (loopback TCP, 1 thread)\n", total_mb);
+    printf("%-9s %9s %9s %12s %10s\n", "mode", "body", "count", "rsp/s",
+           "MB/s");
+    uint16_t port = 18600;
+    for (size_t size : sizes) {
+        size_t count = std::max<size_t>(total_mb * 1048576 / size, 1);
+        // 小响应时每个响应的固定开销为主, 控制次数避免运行过久
+        count = std::min<size_t>(count, 200000);
+        for (int mode = COPY; mode <= SENDFILE; ++mode) {
+            run((Mode)mode, size, count, port++);
+        }
+    }
+    unlink(s_file.c_str());
+    return 0;
+}
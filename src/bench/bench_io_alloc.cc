@@ -0,0 +1,138 @@
+/**
+ * @file      bench_io_alloc.cc
+ * @brief     HTTP keep-alive 请求路径上服务端每个请求的堆分配次数: 定时器超时 vs 内联超时
+ * @details   用法: bench_io_alloc [connections] [seconds]
+ *            替换全局 operator new, 只统计服务端 IOManager 线程上的分配;
+ *            服务端连接带有读超时, 每次 recv 返回 EAGAIN 都会走一遍超时等待
+ */
+#include "sylar/sylar.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/socket.hh"
+#include "http/http_server.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static std::atomic<sylar::Scheduler *> s_counted{nullptr};
+static std::atomic<uint64_t> s_allocs{0};
+static std::atomic<uint64_t> s_requests{0};
+static std::atomic<bool> s_running{false};
+
+void *operator new(size_t size)
+{
+    if (s_counted && sylar::Scheduler::GetThis() == s_counted) {
+        ++s_allocs;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+static const std::string s_http_req = "GET /ping HTTP/1.1\r\n"
+                                      "Host: 127.0.0.1\r\n"
+                                      "Connection: keep-alive\r\n\r\n";
+
+static void http_client(sylar::Address::ptr addr)
+{
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        return;
+    }
+    char buf[4096];
+    while (s_running) {
+        if (sock->send(s_http_req.c_str(), s_http_req.size())
+            != (int)s_http_req.size())
+        {
+            break;
+        }
+        // 响应体固定为 pong, 收到结尾即为一个完整响应
+        size_t got = 0;
+        while (got < 4 || memcmp(buf + got - 4, "pong", 4)) {
+            int rt = sock->recv(buf + got, sizeof(buf) - got);
+            if (rt <= 0) {
+                return;
+            }
+            got += rt;
+        }
+        ++s_requests;
+    }
+    sock->close();
+}
+
+static void run_once(bool inline_timeout, size_t conns, int seconds, uint16_t port)
+{
+    sylar::Config::Lookup<bool>("hook.inline_io_timeout")->setValue(inline_timeout);
+
+    s_requests = 0;
+    s_running  = true;
+
+    sylar::IOManager server_iom(1, false, "server");
+    sylar::IOManager client_iom(1, false, "client");
+
+    sylar::Address::ptr addr =
+        sylar::Address::LookupAny("127.0.0.1:" + std::to_string(port));
+    sylar::http::HttpServer::ptr server(
+        new sylar::http::HttpServer(true, &server_iom, &server_iom));
+    server->getServletDispatcher()->addServlet(
+        "/ping", [](sylar::http::HttpRequest::ptr req,
+                    sylar::http::HttpResponse::ptr rsp,
+                    sylar::http::HttpSession::ptr session) {
+            rsp->setBody("pong");
+            return 0;
+        });
+    server_iom.schedule([server, addr]() {
+        while (!server->bind(addr)) {
+            sleep(1);
+        }
+        server->start();
+    });
+    sleep(1);
+
+    for (size_t i = 0; i < conns; ++i) {
+        client_iom.schedule(std::bind(&http_client, addr));
+    }
+
+    // 跳过建连阶段, 只统计稳定收发期间的分配
+    sleep(1);
+    s_counted      = &server_iom;
+    uint64_t a0    = s_allocs;
+    uint64_t r0    = s_requests;
+    uint64_t begin = sylar::GetCurrentUS();
+
+    sleep(seconds);
+
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    uint64_t done = s_requests - r0;
+    uint64_t allocs = s_allocs - a0;
+    s_counted = nullptr;
+    s_running = false;
+
+    printf("%-8s %12.0f %14.2f\n", inline_timeout ? "inline" : "timer",
+           done * 1000000.0 / (cost ? cost : 1),
+           allocs / (done ? (double)done : 1.0));
+
+    client_iom.stop();
+    server->stop();
+}
+
+int main(int argc, char **argv)
+{
+    size_t conns = argc > 1 ? atoi(argv[1]) : 100;
+    int seconds  = argc > 2 ? atoi(argv[2]) : 3;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::ERROR);
+
+    printf("connections=%zu seconds=%d (server side)\n", conns, seconds);
+    printf("%-8s %12s %14s\n", "timeout", "req/s", "allocs/req");
+    run_once(false, conns, seconds, 18050);
+    run_once(true, conns, seconds, 18051);
+    return 0;
+}
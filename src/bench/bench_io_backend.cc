@@ -0,0 +1,175 @@
+/**
+ * @file      bench_io_backend.cc
+ * @brief     IOManager 后端吞吐测试: epoll vs io_uring
+ * @details   用法: bench_io_backend [connections] [seconds]
+ *            同一进程内启动 echo 服务器和 HttpServer, 由另一个 IOManager 建立
+ *            connections 个长连接循环发送请求, 统计每秒完成的请求数
+ */
+#include "sylar/sylar.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/socket.hh"
+#include "http/http_server.hh"
+#include "http/tcp_server.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static std::atomic<uint64_t> s_requests{0};
+static std::atomic<bool> s_running{false};
+
+class EchoServer : public sylar::TcpServer {
+  public:
+    EchoServer(sylar::IOManager *worker) : sylar::TcpServer(worker, worker) {}
+
+  protected:
+    void handleClient(sylar::Socket::ptr client) override
+    {
+        char buf[4096];
+        while (true) {
+            int rt = client->recv(buf, sizeof(buf));
+            if (rt <= 0) {
+                break;
+            }
+            if (client->send(buf, rt) != rt) {
+                break;
+            }
+        }
+        client->close();
+    }
+};
+
+static const char s_echo_msg[64] = "sylar echo benchmark payload";
+
+static const std::string s_http_req = "GET /ping HTTP/1.1\r\n"
+                                      "Host: 127.0.0.1\r\n"
+                                      "Connection: keep-alive\r\n\r\n";
+
+static void echo_client(sylar::Address::ptr addr)
+{
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        return;
+    }
+    char buf[sizeof(s_echo_msg)];
+    while (s_running) {
+        if (sock->send(s_echo_msg, sizeof(s_echo_msg)) != sizeof(s_echo_msg)) {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(buf)) {
+            int rt = sock->recv(buf + got, sizeof(buf) - got);
+            if (rt <= 0) {
+                return;
+            }
+            got += rt;
+        }
+        ++s_requests;
+    }
+    sock->close();
+}
+
+static void http_client(sylar::Address::ptr addr)
+{
+    sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+    if (!sock->connect(addr)) {
+        return;
+    }
+    char buf[4096];
+    while (s_running) {
+        if (sock->send(s_http_req.c_str(), s_http_req.size())
+            != (int)s_http_req.size())
+        {
+            break;
+        }
+        // 响应体固定为 pong, 收到结尾即为一个完整响应
+        std::string rsp;
+        while (rsp.size() < 4 || rsp.compare(rsp.size() - 4, 4, "pong")) {
+            int rt = sock->recv(buf, sizeof(buf));
+            if (rt <= 0) {
+                return;
+            }
+            rsp.append(buf, rt);
+        }
+        ++s_requests;
+    }
+    sock->close();
+}
+
+static double run_once(const std::string &backend, bool http, size_t conns,
+                       int seconds, uint16_t port)
+{
+    sylar::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+
+    s_requests = 0;
+    s_running  = true;
+
+    sylar::IOManager server_iom(1, false, "server");
+    sylar::IOManager client_iom(1, false, "client");
+
+    sylar::Address::ptr addr =
+        sylar::Address::LookupAny("127.0.0.1:" + std::to_string(port));
+
+    sylar::TcpServer::ptr server;
+    if (http) {
+        sylar::http::HttpServer::ptr hs(
+            new sylar::http::HttpServer(true, &server_iom, &server_iom));
+        hs->getServletDispatcher()->addServlet(
+            "/ping", [](sylar::http::HttpRequest::ptr req,
+                        sylar::http::HttpResponse::ptr rsp,
+                        sylar::http::HttpSession::ptr session) {
+                rsp->setBody("pong");
+                return 0;
+            });
+        server = hs;
+    }
+    else {
+        server.reset(new EchoServer(&server_iom));
+    }
+
+    server_iom.schedule([server, addr]() {
+        while (!server->bind(addr)) {
+            sleep(1);
+        }
+        server->start();
+    });
+    sleep(1);
+
+    for (size_t i = 0; i < conns; ++i) {
+        client_iom.schedule(std::bind(http ? &http_client : &echo_client, addr));
+    }
+
+    uint64_t begin = sylar::GetCurrentUS();
+    sleep(seconds);
+    s_running     = false;
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    uint64_t done = s_requests;
+
+    client_iom.stop();
+    server->stop();
+    return done * 1000000.0 / (cost ? cost : 1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t conns = argc > 1 ? atoi(argv[1]) : 1000;
+    int seconds  = argc > 2 ? atoi(argv[2]) : 3;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::ERROR);
+
+    printf("connections=%zu seconds=%d\n", conns, seconds);
+    printf("%-8s %16s %16s %8s\n", "server", "epoll(req/s)", "io_uring(req/s)",
+           "speedup");
+
+    uint16_t port = 18020;
+    const char *modes[] = {"echo", "http"};
+    for (const char *mode : modes) {
+        bool http     = !strcmp(mode, "http");
+        double epoll  = run_once("epoll", http, conns, seconds, port++);
+        double uring  = run_once("io_uring", http, conns, seconds, port++);
+        printf("%-8s %16.0f %16.0f %7.2fx\n", mode, epoll, uring, uring / epoll);
+    }
+    return 0;
+}
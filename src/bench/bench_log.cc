@@ -0,0 +1,123 @@
+/**
+ * @file      bench_log.cc
+ * @brief     日志写文件吞吐与调用方延迟: FileLogAppender vs AsyncLogAppender vs MmapFileLogAppender
+ * @details   用法: bench_log [threads] [lines_per_thread]
+ *            多个线程交替输出 DEBUG/INFO 日志到同一个文件, 统计包含落盘在内的每秒行数,
+ *            以及每次 SYLAR_LOG_* 调用在生产线程上的耗时分布. 取代 src/test/log_rate.sh
+ *            只能观察文件增长速度的做法
+ */
+#include "sylar/sylar.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void run_once(const char *mode, sylar::LogAppender::ptr appender,
+                     size_t threads, size_t lines)
+{
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME(std::string("bench_") + mode);
+    logger->setLevel(sylar::LogLevel::DEBUG);
+    logger->clearAppenders();
+    logger->addAppender(appender);
+
+    std::vector<std::vector<uint32_t>> costs(threads);
+    std::vector<std::thread> workers;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([logger, lines, &costs, t]() {
+            std::vector<uint32_t> &cost = costs[t];
+            cost.reserve(lines);
+            for (size_t i = 0; i < lines; ++i) {
+                uint64_t start = now_ns();
+                if (i & 1) {
+                    SYLAR_LOG_DEBUG(logger) << "bench line " << i << " from worker " << t;
+                }
+                else {
+                    SYLAR_LOG_INFO(logger) << "bench line " << i << " from worker " << t;
+                }
+                cost.push_back(now_ns() - start);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    uint64_t produced = sylar::GetCurrentUS() - begin;
+
+    uint64_t dropped = 0;
+    auto async = std::dynamic_pointer_cast<sylar::AsyncLogAppender>(appender);
+    if (async) {
+        async->flush();
+        dropped = async->getDropped();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    logger->clearAppenders();
+
+    std::vector<uint32_t> all;
+    all.reserve(threads * lines);
+    for (auto &c : costs) {
+        all.insert(all.end(), c.begin(), c.end());
+    }
+    std::sort(all.begin(), all.end());
+    size_t n = all.size();
+
+    printf("%-18s %12.0f %12.0f %9.2f %9.2f %9.2f %10zu\n", mode,
+           threads * lines * 1000000.0 / (cost ? cost : 1),
+           threads * lines * 1000000.0 / (produced ? produced : 1),
+           all[n / 2] / 1000.0, all[n * 99 / 100] / 1000.0, all[n - 1] / 1000.0,
+           (size_t)dropped);
+}
+
+int main(int argc, char **argv)
+{
+    size_t threads = argc > 1 ? atoi(argv[1]) : 4;
+    size_t lines   = argc > 2 ? atoi(argv[2]) : 200000;
+    std::string dir = "/tmp/sylar_bench_log/";
+    sylar::FSUtil::MKDir(dir);
+
+    printf("threads=%zu lines_per_thread=%zu (lines/s includes the final flush)\n",
+           threads, lines);
+    printf("%-18s %12s %12s %9s %9s %9s %10s\n", "mode", "lines/s", "produce/s",
+           "p50(us)", "p99(us)", "max(us)", "dropped");
+
+    enum Kind { SYNC, ASYNC, MMAP };
+    struct {
+        const char *name;
+        Kind kind;
+        sylar::AsyncLogAppender::OverflowPolicy policy;
+    } modes[] = {
+        {"sync", SYNC, sylar::AsyncLogAppender::BLOCK},
+        {"async_block", ASYNC, sylar::AsyncLogAppender::BLOCK},
+        {"async_drop_newest", ASYNC, sylar::AsyncLogAppender::DROP_NEWEST},
+        {"async_drop_debug", ASYNC, sylar::AsyncLogAppender::DROP_DEBUG_FIRST},
+        {"mmap", MMAP, sylar::AsyncLogAppender::BLOCK},
+    };
+    for (auto &m : modes) {
+        std::string file = dir + m.name + ".log";
+        unlink(file.c_str());
+        sylar::LogAppender::ptr appender;
+        if (m.kind == ASYNC) {
+            appender.reset(new sylar::AsyncLogAppender(file, m.policy));
+        }
+        else if (m.kind == MMAP) {
+            appender.reset(new sylar::MmapFileLogAppender(file));
+        }
+        else {
+            appender.reset(new sylar::FileLogAppender(file));
+        }
+        run_once(m.name, appender, threads, lines);
+        appender.reset();
+        unlink(file.c_str());
+    }
+    return 0;
+}
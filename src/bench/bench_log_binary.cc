@@ -0,0 +1,85 @@
+/**
+ * @file      bench_log_binary.cc
+ * @brief     访问日志的写文件开销: FileLogAppender 文本 vs BinaryLogAppender 二进制
+ * @details   用法: bench_log_binary [lines]
+ *            同一条访问日志分别用 SYLAR_LOG_INFO 写文本文件和 SYLAR_LOG_BIN_INFO 写二进制文件,
+ *            统计每秒行数和每行占用的字节数. text_bin_macro 把 SYLAR_LOG_BIN_INFO
+ *            交给 FileLogAppender, 观察二进制宏在文本输出器上的格式化开销.
+ *            二进制文件可以用 bin/tools/sylar_logdecode 还原后与文本文件对比
+ */
+#include "sylar/sylar.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *s_paths[] = {"/index.html", "/api/v1/users", "/static/app.js",
+                                "/favicon.ico"};
+
+static void run(const char *mode, sylar::LogAppender::ptr appender,
+                const std::string &file, size_t lines, bool binary_macro)
+{
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME(std::string("bench_") + mode);
+    logger->setLevel(sylar::LogLevel::DEBUG);
+    logger->clearAppenders();
+    logger->addAppender(appender);
+
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < lines; ++i) {
+        const char *path = s_paths[i & 3];
+        int status       = (i % 10) ? 200 : 404;
+        if (binary_macro) {
+            SYLAR_LOG_BIN_INFO(logger,
+                               "GET %s status=%d bytes=%u cost=%.3fms peer=%s",
+                               path, status, (unsigned)(i * 37 % 65536),
+                               (i % 100) / 7.0, "10.0.0.1:52144");
+        }
+        else {
+            SYLAR_LOG_INFO(logger) << "GET " << path << " status=" << status
+                                   << " bytes=" << (unsigned)(i * 37 % 65536)
+                                   << " cost=" << (i % 100) / 7.0
+                                   << "ms peer=10.0.0.1:52144";
+        }
+    }
+    auto bin = std::dynamic_pointer_cast<sylar::BinaryLogAppender>(appender);
+    if (bin) {
+        bin->flush();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    logger->clearAppenders();
+
+    struct stat st;
+    size_t bytes = stat(file.c_str(), &st) == 0 ? st.st_size : 0;
+    printf("%-16s %12.0f %12.1f %12zu\n", mode,
+           lines * 1000000.0 / (cost ? cost : 1), (double)bytes / lines, bytes);
+}
+
+int main(int argc, char **argv)
+{
+    size_t lines    = argc > 1 ? atoi(argv[1]) : 1000000;
+    std::string dir = "/tmp/sylar_bench_log/";
+    sylar::FSUtil::MKDir(dir);
+
+    printf("lines=%zu\n", lines);
+    printf("%-16s %12s %12s %12s\n", "mode", "lines/s", "bytes/line",
+           "file_bytes");
+
+    std::string text = dir + "access.log";
+    std::string fmt  = dir + "access_fmt.log";
+    std::string bin  = dir + "access.bin";
+    unlink(text.c_str());
+    unlink(fmt.c_str());
+    unlink(bin.c_str());
+
+    run("text", sylar::LogAppender::ptr(new sylar::FileLogAppender(text)), text,
+        lines, false);
+    run("text_bin_macro", sylar::LogAppender::ptr(new sylar::FileLogAppender(fmt)),
+        fmt, lines, true);
+    run("binary", sylar::LogAppender::ptr(new sylar::BinaryLogAppender(bin)),
+        bin, lines, true);
+
+    unlink(text.c_str());
+    unlink(fmt.c_str());
+    return 0;
+}
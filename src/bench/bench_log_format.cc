@@ -0,0 +1,86 @@
+/**
+ * @file      bench_log_format.cc
+ * @brief     日志格式化开销: 运行期 FormatItem vs 编译期模式 + 线程缓存的时间字符串
+ * @details   用法: bench_log_format [lines]
+ *            运行期模式与默认模式输出完全相同(只是用 '\t' 字面量代替 %T, 因而不会命中
+ *            编译期模式). compiled_miss 每行换一个秒数, 用来观察时间缓存失效时的开销.
+ *            two_same/two_diff 模拟两个输出器各有一个 %d, 每行依次格式化两次,
+ *            时间格式相同/不同, 两者都应命中时间缓存
+ */
+#include "sylar/sylar.hh"
+
+#include <cstdio>
+#include <cstdlib>
+
+static double run(sylar::LogFormatter::ptr formatter, sylar::Logger &logger,
+                  uint64_t now, size_t lines, bool new_second, std::string &out)
+{
+    sylar::LogStream buf;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < lines; ++i) {
+        sylar::LogLine line(sylar::LogLevel::INFO, __FILE__, __LINE__, 0, 1234,
+                            5, new_second ? now + i : now,
+                            sylar::Thread::GetName());
+        line.getSS() << "request " << 12345 << " done, status=" << 200;
+        buf.clear();
+        formatter->format(buf, logger, line);
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    out           = buf.toString();
+    return cost * 1000.0 / lines;
+}
+
+static double run2(sylar::LogFormatter::ptr first,
+                   sylar::LogFormatter::ptr second, sylar::Logger &logger,
+                   uint64_t now, size_t lines)
+{
+    sylar::LogStream buf;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < lines; ++i) {
+        sylar::LogLine line(sylar::LogLevel::INFO, __FILE__, __LINE__, 0, 1234,
+                            5, now, sylar::Thread::GetName());
+        line.getSS() << "request " << 12345 << " done, status=" << 200;
+        buf.clear();
+        first->format(buf, logger, line);
+        second->format(buf, logger, line);
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    return cost * 1000.0 / lines;
+}
+
+int main(int argc, char **argv)
+{
+    size_t lines = argc > 1 ? atoi(argv[1]) : 2000000;
+
+    sylar::Logger logger("bench");
+    sylar::LogFormatter::ptr compiled = logger.getFormatter();
+    sylar::LogFormatter::ptr runtime(new sylar::LogFormatter(
+        "%d{%Y-%m-%d %H:%M:%S}\t%t\t%N\t%F\t[%p]\t[%c]\t%f:%l\t%m%n"));
+
+    printf("lines=%zu pattern=%s\n", lines, compiled->getPattern().c_str());
+    printf("%-14s %10s\n", "formatter", "ns/line");
+
+    std::string a, b, c;
+    uint64_t now = time(0);
+    printf("%-14s %10.1f\n", "runtime",
+           run(runtime, logger, now, lines, false, a));
+    printf("%-14s %10.1f\n", "compiled",
+           run(compiled, logger, now, lines, false, b));
+    printf("%-14s %10.1f\n", "compiled_miss",
+           run(compiled, logger, now, lines, true, c));
+
+    sylar::LogFormatter::ptr runtime2(new sylar::LogFormatter(
+        "%d{%Y-%m-%d %H:%M:%S}\t%t\t%N\t%F\t[%p]\t[%c]\t%f:%l\t%m%n"));
+    sylar::LogFormatter::ptr runtime_iso(new sylar::LogFormatter(
+        "%d{%Y-%m-%dT%H:%M:%S}\t%t\t%N\t%F\t[%p]\t[%c]\t%f:%l\t%m%n"));
+    printf("%-14s %10.1f\n", "two_same",
+           run2(runtime, runtime2, logger, now, lines));
+    printf("%-14s %10.1f\n", "two_diff",
+           run2(runtime, runtime_iso, logger, now, lines));
+
+    if (!compiled->isCompiled() || runtime->isCompiled() || a != b) {
+        printf("output mismatch:\n%s%s", a.c_str(), b.c_str());
+        return 1;
+    }
+    return 0;
+}
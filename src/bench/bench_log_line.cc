@@ -0,0 +1,98 @@
+/**
+ * @file      bench_log_line.cc
+ * @brief     单条日志的构建与格式化开销: 堆上 LogEvent vs 栈上 LogLine
+ * @details   用法: bench_log_line [lines]
+ *            输出器只格式化不写出, 统计每行耗时(ns)以及每行的堆分配次数.
+ *            旧路径按原来 SYLAR_LOG_LEVEL 的展开方式构建 LogEventWrap
+ */
+#include "sylar/sylar.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_allocs{0};
+
+void *operator new(size_t size)
+{
+    ++s_allocs;
+    void *p = malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+/**
+ * @brief 只做格式化的输出器
+ */
+class DiscardLogAppender : public sylar::LogAppender {
+  public:
+    void log(sylar::Logger::ptr logger, sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {
+        m_bytes += m_formatter->format(logger, level, event).size();
+    }
+
+    void log(sylar::Logger &logger, const sylar::LogLine &line) override
+    {
+        sylar::LogStream buf;
+        m_formatter->format(buf, logger, line);
+        m_bytes += buf.size();
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    uint64_t getBytes() const { return m_bytes; }
+
+  private:
+    uint64_t m_bytes = 0;
+};
+
+#define OLD_LOG_LEVEL(logger, level)                                    \
+    if (logger->getLevel() <= level)                                    \
+    sylar::LogEventWrap(logger,                                         \
+        sylar::LogEvent::ptr(new sylar::LogEvent(                       \
+            level, __FILE__, __LINE__, 0, sylar::GetThreadId(),         \
+            sylar::GetFiberId(), time(0), sylar::Thread::GetName())))   \
+        .getSS()
+
+static void report(const char *name, size_t lines, uint64_t cost_us,
+                   uint64_t allocs)
+{
+    printf("%-6s %12.1f %12.2f\n", name, cost_us * 1000.0 / lines,
+           (double)allocs / lines);
+}
+
+int main(int argc, char **argv)
+{
+    size_t lines = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    sylar::Logger::ptr logger(new sylar::Logger("bench"));
+    std::shared_ptr<DiscardLogAppender> appender(new DiscardLogAppender);
+    logger->addAppender(appender);
+
+    printf("lines=%zu (format only, output discarded)\n", lines);
+    printf("%-6s %12s %12s\n", "path", "ns/line", "allocs/line");
+
+    uint64_t a0    = s_allocs;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < lines; ++i) {
+        OLD_LOG_LEVEL(logger, sylar::LogLevel::INFO)
+            << "request " << i << " done, status=" << 200 << " cost=" << 1.5;
+    }
+    report("event", lines, sylar::GetCurrentUS() - begin, s_allocs - a0);
+
+    a0    = s_allocs;
+    begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < lines; ++i) {
+        SYLAR_LOG_INFO(logger)
+            << "request " << i << " done, status=" << 200 << " cost=" << 1.5;
+    }
+    report("line", lines, sylar::GetCurrentUS() - begin, s_allocs - a0);
+
+    return appender->getBytes() ? 0 : 1;
+}
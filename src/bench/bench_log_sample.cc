@@ -0,0 +1,100 @@
+/**
+ * @file      bench_log_sample.cc
+ * @brief     采样日志的开销: SYLAR_LOG_ERROR vs SYLAR_LOG_SAMPLE_ERROR
+ * @details   用法: bench_log_sample [calls] [threads]
+ *            同一个调用点连续调用, 输出器只格式化不写出. 统计每次调用的耗时(ns)
+ *            和实际输出的行数; sampled_mt 由 threads 个线程同时调用同一个调用点
+ */
+#include "sylar/sylar.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <inttypes.h>
+
+/**
+ * @brief 只做格式化并计数的输出器
+ */
+class CountLogAppender : public sylar::LogAppender {
+  public:
+    void log(sylar::Logger::ptr logger, sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {
+        ++m_lines;
+    }
+
+    void log(sylar::Logger &logger, const sylar::LogLine &line) override
+    {
+        sylar::LogStream buf;
+        m_formatter->format(buf, logger, line);
+        ++m_lines;
+    }
+
+    std::string toYamlString() override { return ""; }
+
+    uint64_t getLines() const { return m_lines; }
+
+    void reset() { m_lines = 0; }
+
+  private:
+    std::atomic<uint64_t> m_lines{0};
+};
+
+static void sampled(sylar::Logger::ptr logger, size_t calls)
+{
+    for (size_t i = 0; i < calls; ++i) {
+        SYLAR_LOG_SAMPLE_ERROR(logger) << "add event fail fd=" << i;
+    }
+}
+
+static void report(const char *name, size_t calls, uint64_t cost_us,
+                   uint64_t lines)
+{
+    printf("%-12s %10.1f %12" PRIu64 "\n", name, cost_us * 1000.0 / calls,
+           lines);
+}
+
+int main(int argc, char **argv)
+{
+    size_t calls   = argc > 1 ? atoi(argv[1]) : 10000000;
+    size_t threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    sylar::Logger::ptr logger(new sylar::Logger("bench"));
+    std::shared_ptr<CountLogAppender> appender(new CountLogAppender);
+    logger->addAppender(appender);
+
+    printf("calls=%zu threads=%zu sample=%u/%u/%us\n", calls, threads,
+           logger->getSampleFirst(), logger->getSampleEvery(),
+           logger->getSampleInterval());
+    printf("%-12s %10s %12s\n", "mode", "ns/call", "lines");
+
+    // 不采样时每次都格式化, 少跑一些
+    size_t plain_calls = calls / 10;
+    uint64_t begin     = sylar::GetCurrentUS();
+    for (size_t i = 0; i < plain_calls; ++i) {
+        SYLAR_LOG_ERROR(logger) << "add event fail fd=" << i;
+    }
+    report("plain", plain_calls, sylar::GetCurrentUS() - begin,
+           appender->getLines());
+
+    appender->reset();
+    begin = sylar::GetCurrentUS();
+    sampled(logger, calls);
+    report("sampled", calls, sylar::GetCurrentUS() - begin,
+           appender->getLines());
+
+    appender->reset();
+    std::vector<sylar::Thread::ptr> thrs;
+    begin = sylar::GetCurrentUS();
+    for (size_t i = 0; i < threads; ++i) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread(
+            [logger, calls, threads]() { sampled(logger, calls / threads); },
+            "sample_" + std::to_string(i))));
+    }
+    for (auto &i : thrs) {
+        i->join();
+    }
+    report("sampled_mt", calls / threads * threads,
+           sylar::GetCurrentUS() - begin, appender->getLines());
+    return 0;
+}
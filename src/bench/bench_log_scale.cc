@@ -0,0 +1,116 @@
+/**
+ * @file      bench_log_scale.cc
+ * @brief     日志器查找与输出器分发的多线程扩展性
+ * @details   用法: bench_log_scale [ops] [max_threads]
+ *            每个线程在循环里用 SYLAR_LOG_NAME 动态查找同一个日志器:
+ *            lookup 只做查找和级别检查(日志被级别过滤);
+ *            fanout 把日志分发给两个不做输出的输出器;
+ *            fanout_swap 在 fanout 的同时由另一个线程不停增删输出器, 观察配置变更对读者的影响.
+ *            ops 为所有线程的总次数, 线程数从 1 翻倍到 max_threads
+ */
+#include "sylar/sylar.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * @brief 丢弃日志的输出器, 只计量分发本身的开销
+ */
+class NullLogAppender : public sylar::LogAppender {
+  public:
+    void log(sylar::Logger::ptr logger, sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {}
+
+    void log(sylar::Logger &logger, const sylar::LogLine &line) override {}
+
+    std::string toYamlString() override { return ""; }
+};
+
+enum Mode { LOOKUP, FANOUT, FANOUT_SWAP };
+
+static const char *s_names[] = {"lookup", "fanout", "fanout_swap"};
+
+static void worker(Mode mode, size_t ops, std::atomic<bool> &go)
+{
+    while (!go.load(std::memory_order_acquire)) {
+        sched_yield();
+    }
+    for (size_t i = 0; i < ops; ++i) {
+        if (mode == LOOKUP) {
+            SYLAR_LOG_DEBUG(SYLAR_LOG_NAME("bench_scale")) << "op " << i;
+        }
+        else {
+            SYLAR_LOG_INFO(SYLAR_LOG_NAME("bench_scale")) << "op " << i;
+        }
+    }
+}
+
+static void run(Mode mode, size_t ops, int threads)
+{
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("bench_scale");
+    logger->setLevel(sylar::LogLevel::INFO);
+    logger->clearAppenders();
+    logger->addAppender(sylar::LogAppender::ptr(new NullLogAppender));
+    logger->addAppender(sylar::LogAppender::ptr(new NullLogAppender));
+
+    std::atomic<bool> go{false};
+    std::atomic<bool> done{false};
+    uint64_t swaps = 0;
+
+    std::vector<sylar::Thread::ptr> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(sylar::Thread::ptr(new sylar::Thread(
+            std::bind(worker, mode, ops / threads, std::ref(go)),
+            "scale_" + std::to_string(i))));
+    }
+    sylar::Thread::ptr writer;
+    if (mode == FANOUT_SWAP) {
+        writer.reset(new sylar::Thread(
+            [&]() {
+                sylar::LogAppender::ptr extra(new NullLogAppender);
+                while (!done.load(std::memory_order_acquire)) {
+                    logger->addAppender(extra);
+                    logger->delAppender(extra);
+                    swaps += 2;
+                    usleep(100);
+                }
+            },
+            "scale_writer"));
+    }
+
+    uint64_t begin = sylar::GetCurrentUS();
+    go.store(true, std::memory_order_release);
+    for (auto &i : workers) {
+        i->join();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+    done.store(true, std::memory_order_release);
+    if (writer) {
+        writer->join();
+    }
+    logger->clearAppenders();
+
+    size_t total = ops / threads * threads;
+    printf("%-12s %8d %14.0f %10.1f %8lu\n", s_names[mode], threads,
+           total * 1000000.0 / (cost ? cost : 1), cost * 1000.0 / total,
+           (unsigned long)swaps);
+}
+
+int main(int argc, char **argv)
+{
+    size_t ops      = argc > 1 ? atoi(argv[1]) : 4000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 32;
+
+    printf("ops=%zu cpus=%ld\n", ops, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-12s %8s %14s %10s %8s\n", "mode", "threads", "ops/s", "ns/op",
+           "swaps");
+    for (int mode = LOOKUP; mode <= FANOUT_SWAP; ++mode) {
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            run((Mode)mode, ops, threads);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file      bench_scheduler.cc
+ * @brief     调度器吞吐测试: 全局队列 vs 工作窃取
+ * @details   用法: bench_scheduler [roots] [fanout]
+ *            外部线程投递 roots 个任务, 每个任务在工作线程内再派生 fanout 个子任务
+ */
+#include "sylar/sylar.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+static std::atomic<uint64_t> s_done{0};
+static size_t s_fanout = 64;
+
+static void leaf_task() { ++s_done; }
+
+static void root_task()
+{
+    sylar::Scheduler *sc = sylar::Scheduler::GetThis();
+    for (size_t i = 0; i < s_fanout; ++i) {
+        sc->schedule(&leaf_task);
+    }
+    ++s_done;
+}
+
+static double run_once(size_t threads, bool stealing, size_t roots)
+{
+    s_done = 0;
+    sylar::Scheduler sc(threads, false, "bench");
+    sc.setWorkStealing(stealing);
+
+    uint64_t begin = sylar::GetCurrentUS();
+    sc.start();
+    for (size_t i = 0; i < roots; ++i) {
+        sc.schedule(&root_task);
+    }
+    sc.stop();
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+
+    SYLAR_ASSERT(s_done == roots * (s_fanout + 1));
+    return s_done * 1000000.0 / (cost ? cost : 1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t roots = argc > 1 ? atoi(argv[1]) : 2000;
+    s_fanout     = argc > 2 ? atoi(argv[2]) : 64;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+
+    printf("%-8s %16s %16s %8s\n", "threads", "global(task/s)", "stealing(task/s)",
+           "speedup");
+    size_t thread_counts[] = {1, 4, 16, 64};
+    for (size_t threads : thread_counts) {
+        double global   = run_once(threads, false, roots);
+        double stealing = run_once(threads, true, roots);
+        printf("%-8zu %16.0f %16.0f %7.2fx\n", threads, global, stealing,
+               stealing / global);
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file      bench_timer.cc
+ * @brief     定时器添加/取消吞吐测试: std::set vs 分层时间轮
+ * @details   用法: bench_timer [resident] [ops_per_thread]
+ *            先放入 resident 个长超时定时器模拟大量空闲连接, 再由多个线程按 do_io 的方式
+ *            反复 addConditionTimer + cancel; 另有一个线程模拟事件循环每毫秒处理一次到期定时器
+ */
+#include "sylar/sylar.hh"
+#include "sylar/timer.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+class BenchTimerManager : public sylar::TimerManager {
+  protected:
+    void onTimerInsertedAtFront() override {}
+};
+
+static double run_once(bool wheel, size_t threads, size_t resident, size_t ops)
+{
+    sylar::Config::Lookup<bool>("timer.use_wheel")->setValue(wheel);
+    BenchTimerManager manager;
+
+    std::vector<sylar::Timer::ptr> idle;
+    idle.reserve(resident);
+    for (size_t i = 0; i < resident; ++i) {
+        idle.push_back(manager.addTimer(120000 + i % 1000, []() {}));
+    }
+
+    std::atomic<bool> running{true};
+    std::thread loop([&manager, &running]() {
+        std::vector<std::function<void()>> cbs;
+        while (running) {
+            manager.getNextTimer();
+            manager.listExpiredCb(cbs);
+            cbs.clear();
+            usleep(1000);
+        }
+    });
+
+    std::vector<std::thread> workers;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&manager, ops]() {
+            std::shared_ptr<int> cond(new int(0));
+            std::weak_ptr<int> weak(cond);
+            for (size_t i = 0; i < ops; ++i) {
+                sylar::Timer::ptr timer =
+                    manager.addConditionTimer(120000, []() {}, weak);
+                timer->cancel();
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - begin;
+
+    running = false;
+    loop.join();
+    for (auto &timer : idle) {
+        timer->cancel();
+    }
+    return threads * ops * 1000000.0 / (cost ? cost : 1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t resident = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t ops      = argc > 2 ? atoi(argv[2]) : 200000;
+
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+
+    printf("resident=%zu ops_per_thread=%zu (add + cancel pairs)\n", resident, ops);
+    printf("%-8s %16s %16s %8s\n", "threads", "set(op/s)", "wheel(op/s)", "speedup");
+    size_t thread_counts[] = {1, 4, 16};
+    for (size_t threads : thread_counts) {
+        double set   = run_once(false, threads, resident, ops);
+        double wheel = run_once(true, threads, resident, ops);
+        printf("%-8zu %16.0f %16.0f %7.2fx\n", threads, set, wheel, wheel / set);
+    }
+    return 0;
+}
@@ -2,8 +2,14 @@
 #include "sylar/env.hh"
 
 #include <sstream>
-#include <boost/regex.hpp>
+#include <ctype.h>
+#include <dirent.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 namespace sylar {
 
@@ -17,69 +23,187 @@ ConfigVarBase::ptr Config::LookupBase(const std::string &name)
 }
 
 /**
- * @brief     列出所有的节点成员
- * @details   遍历节点, 并将节点的内容放到一个list中
- * @param[in] &prefix, 表示当前节点的前置信息
- * @param[in] &node, 当前待遍历的节点
- * @param[in] &output, 存放处理完成信息的list
+ * @brief 配置名只能由 [a-zA-Z0-9._] 组成, 与 Lookup 的检查一致
  */
-static void
-ListAllMember(const std::string &prefix, const YAML::Node &node,
-              std::list<std::pair<std::string, const YAML::Node>> &output)
+static bool IsValidName(const std::string &name)
 {
-    boost::regex error_pattern("[^a-zA-Z0-9._]");
+    for (char c : name) {
+        if (!isalnum((unsigned char)c) && c != '.' && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
 
-    if (boost::regex_search(prefix, error_pattern)) {
-        SYLAR_LOG_ERROR(g_logger)
-            << "Config invalid name: " << prefix << " : " << YAML::Dump(node);
-        return;
+/**
+ * @brief   在旧的 map 节点中按键名查找子节点
+ * @details 同一个文件修改前后键的顺序通常不变, 先按位置匹配,
+ *          顺序不一致时才建立索引, 避免 yaml-cpp 按键查找时的线性扫描
+ */
+class ChildFinder {
+  public:
+    explicit ChildFinder(const YAML::Node *map) : m_map(map)
+    {
+        if (m_map && m_map->IsMap()) {
+            m_it  = m_map->begin();
+            m_end = m_map->end();
+        }
+        else {
+            m_map = nullptr;
+        }
+    }
+
+    /**
+     * @brief 返回的指针在下一次调用 find 前有效, 找不到时返回 nullptr
+     */
+    const YAML::Node *find(const std::string &key)
+    {
+        if (!m_map) {
+            return nullptr;
+        }
+        if (!m_indexed) {
+            if (m_it != m_end && m_it->first.Scalar() == key) {
+                // YAML::Node 的赋值会合并两棵树的内存, 这里只能拷贝构造
+                m_cur.reset(new YAML::Node(m_it->second));
+                ++m_it;
+                return m_cur.get();
+            }
+            m_index.reserve(m_map->size());
+            for (auto it = m_map->begin(); it != m_map->end(); ++it) {
+                m_index.emplace(it->first.Scalar(), it->second);
+            }
+            m_indexed = true;
+        }
+        auto it = m_index.find(key);
+        return it == m_index.end() ? nullptr : &it->second;
     }
 
-    // 注意, 这里可能将 prefix 为空的情况, 即顶层节点添加进去
-    // 后续使用需要判断: key->first.empty()
-    output.push_back(std::make_pair(prefix, node));
+  private:
+    const YAML::Node *m_map;
+    YAML::const_iterator m_it;
+    YAML::const_iterator m_end;
+    std::unique_ptr<YAML::Node> m_cur;
+    bool m_indexed = false;
+    std::unordered_map<std::string, YAML::Node> m_index;
+};
 
-    if (node.IsMap()) {
-        for (auto it = node.begin(); it != node.end(); ++it) {
-            ListAllMember(prefix.empty() ? it->first.Scalar()
-                                         : prefix + "." + it->first.Scalar(),
-                          it->second, output);
+/**
+ * @brief 比较两棵配置树的内容是否相同, 忽略 map 中键的顺序
+ */
+static bool YamlEqual(const YAML::Node &lhs, const YAML::Node &rhs)
+{
+    if (lhs.Type() != rhs.Type()) {
+        return false;
+    }
+    switch (lhs.Type()) {
+        case YAML::NodeType::Scalar:
+            return lhs.Scalar() == rhs.Scalar();
+        case YAML::NodeType::Sequence: {
+            if (lhs.size() != rhs.size()) {
+                return false;
+            }
+            for (auto l = lhs.begin(), r = rhs.begin(); l != lhs.end(); ++l, ++r)
+            {
+                if (!YamlEqual(*l, *r)) {
+                    return false;
+                }
+            }
+            return true;
         }
+        case YAML::NodeType::Map: {
+            if (lhs.size() != rhs.size()) {
+                return false;
+            }
+            ChildFinder finder(&rhs);
+            for (auto it = lhs.begin(); it != lhs.end(); ++it) {
+                const YAML::Node *r = finder.find(it->first.Scalar());
+                if (!r || !YamlEqual(it->second, *r)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return true;
     }
 }
 
-void Config::LoadFromYaml(const YAML::Node &root)
+/**
+ * @brief     按先序遍历新配置树, 把内容变化的节点赋值给同名的配置项
+ * @details   只在对应配置项的节点上比较新旧内容, 相同则整棵子树跳过;
+ *            没有配置项的 map 节点直接进入子节点, 避免在每一层重复比较整棵子树.
+ *            old 为 nullptr 时每个节点都视为变化
+ * @param[in] prefix 当前节点的配置名, 顶层节点为空
+ * @param[in] node 新配置树中的当前节点
+ * @param[in] old 旧配置树中同一位置的节点, 可为 nullptr
+ * @param[out] changed 调用了 fromString 的配置项个数
+ */
+static void LoadMember(const std::string &prefix, const YAML::Node &node,
+                       const YAML::Node *old, size_t &changed)
 {
-    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
-
-    // 递归加载配置节点到容器
-    ListAllMember("", root, all_nodes);
-
-    for (auto &i : all_nodes) {
-        std::string key = i.first;
-        if (key.empty()) {
-            continue;
-        }
+    if (!IsValidName(prefix)) {
+        SYLAR_LOG_ERROR(g_logger)
+            << "Config invalid name: " << prefix << " : " << YAML::Dump(node);
+        return;
+    }
 
+    if (!prefix.empty()) {
+        std::string key = prefix;
         std::transform(key.begin(), key.end(), key.begin(), ::tolower);
 
         // 通过给定的 yaml文件中的 string,  找与之相应的底层结构
         // 来判断是需要重新调整属性
-        ConfigVarBase::ptr var = LookupBase(key);
-
+        ConfigVarBase::ptr var = Config::LookupBase(key);
         if (var) {
-            if (i.second.IsScalar()) {
-                var->fromString(i.second.Scalar());
-            } else {
+            if (old && YamlEqual(node, *old)) {
+                return;
+            }
+            if (node.IsScalar()) {
+                var->fromString(node.Scalar());
+            }
+            else {
                 std::stringstream ss;
-                ss << i.second;
+                ss << node;
                 var->fromString(ss.str());
             }
+            ++changed;
+        }
+    }
+
+    if (node.IsMap()) {
+        ChildFinder finder(old);
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            const std::string &name = it->first.Scalar();
+            LoadMember(prefix.empty() ? name : prefix + "." + name, it->second,
+                       finder.find(name), changed);
         }
     }
 }
 
-static std::map<std::string, uint64_t> S_FileModifyTime;
+void Config::LoadFromYaml(const YAML::Node &root)
+{
+    size_t changed = 0;
+    LoadMember("", root, nullptr, changed);
+}
+
+size_t Config::LoadFromYamlDiff(const YAML::Node &root, const YAML::Node &old)
+{
+    size_t changed = 0;
+    LoadMember("", root, old.IsDefined() ? &old : nullptr, changed);
+    return changed;
+}
+
+/**
+ * @brief 已加载的配置文件
+ */
+struct ConfFile {
+    uint64_t mtime = 0; /**< 修改时间(纳秒) */
+    uint64_t ino   = 0;
+    uint64_t size  = 0;
+    YAML::Node root;    /**< 上次成功加载的内容, 用于差异加载 */
+};
+
+static std::map<std::string, ConfFile> s_conf_files;
 static sylar::Mutex s_mutex;
 
 auto Config::LoadFromConfDir(const std::string &path) -> void
@@ -89,28 +213,231 @@ auto Config::LoadFromConfDir(const std::string &path) -> void
     std::vector<std::string> files;
     FSUtil::ListAllFile(files, absolute_path, ".yaml");
 
+    // 监视线程与调用方可能同时加载, 整个过程串行执行
+    sylar::Mutex::Lock lock(s_mutex);
+
+    // 已删除的文件, 重新出现时按新文件加载
+    std::set<std::string> exists(files.begin(), files.end());
+    for (auto it = s_conf_files.lower_bound(absolute_path);
+         it != s_conf_files.end()
+         && it->first.compare(0, absolute_path.size(), absolute_path) == 0;)
+    {
+        if (exists.count(it->first)) {
+            ++it;
+        }
+        else {
+            it = s_conf_files.erase(it);
+        }
+    }
+
     for (auto &i : files) {
+        // 修改时间精确到纳秒, 同一秒内的多次修改也能发现;
+        // 编辑器改名覆盖时 inode 会变化
+        struct stat st;
+        if (stat(i.c_str(), &st) != 0) {
+            continue;
+        }
+        uint64_t mtime =
+            st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+        ConfFile &file = s_conf_files[i];
+        if (file.mtime == mtime && file.ino == (uint64_t)st.st_ino
+            && file.size == (uint64_t)st.st_size)
         {
-            // 简化起见, 只判断访问时间, 来判断文件是否需要重新加载
-            // 严格上通过比对 md5 更好
-            struct stat st;
-            lstat(i.c_str(), &st);
-            sylar::Mutex::Lock lock(s_mutex);
-            if (S_FileModifyTime[i] == (uint64_t)st.st_mtime) {
-                continue;
-            }
-            S_FileModifyTime[i] = st.st_mtime;
+            continue;
         }
+        file.mtime = mtime;
+        file.ino   = st.st_ino;
+        file.size  = st.st_size;
+
         try {
             YAML::Node root = YAML::LoadFile(i);
-            LoadFromYaml(root);
-            SYLAR_LOG_INFO(g_logger) << "LoadConfFile file=" << i << " ok";
+            size_t changed  = LoadFromYamlDiff(root, file.root);
+            file.root       = root;
+            SYLAR_LOG_INFO(g_logger)
+                << "LoadConfFile file=" << i << " ok changed=" << changed;
         } catch (...) {
             SYLAR_LOG_ERROR(g_logger) << "LoadConfFile file=" << i << " failed";
         }
     }
 }
 
+/**
+ * @brief   配置文件夹的 inotify 监视线程
+ * @details 收到事件后继续等待, 直到 100ms 内没有新事件再加载, 把保存文件时的
+ *          多个事件(创建, 写入, 改名)合并为一次加载
+ */
+class ConfDirWatcher {
+  public:
+    ~ConfDirWatcher() { stop(); }
+
+    bool start(const std::string &path)
+    {
+        sylar::Mutex::Lock lock(m_mutex);
+        if (m_thread) {
+            return false;
+        }
+        m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        m_eventFd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_inotifyFd < 0 || m_eventFd < 0) {
+            SYLAR_LOG_ERROR(g_logger)
+                << "WatchConfDir init failed path=" << path
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            closeFds();
+            return false;
+        }
+        m_path = sylar::EnvMgr::GetInstance()->getAbsolutePath(path);
+        addWatches(m_path);
+        m_thread.reset(
+            new Thread(std::bind(&ConfDirWatcher::run, this), "conf_watch"));
+        return true;
+    }
+
+    void stop()
+    {
+        sylar::Mutex::Lock lock(m_mutex);
+        if (!m_thread) {
+            return;
+        }
+        uint64_t one = 1;
+        if (write(m_eventFd, &one, sizeof(one)) < 0) {
+            SYLAR_LOG_ERROR(g_logger) << "UnwatchConfDir write eventfd failed"
+                                      << " errno=" << errno;
+        }
+        m_thread->join();
+        m_thread.reset();
+        closeFds();
+    }
+
+  private:
+    void closeFds()
+    {
+        if (m_inotifyFd >= 0) {
+            close(m_inotifyFd);
+            m_inotifyFd = -1;
+        }
+        if (m_eventFd >= 0) {
+            close(m_eventFd);
+            m_eventFd = -1;
+        }
+    }
+
+    /**
+     * @brief 监视 dir 及其所有子文件夹, 已监视的文件夹重复添加不会产生新的监视
+     */
+    void addWatches(const std::string &dir)
+    {
+        if (inotify_add_watch(m_inotifyFd, dir.c_str(),
+                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                                  | IN_CREATE | IN_DELETE)
+            < 0)
+        {
+            SYLAR_LOG_ERROR(g_logger)
+                << "WatchConfDir inotify_add_watch failed path=" << dir
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            return;
+        }
+        DIR *d = opendir(dir.c_str());
+        if (!d) {
+            return;
+        }
+        struct dirent *dp = nullptr;
+        while ((dp = readdir(d)) != nullptr) {
+            if (dp->d_type == DT_DIR && strcmp(dp->d_name, ".")
+                && strcmp(dp->d_name, ".."))
+            {
+                addWatches(dir + "/" + dp->d_name);
+            }
+        }
+        closedir(d);
+    }
+
+    /**
+     * @brief  读空 inotify 事件
+     * @return 是否出现了新的子文件夹
+     */
+    bool drain()
+    {
+        bool new_dir = false;
+        alignas(struct inotify_event) char buf[4096];
+        ssize_t n;
+        while ((n = read(m_inotifyFd, buf, sizeof(buf))) > 0) {
+            for (char *p = buf; p < buf + n;) {
+                auto ev = (struct inotify_event *)p;
+                if ((ev->mask & IN_ISDIR)
+                    && (ev->mask & (IN_CREATE | IN_MOVED_TO)))
+                {
+                    new_dir = true;
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        return new_dir;
+    }
+
+    void run()
+    {
+        struct pollfd fds[2];
+        fds[0].fd     = m_inotifyFd;
+        fds[0].events = POLLIN;
+        fds[1].fd     = m_eventFd;
+        fds[1].events = POLLIN;
+
+        int timeout  = -1;
+        bool pending = false;
+        bool new_dir = false;
+        while (true) {
+            int rt = poll(fds, 2, timeout);
+            if (rt < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                SYLAR_LOG_ERROR(g_logger)
+                    << "WatchConfDir poll failed errno=" << errno
+                    << " errstr=" << strerror(errno);
+                return;
+            }
+            if (fds[1].revents & POLLIN) {
+                return;
+            }
+            if (fds[0].revents & POLLIN) {
+                new_dir |= drain();
+                pending = true;
+                timeout = 100;
+                continue;
+            }
+            if (pending) {
+                if (new_dir) {
+                    addWatches(m_path);
+                }
+                Config::LoadFromConfDir(m_path);
+            }
+            pending = false;
+            new_dir = false;
+            timeout = -1;
+        }
+    }
+
+  private:
+    sylar::Mutex m_mutex; /**< 串行化 start/stop */
+    std::string m_path;
+    int m_inotifyFd = -1;
+    int m_eventFd   = -1;
+    Thread::ptr m_thread;
+};
+
+static ConfDirWatcher &GetConfDirWatcher()
+{
+    static ConfDirWatcher s_watcher;
+    return s_watcher;
+}
+
+bool Config::WatchConfDir(const std::string &path)
+{
+    return GetConfDirWatcher().start(path);
+}
+
+void Config::UnwatchConfDir() { GetConfDirWatcher().stop(); }
+
 // 访问者模式
 void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb)
 {
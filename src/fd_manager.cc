@@ -75,47 +75,45 @@ auto FdCtx::getTimeout(int type) -> uint64_t
     }
 }
 
-FdManager::FdManager() { m_datas.resize(64); }
+FdManager::FdManager() {}
 
-auto FdManager::get(int fd, bool auto_create) -> FdCtx::ptr
+auto FdManager::get(int fd, bool auto_create) -> FdCtx *
 {
-    if(fd == -1) {
+    if (fd < 0) {
         return nullptr;
     }
 
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_datas.size() <= fd) {
-        if (auto_create == false) {
-            return nullptr;
-        }
+    FdCtx *ctx = m_datas.get(fd);
+    if (ctx && ctx->m_inUse.load(std::memory_order_acquire)) {
+        return ctx;
     }
-    else {
-        // 只要 fd 在范围内
-        if (m_datas[fd] || !auto_create) {
-            // 不论是否存在, 都会进行返回
-            return m_datas[fd];
-        }
+    if (!auto_create) {
+        return nullptr;
     }
 
-    lock.unlock();
-
-    // 没有对象且允许自动创建的话
-    RWMutexType::WriteLock lock2(m_mutex);
-    FdCtx::ptr ctx(new FdCtx(fd));
-    if(fd >= (int)m_datas.size()) {
-        m_datas.resize(fd*1.5);
+    // 没有对象, 或对象属于已关闭的同号句柄, 且允许自动创建的话
+    MutexType::Lock lock(m_mutex);
+    ctx = m_datas.getOrCreate(fd, [](size_t index) { return new FdCtx(index); });
+    if (!ctx) {
+        return nullptr;
+    }
+    if (!ctx->m_inUse.load(std::memory_order_relaxed)) {
+        ctx->m_isInit = false;
+        ctx->init();
+        ctx->m_inUse.store(true, std::memory_order_release);
     }
-    m_datas[fd] = ctx;
     return ctx;
 }
 
 auto FdManager::del(int fd) -> void
 {
-    RWMutexType::WriteLock lock(m_mutex);
-    if ((int)m_datas.size() <= fd) {
+    if (fd < 0) {
         return;
     }
-    m_datas[fd].reset();
+    FdCtx *ctx = m_datas.get(fd);
+    if (ctx) {
+        ctx->m_inUse.store(false, std::memory_order_release);
+    }
 }
 
 }; // namespace sylar
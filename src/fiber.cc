@@ -6,6 +6,8 @@
 
 #include "sylar/log.hh"
 #include "sylar/scheduler.hh"
+#include "sylar/stack_allocator.hh"
+#include <string.h>
 
 namespace sylar {
 
@@ -20,14 +22,37 @@ static thread_local Fiber::ptr t_threadFiber = nullptr; /**< 线程的主协程
 static ConfigVar<uint32_t>::ptr g_fiber_stack_size = Config::Lookup<uint32_t>(
     "fiber.stack_size", 1024 * 1024, "fiber stack size");
 
-class MallocStackAllocator {
-  public:
-    static void *Alloc(size_t size) { return malloc(size); }
+static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_size =
+    Config::Lookup<uint32_t>("fiber.shared_stack.size", 1024 * 1024,
+                             "fiber shared stack size");
+
+static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_count =
+    Config::Lookup<uint32_t>("fiber.shared_stack.count", 4,
+                             "fiber shared stacks per thread");
+
+/**
+ * @brief 线程共享栈, 同一时刻只有一个协程(occupant)的栈内容在上面
+ */
+struct FiberSharedStack {
+    using ptr       = std::shared_ptr<FiberSharedStack>;
+    using MutexType = Mutex;
+
+    FiberSharedStack(size_t s) : size(MmapStackAllocator::RoundSize(s))
+    {
+        mem = (char *)MmapStackAllocator::Map(size);
+        SYLAR_ASSERT2(mem, "map fiber shared stack");
+    }
+
+    ~FiberSharedStack() { MmapStackAllocator::Unmap(mem, size); }
 
-    static void Dealloc(void *vp, size_t size) { return free(vp); }
+    char *mem       = nullptr; /**< 栈底 */
+    size_t size     = 0;       /**< 栈大小 */
+    Fiber *occupant = nullptr; /**< 栈上当前内容所属的协程 */
+    MutexType mutex;           /**< 保护 occupant, 协程可能在其他线程析构 */
 };
 
-using StackAllocator = MallocStackAllocator;
+static thread_local std::vector<FiberSharedStack::ptr> t_shared_stacks;
+static thread_local size_t t_shared_stack_next = 0;
 
 Fiber::Fiber()
 {
@@ -37,7 +62,7 @@ Fiber::Fiber()
 
     SetThis(this);
 
-    if (getcontext(&m_ctx)) {
+    if (!m_ctx.init()) {
         SYLAR_ASSERT2(false, "getcontext");
     }
 
@@ -46,7 +71,8 @@ Fiber::Fiber()
     SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber  id = " << m_id;
 }
 
-Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool return_to_mainFiber)
+Fiber::Fiber(std::function<void()> cb, size_t stacksize,
+             bool return_to_mainFiber, bool shared_stack)
     : m_id(s_fiber_id++), m_cb(cb)
 {
     // 有参构造的 m_id 依赖 ++s_fiber_id
@@ -57,22 +83,25 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool return_to_mainFibe
 
     SetThis(this);
 
-    m_stack = StackAllocator::Alloc(m_stacksize);
-    if (getcontext(&m_ctx)) {
-        SYLAR_ASSERT2(false, "getcontext");
+    if (shared_stack) {
+        // 共享栈在首次 swapIn 时绑定, 上下文也推迟到占用栈之后再创建
+        SYLAR_ASSERT2(!return_to_mainFiber, "shared stack fiber must use swapIn");
+        m_sharedStack = true;
+        m_ctxPending  = true;
+        SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber  id = " << m_id << " shared";
+        return;
     }
 
-    m_ctx.uc_link          = nullptr;
-    m_ctx.uc_stack.ss_sp   = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
+    m_allocator = StackAllocator::GetDefault();
+    m_stack     = m_allocator->alloc(m_stacksize);
+    SYLAR_ASSERT2(m_stack, "alloc fiber stack");
 
-    if (return_to_mainFiber) {
-        // 执行者是调度器：返回到主协程
-        makecontext(&m_ctx, &Fiber::MainFiberFunc, 0);
-    }
-    else {
-        // 执行者是任务协程：返回到调度器
-        makecontext(&m_ctx, &Fiber::SchedulerFiberFunc, 0);
+    // 执行者是调度器：返回到主协程; 执行者是任务协程：返回到调度器
+    if (!m_ctx.make(m_stack, m_stacksize,
+                    return_to_mainFiber ? &Fiber::MainFiberFunc
+                                        : &Fiber::SchedulerFiberFunc))
+    {
+        SYLAR_ASSERT2(false, "makecontext");
     }
 
     SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber  id = " << m_id;
@@ -83,10 +112,21 @@ Fiber::~Fiber()
     --s_fiber_count;
     // --s_fiber_id;
 
-    if (m_stack) {
+    if (m_sharedStack) {
+        SYLAR_ASSERT(m_state == TERM || m_state == INIT || m_state == EXCEPT);
+
+        if (m_shared) {
+            FiberSharedStack::MutexType::Lock lock(m_shared->mutex);
+            if (m_shared->occupant == this) {
+                m_shared->occupant = nullptr;
+            }
+        }
+        free(m_savedStack);
+    }
+    else if (m_stack) {
         SYLAR_ASSERT(m_state == TERM || m_state == INIT || m_state == EXCEPT);
 
-        StackAllocator::Dealloc(m_stack, m_stacksize);
+        m_allocator->dealloc(m_stack, m_stacksize);
     }
     else {
         SYLAR_ASSERT(!m_cb);
@@ -104,18 +144,22 @@ Fiber::~Fiber()
 
 void Fiber::reset(std::function<void()> cb)
 {
-    SYLAR_ASSERT(m_stack);
+    SYLAR_ASSERT(m_stack || m_sharedStack);
     SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
     m_cb = cb;
-    if (getcontext(&m_ctx)) {
-        SYLAR_ASSERT2(false, "getcontext");
-    }
 
-    m_ctx.uc_link          = nullptr;     // 设置关联的上下文
-    m_ctx.uc_stack.ss_sp   = m_stack;     // 设置使用的栈空间
-    m_ctx.uc_stack.ss_size = m_stacksize; // 设置栈空间的大小
+    if (m_sharedStack) {
+        // 仍绑定原共享栈, 下次切入时重新创建上下文
+        m_ctxPending = true;
+        m_savedSize  = 0;
+        m_state      = INIT;
+        return;
+    }
 
-    makecontext(&m_ctx, &Fiber::SchedulerFiberFunc, 0); // 创建这个上下文
+    // 在原有栈空间上重新创建上下文
+    if (!m_ctx.make(m_stack, m_stacksize, &Fiber::SchedulerFiberFunc)) {
+        SYLAR_ASSERT2(false, "makecontext");
+    }
     m_state = INIT;
 }
 
@@ -125,7 +169,7 @@ void Fiber::call()
     m_state = EXEC;
     // SYLAR_LOG_DEBUG(g_logger) << getId();
 
-    if (swapcontext(&t_threadFiber->m_ctx, &m_ctx)) {
+    if (!FiberContext::Swap(t_threadFiber->m_ctx, m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
@@ -133,17 +177,84 @@ void Fiber::call()
 void Fiber::back()
 {
     SetThis(t_threadFiber.get());
-    if (swapcontext(&m_ctx, &t_threadFiber->m_ctx)) {
+    if (!FiberContext::Swap(m_ctx, t_threadFiber->m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
 
+void Fiber::acquireSharedStack()
+{
+    if (!m_shared) {
+        if (t_shared_stacks.empty()) {
+            uint32_t count = std::max(1u, g_fiber_shared_stack_count->getValue());
+            for (uint32_t i = 0; i < count; ++i) {
+                t_shared_stacks.emplace_back(
+                    new FiberSharedStack(g_fiber_shared_stack_size->getValue()));
+            }
+        }
+        m_shared = t_shared_stacks[t_shared_stack_next++ % t_shared_stacks.size()];
+        m_sharedThread = sylar::GetThreadId();
+    }
+    SYLAR_ASSERT2(m_sharedThread == sylar::GetThreadId(),
+                  "shared stack fiber resumed on another thread");
+
+    FiberSharedStack::MutexType::Lock lock(m_shared->mutex);
+    Fiber *occupant = m_shared->occupant;
+    if (occupant != this) {
+        if (occupant) {
+            occupant->saveSharedStack();
+        }
+        m_shared->occupant = this;
+
+        if (!m_ctxPending && m_savedSize) {
+            memcpy(m_shared->mem + m_shared->size - m_savedSize, m_savedStack,
+                   m_savedSize);
+        }
+    }
+
+    if (m_ctxPending) {
+        if (!m_ctx.make(m_shared->mem, m_shared->size,
+                        &Fiber::SchedulerFiberFunc))
+        {
+            SYLAR_ASSERT2(false, "makecontext");
+        }
+        m_ctxPending = false;
+    }
+}
+
+void Fiber::saveSharedStack()
+{
+    // 已结束或尚未开始的协程栈上没有需要保留的内容
+    if (m_state == TERM || m_state == EXCEPT || m_ctxPending) {
+        m_savedSize = 0;
+        return;
+    }
+
+    char *top = m_shared->mem + m_shared->size;
+    char *sp  = (char *)m_ctx.getStackPointer();
+    if (!sp || sp < m_shared->mem || sp > top) {
+        sp = m_shared->mem; // 无法确定栈顶时整栈保存
+    }
+
+    m_savedSize = top - sp;
+    if (m_savedCapacity < m_savedSize) {
+        free(m_savedStack);
+        m_savedStack    = (char *)malloc(m_savedSize);
+        m_savedCapacity = m_savedSize;
+        SYLAR_ASSERT2(m_savedStack, "alloc fiber saved stack");
+    }
+    memcpy(m_savedStack, sp, m_savedSize);
+}
+
 void Fiber::swapIn()
 {
     SetThis(this);
     SYLAR_ASSERT(m_state != EXEC);
+    if (m_sharedStack) {
+        acquireSharedStack();
+    }
     m_state = EXEC;
-    if (swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx)) {
+    if (!FiberContext::Swap(Scheduler::GetMainFiber()->m_ctx, m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
@@ -151,7 +262,7 @@ void Fiber::swapIn()
 void Fiber::swapOut()
 {
     SetThis(Scheduler::GetMainFiber());
-    if (swapcontext(&m_ctx, &Scheduler::GetMainFiber()->m_ctx)) {
+    if (!FiberContext::Swap(m_ctx, Scheduler::GetMainFiber()->m_ctx)) {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
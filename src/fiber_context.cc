@@ -0,0 +1,179 @@
+#include "sylar/fiber_context.hh"
+
+#include <cstdint>
+
+#ifdef SYLAR_FIBER_USE_ASM
+
+extern "C" void sylar_fctx_start();
+
+#if defined(__x86_64__)
+// 栈帧(低地址 -> 高地址): [mxcsr|x87 cw] r12 r13 r14 r15 rbx rbp ret
+asm(R"(
+    .text
+    .globl  sylar_fctx_swap
+    .type   sylar_fctx_swap, @function
+    .align  16
+sylar_fctx_swap:
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r15
+    pushq   %r14
+    pushq   %r13
+    pushq   %r12
+    leaq    -8(%rsp), %rsp
+    stmxcsr (%rsp)
+    fnstcw  4(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw   4(%rsp)
+    leaq    8(%rsp), %rsp
+    popq    %r12
+    popq    %r13
+    popq    %r14
+    popq    %r15
+    popq    %rbx
+    popq    %rbp
+    ret
+    .size   sylar_fctx_swap, .-sylar_fctx_swap
+
+    .globl  sylar_fctx_start
+    .hidden sylar_fctx_start
+    .type   sylar_fctx_start, @function
+    .align  16
+sylar_fctx_start:
+    .cfi_startproc
+    .cfi_undefined rip
+    andq    $-16, %rsp
+    callq   *%r12
+    ud2
+    .cfi_endproc
+    .size   sylar_fctx_start, .-sylar_fctx_start
+)");
+#elif defined(__aarch64__)
+// 栈帧(相对 sp): d8-d15 [0x00,0x40) x19-x30 [0x40,0xa0) 填充 [0xa0,0xb0)
+asm(R"(
+    .text
+    .globl  sylar_fctx_swap
+    .type   sylar_fctx_swap, %function
+    .align  4
+sylar_fctx_swap:
+    sub     sp, sp, #0xb0
+    stp     d8,  d9,  [sp, #0x00]
+    stp     d10, d11, [sp, #0x10]
+    stp     d12, d13, [sp, #0x20]
+    stp     d14, d15, [sp, #0x30]
+    stp     x19, x20, [sp, #0x40]
+    stp     x21, x22, [sp, #0x50]
+    stp     x23, x24, [sp, #0x60]
+    stp     x25, x26, [sp, #0x70]
+    stp     x27, x28, [sp, #0x80]
+    stp     x29, x30, [sp, #0x90]
+    mov     x9, sp
+    str     x9, [x0]
+    mov     sp, x1
+    ldp     d8,  d9,  [sp, #0x00]
+    ldp     d10, d11, [sp, #0x10]
+    ldp     d12, d13, [sp, #0x20]
+    ldp     d14, d15, [sp, #0x30]
+    ldp     x19, x20, [sp, #0x40]
+    ldp     x21, x22, [sp, #0x50]
+    ldp     x23, x24, [sp, #0x60]
+    ldp     x25, x26, [sp, #0x70]
+    ldp     x27, x28, [sp, #0x80]
+    ldp     x29, x30, [sp, #0x90]
+    add     sp, sp, #0xb0
+    ret
+    .size   sylar_fctx_swap, .-sylar_fctx_swap
+
+    .globl  sylar_fctx_start
+    .hidden sylar_fctx_start
+    .type   sylar_fctx_start, %function
+    .align  4
+sylar_fctx_start:
+    .cfi_startproc
+    .cfi_undefined x30
+    blr     x19
+    brk     #0
+    .cfi_endproc
+    .size   sylar_fctx_start, .-sylar_fctx_start
+)");
+#endif
+
+#endif // SYLAR_FIBER_USE_ASM
+
+namespace sylar {
+
+#ifdef SYLAR_FIBER_USE_ASM
+
+bool FiberContext::init()
+{
+    // 首次切出时由 sylar_fctx_swap 写入栈指针
+    m_sp = nullptr;
+    return true;
+}
+
+bool FiberContext::make(void *stack, size_t size, EntryFunc fn)
+{
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+
+#if defined(__x86_64__)
+    uint32_t mxcsr = 0;
+    uint16_t fpucw = 0;
+    asm volatile("stmxcsr %0" : "=m"(mxcsr));
+    asm volatile("fnstcw %0" : "=m"(fpucw));
+
+    uint64_t *sp = (uint64_t *)top - 9;
+    sp[0] = mxcsr | ((uint64_t)fpucw << 32); // mxcsr | x87 控制字
+    sp[1] = (uint64_t)fn;                     // r12: 入口函数
+    sp[2] = 0;                                // r13
+    sp[3] = 0;                                // r14
+    sp[4] = 0;                                // r15
+    sp[5] = 0;                                // rbx
+    sp[6] = 0;                                // rbp
+    sp[7] = (uint64_t)&sylar_fctx_start;      // 返回地址
+    sp[8] = 0;                                // 填充
+#elif defined(__aarch64__)
+    uint64_t *sp = (uint64_t *)(top - 0xb0);
+    for (size_t i = 0; i < 0xb0 / sizeof(uint64_t); ++i) {
+        sp[i] = 0;
+    }
+    sp[0x40 / 8] = (uint64_t)fn;                // x19: 入口函数
+    sp[0x98 / 8] = (uint64_t)&sylar_fctx_start; // x30: 返回地址
+#endif
+
+    m_sp = sp;
+    return true;
+}
+
+const char *FiberContext::BackendName()
+{
+#if defined(__x86_64__)
+    return "asm-x86_64";
+#else
+    return "asm-aarch64";
+#endif
+}
+
+#else
+
+bool FiberContext::init() { return !getcontext(&m_ctx); }
+
+bool FiberContext::make(void *stack, size_t size, EntryFunc fn)
+{
+    if (getcontext(&m_ctx)) {
+        return false;
+    }
+
+    m_ctx.uc_link          = nullptr;
+    m_ctx.uc_stack.ss_sp   = stack;
+    m_ctx.uc_stack.ss_size = size;
+    makecontext(&m_ctx, fn, 0);
+    return true;
+}
+
+const char *FiberContext::BackendName() { return "ucontext"; }
+
+#endif // SYLAR_FIBER_USE_ASM
+
+} // namespace sylar
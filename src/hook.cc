@@ -7,6 +7,9 @@
 #include "sylar/fd_manager.hh"
 #include "sylar/log.hh"
 #include <stdarg.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <sys/sendfile.h>
 #include "sylar/macro.hh"
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
@@ -16,6 +19,9 @@ namespace sylar {
 static thread_local bool t_hook_enable = false;
 static sylar::ConfigVar<int>::ptr g_tcp_connect_timeout =
     sylar::Config::Lookup("tcp.connect.timeout", 5000, "tcp connect timeout");
+static sylar::ConfigVar<bool>::ptr g_hook_inline_io_timeout =
+    sylar::Config::Lookup("hook.inline_io_timeout", true,
+                          "io wait timeouts are swept by the iomanager instead of timers");
 
 #define HOOK_FUN(XX) \
     XX(sleep)        \
@@ -34,6 +40,7 @@ static sylar::ConfigVar<int>::ptr g_tcp_connect_timeout =
     XX(send)         \
     XX(sendto)       \
     XX(sendmsg)      \
+    XX(sendfile)     \
     XX(fcntl)        \
     XX(getsockopt)   \
     XX(setsockopt)   \
@@ -54,12 +61,19 @@ void hook_init()
 }
 
 static uint64_t s_connect_timeout = -1;
+static bool s_inline_io_timeout   = true;
 struct _HookIniter {
     _HookIniter()
     {
         hook_init();
 
-        s_connect_timeout = g_tcp_connect_timeout->getValue();
+        s_connect_timeout   = g_tcp_connect_timeout->getValue();
+        s_inline_io_timeout = g_hook_inline_io_timeout->getValue();
+
+        g_hook_inline_io_timeout->addListener(
+            [](const bool &old_value, const bool &new_value) {
+                s_inline_io_timeout = new_value;
+            });
 
         g_tcp_connect_timeout->addListener(
             [](const int &old_value, const int &new_value) {
@@ -134,7 +148,7 @@ static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name,
     }
 
     // 获取这个 fd 对应的上下文对象
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
     if (!ctx) {
         // 不存在上下文对象的话, 调用原始的函数
         return fun(fd, std::forward<Args>(args)...);
@@ -154,8 +168,8 @@ static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name,
     // 获取当前 fd 的超时时间: 是SO_RCVTIMEO 或 SO_SNDTIMEO
     uint64_t to = ctx->getTimeout(timeout_so);
 
-    // 创建一个定时器, 进行定时操作
-    std::shared_ptr<timer_info> tinfo(new timer_info);
+    // 旧的定时器超时方式才需要, 每次调用一个 shared_ptr
+    std::shared_ptr<timer_info> tinfo;
 
 retry:
 
@@ -172,11 +186,46 @@ retry:
 
         // 获取当前线程的 iomanager. 即事件调度器
         sylar::IOManager *iom = sylar::IOManager::GetThis();
+
+        // 超时时间点记在事件上下文中, 由 IOManager 扫描取消, 等待过程不分配内存
+        if (sylar::s_inline_io_timeout) {
+            uint64_t seq = 0;
+            int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event), to, seq);
+            if (rt == 1) {
+                goto retry;
+            }
+            if (SYLAR_UNLICKLY(rt)) {
+                SYLAR_LOG_SAMPLE_ERROR(g_logger)
+                    << hook_fun_name << " addEvent(" << fd << ", " << event << " )";
+                return -1;
+            }
+
+            sylar::Fiber::YieldToHold();
+            if (to != (uint64_t)-1
+                && iom->isTimedOut(fd, (sylar::IOManager::Event)(event), seq))
+            {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            goto retry;
+        }
+
+        if (!tinfo) {
+            tinfo.reset(new timer_info);
+        }
         sylar::Timer::ptr condition_timer_to_cancel_event;
         std::weak_ptr<timer_info> winfo(tinfo);
 
+        // 添加一个IO事件监听, 比如 EPOLLIN(读) 或 EPOLLOUT(写), 因为无论accpet成功与否都会进行通知
+        int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
+
+        // 持久注册模式下, 上次等待之后已经到达过就绪边沿, 不挂起直接重试
+        if (rt == 1) {
+            goto retry;
+        }
+
         // 如果设置了超时时间, 添加一个超时定时器, 定时取消当前事件
-        if (to != (uint64_t)-1) {
+        if (rt == 0 && to != (uint64_t)-1) {
             condition_timer_to_cancel_event = iom->addConditionTimer(
                 to,                         // 超时时间
                 [winfo, fd, iom, event]() { // 条件定时器的超时逻辑
@@ -192,17 +241,10 @@ retry:
                 winfo); // 条件变量: 定时器只在未取消状态下有效
         }
 
-        // 添加一个IO事件监听, 比如 EPOLLIN(读) 或 EPOLLOUT(写), 因为无论accpet成功与否都会进行通知
-        int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
-
         if (SYLAR_UNLICKLY(rt)) {
             // 添加失败时, 进行日志提醒
-            SYLAR_LOG_ERROR(g_logger)
+            SYLAR_LOG_SAMPLE_ERROR(g_logger)
                 << hook_fun_name << " addEvent(" << fd << ", " << event << " )";
-
-            if (condition_timer_to_cancel_event) {
-                condition_timer_to_cancel_event->cancel();
-            }
             return -1;
         }
         else {
@@ -233,6 +275,89 @@ retry:
     return n;
 }
 
+/**
+ * @brief      判断 fd 上的 IO 能否交给 io_uring 完成
+ * @param[in]  fd 文件描述符
+ * @param[out] ctx fd 对应的上下文
+ * @return     可以时返回当前的 IOManager, 否则返回 nullptr, 由 do_io 走 epoll 流程
+ */
+static sylar::IOManager *uring_iomanager(int fd, sylar::FdCtx *&ctx)
+{
+    if (!sylar::t_hook_enable) {
+        return nullptr;
+    }
+
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    if (!iom || !iom->isUringEnabled()) {
+        return nullptr;
+    }
+
+    ctx = sylar::FdMgr::GetInstance()->get(fd);
+    if (!ctx || ctx->isClose() || !ctx->isSocket() || ctx->getUserNonblock()) {
+        return nullptr;
+    }
+
+    // 共享栈协程挂起后栈内容会被换出, 内核不能读写其栈上的缓冲区
+    if (sylar::Fiber::GetThis()->isSharedStack()) {
+        return nullptr;
+    }
+    return iom;
+}
+
+/**
+ * @brief 填充 io_uring 请求的公共字段
+ */
+static void uring_prep(io_uring_sqe &sqe, uint8_t opcode, int fd,
+                       const void *addr, uint32_t len, uint64_t off)
+{
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd     = fd;
+    sqe.addr   = (uint64_t)(uintptr_t)addr;
+    sqe.len    = len;
+    sqe.off    = off;
+}
+
+/**
+ * @brief      通过 io_uring 完成一次 IO, 挂起当前协程直到请求完成
+ * @param[in]  iom uring_iomanager 返回的 IOManager
+ * @param[in]  sqe 已填充的请求
+ * @param[in]  timeout_ms 超时时间, (uint64_t)-1 表示不超时
+ * @param[out] n 与原始函数相同语义的返回值, 失败时设置 errno
+ * @return     请求未能提交时返回 false, 调用方应回退到 do_io
+ */
+static bool uring_io(sylar::IOManager *iom, const io_uring_sqe &sqe,
+                     uint64_t timeout_ms, ssize_t &n)
+{
+    int res = 0;
+    do {
+        if (!iom->uringSubmit(sqe, timeout_ms, res)) {
+            return false;
+        }
+    } while (res == -EINTR);
+
+    if (res < 0) {
+        // 未超时的取消只来自 close 时的 cancelAll, 与 epoll 流程一样返回 EBADF
+        errno = res == -ECANCELED ? EBADF : -res;
+        n     = -1;
+    }
+    else {
+        n = res;
+    }
+    return true;
+}
+
+/**
+ * @brief 新建句柄时清除当前 IOManager 中同号旧句柄遗留的持久注册状态
+ */
+static void reset_fd(int fd)
+{
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    if (iom) {
+        iom->resetFd(fd);
+    }
+}
+
 extern "C" {
 #define XX(name) name##_fun name##_f = nullptr;
 HOOK_FUN(XX);
@@ -246,7 +371,8 @@ unsigned int sleep(unsigned int seconds)
 
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager *iom = sylar::IOManager::GetThis();
-    iom->addTimer(seconds * 1000, [iom, fiber]() { iom->schedule(fiber, -1); });
+    int thread = sylar::Scheduler::GetTaskThread();
+    iom->addTimer(seconds * 1000, [iom, fiber, thread]() { iom->schedule(fiber, thread); });
 
     sylar::Fiber::YieldToHold();
     return 0;
@@ -260,7 +386,8 @@ int usleep(useconds_t usec)
 
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager *iom   = sylar::IOManager::GetThis();
-    iom->addTimer(usec / 1000, [iom, fiber]() { iom->schedule(fiber, -1); });
+    int thread              = sylar::Scheduler::GetTaskThread();
+    iom->addTimer(usec / 1000, [iom, fiber, thread]() { iom->schedule(fiber, thread); });
     sylar::Fiber::YieldToHold();
 
     return 0;
@@ -276,7 +403,8 @@ int nanosleep(const struct timespec *rqtp, struct timespec *rmtp)
 
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager *iom   = sylar::IOManager::GetThis();
-    iom->addTimer(timeout_ms, [iom, fiber]() { iom->schedule(fiber, -1); });
+    int thread              = sylar::Scheduler::GetTaskThread();
+    iom->addTimer(timeout_ms, [iom, fiber, thread]() { iom->schedule(fiber, thread); });
 
     sylar::Fiber::YieldToHold();
 
@@ -295,6 +423,7 @@ int socket(int domain, int type, int protocol)
     }
 
     sylar::FdMgr::GetInstance()->get(fd, true);
+    reset_fd(fd);
 
     return fd;
 }
@@ -306,7 +435,7 @@ int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
         return connect_f(fd, addr, addrlen);
     }
 
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
 
     if (!ctx || ctx->isClose()) {
         errno = EBADF;
@@ -322,6 +451,16 @@ int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
         return connect_f(fd, addr, addrlen);
     }
 
+    sylar::IOManager *uring_iom = uring_iomanager(fd, ctx);
+    if (uring_iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_CONNECT, fd, addr, 0, addrlen);
+        ssize_t n = 0;
+        if (uring_io(uring_iom, sqe, timeout_ms, n)) {
+            return n;
+        }
+    }
+
     int n = connect_f(fd, addr, addrlen);
     if (n == 0) {
         return 0; // 直接成功
@@ -332,47 +471,67 @@ int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
 
     // if (n == -1 && errno == EINPROGRESS) 的情况
 
-    // 设置超时取消写事件
     sylar::IOManager *iom = sylar::IOManager::GetThis();
-    sylar::Timer::ptr timer;
-    std::shared_ptr<timer_info> tinfo(new timer_info);
-    std::weak_ptr<timer_info> winfo(tinfo); // 用来记录定时器的状态
-
-    if (timeout_ms != (uint64_t)-1) {
-        timer = iom->addConditionTimer(
-            timeout_ms,
-            [winfo, fd, iom]() {
-                auto t = winfo.lock();
-                if (!t || t->cancelled) {
-                    return;
-                }
-                t->cancelled = ETIMEDOUT;
-                iom->cancelEvent(fd, sylar::IOManager::WRITE);
-            },
-            winfo);
-    }
-
-    // 注册 WRITE 事件,并挂起协程
-    int rt = iom->addEvent(fd, sylar::IOManager::WRITE);
-    if (rt == 0) {
-        sylar::Fiber::YieldToHold();
-
-        // epoll 回调回来后,在后面检测异步connect中的 fd 是否最终连接失败
-        // 先提前取消条件定时器
-        if (timer) {
-            timer->cancel();
+
+    if (sylar::s_inline_io_timeout) {
+        // 注册 WRITE 事件并带上超时; 持久注册模式下若已可写(返回1), 直接检查连接结果
+        uint64_t seq = 0;
+        int rt = iom->addEvent(fd, sylar::IOManager::WRITE, timeout_ms, seq);
+        if (rt == 0) {
+            sylar::Fiber::YieldToHold();
+            if (timeout_ms != (uint64_t)-1
+                && iom->isTimedOut(fd, sylar::IOManager::WRITE, seq))
+            {
+                errno = ETIMEDOUT;
+                return -1;
+            }
         }
-        if (tinfo->cancelled) {
-            errno = tinfo->cancelled;
-            return -1;
+        else if (rt < 0) {
+            SYLAR_LOG_SAMPLE_ERROR(g_logger)
+                << "connect addEvent(" << fd << ", WRITE error";
         }
     }
-    else { // 错误处理
-        if (timer) {
-            timer->cancel(); // 取消 timer
+    else {
+        // 设置超时取消写事件
+        sylar::Timer::ptr timer;
+        std::shared_ptr<timer_info> tinfo(new timer_info);
+        std::weak_ptr<timer_info> winfo(tinfo); // 用来记录定时器的状态
+
+        // 注册 WRITE 事件; 持久注册模式下若已可写(返回1), 直接检查连接结果
+        int rt = iom->addEvent(fd, sylar::IOManager::WRITE);
+
+        if (rt == 0 && timeout_ms != (uint64_t)-1) {
+            timer = iom->addConditionTimer(
+                timeout_ms,
+                [winfo, fd, iom]() {
+                    auto t = winfo.lock();
+                    if (!t || t->cancelled) {
+                        return;
+                    }
+                    t->cancelled = ETIMEDOUT;
+                    iom->cancelEvent(fd, sylar::IOManager::WRITE);
+                },
+                winfo);
+        }
+
+        // 挂起协程
+        if (rt == 0) {
+            sylar::Fiber::YieldToHold();
+
+            // epoll 回调回来后,在后面检测异步connect中的 fd 是否最终连接失败
+            // 先提前取消条件定时器
+            if (timer) {
+                timer->cancel();
+            }
+            if (tinfo->cancelled) {
+                errno = tinfo->cancelled;
+                return -1;
+            }
+        }
+        else if (rt < 0) { // 错误处理
+            SYLAR_LOG_SAMPLE_ERROR(g_logger)
+                << "connect addEvent(" << fd << ", WRITE error";
         }
-        SYLAR_LOG_ERROR(g_logger)
-            << "connect addEvent(" << fd << ", WRITE error";
     }
 
     // 检查异步回来的连接是否失败
@@ -398,11 +557,27 @@ int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 
 int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(s, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_ACCEPT, s, addr, 0, (uint64_t)(uintptr_t)addrlen);
+        ssize_t fd = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_RCVTIMEO), fd)) {
+            if (fd >= 0) {
+                sylar::FdMgr::GetInstance()->get(fd, true);
+                reset_fd(fd);
+            }
+            return fd;
+        }
+    }
+
     int fd = do_io(s, accept_f, "accept", sylar::IOManager::READ, SO_RCVTIMEO,
                    addr, addrlen);
 
     if (fd >= 0) {
         sylar::FdMgr::GetInstance()->get(fd, true);
+        reset_fd(fd);
     }
 
     return fd;
@@ -410,6 +585,17 @@ int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
 
 ssize_t read(int fd, void *buf, size_t count)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(fd, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_READ, fd, buf, count, (uint64_t)-1);
+        ssize_t n = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_RCVTIMEO), n)) {
+            return n;
+        }
+    }
+
     return do_io(fd, read_f, "read", sylar::IOManager::READ, SO_RCVTIMEO, buf,
                  count);
 }
@@ -422,6 +608,18 @@ ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(sockfd, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_RECV, sockfd, buf, len, 0);
+        sqe.msg_flags = flags;
+        ssize_t n = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_RCVTIMEO), n)) {
+            return n;
+        }
+    }
+
     return do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO,
                  buf, len, flags);
 }
@@ -435,6 +633,18 @@ ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(sockfd, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_RECVMSG, sockfd, msg, 1, 0);
+        sqe.msg_flags = flags;
+        ssize_t n = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_RCVTIMEO), n)) {
+            return n;
+        }
+    }
+
     return do_io(sockfd, recvmsg_f, "recvmsg", sylar::IOManager::READ,
                  SO_RCVTIMEO, msg, flags);
 }
@@ -447,12 +657,35 @@ ssize_t write(int fd, const void *buf, size_t count)
 
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(fd, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_WRITEV, fd, iov, iovcnt, (uint64_t)-1);
+        ssize_t n = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_SNDTIMEO), n)) {
+            return n;
+        }
+    }
+
     return do_io(fd, writev_f, "writev", sylar::IOManager::WRITE, SO_SNDTIMEO,
                  iov, iovcnt);
 }
 
 ssize_t send(int s, const void *mag, size_t len, int flags)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(s, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_SEND, s, mag, len, 0);
+        sqe.msg_flags = flags;
+        ssize_t n = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_SNDTIMEO), n)) {
+            return n;
+        }
+    }
+
     return do_io(s, send_f, "send", sylar::IOManager::WRITE, SO_SNDTIMEO, mag,
                  len, flags);
 }
@@ -466,10 +699,28 @@ ssize_t sendto(int s, const void *msg, size_t len, int flags,
 
 ssize_t sendmsg(int s, const struct msghdr *msg, int flags)
 {
+    sylar::FdCtx *ctx = nullptr;
+    sylar::IOManager *iom = uring_iomanager(s, ctx);
+    if (iom) {
+        io_uring_sqe sqe;
+        uring_prep(sqe, IORING_OP_SENDMSG, s, msg, 1, 0);
+        sqe.msg_flags = flags;
+        ssize_t n = 0;
+        if (uring_io(iom, sqe, ctx->getTimeout(SO_SNDTIMEO), n)) {
+            return n;
+        }
+    }
+
     return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO,
                  msg, flags);
 }
 
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    return do_io(out_fd, sendfile_f, "sendfile", sylar::IOManager::WRITE,
+                 SO_SNDTIMEO, in_fd, offset, count);
+}
+
 int close(int fd)
 {
     if (!sylar::t_hook_enable) {
@@ -477,7 +728,7 @@ int close(int fd)
     }
 
     // 获得上下文对象
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
 
     if (ctx) {
         // 获得事件调度器
@@ -507,7 +758,7 @@ int fcntl(int fd, int cmd, ...)
             int arg = va_arg(va, int);
             va_end(va);
 
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+            sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
 
             if (!ctx || ctx->isClose() || !ctx->isSocket()) {
                 return fcntl_f(fd, cmd, arg);
@@ -529,7 +780,7 @@ int fcntl(int fd, int cmd, ...)
         case F_GETFL: {
             va_end(va);
             int arg               = fcntl_f(fd, cmd);
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+            sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
 
             if (!ctx || ctx->isClose() || !ctx->isSocket()) {
                 return arg;
@@ -598,7 +849,7 @@ int ioctl(int fd, unsigned long request, ...)
 
     if (FIONBIO == request) {
         bool user_nonblock    = !!*(int *)arg;
-        sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+        sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(fd);
         if (!ctx || ctx->isClose() || !ctx->isSocket()) {
             return ioctl_f(fd, request, arg);
         }
@@ -621,7 +872,7 @@ int setsockopt(int sockfd, int level, int optname, const void *optval,
     }
     if (level == SOL_SOCKET) {
         if (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) {
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(sockfd);
+            sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->get(sockfd);
             if (ctx) {
                 const timeval *v = static_cast<const timeval *>(optval);
                 ctx->setTimeout(optname, v->tv_sec * 1000 + v->tv_usec / 1000);
@@ -1,7 +1,11 @@
 #include "http/http.hh"
 // #include "http.hh"
 #include <fstream>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace sylar {
 namespace http {
@@ -199,7 +203,7 @@ void HttpResponse::setHeader(const std::string key, const std::string &val)
 
 void HttpResponse::delHeader(const std::string &key) { m_headers.erase(key); }
 
-std::ostream &HttpResponse::dump(std::ostream &os) const
+void HttpResponse::dumpHead(std::string &buf) const
 {
     /**
      * HTTP/1.1 301 Moved Permanently
@@ -210,30 +214,108 @@ std::ostream &HttpResponse::dump(std::ostream &os) const
      * Connection: keep-alive
      * Location: https://www.bilibili.com/
      */
-    os << "HTTP/" << ((uint32_t)(m_version >> 4)) << "."
-       << ((uint32_t)(m_version & 0x0F)) << " " << (uint32_t)(m_status) << " "
-       << (m_reason.empty() ? HttpStatusToString(m_status) : m_reason)
-       << "\r\n";
+    char line[64];
+    int n = snprintf(line, sizeof(line), "HTTP/%u.%u %u ",
+                     (uint32_t)(m_version >> 4), (uint32_t)(m_version & 0x0F),
+                     (uint32_t)m_status);
+    buf.append(line, n);
+    if (m_reason.empty()) {
+        buf.append(HttpStatusToString(m_status));
+    }
+    else {
+        buf.append(m_reason);
+    }
+    buf.append("\r\n");
 
     for (auto &i : m_headers) {
         if (strcasecmp(i.first.c_str(), "connection") == 0) {
             continue;
         }
-        os << i.first << ": " << i.second << "\r\n";
+        // 生成的响应体长度事先未知, 分帧由 HttpSession 决定
+        if (m_producer && (strcasecmp(i.first.c_str(), "content-length") == 0 ||
+                           strcasecmp(i.first.c_str(), "transfer-encoding") == 0)) {
+            continue;
+        }
+        buf.append(i.first).append(": ").append(i.second).append("\r\n");
     }
 
-    os << "connection: " << (m_close ? "close" : "keep-alive") << "\r\n";
+    buf.append(m_close ? "connection: close\r\n" : "connection: keep-alive\r\n");
 
-    if (!m_body.empty()) {
-        os << "content-length: " << m_body.size() << "\r\n\r\n" << m_body;
+    if (m_producer) {
+        // HTTP/1.0 不认识 chunked, 以关闭连接表示响应体结束; 204/304 没有响应体
+        if (m_version >= 0x11 && m_status != HttpStatus::NO_CONTENT &&
+            m_status != HttpStatus::NOT_MODIFIED) {
+            buf.append("transfer-encoding: chunked\r\n");
+        }
+        buf.append("\r\n");
+        return;
     }
-    else {
-        os << "\r\n";
+
+    uint64_t length = getContentLength();
+    if (length) {
+        n = snprintf(line, sizeof(line), "content-length: %" PRIu64 "\r\n",
+                     length);
+        buf.append(line, n);
     }
+    buf.append("\r\n");
+}
+
+std::ostream &HttpResponse::dump(std::ostream &os) const
+{
+    std::string head;
+    dumpHead(head);
+    os << head;
 
+    if (!m_file) {
+        return os << m_body;
+    }
+    // 文件响应体只在需要完整字符串时(如打印日志)才读出来
+    char buf[64 * 1024];
+    uint64_t offset = m_file->offset;
+    uint64_t left   = m_file->length;
+    while (left > 0) {
+        ssize_t n = pread(m_file->fd, buf, std::min<uint64_t>(left, sizeof(buf)),
+                          offset);
+        if (n <= 0) {
+            break;
+        }
+        os.write(buf, n);
+        offset += n;
+        left -= n;
+    }
     return os;
 }
 
+bool HttpResponse::setBodyFile(const std::string &path, uint64_t offset,
+                               int64_t length)
+{
+    HttpFileBody::ptr file(new HttpFileBody);
+    file->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(file->fd, &st) != 0 || !S_ISREG(st.st_mode)
+        || offset > (uint64_t)st.st_size
+        || (length >= 0 && offset + length > (uint64_t)st.st_size))
+    {
+        return false;
+    }
+    file->offset = offset;
+    file->length = length >= 0 ? (uint64_t)length : st.st_size - offset;
+    m_file       = file;
+    m_body.clear();
+    m_producer = nullptr;
+    return true;
+}
+
+HttpFileBody::~HttpFileBody()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
 std::string HttpResponse::toString() const
 {
     std::stringstream ss;
@@ -0,0 +1,377 @@
+#include "http/http11_fast_parser.hh"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HTTP_FAST_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief 字符分类表, 与 http11_parser.rl 中的文法一致
+ */
+struct CharTables {
+    bool uri[256];   /**< 路径和查询串中可以直接出现的字符, 不含 ? % # */
+    bool token[256]; /**< 头部字段名 */
+    bool ctl[256];   /**< 控制字符, 头部值中只允许 \t */
+
+    CharTables()
+    {
+        for (int c = 0; c < 256; ++c) {
+            bool alnum = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                         (c >= '0' && c <= '9');
+            // pchar: 非 ASCII、unreserved、sub_delims、":"、"@", 再加上分隔路径的 "/"
+            uri[c] = c >= 0x80 || alnum || strchr("-._~!$&'()*+,;=:@/", c);
+            ctl[c] = c < 0x20 || c == 0x7f;
+            token[c] = c < 0x80 && !ctl[c] && !strchr("()<>@,;:\\\"/[]?={} \t", c);
+        }
+        // strchr 会匹配到结尾的 '\0'
+        uri[0]   = false;
+        token[0] = false;
+    }
+};
+
+static const CharTables s_tables;
+
+/**
+ * @brief 各指令集的扫描函数, 返回 [p, end) 中第一个可能需要单独处理的字符,
+ *        没有时返回 end. 可以多停, 由调用者查表确认, 但不能漏掉
+ */
+struct ScanOps {
+    const char *(*uri)(const char *p, const char *end);
+    const char *(*name)(const char *p, const char *end);
+    const char *(*value)(const char *p, const char *end);
+};
+
+static const char *ScalarUri(const char *p, const char *end)
+{
+    while (p < end && s_tables.uri[(uint8_t)*p]) {
+        ++p;
+    }
+    return p;
+}
+
+static const char *ScalarName(const char *p, const char *end)
+{
+    while (p < end && s_tables.token[(uint8_t)*p]) {
+        ++p;
+    }
+    return p;
+}
+
+static const char *ScalarValue(const char *p, const char *end)
+{
+    while (p < end && !s_tables.ctl[(uint8_t)*p]) {
+        ++p;
+    }
+    return p;
+}
+
+static const ScanOps s_scalar_ops = {ScalarUri, ScalarName, ScalarValue};
+
+#ifdef HTTP_FAST_X86
+
+/**
+ * @brief 用 pcmpestri 找第一个落在 ranges 中任一区间的字节, 每次 16 字节
+ * @param[in] ranges 成对的闭区间, 最多 8 对
+ */
+__attribute__((target("sse4.2"))) static inline const char *
+Sse42FindRanges(const char *p, const char *end, const char *ranges,
+                int ranges_len)
+{
+    __m128i r = _mm_loadu_si128((const __m128i *)ranges);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        int idx   = _mm_cmpestri(r, ranges_len, v, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                                     _SIDD_LEAST_SIGNIFICANT);
+        if (idx != 16) {
+            return p + idx;
+        }
+        p += 16;
+    }
+    return p;
+}
+
+// 不在 s_tables.uri 中的字符; 为凑进 8 个区间, "~" 也会停下
+static const char s_uri_ranges[16] = {
+    '\x00', ' ', '"', '#', '%', '%', '<', '<',
+    '>',    '?', '[', '^', '`', '`', '{', '\x7f'};
+
+// 不是 token 的字符; "|" 和 "~" 也会停下
+static const char s_name_ranges[16] = {
+    '\x00', ' ', '"', '"', '(', ')', ',', ',',
+    '/',    '/', ':', '@', '[', ']', '{', '\xff'};
+
+// 只有前 4 个字节有效, 补齐到 16 字节供 _mm_loadu_si128 读取
+static const char s_value_ranges[16] = {'\x00', '\x1f', '\x7f', '\x7f'};
+
+__attribute__((target("sse4.2"))) static const char *Sse42Uri(const char *p,
+                                                              const char *end)
+{
+    return ScalarUri(Sse42FindRanges(p, end, s_uri_ranges, 16), end);
+}
+
+__attribute__((target("sse4.2"))) static const char *Sse42Name(const char *p,
+                                                               const char *end)
+{
+    return ScalarName(Sse42FindRanges(p, end, s_name_ranges, 16), end);
+}
+
+__attribute__((target("sse4.2"))) static const char *
+Sse42Value(const char *p, const char *end)
+{
+    return ScalarValue(Sse42FindRanges(p, end, s_value_ranges, 4), end);
+}
+
+/**
+ * @brief 头部值占请求头的大部分, 用 AVX2 一次比较 32 字节: c <= 0x1f 或 c == 0x7f
+ */
+__attribute__((target("avx2"))) static const char *Avx2Value(const char *p,
+                                                             const char *end)
+{
+    const __m256i ctl = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m = _mm256_or_si256(
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v),
+            _mm256_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return Sse42Value(p, end);
+}
+
+static const ScanOps s_sse42_ops = {Sse42Uri, Sse42Name, Sse42Value};
+static const ScanOps s_avx2_ops  = {Sse42Uri, Sse42Name, Avx2Value};
+
+#endif
+
+static int SupportedIsa()
+{
+#ifdef HTTP_FAST_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2")) {
+        return HTTP_FAST_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return HTTP_FAST_SSE42;
+    }
+#endif
+    return HTTP_FAST_SCALAR;
+}
+
+static const ScanOps *IsaOps(int isa)
+{
+#ifdef HTTP_FAST_X86
+    if (isa == HTTP_FAST_AVX2) {
+        return &s_avx2_ops;
+    }
+    if (isa == HTTP_FAST_SSE42) {
+        return &s_sse42_ops;
+    }
+#endif
+    return &s_scalar_ops;
+}
+
+static int s_isa            = SupportedIsa();
+static const ScanOps *s_ops = IsaOps(s_isa);
+
+static inline bool IsXdigit(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+           (c >= 'A' && c <= 'F');
+}
+
+/**
+ * @brief 校验通过后才调用回调, 先记录下头部的位置
+ */
+struct FastField {
+    const char *name;
+    size_t nlen;
+    const char *value;
+    size_t vlen;
+};
+
+static const size_t FAST_MAX_FIELDS = 64;
+
+} // namespace
+
+ssize_t http_parser_fast_execute(http_parser *parser, const char *data, size_t len)
+{
+    const ScanOps &ops = *s_ops;
+    const char *p      = data;
+    const char *end    = data + len;
+
+    // Method = ( upper | digit ){1,20}
+    const char *method = p;
+    while (p < end && p - method <= 20 &&
+           ((*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9'))) {
+        ++p;
+    }
+    if (p >= end || *p != ' ' || p == method || p - method > 20) {
+        return -1;
+    }
+    size_t method_len = p - method;
+
+    // 只处理 "/" 开头的路径; "//" 开头时 ragel 会按 authority 解析
+    const char *uri = ++p;
+    if (end - p < 2 || p[0] != '/' || p[1] == '/') {
+        return -1;
+    }
+    const char *query = NULL;
+    for (;;) {
+        p = ops.uri(p, end);
+        if (p >= end) {
+            return -1;
+        }
+        char c = *p;
+        if (c == ' ') {
+            break;
+        }
+        if (c == '?') {
+            // 查询串中的 "?" 是普通字符
+            if (!query) {
+                query = p + 1;
+            }
+            ++p;
+        }
+        else if (c == '%') {
+            if (end - p < 3 || !IsXdigit(p[1]) || !IsXdigit(p[2])) {
+                return -1;
+            }
+            p += 3;
+        }
+        else if (s_tables.uri[(uint8_t)c]) {
+            ++p;
+        }
+        else {
+            // "#" fragment、非法字符、uri_relaxed 下的 {}^ 都交给 ragel
+            return -1;
+        }
+    }
+    const char *uri_end = p;
+    if (query == uri_end) {
+        return -1;
+    }
+
+    // HTTP_Version CRLF, 只接受 "\r\n"
+    const char *version = ++p;
+    if (end - p < 10 || memcmp(p, "HTTP/1.", 7) != 0 ||
+        (p[7] != '0' && p[7] != '1') || p[8] != '\r' || p[9] != '\n') {
+        return -1;
+    }
+    p += 10;
+
+    FastField fields[FAST_MAX_FIELDS];
+    size_t count = 0;
+    for (;;) {
+        if (end - p < 2) {
+            return -1;
+        }
+        if (p[0] == '\r') {
+            if (p[1] != '\n') {
+                return -1;
+            }
+            p += 2;
+            break;
+        }
+
+        const char *name = p;
+        for (;;) {
+            p = ops.name(p, end);
+            if (p >= end) {
+                return -1;
+            }
+            if (!s_tables.token[(uint8_t)*p]) {
+                break;
+            }
+            ++p;
+        }
+        if (p == name || *p != ':') {
+            return -1;
+        }
+        size_t nlen = p - name;
+
+        // 值前面的空白不属于值, 行尾之前的都属于值
+        ++p;
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+        const char *value = p;
+        for (;;) {
+            p = ops.value(p, end);
+            if (p >= end) {
+                return -1;
+            }
+            if (*p != '\t') {
+                break;
+            }
+            ++p;
+        }
+        // 下一行以空白开头是折行, 交给 ragel
+        if (*p != '\r' || end - p < 3 || p[1] != '\n' || p[2] == ' ' ||
+            p[2] == '\t') {
+            return -1;
+        }
+        if (count == FAST_MAX_FIELDS) {
+            return -1;
+        }
+        fields[count].name  = name;
+        fields[count].nlen  = nlen;
+        fields[count].value = value;
+        fields[count].vlen  = p - value;
+        ++count;
+        p += 2;
+    }
+
+    // 与 ragel 的回调顺序相同
+    if (parser->request_method) {
+        parser->request_method(parser->data, method, method_len);
+    }
+    if (parser->request_path) {
+        parser->request_path(parser->data, uri,
+                             (query ? query - 1 : uri_end) - uri);
+    }
+    if (query && parser->query_string) {
+        parser->query_string(parser->data, query, uri_end - query);
+    }
+    if (parser->request_uri) {
+        parser->request_uri(parser->data, uri, uri_end - uri);
+    }
+    if (parser->http_version) {
+        parser->http_version(parser->data, version, 8);
+    }
+    if (parser->http_field) {
+        for (size_t i = 0; i < count; ++i) {
+            parser->http_field(parser->data, fields[i].name, fields[i].nlen,
+                               fields[i].value, fields[i].vlen);
+        }
+    }
+    size_t head = p - data;
+    http_parser_set_finished(parser, head);
+    if (parser->header_done) {
+        parser->header_done(parser->data, p, end - p);
+    }
+    return head;
+}
+
+int http_parser_fast_set_isa(int isa)
+{
+    int supported = SupportedIsa();
+    s_isa         = isa < supported ? (isa < 0 ? 0 : isa) : supported;
+    s_ops         = IsaOps(s_isa);
+    return s_isa;
+}
+
+int http_parser_fast_get_isa()
+{
+    return s_isa;
+}
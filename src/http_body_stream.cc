@@ -0,0 +1,331 @@
+#include "http/http_body_stream.hh"
+#include "sylar/log.hh"
+
+#include <algorithm>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+HttpBodyStream::HttpBodyStream(const ReadCallback &cb, bool chunked,
+                               uint64_t content_length)
+    : m_cb(cb), m_chunked(chunked)
+{
+    if (!m_chunked) {
+        m_left     = content_length;
+        m_finished = content_length == 0;
+    }
+}
+
+int HttpBodyStream::read(void *buffer, size_t length)
+{
+    if (m_closed) {
+        return -1;
+    }
+    return readSome(buffer, length);
+}
+
+int HttpBodyStream::readSome(void *buffer, size_t length)
+{
+    if (m_error) {
+        return -1;
+    }
+    if (m_finished || length == 0) {
+        return 0;
+    }
+    if (m_chunked && m_left == 0) {
+        if (!readChunkHead()) {
+            return setError();
+        }
+        if (m_finished) {
+            return 0;
+        }
+    }
+
+    // 不多读, 连接上后面的字节属于下一个 chunk 或下一个消息
+    size_t want = std::min<uint64_t>(std::min<size_t>(length, 1u << 30), m_left);
+    int rt      = m_cb(buffer, want);
+    if (rt <= 0) {
+        return setError();
+    }
+    m_left -= rt;
+    m_readSize += rt;
+    if (m_left == 0) {
+        // chunk 数据后的 CRLF 留到下次读取时处理, 不为它等待网络
+        if (m_chunked) {
+            m_chunkCrlf = true;
+        }
+        else {
+            m_finished = true;
+        }
+    }
+    return rt;
+}
+
+int HttpBodyStream::read(ByteArray::ptr ba, size_t length)
+{
+    std::vector<iovec> iovs;
+    ba->getWriteBuffers(iovs, length);
+    if (iovs.empty()) {
+        return 0;
+    }
+    int rt = read(iovs[0].iov_base, iovs[0].iov_len);
+    if (rt > 0) {
+        ba->setPosition(ba->getPosition() + rt);
+    }
+    return rt;
+}
+
+int HttpBodyStream::write(const void *buffer, size_t length)
+{
+    return -1;
+}
+
+int HttpBodyStream::write(ByteArray::ptr ba, size_t length)
+{
+    return -1;
+}
+
+void HttpBodyStream::close()
+{
+    m_closed = true;
+}
+
+void HttpBodyStream::detach()
+{
+    // 回调绑定了连接的 this, 置空后不会再被调用
+    m_cb    = nullptr;
+    m_error = true;
+}
+
+bool HttpBodyStream::discard(uint64_t max_size)
+{
+    if (!m_chunked && m_left > max_size) {
+        return false;
+    }
+    char buf[4096];
+    uint64_t total = 0;
+    while (true) {
+        int rt = readSome(buf, sizeof(buf));
+        if (rt <= 0) {
+            return rt == 0;
+        }
+        total += rt;
+        if (total > max_size) {
+            return false;
+        }
+    }
+}
+
+bool HttpBodyStream::readAll(std::string &out, uint64_t max_size)
+{
+    size_t begin = out.size();
+    if (!m_chunked) {
+        uint64_t left = m_left;
+        if (m_finished) {
+            return !m_error && !m_closed;
+        }
+        if (left > max_size) {
+            return false;
+        }
+        out.resize(begin + left);
+        if (readFixSize(&out[begin], left) <= 0) {
+            out.resize(begin);
+            return false;
+        }
+        return true;
+    }
+
+    // chunk 数据直接读进 out 的尾部, 不经过临时缓冲
+    size_t size = begin;
+    while (true) {
+        if (out.size() - size < 4096) {
+            out.resize(std::max<size_t>(out.size() * 2, size + 4096));
+        }
+        int rt = read(&out[size], out.size() - size);
+        if (rt == 0) {
+            break;
+        }
+        if (rt < 0 || size + rt - begin > max_size) {
+            out.resize(size);
+            return false;
+        }
+        size += rt;
+    }
+    out.resize(size);
+    return true;
+}
+
+bool HttpBodyStream::readChunkHead()
+{
+    // chunk = chunk-size [ chunk-ext ] CRLF chunk-data CRLF
+    if (m_chunkCrlf) {
+        if (!readLine() || !m_line.empty()) {
+            return false;
+        }
+        m_chunkCrlf = false;
+    }
+    if (!readLine()) {
+        return false;
+    }
+
+    uint64_t size = 0;
+    size_t i      = 0;
+    for (; i < m_line.size(); ++i) {
+        char c = m_line[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        }
+        else {
+            break;
+        }
+        if (size >> 60) {
+            SYLAR_LOG_WARN(g_logger) << "chunk size overflow: " << m_line;
+            return false;
+        }
+        size = (size << 4) | digit;
+    }
+    if (i == 0 || (i < m_line.size() && m_line[i] != ';' && m_line[i] != ' ' &&
+                   m_line[i] != '\t')) {
+        SYLAR_LOG_WARN(g_logger) << "invaild chunk size line: " << m_line;
+        return false;
+    }
+    if (size > 0) {
+        m_left = size;
+        return true;
+    }
+
+    // 结束块之后是 trailer, 以空行结束; trailer 字段不保留
+    do {
+        if (!readLine()) {
+            return false;
+        }
+    } while (!m_line.empty());
+    m_finished = true;
+    return true;
+}
+
+bool HttpBodyStream::readLine()
+{
+    // 会话的回调先从接收缓冲取, 逐字节读不会每次都进内核
+    m_line.clear();
+    char c;
+    while (true) {
+        if (m_cb(&c, 1) <= 0) {
+            return false;
+        }
+        if (c == '\n') {
+            break;
+        }
+        if (m_line.size() >= MAX_CHUNK_LINE) {
+            SYLAR_LOG_WARN(g_logger) << "chunk line too long";
+            return false;
+        }
+        m_line.push_back(c);
+    }
+    if (!m_line.empty() && m_line.back() == '\r') {
+        m_line.pop_back();
+    }
+    return true;
+}
+
+int HttpBodyStream::setError()
+{
+    SYLAR_LOG_DEBUG(g_logger) << "http body stream broken, chunked=" << m_chunked
+                              << " read=" << m_readSize << " left=" << m_left;
+    m_error = true;
+    return -1;
+}
+
+HttpBodyWriter::HttpBodyWriter(const WriteCallback &cb, bool chunked)
+    : m_cb(cb), m_chunked(chunked)
+{}
+
+int HttpBodyWriter::read(void *buffer, size_t length)
+{
+    return -1;
+}
+
+int HttpBodyWriter::read(ByteArray::ptr ba, size_t length)
+{
+    return -1;
+}
+
+int HttpBodyWriter::write(const void *buffer, size_t length)
+{
+    iovec iov;
+    iov.iov_base = (void *)buffer;
+    iov.iov_len  = length;
+    return writeChunk(&iov, 1, length);
+}
+
+int HttpBodyWriter::write(ByteArray::ptr ba, size_t length)
+{
+    std::vector<iovec> iovs;
+    ba->getReadBuffers(iovs, length);
+    int rt = writeChunk(iovs.data(), iovs.size(), length);
+    if (rt > 0) {
+        ba->setPosition(ba->getPosition() + length);
+    }
+    return rt;
+}
+
+int HttpBodyWriter::writeChunk(const iovec *data, size_t count, size_t length)
+{
+    if (m_error || m_closed) {
+        return -1;
+    }
+    // 长度为 0 的 chunk 是结束块, 不能发
+    if (length == 0) {
+        return 0;
+    }
+
+    static const char CRLF[] = "\r\n";
+    char line[32];
+    m_iovs.clear();
+    if (m_chunked) {
+        int n = snprintf(line, sizeof(line), "%" PRIx64 "\r\n", (uint64_t)length);
+        m_iovs.push_back({line, (size_t)n});
+    }
+    m_iovs.insert(m_iovs.end(), data, data + count);
+    if (m_chunked) {
+        m_iovs.push_back({(void *)CRLF, 2});
+    }
+    if (m_cb(m_iovs.data(), m_iovs.size()) <= 0) {
+        m_error = true;
+        return -1;
+    }
+    m_writeSize += length;
+    return (int)std::min<size_t>(length, INT_MAX);
+}
+
+void HttpBodyWriter::close()
+{
+    if (m_closed) {
+        return;
+    }
+    m_closed = true;
+    if (m_chunked && !m_error) {
+        // 结束块, 不带 trailer
+        iovec iov;
+        iov.iov_base = (void *)"0\r\n\r\n";
+        iov.iov_len  = 5;
+        if (m_cb(&iov, 1) <= 0) {
+            m_error = true;
+        }
+    }
+}
+
+} // namespace http
+} // namespace sylar
@@ -4,6 +4,8 @@
 #include "sylar/hook.hh"
 #include "sylar/log.hh"
 
+#include <functional>
+
 namespace sylar {
 
 namespace http {
@@ -25,224 +27,116 @@ HttpConnection::HttpConnection(Socket::ptr sock, bool owner)
 
 HttpConnection::~HttpConnection() {
     SYLAR_LOG_DEBUG(g_logger) << "HttpConnection::~HttpConnection";
+    // 响应持有的消息体流可能比连接活得久, 不能再回调到已析构的连接
+    if (m_bodyStream) {
+        m_bodyStream->detach();
+    }
 }
 
 HttpResponse::ptr HttpConnection::recvResponse() {
-    HttpResponseParser::ptr parser(new HttpResponseParser);
-    uint64_t response_buffer_size =
-        HttpResponseParser::GetHttpResponseBufferSize();
-    // uint64_t response_buffer_size = 100;
-
-    std::shared_ptr<char> buffer(new char[response_buffer_size + 1],
-                                 [](char *ptr) { delete[] ptr; });
-
-    char *data = buffer.get();
-    int unparsed_offset = 0; // 已经解析的数据, 或者说未解析数据的位置
-    // 接受并解析头部字段
-    do {
-        int current_read_size = read(data + unparsed_offset,
-                                     response_buffer_size - unparsed_offset);
-        if (current_read_size <= 0) {
-            close();
-            return nullptr;
-        }
-        current_read_size += unparsed_offset;
+    HttpResponse::ptr rsp = recvResponseHead();
+    if (!rsp) {
+        return nullptr;
+    }
+    HttpBodyStream::ptr stream = m_bodyStream;
+    rsp->setBodyStream(nullptr);
+
+    // 整个响应体读进内存, 受 http.response.max_body_size 限制;
+    // 更大的响应体用 recvResponseHead 按需读取
+    std::string body;
+    if (!stream->readAll(body,
+                         HttpResponseParser::GetHttpResponseMaxBodySize())) {
+        SYLAR_LOG_WARN(g_logger)
+            << "recvResponse body broken or too large, chunked="
+            << stream->isChunked() << " read=" << stream->getReadSize();
+        close();
+        return nullptr;
+    }
+    rsp->setBody(std::move(body));
+    return rsp;
+}
 
-        data[current_read_size] = '\0';
+HttpResponse::ptr HttpConnection::recvResponseHead() {
+    // 多留一个字节: 响应解析器要求输入以 '\0' 结尾
+    uint64_t buffer_size = HttpResponseParser::GetHttpResponseBufferSize();
+    if (m_recvBuf.size() < buffer_size + 1) {
+        m_recvBuf.resize(buffer_size + 1);
+    }
+    size_t capacity = m_recvBuf.size() - 1;
+    if (m_bodyStream) {
+        // 上一个响应的响应体流与接收缓冲脱离, 之后 discard 也不再读连接
+        m_bodyStream->detach();
+        m_bodyStream.reset();
+    }
 
-        size_t nparser = parser->execute(data, current_read_size, false);
-        if (parser->hasError()) {
-            close();
-            return nullptr;
+    HttpResponseParser::ptr parser(new HttpResponseParser);
+    bool need_read = m_recvBegin == m_recvEnd;
+    while (true) {
+        if (need_read) {
+            if (m_recvEnd == capacity) {
+                if (m_recvBegin == 0) {
+                    // 响应头占满了整个缓冲, 数据过大
+                    close();
+                    return nullptr;
+                }
+                memmove(&m_recvBuf[0], &m_recvBuf[m_recvBegin],
+                        m_recvEnd - m_recvBegin);
+                m_recvEnd -= m_recvBegin;
+                m_recvBegin = 0;
+            }
+            int read_size = read(&m_recvBuf[m_recvEnd], capacity - m_recvEnd);
+            if (read_size <= 0) {
+                close();
+                return nullptr;
+            }
+            m_recvEnd += read_size;
         }
 
-        unparsed_offset = current_read_size - nparser;
-        if (unparsed_offset == (int)response_buffer_size) {
-            // 首次请求解析的数据等于当前的 response_buffer_size,
-            // 那么说明是恶意请求, 数据过大
+        m_recvBuf[m_recvEnd] = '\0';
+        size_t len     = m_recvEnd - m_recvBegin;
+        size_t nparser = parser->execute(&m_recvBuf[m_recvBegin], len, false);
+        if (parser->hasError()) {
             close();
             return nullptr;
         }
-
         if (parser->isFinished()) {
+            // execute 已把响应头之后的字节挪到 m_recvBegin 处
+            m_recvEnd = m_recvBegin + len - nparser;
             break;
         }
-    } while (true);
-
-    auto &client_parser = parser->getParser();
-    if (client_parser.chunked) {
-        // 是否是 chunked body, chunk 还有一个小型头, 即长度+数据的形式
-        std::string body;
-        int unparsed_index = unparsed_offset;
-        // 分块传输
-        do {
-            // 通过 do-while 读取 chunk data 的长度头, 避免传输时的分段的行为,
-            // 因为状态检测依靠一个完整的模式才能表示状态检测结束
-            do {
-                int read_size = read(data + unparsed_index,
-                                     response_buffer_size - unparsed_index);
-                if (read_size <= 0) {
-                    close();
-                    return nullptr;
-                }
-                unparsed_index += read_size;
-
-                // chunk 的长度, 需要分段读的情况下, 需要手动添加末尾结束符
-                data[unparsed_index] = '\0';
 
-                // 第三个参数为 true, 即使用 chunk, 每次读取都需要重新 init
-                size_t nparse = parser->execute(data, unparsed_index, true);
-                if (parser->hasError()) {
-                    close();
-                    return nullptr;
-                }
-                unparsed_index -= nparse;
-                if (unparsed_index == (int)response_buffer_size) {
-                    close();
-                    return nullptr;
-                }
-            } while (!parser->isFinished());
-
-            int64_t chunk_size = client_parser.content_len;
-            // 最后一个chunk(大小为0)的话
-            if (chunk_size == 0) {
-                if (unparsed_index >= 2) {
-                    unparsed_index -= 2;
-                    if (unparsed_index > 0) {
-                        memmove(data, data + 2, unparsed_index);
-                    }
-                }
-                break;
-            }
-            int64_t need = chunk_size;
-            if (unparsed_index > 0) {
-                size_t take = std::min((size_t)unparsed_index, (size_t)need);
-                body.append(data, take);
-
-                need -= take;
-                unparsed_index -= take;
-
-                // 移动缓冲区
-                if (unparsed_index > 0) {
-                    memmove(data, data + take, unparsed_index);
-                }
-            }
-
-            // 如果chunk_data不完整,即还需要更多数据
-            if (need > 0) {
-                // 从socket读取剩余数据
-                std::vector<char> temp(need);
-                if (readFixSize(temp.data(), need) <= 0) {
-                    close();
-                    return nullptr;
-                }
-                body.append(temp.data(), need);
-            }
-
-            // === 跳过数据体后的CRLF ===
-            // 注意:此时缓冲区中可能是下一个chunk的头部
-            // 我们需要读取并丢弃2字节的CRLF
-            char crlf[2];
-            if (readFixSize(crlf, 2) <= 0) {
-                close();
-                return nullptr;
-            }
-            // －－－
-
-            // // chunk 部分中: 4\r\nWiki\r\n7\r\nabdcefg\r\n
-            // //  每个 chunk 的数据后面都有 CRLF (\r\n)
-            // //  减去 2 表示 去掉 chunk data 末尾的 CRLF, 准备拼接到 body
-            // unparsed_index -= 2;
-
-            // SYLAR_LOG_INFO(g_logger)
-            //     << "client_content-len=" << client_parser.content_len;
-
-            // // 每个 chunked 段的实际大小: 长度头 + 实际的数据体
-            // if (client_parser.content_len <= unparsed_index) {
-            //     // 在解析时, 头部字段内容已经被消耗, 追加前 conten_len 个
-            //     body.append(data, client_parser.content_len);
-
-            //     // 消耗掉读取的 chunk data
-            //     unparsed_index -= client_parser.content_len;
-            //     memmove(data, data + client_parser.content_len,
-            //     unparsed_index);
-
-            // }
-            // else {
-            //     // 只读取固定前长度
-            //     body.append(data, unparsed_index);
-            //     int left = client_parser.content_len - unparsed_index;
-            //     while (left > 0) {
-            //         int read_size = read(data, left >
-            //         (int)response_buffer_size
-            //                                        ?
-            //                                        (int)response_buffer_size
-            //                                        : left);
-            //         if (read_size <= 0) {
-            //             close();
-            //             return nullptr;
-            //         }
-            //         body.append(data, read_size);
-            //         left -= read_size;
-            //     }
-            //     unparsed_index = 0;
-            // }
-        } while (!client_parser.chunks_done);
-        parser->getData()->setBody(body);
-    } else { // 非chunk类型的话，直接读取
-        int64_t content_size = parser->getContentLength();
-        if (content_size > 0) {
-
-            std::string body;
-            int need = content_size;
-            int take = std::min(need, unparsed_offset);
-
-            body.resize(content_size);
-            if (take) {
-                memcpy(&body[0], data, take);
-            }
+        // 响应头跨越了多次读取, 读到更多数据后从头重新解析
+        parser.reset(new HttpResponseParser);
+        need_read = true;
+    }
 
-            // body.reserve(content_size);
-            // body.append(data, take);
+    HttpResponse::ptr rsp = parser->getData();
+    m_bodyStream.reset(new HttpBodyStream(
+        std::bind(&HttpConnection::readBody, this, std::placeholders::_1,
+                  std::placeholders::_2),
+        parser->getParser().chunked, parser->getContentLength()));
+    rsp->setBodyStream(m_bodyStream);
+    return rsp;
+}
 
-            need -= take;
-            if (need) {
-                if (readFixSize(&body[take], need) <= 0) {
-                    close();
-                    return nullptr;
-                }
-            }
-            parser->getData()->setBody(body);
-
-            // int len = 0;
-            // if (content_size >= unparsed_offset) {
-            //     memcpy(&body[0], data, unparsed_offset);
-            //     len = unparsed_offset;
-            // }
-            // else {
-            //     memcpy(&body[0], data, content_size);
-            //     // 缓冲区中的未解析数据比 content_size 还大
-            //     // 说明缓冲区里的数据已经能把整个 body 填满,
-            //     // 即还存其他的请求数据 因此本次请求解析只需要读取
-            //     content_size
-            //     // 个数据即可
-            //     len = content_size;
-            // }
-            // content_size -= unparsed_offset;
-
-            // if (content_size > 0) {
-            //     // 如果还未读取完毕请求体的话, 接下来读取剩下的请求体
-            //     if (readFixSize(&body[len], content_size) <= 0) {
-            //         close();
-            //         return nullptr;
-            //     }
-            // }
-            // parser->getData()->setBody(body);
-        } else if (content_size == 0) {
-            parser->getData()->setBody("");
+int HttpConnection::readBody(void *buffer, size_t length) {
+    if (m_recvBegin == m_recvEnd) {
+        m_recvBegin = m_recvEnd = 0;
+        // 大块直接读进调用者的内存, 小块先读满接收缓冲, 留出结尾的 '\0'
+        size_t capacity = m_recvBuf.size() - 1;
+        if (length >= capacity) {
+            return read(buffer, length);
+        }
+        int rt = read(&m_recvBuf[0], capacity);
+        if (rt <= 0) {
+            return rt;
         }
+        m_recvEnd = rt;
     }
-    return parser->getData();
+    size_t take = std::min(length, m_recvEnd - m_recvBegin);
+    memcpy(buffer, &m_recvBuf[m_recvBegin], take);
+    m_recvBegin += take;
+    return take;
 }
 
 int HttpConnection::sendRequest(HttpRequest::ptr rsp) {
@@ -1,4 +1,5 @@
 #include "http/http_parser.hh"
+#include "http/http11_fast_parser.hh"
 #include "sylar/log.hh"
 #include "sylar/config.hh"
 #include <string>
@@ -20,8 +21,14 @@ namespace http {
 							  (uint64_t)(64* 1024 * 1024),
 							  "http request max body size");
 
+	// 常见请求先走快速解析, 不符合时再交给 ragel
+	static sylar::ConfigVar<bool>::ptr g_http_request_fast_parser =
+		sylar::Config::Lookup("http.request.fast_parser", true,
+							  "http request fast path parser");
+
 	static uint64_t s_http_request_buffer_size = 0;
 	static uint64_t s_http_request_max_body_size = 0;
+	static bool s_http_request_fast_parser = true;
 
   // 静态初始化为 4k
 	static sylar::ConfigVar<uint64_t>::ptr g_http_response_buffer_size =
@@ -42,6 +49,7 @@ namespace http {
 		_RequestSizeIniter() {
 			s_http_request_buffer_size = g_http_request_buffer_size->getValue();
 			s_http_request_max_body_size = g_http_request_max_body_size->getValue();
+			s_http_request_fast_parser = g_http_request_fast_parser->getValue();
 
 			s_http_response_buffer_size = g_http_response_buffer_size->getValue();
 			s_http_response_max_body_size = g_http_response_max_body_size->getValue();
@@ -56,6 +64,11 @@ namespace http {
 				s_http_request_max_body_size = nv;
 			});
 
+			g_http_request_fast_parser->addListener([](const bool &ov,
+													   const bool &nv){
+				s_http_request_fast_parser = nv;
+			});
+
 			g_http_response_buffer_size->addListener([](const uint64_t&ov,
 													   const uint64_t nv){
 				s_http_response_buffer_size = nv;
@@ -138,7 +151,8 @@ namespace http {
 	}
 
 	HttpRequestParser::HttpRequestParser()
-		:m_error(0) {
+		:m_error(0)
+		,m_started(false) {
 		m_data.reset(new sylar::http::HttpRequest);
 		http_parser_init(&m_parser);
 		m_parser.request_method = on_request_method;
@@ -156,9 +170,30 @@ namespace http {
 		return m_data->getHeaderAs<uint64_t>("content-length", 0);
 	}
 
-	size_t HttpRequestParser::execute(char* data, size_t len) {
-		size_t offset = http_parser_execute(&m_parser, data, len, 0);
-		memmove(data, data+offset, (len-offset));
+	void HttpRequestParser::reset() {
+		m_error = 0;
+		m_started = false;
+		m_data.reset(new sylar::http::HttpRequest);
+		// http_parser_init 不会改动回调和 data
+		http_parser_init(&m_parser);
+	}
+
+	size_t HttpRequestParser::execute(char* data, size_t len, bool move) {
+		size_t offset = 0;
+		ssize_t fast = -1;
+		// 快速解析只能从请求的第一个字节开始
+		if(!m_started && s_http_request_fast_parser) {
+			fast = http_parser_fast_execute(&m_parser, data, len);
+		}
+		m_started = true;
+		if(fast > 0) {
+			offset = fast;
+		} else {
+			offset = http_parser_execute(&m_parser, data, len, 0);
+		}
+		if(move) {
+			memmove(data, data+offset, (len-offset));
+		}
 		return offset;
 	}
 
@@ -267,6 +302,11 @@ namespace http {
 		return s_http_request_max_body_size;
 	}
 
+	bool HttpRequestParser::IsFastParserEnabled()
+	{
+		return s_http_request_fast_parser;
+	}
+
 	uint64_t HttpResponseParser::GetHttpResponseBufferSize()
 	{
 		return s_http_response_buffer_size;
@@ -0,0 +1,204 @@
+#include "http/http_request_view.hh"
+#include "http/http11_fast_parser.hh"
+#include "http/http_parser.hh"
+#include "sylar/log.hh"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+HttpRequestView::HttpRequestView()
+    : m_method(HttpMethod::GET), m_version(0x11), m_path("/")
+{
+    // 常见浏览器请求在 20 个头部以内
+    m_headers.reserve(24);
+}
+
+void HttpRequestView::clear()
+{
+    m_method   = HttpMethod::GET;
+    m_version  = 0x11;
+    m_path     = StringView("/");
+    m_query    = StringView();
+    m_fragment = StringView();
+    m_body     = StringView();
+    m_headers.clear();
+    m_close    = false;
+}
+
+bool HttpRequestView::isClose() const
+{
+    return m_close || !getHeader("connection").equalsIgnoreCase("keep-alive");
+}
+
+uint32_t HttpRequestView::HashName(const char *name, size_t len)
+{
+    // FNV-1a, 字母统一成小写; 其他字符 | 0x20 后可能相撞, 查找时还会比较原文
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)(name[i] | 0x20);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void HttpRequestView::addHeader(const StringView &name, const StringView &value)
+{
+    Header header;
+    header.hash  = HashName(name.data(), name.size());
+    header.name  = name;
+    header.value = value;
+    m_headers.push_back(header);
+}
+
+bool HttpRequestView::findHeader(const StringView &name, StringView &value) const
+{
+    uint32_t hash = HashName(name.data(), name.size());
+    for (auto &i : m_headers) {
+        if (i.hash == hash && i.name.equalsIgnoreCase(name)) {
+            value = i.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+StringView HttpRequestView::getHeader(const StringView &name,
+                                      const StringView &def) const
+{
+    StringView v;
+    return findHeader(name, v) ? v : def;
+}
+
+HttpRequest::ptr HttpRequestView::toRequest(bool body) const
+{
+    HttpRequest::ptr req(new HttpRequest(m_version, isClose()));
+    req->setMethod(m_method);
+    req->setPath(m_path.toString());
+    req->setQuery(m_query.toString());
+    req->setFragment(m_fragment.toString());
+    for (auto &i : m_headers) {
+        req->setHeader(i.name.toString(), i.value.toString());
+    }
+    if (body && !m_body.empty()) {
+        req->setBody(m_body.toString());
+    }
+    return req;
+}
+
+static void on_view_method(void *data, const char *at, size_t length)
+{
+    HttpRequestViewParser *parser = static_cast<HttpRequestViewParser *>(data);
+    HttpMethod m = CharsToHttpMethod(at);
+    if (m == HttpMethod::INVAILD_METHOD) {
+        SYLAR_LOG_WARN(g_logger)
+            << "invaild http request  method: " << std::string(at, length);
+        parser->setError(1000);
+        return;
+    }
+    parser->getView()->setMethod(m);
+}
+
+static void on_view_uri(void *data, const char *at, size_t length) {}
+
+static void on_view_fragment(void *data, const char *at, size_t length)
+{
+    HttpRequestViewParser *parser = static_cast<HttpRequestViewParser *>(data);
+    parser->getView()->setFragment(StringView(at, length));
+}
+
+static void on_view_path(void *data, const char *at, size_t length)
+{
+    HttpRequestViewParser *parser = static_cast<HttpRequestViewParser *>(data);
+    parser->getView()->setPath(StringView(at, length));
+}
+
+static void on_view_query(void *data, const char *at, size_t length)
+{
+    HttpRequestViewParser *parser = static_cast<HttpRequestViewParser *>(data);
+    parser->getView()->setQuery(StringView(at, length));
+}
+
+static void on_view_version(void *data, const char *at, size_t length)
+{
+    HttpRequestViewParser *parser = static_cast<HttpRequestViewParser *>(data);
+    uint8_t v = 0;
+    if (strncmp(at, "HTTP/1.1", length) == 0) {
+        v = 0x11;
+    }
+    else if (strncmp(at, "HTTP/1.0", length) == 0) {
+        v = 0x10;
+    }
+    else {
+        SYLAR_LOG_WARN(g_logger)
+            << "invaild http request version: " << std::string(at, length);
+        parser->setError(1001);
+        return;
+    }
+    parser->getView()->setVersion(v);
+}
+
+static void on_view_header_done(void *data, const char *at, size_t length) {}
+
+static void on_view_http_field(void *data, const char *field, size_t flen,
+                               const char *value, size_t vlen)
+{
+    HttpRequestViewParser *parser = static_cast<HttpRequestViewParser *>(data);
+    if (flen == 0) {
+        SYLAR_LOG_WARN(g_logger) << "invaild http request field lenght ==0";
+        return;
+    }
+    parser->getView()->addHeader(StringView(field, flen),
+                                 StringView(value, vlen));
+}
+
+HttpRequestViewParser::HttpRequestViewParser(HttpRequestView *view)
+    : m_view(view), m_error(0), m_started(false)
+{
+    http_parser_init(&m_parser);
+    m_parser.request_method = on_view_method;
+    m_parser.request_uri    = on_view_uri;
+    m_parser.fragment       = on_view_fragment;
+    m_parser.request_path   = on_view_path;
+    m_parser.query_string   = on_view_query;
+    m_parser.http_version   = on_view_version;
+    m_parser.header_done    = on_view_header_done;
+    m_parser.http_field     = on_view_http_field;
+    m_parser.data           = this;
+}
+
+void HttpRequestViewParser::reset()
+{
+    m_error   = 0;
+    m_started = false;
+    m_view->clear();
+    http_parser_init(&m_parser);
+}
+
+size_t HttpRequestViewParser::execute(const char *data, size_t len)
+{
+    // 快速解析只能从请求的第一个字节开始
+    bool first = !m_started;
+    m_started  = true;
+    if (first && HttpRequestParser::IsFastParserEnabled()) {
+        ssize_t rt = http_parser_fast_execute(&m_parser, data, len);
+        if (rt > 0) {
+            return rt;
+        }
+    }
+    return http_parser_execute(&m_parser, data, len, 0);
+}
+
+int HttpRequestViewParser::isFinished()
+{
+    return http_parser_finish(&m_parser);
+}
+
+int HttpRequestViewParser::hasError()
+{
+    return m_error || http_parser_has_error(&m_parser);
+}
+
+} // namespace http
+} // namespace sylar
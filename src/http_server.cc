@@ -19,7 +19,8 @@ void HttpServer::handleClient(Socket::ptr client)
 {
 	HttpSession::ptr session(new HttpSession(client));
 	do {
-		auto req = session->recvRequest();
+		auto req = m_streamBody ? session->recvRequestHead()
+								: session->recvRequest();
 		if(!req) {
 			SYLAR_LOG_DEBUG(g_logger) << "recv http request fail,"
 				" errno=" << errno << " errstr=" << strerror(errno)
@@ -34,9 +35,16 @@ void HttpServer::handleClient(Socket::ptr client)
 		rsp->setHeader("Server", getName());
 		m_dispatcher->handle(req, rsp, session);
 
-		session->sendResponse(rsp);
+		// 处理函数没读完的请求体还在连接上, 丢弃不了就不能再读下一个请求
+		if(!session->skipRequestBody()) {
+			rsp->setClose(true);
+		}
+		// 生成的响应体发送失败时响应不完整, 连接不能复用
+		if(session->sendResponse(rsp) <= 0) {
+			break;
+		}
 
-		if(!m_isKeepAlive || req->isClose()) {
+		if(!m_isKeepAlive || req->isClose() || rsp->isClose()) {
 				break;
 		}
 	} while(m_isKeepAlive);
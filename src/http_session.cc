@@ -2,136 +2,437 @@
 #include "http/http_parser.hh"
 #include "http/socketstream.hh"
 #include "sylar/hook.hh"
+#include "sylar/log.hh"
+
+#include <functional>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 
 namespace sylar {
 
 namespace http {
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
 HttpSession::HttpSession(Socket::ptr sock, bool owner)
-    : SocketStream(sock, owner)
+    : SocketStream(sock, owner), m_viewParser(&m_view)
 {}
 
+HttpSession::~HttpSession()
+{
+    // 请求持有的消息体流可能比会话活得久, 不能再回调到已析构的会话
+    if (m_bodyStream) {
+        m_bodyStream->detach();
+    }
+}
+
+// 解析时不移动缓冲中的数据, 由 recvHead 跳过已解析的长度
+static size_t ExecuteParser(HttpRequestParser &parser, char *data, size_t len)
+{
+    return parser.execute(data, len, false);
+}
+
+static size_t ExecuteParser(HttpRequestViewParser &parser, char *data,
+                            size_t len)
+{
+    return parser.execute(data, len);
+}
+
+/**
+ * @brief 由 Transfer-Encoding 决定请求体的分帧, 它优先于 Content-Length
+ * @return 0 按 Content-Length, 1 chunked, -1 最后一个编码不是 chunked, 无法确定长度
+ */
+static int BodyFraming(const char *te, size_t len)
+{
+    while (len > 0 && (te[len - 1] == ' ' || te[len - 1] == '\t')) {
+        --len;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    static const size_t n = sizeof("chunked") - 1;
+    if (len < n || strncasecmp(te + len - n, "chunked", n) != 0) {
+        return -1;
+    }
+    if (len > n && te[len - n - 1] != ',' && te[len - n - 1] != ' ' &&
+        te[len - n - 1] != '\t') {
+        return -1;
+    }
+    return 1;
+}
+
 HttpRequest::ptr HttpSession::recvRequest()
 {
-    HttpRequestParser::ptr parser(new HttpRequestParser);
-    uint64_t buffer_size = HttpRequestParser::GetHttpRequestBufferSize();
+    // 拷贝字段的解析器比先解析成视图再 toRequest 少一次遍历
+    if (!recvHead(m_parser)) {
+        return nullptr;
+    }
+    HttpRequest::ptr req = m_parser.getData();
+    std::string te       = req->getHeader("Transfer-Encoding");
+    int framing          = BodyFraming(te.data(), te.size());
+    StringView body;
+    if (!recvBody(m_parser.getContentLength(), framing, body)) {
+        return nullptr;
+    }
+    if (!body.empty()) {
+        if (body.data() == m_body.data()) {
+            req->setBody(std::move(m_body));
+        }
+        else {
+            req->setBody(body.toString());
+        }
+    }
 
-    std::shared_ptr<char> buffer(new char[buffer_size],
-                                 [](char *ptr) { delete[] ptr; });
+    // 增加对长连接的设置
+    std::string keep_alive = req->getHeader("Connection");
+    if (!strcasecmp(keep_alive.c_str(), "keep-alive")) {
+        req->setClose(false);
+    }
+    if (framing == 1 && req->hasHeader("Content-Length")) {
+        // 两个字段同时出现时前后的代理可能按不同的分帧理解, 响应后不再复用连接
+        req->setClose(true);
+    }
+    m_headRequest = req->getMethod() == HttpMethod::HEAD;
+    return req;
+}
 
-    char *data          = buffer.get();
-    int unparsed_offset = 0;
-    do {
-				// [请求行 + 请求头][请求体][下一个请求行 + 请求头 + ...]
-				// unparsed_offset 表示本次read过程中没有解析的偏移
-				// content-size 表示本次数据包中的 数据体的大小
+const HttpRequestView *HttpSession::recvRequestView()
+{
+    if (!recvHead(m_viewParser)) {
+        return nullptr;
+    }
+    StringView te = m_view.getHeader("Transfer-Encoding");
+    int framing   = BodyFraming(te.data(), te.size());
+    StringView body;
+    if (!recvBody(m_viewParser.getContentLength(), framing, body)) {
+        return nullptr;
+    }
+    m_view.setBody(body);
+    if (framing == 1 && m_view.hasHeader("Content-Length")) {
+        // 同 recvRequest, chunked 优先, 响应后关闭连接
+        m_view.setClose(true);
+    }
+    m_headRequest = m_view.getMethod() == HttpMethod::HEAD;
+    return &m_view;
+}
 
-        // 获取数据
-        int read_size =
-            read(data + unparsed_offset, buffer_size - unparsed_offset);
-        if (read_size <= 0) {
-            close();
-            return nullptr;
+HttpRequest::ptr HttpSession::recvRequestHead()
+{
+    if (!recvHead(m_parser)) {
+        return nullptr;
+    }
+    HttpRequest::ptr req = m_parser.getData();
+    std::string te       = req->getHeader("Transfer-Encoding");
+    int framing          = BodyFraming(te.data(), te.size());
+    if (framing < 0) {
+        SYLAR_LOG_WARN(g_logger)
+            << "recvRequest unsupported transfer-encoding: " << te;
+        close();
+        return nullptr;
+    }
+    m_bodyStream.reset(new HttpBodyStream(
+        std::bind(&HttpSession::readBody, this, std::placeholders::_1,
+                  std::placeholders::_2),
+        framing == 1, m_parser.getContentLength()));
+    req->setBodyStream(m_bodyStream);
+
+    std::string keep_alive = req->getHeader("Connection");
+    if (!strcasecmp(keep_alive.c_str(), "keep-alive")) {
+        req->setClose(false);
+    }
+    if (framing == 1 && req->hasHeader("Content-Length")) {
+        // 同 recvRequest, chunked 优先, 响应后关闭连接
+        req->setClose(true);
+    }
+    m_headRequest = req->getMethod() == HttpMethod::HEAD;
+    return req;
+}
+
+bool HttpSession::skipRequestBody()
+{
+    if (!m_bodyStream || m_bodyStream->isFinished()) {
+        return true;
+    }
+    return m_bodyStream->discard(HttpRequestParser::GetHttpRequestBufferSize());
+}
+
+template <class Parser> bool HttpSession::recvHead(Parser &parser)
+{
+    // [请求行 + 请求头][请求体][下一个请求行 + 请求头 + ...]
+    // [m_recvBegin, m_recvEnd) 是已读入还未处理的数据,
+    // 处理完当前请求后剩下的就是管线化的下一个请求
+    uint64_t buffer_size = HttpRequestParser::GetHttpRequestBufferSize();
+    if (m_recvBuf.size() < buffer_size) {
+        // 缓冲只增不减, 配置调大后从下一个请求开始生效
+        m_recvBuf.resize(buffer_size);
+    }
+    parser.reset();
+    if (m_bodyStream) {
+        // 上一个请求的请求体流与接收缓冲脱离, 之后 discard 也不再读连接
+        m_bodyStream->detach();
+        m_bodyStream.reset();
+    }
+
+    // 缓冲中剩余的字节可能已经包含完整的请求头, 先解析再读
+    bool need_read = m_recvBegin == m_recvEnd;
+    while (true) {
+        if (need_read) {
+            if (m_recvEnd == m_recvBuf.size()) {
+                if (m_recvBegin == 0) {
+                    // 请求头占满了整个缓冲, 说明是恶意请求, 数据过大
+                    close();
+                    return false;
+                }
+                // 只在缓冲尾部用完时把未处理的数据挪到头部
+                memmove(&m_recvBuf[0], &m_recvBuf[m_recvBegin],
+                        m_recvEnd - m_recvBegin);
+                m_recvEnd -= m_recvBegin;
+                m_recvBegin = 0;
+            }
+            int read_size =
+                read(&m_recvBuf[m_recvEnd], m_recvBuf.size() - m_recvEnd);
+            if (read_size <= 0) {
+                close();
+                return false;
+            }
+            m_recvEnd += read_size;
         }
-        read_size += unparsed_offset;
 
-        // 解析数据
-        size_t nparser = parser->execute(data, read_size);
-        if (parser->hasError()) {
+        size_t nparser = ExecuteParser(parser, &m_recvBuf[m_recvBegin],
+                                       m_recvEnd - m_recvBegin);
+        if (parser.hasError()) {
             close();
-            return nullptr;
+            return false;
         }
+        if (parser.isFinished()) {
+            m_recvBegin += nparser;
+            return true;
+        }
+
+        // 请求头跨越了多次读取: 解析器记录的字段偏移只对本次输入有效,
+        // 保留整个请求头, 读到更多数据后从头重新解析
+        parser.reset();
+        need_read = true;
+    }
+}
 
-        // 本轮中读到的数据 - 已经解析的数据,这也就对读到数据的一个偏移
-        unparsed_offset = read_size - nparser;
-        if (unparsed_offset == (int)buffer_size) {
-            // 首次请求解析的数据等于当前的 buffer_size, 那么说明是恶意请求,
-            // 数据过大
+bool HttpSession::recvBody(uint64_t content_size, int framing, StringView &body)
+{
+    m_body.clear();
+    if (framing < 0) {
+        SYLAR_LOG_WARN(g_logger) << "recvRequest unsupported transfer-encoding";
+        close();
+        return false;
+    }
+    if (framing == 1) {
+        // 解码时可能还要读 socket, 不能覆盖缓冲中视图指向的请求头
+        m_recvFloor = m_recvBegin;
+        HttpBodyStream stream(std::bind(&HttpSession::readBody, this,
+                                        std::placeholders::_1,
+                                        std::placeholders::_2),
+                              true);
+        bool ok = stream.readAll(
+            m_body, HttpRequestParser::GetHttpRequestMaxBodySize());
+        m_recvFloor = 0;
+        if (!ok) {
+            SYLAR_LOG_WARN(g_logger)
+                << "recvRequest chunked body broken or too large, read="
+                << stream.getReadSize();
             close();
-            return nullptr;
+            return false;
         }
+        body = StringView(m_body);
+    }
+    else if (content_size > HttpRequestParser::GetHttpRequestMaxBodySize()) {
+        SYLAR_LOG_WARN(g_logger) << "recvRequest body too large content-length="
+                                 << content_size;
+        close();
+        return false;
+    }
+    else if (content_size > 0) {
+        // 缓冲中可能已有部分或全部请求体, 只取 content_size 那么多,
+        // 后面的字节属于下一个请求
+        size_t take = std::min<uint64_t>(m_recvEnd - m_recvBegin, content_size);
+        if (take == content_size) {
+            body = StringView(&m_recvBuf[m_recvBegin], take);
+        }
+        else {
+            // 剩余的请求体直接读进 m_body, 不经过接收缓冲
+            m_body.resize(content_size);
+            memcpy(&m_body[0], &m_recvBuf[m_recvBegin], take);
+            if (readFixSize(&m_body[take], content_size - take) <= 0) {
+                close();
+                return false;
+            }
+            body = StringView(m_body);
+        }
+        m_recvBegin += take;
+    }
+    // 视图可能指向缓冲, 游标归零不会移动数据
+    if (m_recvBegin == m_recvEnd) {
+        m_recvBegin = m_recvEnd = 0;
+    }
+    return true;
+}
 
-        if (parser->isFinished()) {
-            // 解析完成后, 退出循环
-            break;
+int HttpSession::readBody(void *buffer, size_t length)
+{
+    if (m_recvBegin == m_recvEnd) {
+        m_recvBegin = m_recvEnd = m_recvFloor;
+        // 大块直接读进调用者的内存; 小块(如 chunk 的长度行)先读满接收缓冲,
+        // 多读到的下一个请求留在缓冲中
+        size_t capacity = m_recvBuf.size() - m_recvFloor;
+        if (length >= capacity) {
+            return read(buffer, length);
+        }
+        int rt = read(&m_recvBuf[m_recvFloor], capacity);
+        if (rt <= 0) {
+            return rt;
         }
-    } while (true);
+        m_recvEnd += rt;
+    }
+    size_t take = std::min(length, m_recvEnd - m_recvBegin);
+    memcpy(buffer, &m_recvBuf[m_recvBegin], take);
+    m_recvBegin += take;
+    return take;
+}
 
-    int64_t content_size = parser->getContentLength();
-    if (content_size > 0) {
-        std::string body;
+int HttpSession::sendResponse(HttpResponse::ptr rsp)
+{
+    if (rsp->getBodyProducer()) {
+        return sendProducedBody(rsp);
+    }
 
-#if 1
-        body.reserve(content_size);
-        size_t already_use = 0;
-        if ((int64_t)unparsed_offset > 0) {
+    m_head.clear();
+    rsp->dumpHead(m_head);
 
-            // 这里只能拷贝正文长度那么多
-            // unparsed_offset 可能大于正文长度(后面跟着下一个请求的起始)
+    const HttpFileBody::ptr &file = rsp->getBodyFile();
+    const std::string &body       = rsp->getBody();
 
-						// 这里通过min((size_t)unparsed_offset,(size_t)content_size)
-						// 不能多取 → 不要把下一请求的数据当成当前请求体,只取 content_size
-						// 不能少取 → 如果请求体还没读完,就先把已收到的部分放进 body,只取 unparsed_offset
-            size_t take =
-                std::min((size_t)unparsed_offset, (size_t)content_size);
-            body.append(data, take);
-            already_use = take;
-        }
+    iovec iov[2];
+    iov[0].iov_base = (void *)m_head.data();
+    iov[0].iov_len  = m_head.size();
+    iov[1].iov_base = (void *)body.data();
+    iov[1].iov_len  = body.size();
 
-				// 手动读取剩余的请求体数据: content_size - take
-        size_t need = (size_t)content_size - already_use;
-        if (need > 0) {
-            size_t old = body.size();
-            body.resize(old + need); // 先扩大 size
-            if (readFixSize(&body[old], need) <= 0) {
-                close();
-                return nullptr;
-            }
+    if (!file || file->length == 0) {
+        return sendFixSize(iov, body.empty() ? 1 : 2);
+    }
+
+    // 小文件读到响应头后面一起发送, 比 sendmsg + sendfile 少一次系统调用的开销
+    if (file->length <= SMALL_FILE_SIZE) {
+        size_t head = m_head.size();
+        m_head.resize(head + file->length);
+        ssize_t n = pread(file->fd, &m_head[head], file->length, file->offset);
+        if (n != (ssize_t)file->length) {
+            SYLAR_LOG_ERROR(g_logger)
+                << "sendResponse read file failed fd=" << file->fd
+                << " rt=" << n << " errno=" << errno;
+            return -1;
         }
-#endif
-
-#if 0
-		body.resize(content_size);
-		int len = 0;
-		if(content_size >= unparsed_offset) {
-			memcpy(&body[0], data, unparsed_offset);
-			len = unparsed_offset;
-		}
-		else {
-			memcpy(&body[0], data, content_size);
-		  // 缓冲区中的未解析数据比 content_size 还大
-			// 说明缓冲区里的数据已经能把整个 body 填满, 即还存其他的请求数据
-			// 因此本次请求解析只需要读取 content_size 个数据即可
-			len = content_size;
-		}
-		content_size -= unparsed_offset;
-
-		if(content_size > 0) {
-			// 如果还未读取完毕请求体的话, 接下来读取剩下的请求体
-			if(readFixSize(&body[len], content_size) <= 0) {
-				close();
-				return nullptr;
-			}
-		}
-#endif
-
-        parser->getData()->setBody(body);
+        iov[0].iov_base = (void *)m_head.data();
+        iov[0].iov_len  = m_head.size();
+        return sendFixSize(iov, 1);
     }
 
-    // 增加对长连接的设置
-    std::string keep_alive = parser->getData()->getHeader("Connection");
-    if (!strcasecmp(keep_alive.c_str(), "keep-alive")) {
-        parser->getData()->setClose(false);
+    // MSG_MORE 让响应头与文件的第一段合并成一个报文
+    int rt = sendFixSize(iov, 1, MSG_MORE);
+    if (rt <= 0) {
+        return rt;
+    }
+    return sendFile(*file);
+}
+
+int HttpSession::sendProducedBody(HttpResponse::ptr rsp)
+{
+    // HEAD 请求和 204/304 响应没有响应体, 只发响应头, 不调用生成函数
+    bool no_body = m_headRequest ||
+                   rsp->getStatus() == HttpStatus::NO_CONTENT ||
+                   rsp->getStatus() == HttpStatus::NOT_MODIFIED;
+    bool chunked = rsp->getVersion() >= 0x11;
+    if (!chunked && !no_body) {
+        rsp->setClose(true);
+    }
+    m_head.clear();
+    rsp->dumpHead(m_head);
+
+    // 响应头立即发出, 不等第一块数据生成
+    iovec iov;
+    iov.iov_base = (void *)m_head.data();
+    iov.iov_len  = m_head.size();
+    int rt       = sendFixSize(&iov, 1);
+    if (rt <= 0 || no_body) {
+        return rt;
+    }
+
+    HttpBodyWriter::ptr writer(new HttpBodyWriter(
+        std::bind(&HttpSession::sendFixSize, this, std::placeholders::_1,
+                  std::placeholders::_2, 0),
+        chunked));
+    bool ok = rsp->getBodyProducer()(writer);
+    if (ok) {
+        writer->close();
+    }
+    if (!ok || writer->hasError()) {
+        // 已经发出的部分收不回来, 不发结束块, 对方能看出响应不完整
+        SYLAR_LOG_WARN(g_logger)
+            << "sendResponse body producer failed, producer=" << ok
+            << " written=" << writer->getWriteSize();
+        rsp->setClose(true);
+        return -1;
     }
+    return (int)std::min<uint64_t>(m_head.size() + writer->getWriteSize(),
+                                   INT_MAX);
+}
 
-    return parser->getData();
+int HttpSession::sendFixSize(iovec *iov, int count, int flags)
+{
+    Socket::ptr sock = getSocket();
+    uint64_t total   = 0;
+    while (count > 0) {
+        int rt = sock->send(iov, count, flags);
+        if (rt <= 0) {
+            return rt;
+        }
+        total += rt;
+
+        // 跳过已写完的部分, 剩余部分从 iov 中截取
+        size_t left = rt;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return (int)std::min<uint64_t>(total, INT_MAX);
 }
 
-int HttpSession::sendResponse(HttpResponse::ptr rsp)
+int HttpSession::sendFile(const HttpFileBody &file)
 {
-    std::stringstream ss;
-    ss << *rsp;
-    std::string data = ss.str();
-    return writeFixSize(data.c_str(), data.size());
+    int fd        = getSocket()->getSocket();
+    off_t offset  = file.offset;
+    uint64_t left = file.length;
+    while (left > 0) {
+        // 单次 sendfile 最多发送约 2GB
+        ssize_t rt = sendfile(fd, file.fd, &offset,
+                              std::min<uint64_t>(left, 1u << 30));
+        if (rt < 0) {
+            return rt;
+        }
+        if (rt == 0) {
+            // 文件在发送过程中被截断, 已发出的内容长度与响应头不符
+            SYLAR_LOG_ERROR(g_logger)
+                << "sendResponse file truncated fd=" << file.fd
+                << " left=" << left;
+            return -1;
+        }
+        left -= rt;
+    }
+    return (int)std::min<uint64_t>(file.length, INT_MAX);
 }
 
 } // namespace http
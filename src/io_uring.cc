@@ -0,0 +1,205 @@
+#include "sylar/io_uring.hh"
+#include "sylar/log.hh"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                        nullptr, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+IoUring::~IoUring()
+{
+    if (m_sqes) {
+        munmap(m_sqes, m_sqesSize);
+    }
+    if (m_ring) {
+        munmap(m_ring, m_ringSize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool IoUring::init(uint32_t entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    m_fd = sys_io_uring_setup(entries, &params);
+    if (m_fd < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring_setup(" << entries
+                                  << ") errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    // 只支持提交/完成队列共用一次映射的内核(5.4+), 且完成队列溢出时不丢弃 CQE
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)
+        || !(params.features & IORING_FEAT_NODROP))
+    {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring features=" << params.features
+                                  << " not supported";
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    m_ringSize     = sq_size > cq_size ? sq_size : cq_size;
+
+    m_ring = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    if (m_ring == MAP_FAILED) {
+        m_ring = nullptr;
+        SYLAR_LOG_ERROR(g_logger) << "mmap io_uring ring errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        SYLAR_LOG_ERROR(g_logger) << "mmap io_uring sqes errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+    m_sqes = (io_uring_sqe *)sqes;
+
+    char *ring  = (char *)m_ring;
+    m_sqHead    = (unsigned *)(ring + params.sq_off.head);
+    m_sqTail    = (unsigned *)(ring + params.sq_off.tail);
+    m_sqFlags   = (unsigned *)(ring + params.sq_off.flags);
+    m_sqArray   = (unsigned *)(ring + params.sq_off.array);
+    m_sqMask    = *(unsigned *)(ring + params.sq_off.ring_mask);
+    m_sqEntries = params.sq_entries;
+
+    m_cqHead = (unsigned *)(ring + params.cq_off.head);
+    m_cqTail = (unsigned *)(ring + params.cq_off.tail);
+    m_cqes   = (io_uring_cqe *)(ring + params.cq_off.cqes);
+    m_cqMask = *(unsigned *)(ring + params.cq_off.ring_mask);
+    return probeCancelFd();
+}
+
+bool IoUring::probeCancelFd()
+{
+    // 对 io_uring 自己的句柄发一个取消, 上面没有请求, 支持时结果是 0 或 -ENOENT
+    io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode       = IORING_OP_ASYNC_CANCEL;
+    sqe.fd           = m_fd;
+    sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    if (!submit(sqe, 0)) {
+        return false;
+    }
+
+    int rt = 0;
+    do {
+        rt = sys_io_uring_enter(m_fd, 0, 1, IORING_ENTER_GETEVENTS);
+    } while (rt < 0 && errno == EINTR);
+
+    int32_t res = -EINVAL;
+    reap([&res](uint64_t user_data, int32_t r) { res = r; });
+    if (res == -EINVAL) {
+        SYLAR_LOG_ERROR(g_logger)
+            << "io_uring IORING_ASYNC_CANCEL_FD not supported (needs 5.19+)";
+        return false;
+    }
+    return true;
+}
+
+bool IoUring::registerEventfd(int efd)
+{
+    if (sys_io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &efd, 1)) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring_register eventfd errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool IoUring::submit(const io_uring_sqe &sqe, uint64_t user_data,
+                     const __kernel_timespec *ts, uint64_t timeout_user_data)
+{
+    unsigned count = ts ? 2 : 1;
+
+    MutexType::Lock lock(m_sqMutex);
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *m_sqTail;
+    if (m_sqEntries - (tail - head) < count) {
+        return false;
+    }
+    unsigned old_tail = tail;
+
+    io_uring_sqe *req = &m_sqes[tail & m_sqMask];
+    *req              = sqe;
+    req->user_data    = user_data;
+    m_sqArray[tail & m_sqMask] = tail & m_sqMask;
+    ++tail;
+
+    if (ts) {
+        req->flags |= IOSQE_IO_LINK;
+
+        io_uring_sqe *timeout = &m_sqes[tail & m_sqMask];
+        memset(timeout, 0, sizeof(*timeout));
+        timeout->opcode    = IORING_OP_LINK_TIMEOUT;
+        timeout->fd        = -1;
+        timeout->addr      = (uint64_t)(uintptr_t)ts;
+        timeout->len       = 1;
+        timeout->user_data = timeout_user_data;
+        m_sqArray[tail & m_sqMask] = tail & m_sqMask;
+        ++tail;
+    }
+    __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+    // 提交队列里还可能留有上次只被内核取走一部分的请求, 一并提交
+    int rt = 0;
+    do {
+        rt = sys_io_uring_enter(m_fd, tail - head, 0, 0);
+    } while (rt < 0 && errno == EINTR);
+
+    if (rt < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring_enter errno=" << errno
+                                  << " errstr=" << strerror(errno);
+    }
+    // 内核没取走的请求撤回, 调用方回退到 epoll; 留在队列里的话, 之后的提交会让
+    // 内核读到调用方已经释放的 ts 和缓冲区
+    head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if ((int)(head - old_tail) <= 0) {
+        __atomic_store_n(m_sqTail, old_tail, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+void IoUring::flushOverflow()
+{
+    int rt = 0;
+    do {
+        rt = sys_io_uring_enter(m_fd, 0, 0, IORING_ENTER_GETEVENTS);
+    } while (rt < 0 && errno == EINTR);
+}
+
+} // namespace sylar
@@ -1,10 +1,14 @@
 #include "sylar/iomanager.hh"
+#include "sylar/config.hh"
+#include "sylar/io_uring.hh"
 #include "sylar/log.hh"
 #include "sylar/macro.hh"
+#include "sylar/util.hh"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -12,6 +16,43 @@ namespace sylar {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static ConfigVar<std::string>::ptr g_iomanager_backend =
+    Config::Lookup<std::string>("iomanager.backend", "epoll",
+                                "iomanager io backend: epoll/io_uring");
+
+static ConfigVar<bool>::ptr g_iomanager_persistent_events =
+    Config::Lookup<bool>("iomanager.persistent_events", false,
+                         "keep fds registered in epoll for their whole lifetime");
+
+static ConfigVar<uint32_t>::ptr g_iomanager_uring_entries =
+    Config::Lookup<uint32_t>("iomanager.io_uring.entries", 4096,
+                             "io_uring submission queue entries");
+
+/**
+ * @brief   io_uring 请求的等待上下文, 位于发起请求的协程栈上
+ * @details 带超时的请求会产生两个 CQE(请求本身 + 链接的超时请求),
+ *          全部到达后才唤醒协程, 保证协程返回后内核不再引用栈上的数据.
+ *          挂起期间栈必须留在原地, 共享栈协程不走 io_uring
+ */
+struct UringWaiter {
+    enum State {
+        INIT    = 0, /**< 已提交, 协程尚未挂起 */
+        WAITING = 1, /**< 协程已挂起(或正在挂起), 需要完成方唤醒 */
+        DONE    = 2, /**< 全部 CQE 已到达 */
+    };
+
+    Scheduler *scheduler = nullptr;  /**< 唤醒协程使用的调度器 */
+    Fiber::ptr fiber;                /**< 等待的协程 */
+    int thread    = -1;              /**< 协程固定的线程 */
+    int32_t res   = 0;               /**< 请求的结果 */
+    bool timedout = false;           /**< 链接的超时请求是否已触发 */
+    std::atomic<int> pending{0};     /**< 尚未到达的 CQE 数量 */
+    std::atomic<int> state{INIT};    /**< 等待状态 */
+};
+
+/**< 超时请求的 user_data 在等待上下文地址的最低位打标记 */
+static const uint64_t URING_TIMEOUT_TAG = 0x1;
+
 IOManager::FdContext::EventContext &
 IOManager::FdContext::getContext(IOManager::Event event)
 {
@@ -30,7 +71,8 @@ void IOManager::FdContext::resetContext(EventContext &ctx)
 {
     ctx.scheduler = nullptr;
     ctx.fiber.reset();
-    ctx.cb = nullptr;
+    ctx.cb     = nullptr;
+    ctx.thread = -1;
 }
 
 void IOManager::FdContext::triggerEvent(IOManager::Event event)
@@ -40,13 +82,15 @@ void IOManager::FdContext::triggerEvent(IOManager::Event event)
     events            = static_cast<Event>(events & ~event);
     EventContext &ctx = getContext(event);
 
+    // 等待方固定在某个线程上时(如分片监听的连接)回到该线程, 不在线程间迁移
     if (ctx.cb) {
-        ctx.scheduler->schedule(&ctx.cb);
+        ctx.scheduler->schedule(&ctx.cb, ctx.thread);
     }
     else {
-        ctx.scheduler->schedule(&ctx.fiber);
+        ctx.scheduler->schedule(&ctx.fiber, ctx.thread);
     }
     ctx.scheduler = nullptr;
+    ctx.thread    = -1;
     return;
 }
 
@@ -54,6 +98,7 @@ IOManager::IOManager(size_t threads,
 					 bool include_caller_thread,
 					 const std::string &name)
     : Scheduler(threads, include_caller_thread, name)
+    , m_persistentEvents(g_iomanager_persistent_events->getValue())
 {
     m_epfd = epoll_create(500);
     SYLAR_ASSERT(m_epfd > 0);
@@ -72,21 +117,54 @@ IOManager::IOManager(size_t threads,
     rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFds[0], &event);
     SYLAR_ASSERT(!rt);
 
-    contextResize(32); // 设置上下文的大小
+    if (g_iomanager_backend->getValue() == "io_uring") {
+        std::unique_ptr<IoUring> uring(new IoUring);
+        int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd >= 0 && uring->init(g_iomanager_uring_entries->getValue())
+            && uring->registerEventfd(efd))
+        {
+            memset(&event, 0x00, sizeof(epoll_event));
+            event.events  = EPOLLIN | EPOLLET;
+            event.data.fd = efd;
+            rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, efd, &event);
+            SYLAR_ASSERT(!rt);
+
+            m_uring.swap(uring);
+            m_uringEventFd = efd;
+        }
+        else {
+            SYLAR_LOG_ERROR(g_logger) << "name=" << name
+                                      << " io_uring unavailable, fall back to epoll";
+            if (efd >= 0) {
+                close(efd);
+            }
+        }
+    }
+    else if (g_iomanager_backend->getValue() != "epoll") {
+        SYLAR_LOG_ERROR(g_logger) << "unknown iomanager.backend "
+                                  << g_iomanager_backend->getValue()
+                                  << ", use epoll";
+    }
+
+    m_deadlineSlots.resize(DEADLINE_SLOTS, nullptr);
+    m_deadlineTick = GetCurrentMS();
 
     start(); // 在这里自动开始进行调度
 }
 
-void IOManager::contextResize(size_t size)
+IOManager::FdContext *IOManager::getFdContext(int fd, bool auto_create)
 {
-    m_fdContexts.resize(size);
-
-    for (size_t i = 0; i < m_fdContexts.size(); ++i) {
-        if (!m_fdContexts[i]) {
-            m_fdContexts[i]     = new FdContext;
-            m_fdContexts[i]->fd = i;
-        }
+    if (fd < 0) {
+        return nullptr;
     }
+    if (!auto_create) {
+        return m_fdContexts.get(fd);
+    }
+    return m_fdContexts.getOrCreate(fd, [](size_t index) {
+        FdContext *fd_ctx = new FdContext;
+        fd_ctx->fd        = index;
+        return fd_ctx;
+    });
 }
 
 IOManager::~IOManager()
@@ -96,29 +174,30 @@ IOManager::~IOManager()
     close(m_tickleFds[0]);
     close(m_tickleFds[1]);
 
-    for (auto &i : m_fdContexts) {
-        if(i) {
-            delete i;
-        }
+    m_uring.reset();
+    if (m_uringEventFd >= 0) {
+        close(m_uringEventFd);
     }
-
 }
 
 int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
 {
-    FdContext *fd_ctx = nullptr;
-    RWMutexType::ReadLock lock(m_mutex);
+    return doAddEvent(fd, event, &cb, ~0ull, nullptr);
+}
+
+int IOManager::addEvent(int fd, Event event, uint64_t timeout_ms, uint64_t &seq)
+{
+    return doAddEvent(fd, event, nullptr, timeout_ms, &seq);
+}
 
+int IOManager::doAddEvent(int fd, Event event, std::function<void()> *cb,
+                          uint64_t timeout_ms, uint64_t *seq)
+{
     // 获取句柄事件对应的 fdContext 对象
-    if (static_cast<int>(m_fdContexts.size()) > fd) {
-        fd_ctx = m_fdContexts[fd];
-        lock.unlock();
-    }
-    else {
-        lock.unlock();
-        RWMutexType::WriteLock lock2(m_mutex);
-        contextResize(fd * 1.5);
-        fd_ctx = m_fdContexts[fd];
+    FdContext *fd_ctx = getFdContext(fd, true);
+    if (!fd_ctx) {
+        SYLAR_LOG_SAMPLE_ERROR(g_logger) << "addEvent fd=" << fd << " out of range";
+        return -1;
     }
 
     // 检查待添加的事件是否已存在, 防止重复注册
@@ -130,25 +209,58 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
 
         SYLAR_ASSERT(!(fd_ctx->events & event));
     }
+    ++m_addEventCount;
+
+    if (m_persistentEvents) {
+        // 没有等待者期间到达的边沿已被 idle 记录下来, 直接消费, 不必挂起
+        if (fd_ctx->readyEvents & event) {
+            fd_ctx->readyEvents = static_cast<Event>(fd_ctx->readyEvents & ~event);
+            ++m_readyHitCount;
+            if (cb && *cb) {
+                Scheduler::GetThis()->schedule(cb, Scheduler::GetTaskThread());
+                return 0;
+            }
+            return 1;
+        }
 
-    // 构造 epoll_event 并注册事件
-    int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
-    epoll_event epevent;
-    if(op == EPOLL_CTL_MOD) {
-        epevent.events = EPOLLET | fd_ctx->events | event;
-    } else if(op & EPOLL_CTL_ADD){
-        epevent.events = EPOLL_FLAGS | fd_ctx->events | event;
+        if (!fd_ctx->registered) {
+            epoll_event epevent;
+            epevent.events   = EPOLL_FLAGS | EPOLLIN | EPOLLOUT;
+            epevent.data.ptr = fd_ctx;
+
+            ++m_epollCtlCount;
+            int rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &epevent);
+            if (rt) {
+                SYLAR_LOG_SAMPLE_ERROR(g_logger)
+                    << "epoll_ctl(" << m_epfd << ", " << EPOLL_CTL_ADD << ", "
+                    << fd << ", " << epevent.events << ")" << rt << " ("
+                    << errno << ") (" << strerror(errno) << ")";
+                return -1;
+            }
+            fd_ctx->registered = true;
+        }
     }
-    epevent.data.ptr = fd_ctx;
+    else {
+        // 构造 epoll_event 并注册事件
+        int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        epoll_event epevent;
+        if(op == EPOLL_CTL_MOD) {
+            epevent.events = EPOLLET | fd_ctx->events | event;
+        } else if(op & EPOLL_CTL_ADD){
+            epevent.events = EPOLL_FLAGS | fd_ctx->events | event;
+        }
+        epevent.data.ptr = fd_ctx;
 
-    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
 
-    if (rt) {
-        SYLAR_LOG_ERROR(g_logger)
-            << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
-            << epevent.events << ")" << rt << " (" << errno << ") ("
-            << strerror(errno) << ")";
-        return -1;
+        if (rt) {
+            SYLAR_LOG_SAMPLE_ERROR(g_logger)
+                << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+                << epevent.events << ")" << rt << " (" << errno << ") ("
+                << strerror(errno) << ")";
+            return -1;
+        }
     }
 
     // 更新状态并绑定调度器/协程/回调
@@ -160,9 +272,10 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
     SYLAR_ASSERT(!event_ctx.scheduler && !event_ctx.fiber && !event_ctx.cb);
 
     event_ctx.scheduler = Scheduler::GetThis();
+    event_ctx.thread    = Scheduler::GetTaskThread();
 
-    if (cb) {
-        event_ctx.cb.swap(cb);
+    if (cb && *cb) {
+        event_ctx.cb.swap(*cb);
     }
     else {
         event_ctx.fiber = Fiber::GetThis(); // 保存返回点的上下文
@@ -170,18 +283,148 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
                       "state=" << event_ctx.fiber->getState());
     }
 
+    ++event_ctx.seq;
+    if (seq) {
+        *seq = event_ctx.seq;
+    }
+
+    if (timeout_ms != ~0ull) {
+        uint64_t deadline = GetCurrentMS() + timeout_ms;
+        bool at_front     = false;
+        {
+            Spinlock::Lock lock3(m_deadlineLock);
+            // 上一次等待留下的节点还在槽中时先摘除, 节点就是事件上下文本身
+            if (event_ctx.dlLinked) {
+                if (event_ctx.dlPrev) {
+                    event_ctx.dlPrev->dlNext = event_ctx.dlNext;
+                }
+                else {
+                    m_deadlineSlots[event_ctx.deadline & (DEADLINE_SLOTS - 1)] =
+                        event_ctx.dlNext;
+                }
+                if (event_ctx.dlNext) {
+                    event_ctx.dlNext->dlPrev = event_ctx.dlPrev;
+                }
+            }
+            // 已经扫描过的时间点不会再被扫描
+            if (deadline < m_deadlineTick) {
+                deadline = m_deadlineTick;
+            }
+
+            FdContext::EventContext *&head =
+                m_deadlineSlots[deadline & (DEADLINE_SLOTS - 1)];
+            event_ctx.owner       = fd_ctx;
+            event_ctx.event       = event;
+            event_ctx.deadline    = deadline;
+            event_ctx.deadlineSeq = event_ctx.seq;
+            event_ctx.dlPrev      = nullptr;
+            event_ctx.dlNext      = head;
+            event_ctx.dlLinked    = true;
+            if (head) {
+                head->dlPrev = &event_ctx;
+            }
+            head = &event_ctx;
+
+            if (deadline < m_nextDeadline) {
+                m_nextDeadline = deadline;
+                at_front       = true;
+            }
+        }
+        // 比阻塞在 epoll_wait 中的线程的唤醒时间更早, 唤醒它们重新计算超时
+        if (at_front) {
+            tickle();
+        }
+    }
+
     return 0;
 }
 
-bool IOManager::delEvent(int fd, Event event)
+bool IOManager::isTimedOut(int fd, Event event, uint64_t seq)
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    if (static_cast<int>(m_fdContexts.size()) <= fd) {
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx) {
         return false;
     }
 
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
+    FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+    return fd_ctx->getContext(event).timedoutSeq == seq;
+}
+
+void IOManager::expireDeadlines()
+{
+    uint64_t now = GetCurrentMS();
+    if (m_nextDeadline > now) {
+        return;
+    }
+
+    struct Expired {
+        FdContext::EventContext *ctx;
+        uint64_t seq;
+    };
+    // 复用容量, 稳态下扫描不分配内存
+    static thread_local std::vector<Expired> t_expired;
+    t_expired.clear();
+
+    {
+        Spinlock::Lock lock(m_deadlineLock);
+        uint64_t tick = m_deadlineTick;
+        if (tick + DEADLINE_SLOTS <= now) {
+            tick = now + 1 - DEADLINE_SLOTS; // 每个槽最多扫描一遍
+        }
+        for (; tick <= now; ++tick) {
+            FdContext::EventContext *&head = m_deadlineSlots[tick & (DEADLINE_SLOTS - 1)];
+            FdContext::EventContext *node  = head;
+            while (node) {
+                FdContext::EventContext *next = node->dlNext;
+                // 同一个槽中还有若干圈之后才到期的节点
+                if (node->deadline <= now) {
+                    if (node->dlPrev) {
+                        node->dlPrev->dlNext = next;
+                    }
+                    else {
+                        head = next;
+                    }
+                    if (next) {
+                        next->dlPrev = node->dlPrev;
+                    }
+                    node->dlLinked = false;
+                    t_expired.push_back({node, node->deadlineSeq});
+                }
+                node = next;
+            }
+        }
+        if (m_deadlineTick <= now) {
+            m_deadlineTick = now + 1;
+        }
+
+        uint64_t next_deadline = ~0ull;
+        for (tick = now + 1; tick <= now + DEADLINE_SLOTS; ++tick) {
+            if (m_deadlineSlots[tick & (DEADLINE_SLOTS - 1)]) {
+                next_deadline = tick;
+                break;
+            }
+        }
+        m_nextDeadline = next_deadline;
+    }
+
+    for (auto &i : t_expired) {
+        FdContext *fd_ctx = i.ctx->owner;
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        // 等待已经结束(事件触发或被取消), 节点只是还没被摘除
+        if (i.ctx->seq != i.seq || !(fd_ctx->events & i.ctx->event)) {
+            continue;
+        }
+        i.ctx->timedoutSeq = i.seq;
+        cancelEventLocked(fd_ctx, i.ctx->event);
+    }
+}
+
+bool IOManager::delEvent(int fd, Event event)
+{
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx) {
+        return false;
+    }
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     if (!(fd_ctx->events & event)) {
@@ -190,18 +433,21 @@ bool IOManager::delEvent(int fd, Event event)
 
 	// 将数据按位取反, 然后与原来的 events 做与操作,  即删除原来的事件
     Event new_events = static_cast<Event>(fd_ctx->events & ~event);
-    int op           = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    epoll_event epevent;
-    epevent.events   = EPOLLET | new_events;
-    epevent.data.ptr = fd_ctx;
-
-    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-    if (rt) {
-        SYLAR_LOG_ERROR(g_logger)
-            << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
-            << epevent.events << "):" << rt << " (" << errno << ") ("
-            << strerror(errno) << ")";
-        return false;
+    if (!m_persistentEvents) {
+        int op           = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        epoll_event epevent;
+        epevent.events   = EPOLLET | new_events;
+        epevent.data.ptr = fd_ctx;
+
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+        if (rt) {
+            SYLAR_LOG_ERROR(g_logger)
+                << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+                << epevent.events << "):" << rt << " (" << errno << ") ("
+                << strerror(errno) << ")";
+            return false;
+        }
     }
 
     // 更新 IOManager 的内部状态
@@ -215,31 +461,39 @@ bool IOManager::delEvent(int fd, Event event)
 
 bool IOManager::cancelEvent(int fd, Event event)
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    if (static_cast<int>(m_fdContexts.size()) <= fd) {
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx) {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+    return cancelEventLocked(fd_ctx, event);
+}
+
+bool IOManager::cancelEventLocked(FdContext *fd_ctx, Event event)
+{
     if (!(fd_ctx->events & event)) {
         return false;
     }
 
-    Event new_events = static_cast<Event>(fd_ctx->events & ~event);
-    int op           = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    epoll_event epevent;
-    epevent.events   = EPOLLET | new_events;
-    epevent.data.ptr = fd_ctx;
-
-    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-    if (rt) {
-        SYLAR_LOG_ERROR(g_logger)
-            << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
-            << epevent.events << "):" << rt << " (" << errno << ") ("
-            << strerror(errno) << ")";
-        return false;
+    int fd = fd_ctx->fd;
+    if (!m_persistentEvents) {
+        Event new_events = static_cast<Event>(fd_ctx->events & ~event);
+        int op           = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        epoll_event epevent;
+        epevent.events   = EPOLLET | new_events;
+        epevent.data.ptr = fd_ctx;
+
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+        // 句柄已被关闭时内核已把它移出 epoll, 等待者仍需唤醒, 否则会永远挂起
+        if (rt && errno != ENOENT && errno != EBADF) {
+            SYLAR_LOG_ERROR(g_logger)
+                << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
+                << epevent.events << "):" << rt << " (" << errno << ") ("
+                << strerror(errno) << ")";
+            return false;
+        }
     }
 
     fd_ctx->triggerEvent(event);
@@ -249,16 +503,23 @@ bool IOManager::cancelEvent(int fd, Event event)
 
 bool IOManager::cancelAll(int fd)
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    if (static_cast<int>(m_fdContexts.size()) <= fd) {
-        return false;
+    // io_uring 请求持有文件引用, 关闭句柄不会让它们结束, 需要显式取消
+    if (m_uring) {
+        io_uring_sqe sqe;
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode       = IORING_OP_ASYNC_CANCEL;
+        sqe.fd           = fd;
+        sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        m_uring->submit(sqe, 0);
     }
 
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx) {
+        return false;
+    }
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
-    if (!fd_ctx->events) {
+    if (!fd_ctx->events && !fd_ctx->registered) {
         return false;
     }
 
@@ -267,14 +528,18 @@ bool IOManager::cancelAll(int fd)
     epevent.events   = 0;
     epevent.data.ptr = fd_ctx;
 
+    ++m_epollCtlCount;
     int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-    if (rt) {
+    // 持久注册的标记可能来自一个未经 hook 关闭的同号旧句柄, 此时 epoll 中已没有注册
+    if (rt && !(m_persistentEvents && errno == ENOENT)) {
         SYLAR_LOG_ERROR(g_logger)
             << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", "
             << epevent.events << "):" << rt << " (" << errno << ") ("
             << strerror(errno) << ")";
         return false;
     }
+    fd_ctx->registered  = false;
+    fd_ctx->readyEvents = NONE;
 
     if (fd_ctx->events & READ) {
         fd_ctx->triggerEvent(READ);
@@ -290,6 +555,114 @@ bool IOManager::cancelAll(int fd)
     return true;
 }
 
+void IOManager::resetFd(int fd)
+{
+    if (!m_persistentEvents) {
+        return;
+    }
+
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx) {
+        return;
+    }
+
+    FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+    if (fd_ctx->registered) {
+        // 新句柄尚未注册, 旧句柄的注册已随关闭从 epoll 中移除, ENOENT 是预期的
+        epoll_event epevent;
+        memset(&epevent, 0, sizeof(epevent));
+        ++m_epollCtlCount;
+        epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, &epevent);
+        fd_ctx->registered = false;
+    }
+    fd_ctx->readyEvents = NONE;
+}
+
+IOManager::Stats IOManager::getStats() const
+{
+    Stats stats;
+    stats.epollWait = m_epollWaitCount;
+    stats.epollCtl  = m_epollCtlCount;
+    stats.addEvent  = m_addEventCount;
+    stats.readyHit  = m_readyHitCount;
+    return stats;
+}
+
+bool IOManager::uringSubmit(const io_uring_sqe &sqe, uint64_t timeout_ms, int &res)
+{
+    if (!m_uring) {
+        return false;
+    }
+    // 共享栈协程挂起后栈被换出, 同一区域给别的协程用; 内核和 uringReap 仍会
+    // 写栈上的 waiter 和缓冲区, 只能走 epoll
+    Fiber::ptr fiber = Fiber::GetThis();
+    if (fiber->isSharedStack()) {
+        return false;
+    }
+
+    UringWaiter waiter;
+    waiter.scheduler = Scheduler::GetThis();
+    waiter.fiber     = std::move(fiber);
+    waiter.thread    = Scheduler::GetTaskThread();
+    waiter.pending   = timeout_ms != ~0ull ? 2 : 1;
+
+    __kernel_timespec ts;
+    ts.tv_sec  = timeout_ms / 1000;
+    ts.tv_nsec = timeout_ms % 1000 * 1000 * 1000;
+
+    ++m_pendingEventCount;
+    if (!m_uring->submit(sqe, (uint64_t)(uintptr_t)&waiter,
+                         timeout_ms != ~0ull ? &ts : nullptr,
+                         (uint64_t)(uintptr_t)&waiter | URING_TIMEOUT_TAG))
+    {
+        --m_pendingEventCount;
+        return false;
+    }
+
+    // 数据已就绪的请求在 io_uring_enter 中就已完成, 直接收割, 不必等 eventfd 唤醒
+    uringReap();
+
+    int expected = UringWaiter::INIT;
+    if (waiter.state.compare_exchange_strong(expected, UringWaiter::WAITING)) {
+        Fiber::YieldToHold();
+    }
+    SYLAR_ASSERT(waiter.state == UringWaiter::DONE);
+
+    res = waiter.res;
+    if (res == -ECANCELED && waiter.timedout) {
+        res = -ETIMEDOUT;
+    }
+    return true;
+}
+
+void IOManager::uringReap()
+{
+    m_uring->reap([this](uint64_t user_data, int32_t res) {
+        if (!user_data) {
+            return; // 取消请求等不需要等待的请求
+        }
+
+        UringWaiter *waiter =
+            (UringWaiter *)(uintptr_t)(user_data & ~URING_TIMEOUT_TAG);
+        if (user_data & URING_TIMEOUT_TAG) {
+            waiter->timedout = res == -ETIME;
+        }
+        else {
+            waiter->res = res;
+        }
+        if (--waiter->pending) {
+            return;
+        }
+
+        --m_pendingEventCount;
+        // 状态变为 DONE 之前发起方不会返回, waiter 一定有效;
+        // 之后只有发起方已挂起时才继续访问 waiter
+        if (waiter->state.exchange(UringWaiter::DONE) == UringWaiter::WAITING) {
+            waiter->scheduler->schedule(waiter->fiber, waiter->thread);
+        }
+    });
+}
+
 IOManager *IOManager::GetThis()
 {
     return dynamic_cast<IOManager *>(Scheduler::GetThis());
@@ -303,7 +676,8 @@ IOManager *IOManager::GetThis()
 
 void IOManager::tickle()
 {
-    if (hasIdleThreads()) {
+    // 没有线程阻塞在 epoll_wait 时, 新任务会在当前调度循环中被取走, 无需唤醒
+    if (!hasIdleThreads()) {
         return;
     }
     int rt = write(m_tickleFds[1], "T", 1);
@@ -344,6 +718,15 @@ void IOManager::idle()
             break;
         }
 
+        uint64_t next_deadline = m_nextDeadline;
+        if (next_deadline != ~0ull) {
+            uint64_t now = GetCurrentMS();
+            next_deadline = next_deadline > now ? next_deadline - now : 0;
+            if (next_deadline < next_timeout) {
+                next_timeout = next_deadline;
+            }
+        }
+
         int rt{0};
 
         // 测试 tcp-server的默认行为
@@ -358,6 +741,7 @@ void IOManager::idle()
             } else {
                 next_timeout = MAX_TIMEOUT;
             }
+            ++m_epollWaitCount;
             rt = epoll_wait(m_epfd, events, 64, static_cast<int>(next_timeout));
             if (rt < 0 && errno == EINTR) {
             }
@@ -366,6 +750,8 @@ void IOManager::idle()
             }
         } while (true);
 
+        expireDeadlines();
+
         std::vector<std::function<void()> > cbs;
         listExpiredCb(cbs);
         if(!cbs.empty()) {
@@ -389,6 +775,17 @@ void IOManager::idle()
                 continue;
             }
 
+            if (m_uring && event.data.fd == m_uringEventFd) {
+                uint64_t dummy;
+                int saved_errno = errno;
+                while (read(m_uringEventFd, &dummy, sizeof(dummy)) > 0)
+                    ;
+                errno = saved_errno;
+
+                uringReap();
+                continue;
+            }
+
             // 事件触发时, 携带了指定的上下文类
             FdContext *fd_ctx = static_cast<FdContext *>(event.data.ptr);
             FdContext::MutexType::Lock lock(fd_ctx->mutex);
@@ -403,24 +800,35 @@ void IOManager::idle()
                 real_events |= WRITE;
             }
 
-            // 只会关心指定的读写IO事件, 其余事件一律跳过
-            if ((fd_ctx->events & real_events) == NONE) {
-                continue;
+            if (m_persistentEvents) {
+                // 持久注册不修改 epoll, 没有等待者的边沿记录下来留给下一次 addEvent
+                fd_ctx->readyEvents = static_cast<Event>(
+                    fd_ctx->readyEvents | (real_events & ~fd_ctx->events));
             }
-
-            int left_events = (fd_ctx->events & ~real_events);
-            int op          = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-            event.events    = EPOLLET | left_events;
-
-            int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
-            if (rt2) {
-                SYLAR_LOG_ERROR(g_logger)
-                    << "epoll_ctl(" << m_epfd << ", " << op << ", "
-                    << fd_ctx->fd << ", " << event.events << "):" << rt2 << " ("
-                    << errno << ") (" << strerror(errno) << ")";
-                continue;
+            else {
+                // 只会关心指定的读写IO事件, 其余事件一律跳过
+                if ((fd_ctx->events & real_events) == NONE) {
+                    continue;
+                }
+
+                int left_events = (fd_ctx->events & ~real_events);
+                int op          = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+                event.events    = EPOLLET | left_events;
+
+                ++m_epollCtlCount;
+                int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
+                if (rt2) {
+                    SYLAR_LOG_ERROR(g_logger)
+                        << "epoll_ctl(" << m_epfd << ", " << op << ", "
+                        << fd_ctx->fd << ", " << event.events << "):" << rt2 << " ("
+                        << errno << ") (" << strerror(errno) << ")";
+                    continue;
+                }
             }
 
+            // EPOLLHUP/EPOLLERR 会同时置上读写位, 只触发真正注册了的事件
+            real_events &= fd_ctx->events;
+
             if (real_events & READ) {
                 fd_ctx->triggerEvent(READ);
                 --m_pendingEventCount;
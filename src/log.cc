@@ -3,12 +3,26 @@
 #include <memory>
 #include <tuple>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <functional>
 #include <string>
 #include <iostream>
 #include "sylar/config.hh"
 #include <time.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
 
 #include "sylar/util.hh"
 #include "sylar/macro.hh"
@@ -95,6 +109,139 @@ void LogEvent::format(const char *fmt, va_list al)
 
 std::stringstream &LogEventWrap::getSS() { return m_event->getSS(); }
 
+LogStream::~LogStream()
+{
+    if (m_data != m_inline) {
+        free(m_data);
+    }
+}
+
+void LogStream::grow(size_t len)
+{
+    size_t cap = m_capacity * 2;
+    while (cap < m_size + len) {
+        cap *= 2;
+    }
+    char *data = (char *)malloc(cap);
+    memcpy(data, m_data, m_size);
+    if (m_data != m_inline) {
+        free(m_data);
+    }
+    m_data     = data;
+    m_capacity = cap;
+}
+
+void LogStream::format(const char *fmt, ...)
+{
+    va_list al;
+    va_start(al, fmt);
+    format(fmt, al);
+    va_end(al);
+}
+
+void LogStream::format(const char *fmt, va_list al)
+{
+    va_list copy;
+    va_copy(copy, al);
+    int len = vsnprintf(m_data + m_size, m_capacity - m_size, fmt, copy);
+    va_end(copy);
+    if (len < 0) {
+        return;
+    }
+    if (m_size + len >= m_capacity) {
+        // vsnprintf 需要额外一个字节放结尾的 '\0'
+        grow(len + 1);
+        vsnprintf(m_data + m_size, m_capacity - m_size, fmt, al);
+    }
+    m_size += len;
+}
+
+bool LogStream::hasStreamState() const
+{
+    // 新建的流: skipws | dec, 精度 6, 宽度 0, 空格填充
+    return m_os->flags() != (std::ios_base::skipws | std::ios_base::dec) ||
+           m_os->precision() != 6 || m_os->width() != 0 || m_os->fill() != ' ';
+}
+
+LogStream &LogStream::operator<<(const char *str)
+{
+    if (m_osState) {
+        // 与 std::ostream 不同, 空指针仍然什么也不输出
+        return str ? stream(str) : *this;
+    }
+    if (str) {
+        append(str, strlen(str));
+    }
+    return *this;
+}
+
+LogStream &LogStream::operator<<(unsigned long long val)
+{
+    if (m_osState) {
+        return stream(val);
+    }
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p   = end;
+    do {
+        *--p = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    append(p, end - p);
+    return *this;
+}
+
+LogStream &LogStream::operator<<(long long val)
+{
+    if (m_osState) {
+        return stream(val);
+    }
+    if (val < 0) {
+        append("-", 1);
+        // 先转成无符号数再取反, 避免 LLONG_MIN 溢出
+        return *this << (0ull - (unsigned long long)val);
+    }
+    return *this << (unsigned long long)val;
+}
+
+LogStream &LogStream::operator<<(double val)
+{
+    if (m_osState) {
+        return stream(val);
+    }
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%g", val);
+    append(buf, len);
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const void *ptr)
+{
+    if (m_osState) {
+        return stream(ptr);
+    }
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%p", ptr);
+    append(buf, len);
+    return *this;
+}
+
+LogLineWrap::LogLineWrap(const Logger::ptr &logger, LogLevel::Level level,
+                         const char *file, int32_t line, uint32_t suppressed)
+    : m_logger(logger.get()), m_suppressed(suppressed),
+      m_line(level, file, line, 0, GetThreadId(), GetFiberId(), time(0),
+             Thread::GetName())
+{}
+
+LogLineWrap::~LogLineWrap()
+{
+    if (m_suppressed) {
+        m_line.getSS() << " (suppressed " << m_suppressed
+                       << " similar messages)";
+    }
+    m_logger->log(m_line);
+}
+
 void LogAppender::setFormatter(LogFormatter::ptr var)
 {
     MutexType::Lock lock(m_mutex);
@@ -108,7 +255,8 @@ void LogAppender::setFormatter(LogFormatter::ptr var)
     }
 }
 
-Logger::Logger(const std::string &name) : m_name(name), m_level(LogLevel::DEBUG)
+Logger::Logger(const std::string &name)
+    : m_name(name), m_level(LogLevel::DEBUG), m_appenders(new Appenders)
 {
     m_formatter.reset(new LogFormatter(
         "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
@@ -125,7 +273,7 @@ void Logger::setFormatter(LogFormatter::ptr var)
     // std::cout << "---" << var << std::endl;
     MutexType::Lock lock(m_mutex);
     m_formatter = var;
-    for (auto &i : m_appenders) {
+    for (auto &i : *m_appenders.get()) {
         MutexType::Lock ll(i->m_mutex);
 
         if (!i->m_hasFormatter) {
@@ -134,128 +282,1572 @@ void Logger::setFormatter(LogFormatter::ptr var)
     }
 }
 
-void Logger::setFormatter(const std::string &var)
+void Logger::setFormatter(const std::string &var)
+{
+    sylar::LogFormatter::ptr new_var(new sylar::LogFormatter(var));
+
+    if (new_var->isError()) {
+        std::cout << "Logger setFormatter name=" << m_name << " value=" << var
+                  << " invalid formatter" << std::endl;
+        return;
+    }
+    setFormatter(new_var);
+}
+
+std::string Logger::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+
+    YAML::Node node;
+    node["name"] = m_name;
+    if (getLevel() != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(getLevel());
+    }
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    LogSamplePolicy sample = getSample();
+    if (!(sample == LogSamplePolicy())) {
+        node["sample"]["first"]    = sample.first;
+        node["sample"]["every"]    = sample.every;
+        node["sample"]["interval"] = sample.interval;
+    }
+
+    for (auto &i : *m_appenders.get()) {
+        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+void Logger::setSample(const LogSamplePolicy &val)
+{
+    m_sampleFirst    = val.first;
+    m_sampleEvery    = val.every;
+    m_sampleInterval = val.interval;
+}
+
+LogSamplePolicy Logger::getSample() const
+{
+    LogSamplePolicy policy;
+    policy.first    = getSampleFirst();
+    policy.every    = getSampleEvery();
+    policy.interval = getSampleInterval();
+    return policy;
+}
+
+LogFormatter::ptr Logger::getFormatter()
+{
+    MutexType::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+int Logger::getAppenderSize()
+{
+    MutexType::Lock lock(m_mutex);
+    return m_appenders.get()->size();
+}
+
+/**
+ * @brief 释放被替换下来的输出器列表
+ * @details 旧列表可能还有正在输出的读者, 等它们退出后再释放.
+ *          在日志器的锁外调用, 避免读者中的输出器反过来等这把锁
+ */
+static void RetireAppenders(const Logger::Appenders *old)
+{
+    if (old) {
+        RcuSynchronize();
+        delete old;
+    }
+}
+
+/**
+ * @brief 添加输出器
+ * @details 只用来添加输出器
+ * @param[in] appender 输出器
+ */
+void Logger::addAppender(LogAppender::ptr appender)
+{
+    const Appenders *old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+
+        if (!appender->getFormatter()) {
+            MutexType::Lock ll(appender->m_mutex);
+            appender->m_formatter = m_formatter; // 将日志的默认解析器设置到输出器中
+        }
+
+        // std::cout << appender->getFormatter()->getPattern() << std::endl;
+
+        Appenders *fresh = new Appenders(*m_appenders.get());
+        fresh->push_back(appender);
+        old = m_appenders.exchange(fresh);
+    }
+    RetireAppenders(old);
+}
+
+/**
+ * @brief 删除输出器
+ * @details 遍历输出器集合, 然后移除与之相应的输出器
+ * @param[in] appender 待移除的输出器
+ */
+void Logger::delAppender(LogAppender::ptr appender)
+{
+    const Appenders *old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+        const Appenders &cur = *m_appenders.get();
+        auto it              = std::find(cur.begin(), cur.end(), appender);
+        if (it == cur.end()) {
+            return;
+        }
+        Appenders *fresh = new Appenders(cur.begin(), it);
+        fresh->insert(fresh->end(), it + 1, cur.end());
+        old = m_appenders.exchange(fresh);
+    }
+    RetireAppenders(old);
+}
+
+void Logger::clearAppenders()
+{
+    const Appenders *old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_appenders.get()->empty()) {
+            return;
+        }
+        old = m_appenders.exchange(new Appenders);
+    }
+    RetireAppenders(old);
+}
+
+/**
+ * @brief 日志输出
+ * @details 如果日志的级别大于默认级别, 那么尝试遍历输出器集合,
+ * 并通过输出器输出日志内容
+ * @param[in] level 日志级别
+ * @param[in] event 待输出的事件
+ */
+void Logger::log(LogLevel::Level level, LogEvent::ptr event)
+{
+    if (level >= getLevel()) { // 事件级别 是否 大于 当前日志的默认级别
+
+        auto self = shared_from_this();
+
+        RcuReadLock lock;
+        const Appenders &appenders = *m_appenders.get();
+        // 如果设置了专有输出器
+        if (!appenders.empty()) {
+            for (auto &i : appenders) {
+                i->log(self, level, event);
+            }
+        }
+        else if (m_root) {
+            m_root->log(level, event);
+        }
+    }
+}
+
+void Logger::log(const LogLine &line)
+{
+    if (line.getLevel() >= getLevel()) {
+        RcuReadLock lock;
+        const Appenders &appenders = *m_appenders.get();
+        if (!appenders.empty()) {
+            for (auto &i : appenders) {
+                i->log(*this, line);
+            }
+        }
+        else if (m_root) {
+            m_root->log(line);
+        }
+    }
+}
+
+void LogAppender::log(Logger &logger, const LogLine &line)
+{
+    LogEvent::ptr event(new LogEvent(
+        line.getLevel(), line.getFile(), line.getLine(), line.getElapse(),
+        line.getThreadId(), line.getFiberId(), line.getTime(),
+        line.getThreadName()));
+    event->getSS().write(line.getContent(), line.getContentSize());
+    log(logger.shared_from_this(), line.getLevel(), event);
+}
+
+void Logger::log(const LogRecord &record)
+{
+    if (record.getLevel() >= getLevel()) {
+        RcuReadLock lock;
+        const Appenders &appenders = *m_appenders.get();
+        if (!appenders.empty()) {
+            for (auto &i : appenders) {
+                i->log(*this, record);
+            }
+        }
+        else if (m_root) {
+            m_root->log(record);
+        }
+    }
+}
+
+void LogAppender::log(Logger &logger, const LogRecord &record)
+{
+    const LogSite &site = record.getSite();
+    LogLine line(site.level, site.file, site.line, 0, record.getThreadId(),
+                 record.getFiberId(), record.getTime(),
+                 record.getThreadName());
+    record.formatMessage(line.getSS());
+    log(logger, line);
+}
+
+static std::atomic<uint32_t> s_log_site_id{0};
+
+LogSite::LogSite(LogLevel::Level l, const char *f, int32_t ln, const char *fm)
+    : id(s_log_site_id++), level(l), file(f), line(ln), fmt(fm)
+{}
+
+void LogRecord::FormatMessage(LogStream &os, const char *fmt,
+                              const LogArg *args, size_t count)
+{
+    size_t idx    = 0;
+    const char *p = fmt;
+    while (*p) {
+        const char *pct = strchr(p, '%');
+        if (!pct) {
+            os.append(p, strlen(p));
+            break;
+        }
+        os.append(p, pct - p);
+        if (pct[1] == '%') {
+            os.append("%", 1);
+            p = pct + 2;
+            continue;
+        }
+
+        // 重新拼出不带长度修饰符的转换说明, 长度修饰符按参数的实际类型补上
+        char spec[32];
+        size_t n      = 0;
+        spec[n++]     = '%';
+        const char *q = pct + 1;
+        while (*q && strchr("-+ #0", *q)) {
+            if (n < 24) {
+                spec[n++] = *q;
+            }
+            ++q;
+        }
+        while (isdigit((unsigned char)*q) || *q == '.') {
+            if (n < 24) {
+                spec[n++] = *q;
+            }
+            ++q;
+        }
+        while (*q && strchr("hlLqjzt", *q)) {
+            ++q;
+        }
+        char conv = *q;
+        if (!conv || !strchr("diouxXeEfFgGaAcsp", conv) || idx >= count) {
+            size_t len = q - pct + (conv ? 1 : 0);
+            os.append(pct, len);
+            p = pct + len;
+            continue;
+        }
+        p = q + 1;
+
+        const LogArg &arg = args[idx++];
+        bool plain        = n == 1;
+        if (arg.type == LogArg::STRING) {
+            if (conv == 's' && !plain) {
+                spec[n++] = 's';
+                spec[n]   = '\0';
+                os.format(spec, arg.s);
+            }
+            else {
+                os.append(arg.s, arg.len);
+            }
+            continue;
+        }
+
+        switch (conv) {
+            case 'd':
+            case 'i':
+            case 's':
+                if (plain) {
+                    if (arg.type == LogArg::INT) {
+                        os << (long long)arg.i;
+                    }
+                    else if (arg.type == LogArg::UINT) {
+                        os << (unsigned long long)arg.u;
+                    }
+                    else {
+                        os << arg.d;
+                    }
+                    break;
+                }
+                if (arg.type == LogArg::DOUBLE) {
+                    spec[n++] = 'g';
+                    spec[n]   = '\0';
+                    os.format(spec, arg.d);
+                    break;
+                }
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+                if (arg.type == LogArg::UINT) {
+                    spec[n++] = 'u';
+                    spec[n]   = '\0';
+                    os.format(spec, (unsigned long long)arg.u);
+                }
+                else {
+                    spec[n++] = 'd';
+                    spec[n]   = '\0';
+                    os.format(spec, (long long)arg.i);
+                }
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                if (plain && conv == 'u' && arg.type != LogArg::DOUBLE) {
+                    os << (unsigned long long)arg.u;
+                    break;
+                }
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+                spec[n++] = conv;
+                spec[n]   = '\0';
+                os.format(spec, arg.type == LogArg::DOUBLE
+                                    ? (unsigned long long)arg.d
+                                    : (unsigned long long)arg.u);
+                break;
+            case 'c':
+                spec[n++] = 'c';
+                spec[n]   = '\0';
+                os.format(spec, arg.type == LogArg::DOUBLE ? (int)arg.d
+                                                           : (int)arg.i);
+                break;
+            case 'p':
+                spec[n++] = 'p';
+                spec[n]   = '\0';
+                os.format(spec, (void *)(uintptr_t)arg.u);
+                break;
+            default: // 浮点数
+                spec[n++] = conv;
+                spec[n]   = '\0';
+                os.format(spec, arg.type == LogArg::DOUBLE ? arg.d
+                                : arg.type == LogArg::INT  ? (double)arg.i
+                                                           : (double)arg.u);
+                break;
+        }
+    }
+}
+
+void Logger::debug(LogEvent::ptr event) { log(LogLevel::DEBUG, event); }
+
+void Logger::info(LogEvent::ptr event) { log(LogLevel::INFO, event); }
+
+void Logger::warn(LogEvent::ptr event) { log(LogLevel::WARN, event); }
+
+void Logger::error(LogEvent::ptr event) { log(LogLevel::ERROR, event); }
+
+void Logger::fatal(LogEvent::ptr event) { log(LogLevel::FATAL, event); }
+
+std::string FileLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "FileLogAppender";
+    node["file"] = m_filename;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/**
+ * @brief 重新打开文件
+ * @details
+ * 如果输出流已经打开, 那么关闭该流, 并以追加的方式, 重新打开该文件流
+ * @return 1 -> success, 0 -> error
+ */
+bool FileLogAppender::reopen()
+{
+    MutexType::Lock lock(m_mutex);
+    if (m_filestream) {
+        m_filestream.close();
+    }
+
+    // m_filestream.open(m_filename, std::ios::app); // 追加方式打开文件
+    // return !!m_filestream;
+    return FSUtil::OpenForWrite(m_filestream, m_filename, std::ios::app);
+}
+
+FileLogAppender::FileLogAppender(const std::string &filename)
+    : m_filename(filename)
+{
+    reopen();
+}
+
+void FileLogAppender::write(uint64_t now, const char *data, size_t len)
+{
+    // 为避免在输出内容时, 文件被删除, 这里每次在输出前都 ropen
+    // if (now != m_lastTime) {
+    if (now >= (m_lastTime + 3)) {
+        if (m_filestream) {
+            m_filestream.close();
+        }
+        FSUtil::OpenForWrite(m_filestream, m_filename, std::ios::app);
+        m_lastTime = now;
+    }
+
+    // 与原来每行 std::endl 一样, 写完即刷新
+    if (!m_filestream.write(data, len).flush()) {
+        std::cout << "error " << std::endl;
+    }
+}
+
+void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,
+                          LogEvent::ptr event)
+{
+    if (level >= m_level) { // 事件的日志级别 是否大于 输出器的 默认级别
+        LogStream buf;
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(buf, *logger, level, *event);
+        write(event->getTime(), buf.data(), buf.size());
+    }
+}
+
+void FileLogAppender::log(Logger &logger, const LogLine &line)
+{
+    if (line.getLevel() >= m_level) {
+        LogStream buf;
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(buf, logger, line);
+        write(line.getTime(), buf.data(), buf.size());
+    }
+}
+
+void StdoutLogAppender::log(std::shared_ptr<Logger> logger,
+                            LogLevel::Level level, LogEvent::ptr event)
+{
+
+    // 只有大于日志默认级别, 才会尝试将其输出
+    // 但是否输出, 还依赖于输出器的输出级别
+    if (level >= m_level) { // 事件的日志级别 是否大于 当前输出器的默认输出级别
+        LogStream buf;
+        MutexType::Lock lock(m_mutex);
+        // std::cout << m_formatter->format(logger, level, event);
+        m_formatter->format(buf, *logger, level, *event);
+        std::cout.write(buf.data(), buf.size()).flush();
+    }
+}
+
+void StdoutLogAppender::log(Logger &logger, const LogLine &line)
+{
+    if (line.getLevel() >= m_level) {
+        LogStream buf;
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(buf, logger, line);
+        std::cout.write(buf.data(), buf.size()).flush();
+    }
+}
+
+std::string StdoutLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "StdoutLogAppender";
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/**
+ * @brief  以追加方式打开日志文件, 目录不存在时先创建
+ * @return 文件句柄, 失败返回 -1
+ */
+static int OpenLogFile(const std::string &filename, const char *who,
+                       int flags = O_WRONLY | O_APPEND)
+{
+    flags |= O_CREAT | O_CLOEXEC;
+    int fd = ::open(filename.c_str(), flags, 0644);
+    if (fd < 0 && errno == ENOENT) {
+        FSUtil::MKDir(FSUtil::Dirname(filename));
+        fd = ::open(filename.c_str(), flags, 0644);
+    }
+    if (fd < 0) {
+        std::cout << who << " open " << filename << " error, errno=" << errno
+                  << " errstr=" << strerror(errno) << std::endl;
+    }
+    return fd;
+}
+
+/**
+ * @brief 用 writev 写出全部数据, 会修改 iovs 的内容
+ */
+static void WriteLogFile(int fd, std::vector<iovec> &iovs, const char *who)
+{
+    size_t idx = 0;
+    while (fd >= 0 && idx < iovs.size()) {
+        int cnt   = (int)std::min<size_t>(iovs.size() - idx, IOV_MAX);
+        ssize_t n = ::writev(fd, &iovs[idx], cnt);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cout << who << " writev error, errno=" << errno
+                      << " errstr=" << strerror(errno) << std::endl;
+            break;
+        }
+        while (n > 0) {
+            if ((size_t)n >= iovs[idx].iov_len) {
+                n -= iovs[idx].iov_len;
+                ++idx;
+            }
+            else {
+                iovs[idx].iov_base = (char *)iovs[idx].iov_base + n;
+                iovs[idx].iov_len -= n;
+                n = 0;
+            }
+        }
+    }
+}
+
+static sylar::ConfigVar<uint32_t>::ptr g_async_queue_size =
+    sylar::Config::Lookup("log.async_queue_size", (uint32_t)8192,
+                          "async log appender per-thread queue size");
+
+static sylar::ConfigVar<uint32_t>::ptr g_async_flush_interval =
+    sylar::Config::Lookup("log.async_flush_interval", (uint32_t)100,
+                          "async log appender idle flush interval ms");
+
+static std::atomic<uint64_t> s_async_appender_id{0};
+
+/**
+ * @brief 单生产者单消费者的定长环形队列
+ * @details 生产者是拥有该队列的线程, 消费者是持有 m_drainMutex 的线程
+ */
+struct AsyncLogAppender::Ring {
+    /**
+     * @brief 一条待写出的日志, 由刷盘线程格式化
+     * @details event 为空时是 SYLAR_LOG_* 的 LogLine, 其字段拷贝在槽位中,
+     *          字符串复用容量; 文件名来自 __FILE__ 或调用点, 是静态字符串
+     */
+    struct Entry {
+        Logger::ptr logger;
+        LogEvent::ptr event;
+        LogLevel::Level level = LogLevel::UNKNOW;
+        const char *file      = nullptr;
+        int32_t line          = 0;
+        uint32_t elapse       = 0;
+        uint32_t threadId     = 0;
+        uint32_t fiberId      = 0;
+        uint64_t time         = 0;
+        std::string threadName;
+        std::string text; /**< 日志内容 */
+    };
+
+    /**
+     * @brief 线程局部的队列引用, 线程退出时把队列标记为无主
+     */
+    struct Ref {
+        Ref(uint64_t i, std::shared_ptr<Ring> r) : id(i), ring(r) {}
+        Ref(Ref &&) = default;
+        Ref &operator=(Ref &&) = default;
+        ~Ref()
+        {
+            if (ring) {
+                ring->orphaned = true;
+            }
+        }
+
+        uint64_t id;
+        std::shared_ptr<Ring> ring;
+    };
+
+    Ring(size_t capacity) : slots(capacity), mask(capacity - 1) {}
+
+    size_t capacity() const { return slots.size(); }
+
+    size_t size() const
+    {
+        return tail.load(std::memory_order_acquire)
+               - head.load(std::memory_order_acquire);
+    }
+
+    template <class Fill>
+    bool push(Fill &fill)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= slots.size()) {
+            return false;
+        }
+        fill(slots[t & mask]);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <class Callback>
+    size_t consume(Callback cb)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        for (size_t i = h; i != t; ++i) {
+            Entry &e = slots[i & mask];
+            cb(e);
+            e.logger.reset();
+            e.event.reset();
+            e.text.clear();
+        }
+        head.store(t, std::memory_order_release);
+        return t - h;
+    }
+
+    std::vector<Entry> slots;
+    size_t mask;
+    std::atomic<bool> closed{false};   /**< 所属 Appender 已析构 */
+    std::atomic<bool> orphaned{false}; /**< 生产线程已退出 */
+
+    char pad0[64];
+    std::atomic<size_t> head{0}; /**< 消费者位置 */
+    char pad1[64];
+    std::atomic<size_t> tail{0}; /**< 生产者位置 */
+    char pad2[64];
+};
+
+const char *AsyncLogAppender::PolicyToString(OverflowPolicy policy)
+{
+    switch (policy) {
+        case DROP_NEWEST:
+            return "drop_newest";
+        case DROP_DEBUG_FIRST:
+            return "drop_debug_first";
+        default:
+            return "block";
+    }
+}
+
+AsyncLogAppender::OverflowPolicy
+AsyncLogAppender::PolicyFromString(const std::string &str)
+{
+    if (str == "drop_newest") {
+        return DROP_NEWEST;
+    }
+    if (str == "drop_debug_first") {
+        return DROP_DEBUG_FIRST;
+    }
+    return BLOCK;
+}
+
+AsyncLogAppender::AsyncLogAppender(const std::string &filename,
+                                   OverflowPolicy policy)
+    : m_filename(filename), m_policy(policy), m_id(++s_async_appender_id)
+{
+    size_t want     = std::max<uint32_t>(g_async_queue_size->getValue(), 2);
+    m_ringCapacity  = 1;
+    while (m_ringCapacity < want) {
+        m_ringCapacity <<= 1;
+    }
+    m_flushInterval = std::max<uint32_t>(g_async_flush_interval->getValue(), 1);
+
+    reopen();
+    m_thread.reset(
+        new Thread(std::bind(&AsyncLogAppender::run, this), "log_flush"));
+}
+
+AsyncLogAppender::~AsyncLogAppender()
+{
+    m_stopping = true;
+    m_wakeup.notify();
+    m_thread->join();
+    drain();
+
+    Mutex::Lock lock(m_ringsMutex);
+    for (auto &ring : m_rings) {
+        ring->closed = true;
+    }
+    if (m_fd >= 0 && !m_filename.empty()) {
+        ::close(m_fd);
+    }
+}
+
+AsyncLogAppender::Ring *AsyncLogAppender::getRing()
+{
+    static thread_local std::vector<Ring::Ref> t_rings;
+
+    for (auto it = t_rings.begin(); it != t_rings.end();) {
+        if (it->id == m_id) {
+            return it->ring.get();
+        }
+        // 顺便清理已析构的 Appender 留下的队列
+        if (it->ring->closed) {
+            it = t_rings.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    std::shared_ptr<Ring> ring(new Ring(m_ringCapacity));
+    {
+        Mutex::Lock lock(m_ringsMutex);
+        m_rings.push_back(ring);
+        ++m_ringsVersion;
+    }
+    t_rings.emplace_back(m_id, ring);
+    return ring.get();
+}
+
+void AsyncLogAppender::wakeup()
+{
+    // 与 run() 中先置 m_sleeping 再检查队列的顺序配对, 避免丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false)) {
+        m_wakeup.notify();
+    }
+}
+
+void AsyncLogAppender::log(std::shared_ptr<Logger> logger,
+                           LogLevel::Level level, LogEvent::ptr event)
+{
+    if (level < m_level) {
+        return;
+    }
+    auto fill = [&logger, &event, level](Ring::Entry &e) {
+        e.logger = logger;
+        e.event  = event;
+        e.level  = level;
+    };
+    enqueue(level, fill);
+}
+
+void AsyncLogAppender::log(Logger &logger, const LogLine &line)
+{
+    if (line.getLevel() < m_level) {
+        return;
+    }
+    // 只拷贝字段, 格式化留给刷盘线程, 生产者之间不共享锁
+    Logger::ptr owner = logger.shared_from_this();
+    auto fill = [&owner, &line](Ring::Entry &e) {
+        e.logger   = std::move(owner);
+        e.level    = line.getLevel();
+        e.file     = line.getFile();
+        e.line     = line.getLine();
+        e.elapse   = line.getElapse();
+        e.threadId = line.getThreadId();
+        e.fiberId  = line.getFiberId();
+        e.time     = line.getTime();
+        e.threadName.assign(line.getThreadName());
+        e.text.assign(line.getContent(), line.getContentSize());
+    };
+    enqueue(line.getLevel(), fill);
+}
+
+template <class Fill>
+void AsyncLogAppender::enqueue(LogLevel::Level level, Fill fill)
+{
+    Ring *ring = getRing();
+    if (m_policy == DROP_DEBUG_FIRST) {
+        size_t used = ring->size();
+        if ((level <= LogLevel::DEBUG && used >= ring->capacity() / 2)
+            || (level <= LogLevel::INFO && used >= ring->capacity() / 4 * 3))
+        {
+            ++m_dropped;
+            wakeup();
+            return;
+        }
+    }
+
+    while (!ring->push(fill)) {
+        if (m_policy == DROP_NEWEST) {
+            ++m_dropped;
+            wakeup();
+            return;
+        }
+        // 此时可能持有 Logger 的自旋锁, 不能让出协程, 只能让出 CPU
+        wakeup();
+        sched_yield();
+    }
+
+    if (level >= LogLevel::ERROR || ring->size() >= ring->capacity() / 4) {
+        wakeup();
+    }
+}
+
+void AsyncLogAppender::flush() { drain(); }
+
+void AsyncLogAppender::run()
+{
+    while (!m_stopping) {
+        drain();
+
+        m_sleeping = true;
+        bool backlog = false;
+        {
+            Mutex::Lock lock(m_drainMutex);
+            for (auto &ring : m_drainRings) {
+                if (ring->size() >= ring->capacity() / 4) {
+                    backlog = true;
+                    break;
+                }
+            }
+        }
+        if (!backlog && !m_stopping) {
+            m_wakeup.waitFor(m_flushInterval);
+        }
+        m_sleeping = false;
+    }
+}
+
+size_t AsyncLogAppender::drain()
+{
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    Mutex::Lock lock(m_drainMutex);
+    if (m_ringsVersion != m_drainVersion) {
+        Mutex::Lock ll(m_ringsMutex);
+        m_drainRings   = m_rings;
+        m_drainVersion = m_ringsVersion;
+    }
+
+    LogFormatter::ptr formatter = getFormatter();
+    if (!formatter) {
+        return 0;
+    }
+
+    LogStream ss;
+    size_t count = 0;
+    bool prune   = false;
+    for (auto &ring : m_drainRings) {
+        count += ring->consume([this, &ss, &formatter](Ring::Entry &e) {
+            if (e.event) {
+                formatter->format(ss, *e.logger, e.level, *e.event);
+            }
+            else {
+                LogLine line(e.level, e.file, e.line, e.elapse, e.threadId,
+                             e.fiberId, e.time, e.threadName);
+                line.getSS().append(e.text);
+                formatter->format(ss, *e.logger, line);
+            }
+            if (ss.size() >= CHUNK_SIZE) {
+                m_chunks.push_back(ss.toString());
+                ss.clear();
+            }
+        });
+        // 先看 orphaned 再看队列, 线程退出后不会再有新的事件
+        if (ring->orphaned && ring->size() == 0) {
+            prune = true;
+        }
+    }
+
+    uint64_t dropped = m_dropped;
+    if (dropped != m_reportedDropped) {
+        ss << "AsyncLogAppender dropped " << dropped - m_reportedDropped
+           << " events\n";
+        m_reportedDropped = dropped;
+    }
+    if (ss.size() > 0) {
+        m_chunks.push_back(ss.toString());
+    }
+
+    if (!m_chunks.empty()) {
+        // 与 FileLogAppender 一样定期重新打开, 避免文件被删除后一直写入旧文件
+        if (!m_filename.empty() && (uint64_t)time(0) >= m_lastOpen + 3) {
+            reopen();
+        }
+        writeChunks();
+    }
+
+    if (prune) {
+        Mutex::Lock ll(m_ringsMutex);
+        for (auto it = m_rings.begin(); it != m_rings.end();) {
+            if ((*it)->orphaned && (*it)->size() == 0) {
+                it = m_rings.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        ++m_ringsVersion;
+    }
+    return count;
+}
+
+bool AsyncLogAppender::reopen()
+{
+    if (m_filename.empty()) {
+        m_fd = STDOUT_FILENO;
+        return true;
+    }
+
+    int fd     = OpenLogFile(m_filename, "AsyncLogAppender");
+    m_lastOpen = time(0);
+    if (fd < 0) {
+        return false;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = fd;
+    return true;
+}
+
+void AsyncLogAppender::writeChunks()
+{
+    std::vector<iovec> iovs(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i) {
+        iovs[i].iov_base = &m_chunks[i][0];
+        iovs[i].iov_len  = m_chunks[i].size();
+    }
+
+    WriteLogFile(m_fd, iovs, "AsyncLogAppender");
+    m_chunks.clear();
+}
+
+std::string AsyncLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    if (m_filename.empty()) {
+        node["type"] = "StdoutLogAppender";
+    }
+    else {
+        node["type"] = "FileLogAppender";
+        node["file"] = m_filename;
+    }
+    node["async"]    = true;
+    node["overflow"] = PolicyToString(m_policy);
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+const char BinaryLogAppender::MAGIC[4] = {'S', 'Y', 'L', 'B'};
+
+BinaryLogAppender::BinaryLogAppender(const std::string &filename)
+    : m_filename(filename), m_buf(64 * 1024)
+{
+    m_lastCheck = m_lastFlush = time(0);
+    reopen();
+}
+
+BinaryLogAppender::~BinaryLogAppender()
+{
+    MutexType::Lock lock(m_mutex);
+    writeBuffer();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool BinaryLogAppender::reopen()
+{
+    int fd = OpenLogFile(m_filename, "BinaryLogAppender");
+    if (fd < 0) {
+        return false;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = fd;
+
+    struct stat st;
+    if (fstat(m_fd, &st) == 0 && st.st_size == 0) {
+        m_buf.write(MAGIC, sizeof(MAGIC));
+        m_buf.writeFuint8(VERSION);
+    }
+    // 新文件里没有之前的定义, 从 SESSION 开始重新定义
+    m_sessionStarted = false;
+    return true;
+}
+
+void BinaryLogAppender::prepare(uint64_t now)
+{
+    // 与 FileLogAppender 一样每 3 秒检查一次, 但只在文件被删除或改名后才重新打开
+    if (now >= m_lastCheck + 3) {
+        m_lastCheck = now;
+        struct stat path_st, fd_st;
+        if (m_fd < 0 || stat(m_filename.c_str(), &path_st) != 0
+            || fstat(m_fd, &fd_st) != 0 || path_st.st_ino != fd_st.st_ino
+            || path_st.st_dev != fd_st.st_dev)
+        {
+            writeBuffer();
+            reopen();
+        }
+    }
+
+    if (!m_sessionStarted || m_formatter.get() != m_sessionFormatter) {
+        m_buf.writeFuint8(SESSION);
+        m_buf.writeStringVint(m_formatter ? m_formatter->getPattern() : "");
+        m_sessionFormatter = m_formatter.get();
+        m_sessionStarted   = true;
+        m_lastTime         = 0;
+        m_sites.clear();
+        m_threads.clear();
+        m_loggers.clear();
+    }
+}
+
+uint32_t BinaryLogAppender::defineLogger(const Logger &logger)
+{
+    auto it = m_loggers.find(&logger);
+    if (it != m_loggers.end()) {
+        return it->second;
+    }
+    uint32_t id = m_loggers.size();
+    m_loggers.emplace(&logger, id);
+    m_buf.writeFuint8(LOGGER);
+    m_buf.writeUint32(id);
+    m_buf.writeStringVint(logger.getName());
+    return id;
+}
+
+void BinaryLogAppender::defineThread(uint32_t thread_id,
+                                     const std::string &name)
+{
+    auto it = m_threads.find(thread_id);
+    if (it != m_threads.end() && it->second == name) {
+        return;
+    }
+    m_threads[thread_id] = name;
+    m_buf.writeFuint8(THREAD);
+    m_buf.writeUint32(thread_id);
+    m_buf.writeStringVint(name);
+}
+
+void BinaryLogAppender::writeHead(uint32_t logger_id, uint64_t time,
+                                  uint32_t thread_id, uint32_t fiber_id)
+{
+    m_buf.writeUint32(logger_id);
+    m_buf.writeInt64((int64_t)(time - m_lastTime));
+    m_lastTime = time;
+    m_buf.writeUint32(thread_id);
+    m_buf.writeUint32(fiber_id);
+}
+
+void BinaryLogAppender::commit(LogLevel::Level level, uint64_t now)
+{
+    static const size_t FLUSH_SIZE = 64 * 1024;
+
+    if (m_buf.getSize() >= FLUSH_SIZE || level >= LogLevel::ERROR
+        || now >= m_lastFlush + 1)
+    {
+        writeBuffer();
+        m_lastFlush = now;
+    }
+}
+
+void BinaryLogAppender::writeBuffer()
+{
+    if (m_buf.getSize() == 0) {
+        return;
+    }
+    m_buf.setPosition(0);
+    m_iovs.clear();
+    m_buf.getReadBuffers(m_iovs, m_buf.getSize());
+    WriteLogFile(m_fd, m_iovs, "BinaryLogAppender");
+    m_buf.clear();
+}
+
+void BinaryLogAppender::flush()
+{
+    MutexType::Lock lock(m_mutex);
+    writeBuffer();
+}
+
+void BinaryLogAppender::log(Logger &logger, const LogRecord &record)
+{
+    if (record.getLevel() < m_level) {
+        return;
+    }
+    const LogSite &site = record.getSite();
+    const LogArg *args  = record.getArgs();
+    size_t count        = record.getArgCount();
+
+    MutexType::Lock lock(m_mutex);
+    prepare(record.getTime());
+    uint32_t logger_id = defineLogger(logger);
+    defineThread(record.getThreadId(), record.getThreadName());
+    if (site.id >= m_sites.size() || !m_sites[site.id]) {
+        if (site.id >= m_sites.size()) {
+            m_sites.resize(site.id + 1);
+        }
+        m_sites[site.id] = true;
+        // 同一调用点的参数类型在编译期就已确定, 只在定义中记录一次
+        char types[64];
+        size_t n = std::min<size_t>(count, sizeof(types));
+        for (size_t i = 0; i < n; ++i) {
+            types[i] = args[i].type;
+        }
+        m_buf.writeFuint8(SITE);
+        m_buf.writeUint32(site.id);
+        m_buf.writeFuint8(site.level);
+        m_buf.writeUint32(site.line);
+        m_buf.writeStringVint(site.file);
+        m_buf.writeStringVint(site.fmt);
+        m_buf.writeUint64(n);
+        m_buf.write(types, n);
+    }
+
+    m_buf.writeFuint8(RECORD);
+    m_buf.writeUint32(site.id);
+    writeHead(logger_id, record.getTime(), record.getThreadId(),
+              record.getFiberId());
+    for (size_t i = 0; i < count && i < 64; ++i) {
+        const LogArg &arg = args[i];
+        switch (arg.type) {
+            case LogArg::INT:
+                m_buf.writeInt64(arg.i);
+                break;
+            case LogArg::UINT:
+                m_buf.writeUint64(arg.u);
+                break;
+            case LogArg::DOUBLE:
+                m_buf.writeDouble(arg.d);
+                break;
+            default:
+                m_buf.writeUint64(arg.len);
+                m_buf.write(arg.s, arg.len);
+                break;
+        }
+    }
+    commit(site.level, record.getTime());
+}
+
+void BinaryLogAppender::log(Logger &logger, const LogLine &line)
+{
+    if (line.getLevel() < m_level) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    prepare(line.getTime());
+    uint32_t logger_id = defineLogger(logger);
+    defineThread(line.getThreadId(), line.getThreadName());
+
+    m_buf.writeFuint8(TEXT);
+    m_buf.writeFuint8(line.getLevel());
+    writeHead(logger_id, line.getTime(), line.getThreadId(),
+              line.getFiberId());
+    m_buf.writeUint32(line.getLine());
+    size_t len = strlen(line.getFile());
+    m_buf.writeUint64(len);
+    m_buf.write(line.getFile(), len);
+    m_buf.writeUint64(line.getContentSize());
+    m_buf.write(line.getContent(), line.getContentSize());
+    commit(line.getLevel(), line.getTime());
+}
+
+void BinaryLogAppender::log(std::shared_ptr<Logger> logger,
+                            LogLevel::Level level, LogEvent::ptr event)
+{
+    LogLine line(level, event->getFile(), event->getLine(), event->getElapse(),
+                 event->getThreadId(), event->getFiberId(), event->getTime(),
+                 event->getThreadName());
+    line.getSS() << event->getContent();
+    log(*logger, line);
+}
+
+std::string BinaryLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "BinaryLogAppender";
+    node["file"] = m_filename;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+static sylar::ConfigVar<uint32_t>::ptr g_mmap_window_size =
+    sylar::Config::Lookup("log.mmap_window_size", (uint32_t)(4 * 1024 * 1024),
+                          "mmap log appender window size");
+
+/**
+ * @brief 找到文件中最后一个非 '\0' 字节之后的位置, 跳过上次异常退出时留下的预扩展部分
+ */
+static uint64_t FindLogDataEnd(int fd, uint64_t size)
+{
+    char buf[64 * 1024];
+    uint64_t end = size;
+    while (end > 0) {
+        size_t len    = std::min<uint64_t>(end, sizeof(buf));
+        ssize_t n = ::pread(fd, buf, len, end - len);
+        if (n != (ssize_t)len) {
+            return end;
+        }
+        for (size_t i = len; i > 0; --i) {
+            if (buf[i - 1] != '\0') {
+                return end - len + i;
+            }
+        }
+        end -= len;
+    }
+    return 0;
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string &filename,
+                                         uint64_t max_size,
+                                         uint32_t rotate_interval)
+    : m_filename(filename), m_maxSize(max_size),
+      m_rotateInterval(rotate_interval)
 {
-    sylar::LogFormatter::ptr new_var(new sylar::LogFormatter(var));
+    size_t page  = sysconf(_SC_PAGESIZE);
+    m_windowSize = (g_mmap_window_size->getValue() + page - 1) / page * page;
+    m_windowSize = std::max(m_windowSize, page);
+    if (m_rotateInterval) {
+        m_rotateAt = (time(0) / m_rotateInterval + 1) * m_rotateInterval;
+    }
 
-    if (new_var->isError()) {
-        std::cout << "Logger setFormatter name=" << m_name << " value=" << var
-                  << " invalid formatter" << std::endl;
-        return;
+    m_eventFd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        std::cout << "MmapFileLogAppender inotify_init1 error, errno=" << errno
+                  << " errstr=" << strerror(errno) << std::endl;
     }
-    setFormatter(new_var);
+    m_cur = openFile(false);
+    m_pos = m_cur.pos;
+    m_thread.reset(
+        new Thread(std::bind(&MmapFileLogAppender::run, this), "log_mmap"));
 }
 
-std::string Logger::toYamlString()
+MmapFileLogAppender::~MmapFileLogAppender()
 {
-    MutexType::Lock lock(m_mutex);
+    m_stopping = true;
+    wakeup();
+    m_thread->join();
 
-    YAML::Node node;
-    node["name"] = m_name;
-    if (m_level != LogLevel::UNKNOW) {
-        node["level"] = LogLevel::ToString(m_level);
+    MutexType::Lock lock(m_mutex);
+    for (auto &win : m_retired) {
+        Unmap(win);
     }
-    if (m_formatter) {
-        node["formatter"] = m_formatter->getPattern();
+    Unmap(m_nextWindow);
+    if (m_cur.base) {
+        m_cur.pos  = m_pos;
+        m_cur.last = true;
+        Unmap(m_cur);
     }
-
-    for (auto &i : m_appenders) {
-        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+    if (m_nextFile.base) {
+        m_nextFile.last = true;
+        Unmap(m_nextFile);
+    }
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+    if (m_eventFd >= 0) {
+        ::close(m_eventFd);
     }
-    std::stringstream ss;
-    ss << node;
-    return ss.str();
 }
 
-LogFormatter::ptr Logger::getFormatter()
+MmapFileLogAppender::Window MmapFileLogAppender::map(int fd, uint64_t offset)
 {
-    MutexType::Lock lock(m_mutex);
-    return m_formatter;
+    Window win;
+    // 预先分配磁盘空间, 避免磁盘满时在缺页处理中触发 SIGBUS
+    int rt = posix_fallocate(fd, offset, m_windowSize);
+    if (rt != 0) {
+        std::cout << "MmapFileLogAppender fallocate " << m_filename
+                  << " error, errno=" << rt << " errstr=" << strerror(rt)
+                  << std::endl;
+        return win;
+    }
+    void *base = mmap(nullptr, m_windowSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, offset);
+    if (base == MAP_FAILED) {
+        std::cout << "MmapFileLogAppender mmap " << m_filename
+                  << " error, errno=" << errno << " errstr=" << strerror(errno)
+                  << std::endl;
+        return win;
+    }
+    win.fd     = fd;
+    win.base   = (char *)base;
+    win.offset = offset;
+    win.size   = m_windowSize;
+    return win;
 }
 
-/**
- * @brief 添加输出器
- * @details 只用来添加输出器
- * @param[in] appender 输出器
- */
-void Logger::addAppender(LogAppender::ptr appender)
+void MmapFileLogAppender::Unmap(const Window &win)
 {
-    MutexType::Lock lock(m_mutex);
+    if (win.base) {
+        munmap(win.base, win.size);
+    }
+    if (win.last && win.fd >= 0) {
+        if (ftruncate(win.fd, win.offset + win.pos) != 0) {
+            std::cout << "MmapFileLogAppender ftruncate error, errno=" << errno
+                      << " errstr=" << strerror(errno) << std::endl;
+        }
+        ::close(win.fd);
+    }
+}
 
-    if (!appender->getFormatter()) {
-        MutexType::Lock ll(appender->m_mutex);
-        appender->m_formatter = m_formatter; // 将日志的默认解析器设置到输出器中
+MmapFileLogAppender::Window MmapFileLogAppender::openFile(bool rotate)
+{
+    // 先移除监视, 自己改名时不会收到 IN_MOVE_SELF
+    if (m_watch >= 0) {
+        inotify_rm_watch(m_inotifyFd, m_watch);
+        m_watch = -1;
+    }
+    if (rotate) {
+        std::string base = m_filename + "." + Time2Str(time(0), "%Y%m%d-%H%M%S");
+        std::string name = base;
+        struct stat st;
+        for (int i = 1; ::stat(name.c_str(), &st) == 0; ++i) {
+            name = base + "." + std::to_string(i);
+        }
+        if (::rename(m_filename.c_str(), name.c_str()) != 0 && errno != ENOENT) {
+            std::cout << "MmapFileLogAppender rename " << m_filename << " to "
+                      << name << " error, errno=" << errno
+                      << " errstr=" << strerror(errno) << std::endl;
+        }
     }
 
-    // std::cout << appender->getFormatter()->getPattern() << std::endl;
+    Window win;
+    int fd = OpenLogFile(m_filename, "MmapFileLogAppender", O_RDWR);
+    if (fd < 0) {
+        return win;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return win;
+    }
+    uint64_t end = FindLogDataEnd(fd, st.st_size);
+    win          = map(fd, end / m_windowSize * m_windowSize);
+    if (!win.base) {
+        ::close(fd);
+        return win;
+    }
+    win.pos = end - win.offset;
 
-    m_appenders.push_back(appender);
+    m_ino = st.st_ino;
+    if (m_inotifyFd >= 0) {
+        m_watch = inotify_add_watch(m_inotifyFd, m_filename.c_str(),
+                                    IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+    }
+    return win;
 }
 
-/**
- * @brief 删除输出器
- * @details 遍历输出器集合, 然后移除与之相应的输出器
- * @param[in] appender 待移除的输出器
- */
-void Logger::delAppender(LogAppender::ptr appender)
+void MmapFileLogAppender::wakeup()
 {
-    MutexType::Lock lock(m_mutex);
-    for (auto it = m_appenders.begin(); it != m_appenders.end(); ++it) {
-        if (*it == appender) {
-            m_appenders.erase(it);
-            break;
-        }
+    uint64_t one = 1;
+    if (::write(m_eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        std::cout << "MmapFileLogAppender wakeup error, errno=" << errno
+                  << " errstr=" << strerror(errno) << std::endl;
     }
 }
 
-void Logger::clearAppenders()
+void MmapFileLogAppender::write(const char *data, size_t len)
 {
-    MutexType::Lock lock(m_mutex);
-    m_appenders.clear();
+    bool wake = false;
+    // 只在行边界切换到轮转后的新文件, 旧文件由后台线程截断并关闭
+    if (m_nextFile.base) {
+        if (m_cur.base) {
+            m_cur.pos  = m_pos;
+            m_cur.last = true;
+            m_retired.push_back(m_cur);
+        }
+        if (m_nextWindow.base) {
+            m_retired.push_back(m_nextWindow);
+        }
+        m_cur             = m_nextFile;
+        m_pos             = m_cur.pos;
+        m_nextFile        = Window();
+        m_nextWindow      = Window();
+        m_rotateRequested = false;
+        wake              = true;
+    }
+
+    while (m_cur.base && len > 0) {
+        if (m_pos == m_cur.size) {
+            // 后台线程还没来得及映射下一个窗口时, 在当前线程映射
+            Window next = m_nextWindow.base
+                              ? m_nextWindow
+                              : map(m_cur.fd, m_cur.offset + m_cur.size);
+            m_nextWindow = Window();
+            if (!next.base) {
+                break;
+            }
+            m_retired.push_back(m_cur);
+            m_cur = next;
+            m_pos = 0;
+            wake  = true;
+        }
+        size_t n = std::min(len, m_cur.size - m_pos);
+        memcpy(m_cur.base + m_pos, data, n);
+        m_pos += n;
+        data += n;
+        len -= n;
+    }
+
+    if (m_maxSize && !m_rotateRequested && m_cur.base
+        && m_cur.offset + m_pos >= m_maxSize)
+    {
+        m_rotateRequested = true;
+        wake              = true;
+    }
+    if (wake) {
+        wakeup();
+    }
 }
 
-/**
- * @brief 日志输出
- * @details 如果日志的级别大于默认级别, 那么尝试遍历输出器集合,
- * 并通过输出器输出日志内容
- * @param[in] level 日志级别
- * @param[in] event 待输出的事件
- */
-void Logger::log(LogLevel::Level level, LogEvent::ptr event)
+void MmapFileLogAppender::run()
 {
-    if (level >= m_level) { // 事件级别 是否 大于 当前日志的默认级别
-
-        auto self = shared_from_this();
+    pollfd fds[2];
+    fds[0].fd     = m_eventFd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = m_inotifyFd;
+    fds[1].events = POLLIN;
+    int nfds      = m_inotifyFd >= 0 ? 2 : 1;
+
+    while (!m_stopping) {
+        fds[0].revents = fds[1].revents = 0;
+        poll(fds, nfds, 1000);
+
+        uint64_t count;
+        while (::read(m_eventFd, &count, sizeof(count)) > 0) {
+        }
 
-        MutexType::Lock lock(m_mutex);
-        // 如果设置了专有输出器
-        if (!m_appenders.empty()) {
-            for (auto &i : m_appenders) {
-                i->log(self, level, event);
+        bool check = false;
+        if (nfds > 1 && (fds[1].revents & POLLIN)) {
+            char buf[4096]
+                __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t n;
+            while ((n = ::read(m_inotifyFd, buf, sizeof(buf))) > 0) {
+                for (char *p = buf; p < buf + n;) {
+                    inotify_event *ev = (inotify_event *)p;
+                    if (ev->wd == m_watch) {
+                        check = true;
+                    }
+                    p += sizeof(inotify_event) + ev->len;
+                }
             }
         }
-        else if (m_root) {
-            m_root->log(level, event);
+        if (check) {
+            struct stat st;
+            if (::stat(m_filename.c_str(), &st) != 0 || (uint64_t)st.st_ino != m_ino) {
+                m_fileGone = true;
+            }
         }
-    }
-}
 
-void Logger::debug(LogEvent::ptr event) { log(LogLevel::DEBUG, event); }
+        uint64_t now = time(0);
+        bool due     = m_rotateInterval && now >= m_rotateAt;
+        std::vector<Window> retired;
+        Window cur;
+        bool pending, rotate, empty;
+        {
+            MutexType::Lock lock(m_mutex);
+            retired.swap(m_retired);
+            // 监视的是最近打开的文件, 还没切换过去就被删除时重新准备
+            if (m_fileGone && m_nextFile.base) {
+                m_nextFile.last = true;
+                retired.push_back(m_nextFile);
+                m_nextFile = Window();
+            }
+            cur     = m_cur;
+            pending = m_nextFile.base != nullptr;
+            rotate  = m_rotateRequested;
+            empty   = m_cur.offset + m_pos == 0;
+        }
 
-void Logger::info(LogEvent::ptr event) { log(LogLevel::INFO, event); }
+        for (auto &win : retired) {
+            Unmap(win);
+        }
 
-void Logger::warn(LogEvent::ptr event) { log(LogLevel::WARN, event); }
+        if (due && (pending || (empty && cur.base))) {
+            // 新文件还没用上或当前文件为空时不按时间轮转
+            m_rotateAt = (now / m_rotateInterval + 1) * m_rotateInterval;
+            due        = false;
+        }
+        rotate = rotate || due;
+        if (!pending && (rotate || m_fileGone || !cur.base)) {
+            // 文件已被删除或改名时直接新建, 不再改名
+            Window win = openFile(rotate && !m_fileGone && cur.base);
+            if (win.base) {
+                m_fileGone = false;
+                if (due) {
+                    m_rotateAt = (now / m_rotateInterval + 1) * m_rotateInterval;
+                }
+                MutexType::Lock lock(m_mutex);
+                m_nextFile = win;
+            }
+            continue;
+        }
 
-void Logger::error(LogEvent::ptr event) { log(LogLevel::ERROR, event); }
+        bool need_window;
+        {
+            MutexType::Lock lock(m_mutex);
+            need_window = m_cur.base && !m_nextWindow.base && !m_nextFile.base
+                          && m_cur.fd == cur.fd && m_cur.offset == cur.offset;
+        }
+        if (need_window) {
+            Window win = map(cur.fd, cur.offset + cur.size);
+            {
+                MutexType::Lock lock(m_mutex);
+                if (win.base && m_cur.fd == cur.fd && m_cur.offset == cur.offset
+                    && !m_nextWindow.base)
+                {
+                    m_nextWindow = win;
+                    win.base     = nullptr;
+                }
+            }
+            Unmap(win);
+        }
+    }
+}
 
-void Logger::fatal(LogEvent::ptr event) { log(LogLevel::FATAL, event); }
+void MmapFileLogAppender::log(std::shared_ptr<Logger> logger,
+                              LogLevel::Level level, LogEvent::ptr event)
+{
+    if (level >= m_level) {
+        LogStream buf;
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(buf, *logger, level, *event);
+        write(buf.data(), buf.size());
+    }
+}
 
-std::string FileLogAppender::toYamlString()
+void MmapFileLogAppender::log(Logger &logger, const LogLine &line)
+{
+    if (line.getLevel() >= m_level) {
+        LogStream buf;
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(buf, logger, line);
+        write(buf.data(), buf.size());
+    }
+}
+
+std::string MmapFileLogAppender::toYamlString()
 {
     MutexType::Lock lock(m_mutex);
     YAML::Node node;
-    node["type"] = "FileLogAppender";
+    node["type"] = "MmapFileLogAppender";
     node["file"] = m_filename;
+    if (m_maxSize) {
+        node["max_size"] = m_maxSize;
+    }
+    if (m_rotateInterval) {
+        node["rotate_interval"] = m_rotateInterval;
+    }
     if (m_level != LogLevel::UNKNOW) {
         node["level"] = LogLevel::ToString(m_level);
     }
@@ -268,83 +1860,102 @@ std::string FileLogAppender::toYamlString()
 }
 
 /**
- * @brief 重新打开文件
- * @details
- * 如果输出流已经打开, 那么关闭该流, 并以追加的方式, 重新打开该文件流
- * @return 1 -> success, 0 -> error
+ * @brief 默认模式, 分别对应 Logger 构造函数和 Logger::initFormatter
  */
-bool FileLogAppender::reopen()
-{
-    MutexType::Lock lock(m_mutex);
-    if (m_filestream) {
-        m_filestream.close();
-    }
+using DefaultLogPattern = CompiledLogPattern<
+    logfmt::DateTime, logfmt::Tab, logfmt::ThreadId, logfmt::Tab,
+    logfmt::ThreadName, logfmt::Tab, logfmt::FiberId, logfmt::Tab,
+    logfmt::Char<'['>, logfmt::Level, logfmt::Char<']'>, logfmt::Tab,
+    logfmt::Char<'['>, logfmt::Name, logfmt::Char<']'>, logfmt::Tab,
+    logfmt::File, logfmt::Char<':'>, logfmt::Line, logfmt::Tab,
+    logfmt::Message, logfmt::NewLine>;
+
+using InitLogPattern = CompiledLogPattern<
+    logfmt::DateTime, logfmt::Tab, logfmt::ThreadId, logfmt::Tab,
+    logfmt::FiberId, logfmt::Tab, logfmt::Char<'['>, logfmt::Level,
+    logfmt::Char<']'>, logfmt::Tab, logfmt::Char<'['>, logfmt::Name,
+    logfmt::Char<']'>, logfmt::Tab, logfmt::File, logfmt::Char<':'>,
+    logfmt::Line, logfmt::Tab, logfmt::Message, logfmt::NewLine>;
 
-    // m_filestream.open(m_filename, std::ios::app); // 追加方式打开文件
-    // return !!m_filestream;
-    return FSUtil::OpenForWrite(m_filestream, m_filename, std::ios::app);
+/**
+ * @brief 已注册的编译期模式
+ * @details 用函数内静态变量保证其它编译单元在静态初始化阶段创建 Logger 时,
+ *          默认模式已经注册
+ */
+static std::map<std::string, LogFormatter::CompiledFunc> &GetCompiledPatterns()
+{
+    static std::map<std::string, LogFormatter::CompiledFunc> s_patterns = {
+        {DefaultLogPattern::Pattern(), &DefaultLogPattern::Format},
+        {InitLogPattern::Pattern(), &InitLogPattern::Format},
+    };
+    return s_patterns;
 }
 
-FileLogAppender::FileLogAppender(const std::string &filename)
-    : m_filename(filename)
+static Spinlock &GetCompiledPatternsMutex()
 {
-    reopen();
+    static Spinlock s_mutex;
+    return s_mutex;
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level,
-                          LogEvent::ptr event)
+void LogFormatter::RegisterCompiled(const std::string &pattern,
+                                    CompiledFunc func)
 {
-    if (level >= m_level) { // 事件的日志级别 是否大于 输出器的 默认级别
-        // uint64_t now = time(0);
-        uint64_t now = event->getTime();
-
-        // 为避免在输出内容时, 文件被删除, 这里每次在输出前都 ropen
-        // if (now != m_lastTime) {
-        if (now >= (m_lastTime + 3)) {
-            reopen();
-            m_lastTime = now;
-        }
+    Spinlock::Lock lock(GetCompiledPatternsMutex());
+    GetCompiledPatterns()[pattern] = func;
+}
 
-        MutexType::Lock lock(m_mutex);
-        // if (!(m_filestream << m_formatter->format(logger, level, event))) {
-        if (!m_formatter->format(m_filestream, logger, level, event)) {
-            std::cout << "error " << std::endl;
+LogFormatter::LogFormatter(const std::string &pattern) : m_pattern(pattern)
+{
+    init();
+    if (!m_error) {
+        Spinlock::Lock lock(GetCompiledPatternsMutex());
+        auto &patterns = GetCompiledPatterns();
+        auto it        = patterns.find(m_pattern);
+        if (it != patterns.end()) {
+            m_compiled = it->second;
         }
     }
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger,
-                            LogLevel::Level level, LogEvent::ptr event)
+uint64_t InternLogTimeFormat(const std::string &fmt)
 {
+    static Spinlock s_mutex;
+    // 0 号固定给 logfmt::DateTime 的格式, 与同格式的 %d 共用缓存
+    static std::unordered_map<std::string, uint64_t> s_ids{{"%Y-%m-%d %H:%M:%S", 0}};
 
-    // 只有大于日志默认级别, 才会尝试将其输出
-    // 但是否输出, 还依赖于输出器的输出级别
-    if (level >= m_level) { // 事件的日志级别 是否大于 当前输出器的默认输出级别
-        MutexType::Lock lock(m_mutex);
-        // std::cout << m_formatter->format(logger, level, event);
-        m_formatter->format(std::cout, logger, level, event);
+    Spinlock::Lock lock(s_mutex);
+    auto it = s_ids.find(fmt);
+    if (it != s_ids.end()) {
+        return it->second;
     }
+    uint64_t id = s_ids.size();
+    s_ids.emplace(fmt, id);
+    return id;
 }
 
-std::string StdoutLogAppender::toYamlString()
+void FormatLogTime(LogStream &os, uint64_t time, const char *fmt,
+                   uint64_t cache_id)
 {
-    MutexType::Lock lock(m_mutex);
-    YAML::Node node;
-    node["type"] = "StdoutLogAppender";
-    if (m_level != LogLevel::UNKNOW) {
-        node["level"] = LogLevel::ToString(m_level);
-    }
-    if (m_hasFormatter && m_formatter) {
-        node["formatter"] = m_formatter->getPattern();
-    }
-    std::stringstream ss;
-    ss << node;
-    return ss.str();
-}
+    struct TimeCache {
+        uint64_t id   = ~0ull;
+        uint64_t time = ~0ull;
+        size_t len    = 0;
+        char buf[64];
+    };
+    // 按编号直接映射的几个槽, 多个输出器使用不同格式时互不驱逐
+    static const size_t CACHE_SIZE = 4;
+    static thread_local TimeCache t_cache[CACHE_SIZE];
 
-LogFormatter::LogFormatter(const std::string &pattern) : m_pattern(pattern)
-{
-    init();
+    TimeCache &cache = t_cache[cache_id & (CACHE_SIZE - 1)];
+    if (cache.time != time || cache.id != cache_id) {
+        struct tm tm;
+        time_t t = time;
+        localtime_r(&t, &tm); // 以线程安全的方式将时间戳转换成本地时间
+        cache.len  = strftime(cache.buf, sizeof(cache.buf), fmt, &tm);
+        cache.time = time;
+        cache.id   = cache_id;
+    }
+    os.append(cache.buf, cache.len);
 }
 
 std::string LogFormatter::format(std::shared_ptr<Logger> logger,
@@ -354,13 +1965,19 @@ std::string LogFormatter::format(std::shared_ptr<Logger> logger,
     // std::cerr << "[formatter] m_items size = " << m_items.size() <<
     // std::endl;
 
-    std::stringstream s_stream;
-
-    for (auto &i : m_items) {
-        i->format(s_stream, logger, level, event);
-    }
+    LogStream os;
+    format(os, *logger, level, *event);
+    return os.toString();
+}
 
-    return s_stream.str();
+void LogFormatter::format(LogStream &os, const Logger &logger,
+                          LogLevel::Level level, const LogEvent &event)
+{
+    LogLine line(level, event.getFile(), event.getLine(), event.getElapse(),
+                 event.getThreadId(), event.getFiberId(), event.getTime(),
+                 event.getThreadName());
+    line.getSS().append(event.getContent());
+    format(os, logger, line);
 }
 
 LogFormatter::ptr LogAppender::getFormatter()
@@ -378,40 +1995,40 @@ LogFormatter::ptr LogAppender::getFormatter()
 class MessageFormatItem : public LogFormatter::FormatItem {
   public:
     MessageFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getContent();
+        os.append(line.getContent(), line.getContentSize());
     }
 };
 
 class LevelFormatItem : public LogFormatter::FormatItem {
   public:
     LevelFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << LogLevel::ToString(level);
+        os << LogLevel::ToString(line.getLevel());
     }
 };
 
 class ElapseFormatItem : public LogFormatter::FormatItem {
   public:
     ElapseFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getElapse();
+        os << line.getElapse();
     }
 };
 
 class ThreadIdFormatItem : public LogFormatter::FormatItem {
   public:
     ThreadIdFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getThreadId();
+        os << line.getThreadId();
     }
 };
 
@@ -419,10 +2036,10 @@ class FiberIdFormatItem : public LogFormatter::FormatItem {
   public:
     FiberIdFormatItem(const std::string &str = "") {}
 
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getFiberId();
+        os << line.getFiberId();
     }
 };
 
@@ -430,10 +2047,10 @@ class ThreadNameFormatItem : public LogFormatter::FormatItem {
   public:
     ThreadNameFormatItem(const std::string &str = "") {}
 
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getThreadName();
+        os << line.getThreadName();
     }
 };
 
@@ -445,43 +2062,37 @@ class DateTimeFormatItem : public LogFormatter::FormatItem {
         if (m_format.empty()) {              // 如果显示地传入了一个空字符串
             m_format = "%Y-%m-%d  %H:%M:%S"; // eward append
         }
+        m_cacheId = InternLogTimeFormat(m_format);
     }
 
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm); // 以线程安全的方式将时间戳转换成本地时间
-        char buf[64];
-
-        // 将时间格式化输入字符串中
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-
-        os << buf;
+        FormatLogTime(os, line.getTime(), m_format.c_str(), m_cacheId);
     }
 
   private:
     std::string m_format;
+    uint64_t m_cacheId; /**< 格式字符串的编号, 同一格式的 %d 共用时间缓存 */
 };
 
 class FilenameFormatItem : public LogFormatter::FormatItem {
   public:
     FilenameFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getFile();
+        os << line.getFile();
     }
 };
 
 class NameFormatItem : public LogFormatter::FormatItem {
   public:
     NameFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << logger->getName();
+        os << logger.getName();
         // os << event->getLogger()->getName();
     }
 };
@@ -489,30 +2100,30 @@ class NameFormatItem : public LogFormatter::FormatItem {
 class LineFormatItem : public LogFormatter::FormatItem {
   public:
     LineFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << event->getLine();
+        os << line.getLine();
     }
 };
 
 class NewLineFormatItem : public LogFormatter::FormatItem {
   public:
     NewLineFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << std::endl;
+        os << '\n';
     }
 };
 
 class TabFormatItem : public LogFormatter::FormatItem {
   public:
     TabFormatItem(const std::string &str = "") {}
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
-        os << "\t";
+        os << '\t';
     }
 
   private:
@@ -523,8 +2134,8 @@ class StringFormatItem : public LogFormatter::FormatItem {
   public:
     StringFormatItem(const std::string &str) : m_string(str) {}
 
-    void format(std::ostream &os, Logger::ptr logger, LogLevel::Level level,
-                LogEvent::ptr event) override
+    void format(LogStream &os, const Logger &logger,
+                const LogLine &line) override
     {
         os << m_string;
     }
@@ -537,10 +2148,9 @@ std::ostream &LogFormatter::format(std::ostream &ofs,
                                    std::shared_ptr<Logger> logger,
                                    LogLevel::Level level, LogEvent::ptr event)
 {
-    for (auto &i : m_items) {
-        i->format(ofs, logger, level, event);
-    }
-    return ofs;
+    LogStream os;
+    format(os, *logger, level, *event);
+    return ofs.write(os.data(), os.size());
 }
 
 void LogFormatter::init()
@@ -693,32 +2303,66 @@ LogEvent::LogEvent(LogLevel::Level level, const char *file, int32_t line,
       m_level(level)
 {}
 
-Logger::ptr LoggerManager::getLogger(const std::string &name)
+const Logger::ptr *LoggerManager::find(const std::string &name,
+                                       size_t hash) const
 {
-    MutexType::Lock lock(m_mutex);
+    // 节点发布后不再修改, acquire 保证读到完整的节点
+    Node *node = m_buckets[hash % BUCKETS].load(std::memory_order_acquire);
+    for (; node; node = node->next) {
+        if (node->name == name) {
+            return &node->logger;
+        }
+    }
+    return nullptr;
+}
 
-    auto it = m_loggers.find(name);
+void LoggerManager::insert(const Logger::ptr &logger, size_t hash)
+{
+    std::atomic<Node *> &head = m_buckets[hash % BUCKETS];
+    Node *node = new Node{logger->m_name, logger,
+                          head.load(std::memory_order_relaxed)};
+    head.store(node, std::memory_order_release);
+}
 
-    if (it != m_loggers.end()) {
-        return it->second;
+const Logger::ptr &LoggerManager::getLogger(const std::string &name)
+{
+    size_t hash = std::hash<std::string>()(name);
+    const Logger::ptr *found = find(name, hash);
+    if (found) {
+        return *found;
+    }
+
+    MutexType::Lock lock(m_mutex);
+    // 加锁期间可能已被其他线程创建
+    found = find(name, hash);
+    if (found) {
+        return *found;
     }
 
     Logger::ptr logger(new Logger(name));
     logger->m_root  = m_root;
     m_loggers[name] = logger;
-    return logger;
+    insert(logger, hash);
+    return *find(name, hash);
 }
 
 struct LogAppenderDefine {
-    int type              = 0; // 1->file, 2->stdout
+    int type              = 0; // 1->file, 2->stdout, 3->binary, 4->mmap
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::string file;
+    bool async   = false; // 是否使用 AsyncLogAppender
+    int overflow = 0;     // AsyncLogAppender::OverflowPolicy
+    uint64_t max_size        = 0; // MmapFileLogAppender 按大小轮转
+    uint32_t rotate_interval = 0; // MmapFileLogAppender 按时间轮转
 
     bool operator==(const LogAppenderDefine &oth) const
     {
         return type == oth.type && level == oth.level
-               && formatter == oth.formatter && file == oth.file;
+               && formatter == oth.formatter && file == oth.file
+               && async == oth.async && overflow == oth.overflow
+               && max_size == oth.max_size
+               && rotate_interval == oth.rotate_interval;
     }
 };
 
@@ -727,11 +2371,13 @@ struct LogDefine {
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::vector<LogAppenderDefine> appenders;
+    LogSamplePolicy sample;
 
     bool operator==(const LogDefine &oth) const
     {
         return name == oth.name && level == oth.level
-               && formatter == oth.formatter && appenders == oth.appenders;
+               && formatter == oth.formatter && appenders == oth.appenders
+               && sample == oth.sample;
     }
 
     bool operator<(const LogDefine &oth) const { return name < oth.name; }
@@ -761,6 +2407,19 @@ class LexicalCast<std::string, std::set<LogDefine>> {
                 ld.formatter = n["formatter"].as<std::string>();
             }
 
+            auto sample = n["sample"];
+            if (sample.IsDefined()) {
+                if (sample["first"].IsDefined()) {
+                    ld.sample.first = sample["first"].as<uint32_t>();
+                }
+                if (sample["every"].IsDefined()) {
+                    ld.sample.every = sample["every"].as<uint32_t>();
+                }
+                if (sample["interval"].IsDefined()) {
+                    ld.sample.interval = sample["interval"].as<uint32_t>();
+                }
+            }
+
             if (n["appenders"].IsDefined()) {
                 // std::cout << "==" << ld.name << " = " <<
                 // n["appenders"].size()
@@ -792,12 +2451,52 @@ class LexicalCast<std::string, std::set<LogDefine>> {
                     else if (type == "StdoutLogAppender") {
                         lad.type = 2;
                     }
+                    else if (type == "MmapFileLogAppender") {
+                        lad.type = 4;
+                        if (!a["file"].IsDefined()) {
+                            std::cout << "log config error: mmapappender"
+                                         " file is null, "
+                                      << a << std::endl;
+                            continue;
+                        }
+                        lad.file = a["file"].as<std::string>();
+                        if (a["formatter"].IsDefined()) {
+                            lad.formatter = a["formatter"].as<std::string>();
+                        }
+                        if (a["max_size"].IsDefined()) {
+                            lad.max_size = a["max_size"].as<uint64_t>();
+                        }
+                        if (a["rotate_interval"].IsDefined()) {
+                            lad.rotate_interval =
+                                a["rotate_interval"].as<uint32_t>();
+                        }
+                    }
+                    else if (type == "BinaryLogAppender") {
+                        lad.type = 3;
+                        if (!a["file"].IsDefined()) {
+                            std::cout << "log config error: binaryappender"
+                                         " file is null, "
+                                      << a << std::endl;
+                            continue;
+                        }
+                        lad.file = a["file"].as<std::string>();
+                        if (a["formatter"].IsDefined()) {
+                            lad.formatter = a["formatter"].as<std::string>();
+                        }
+                    }
                     else {
                         std::cout << "Log config error: appender type is"
                                      " invaild, "
                                   << a << std::endl;
                         continue;
                     }
+                    if (a["async"].IsDefined()) {
+                        lad.async = a["async"].as<bool>();
+                    }
+                    if (a["overflow"].IsDefined()) {
+                        lad.overflow = AsyncLogAppender::PolicyFromString(
+                            a["overflow"].as<std::string>());
+                    }
                     ld.appenders.push_back(lad);
                 }
             }
@@ -824,6 +2523,11 @@ class LexicalCast<std::set<LogDefine>, std::string> {
             if (i.formatter.empty()) {
                 n["formatter"] = i.formatter;
             }
+            if (!(i.sample == LogSamplePolicy())) {
+                n["sample"]["first"]    = i.sample.first;
+                n["sample"]["every"]    = i.sample.every;
+                n["sample"]["interval"] = i.sample.interval;
+            }
 
             for (auto &a : i.appenders) {
                 YAML::Node na;
@@ -834,6 +2538,25 @@ class LexicalCast<std::set<LogDefine>, std::string> {
                 else if (a.type == 2) { // std
                     na["type"] = "StdoutLogAppender";
                 }
+                else if (a.type == 3) { // binary
+                    na["type"] = "BinaryLogAppender";
+                    na["file"] = a.file;
+                }
+                else if (a.type == 4) { // mmap
+                    na["type"] = "MmapFileLogAppender";
+                    na["file"] = a.file;
+                    if (a.max_size) {
+                        na["max_size"] = a.max_size;
+                    }
+                    if (a.rotate_interval) {
+                        na["rotate_interval"] = a.rotate_interval;
+                    }
+                }
+                if (a.async) {
+                    na["async"]    = true;
+                    na["overflow"] = AsyncLogAppender::PolicyToString(
+                        (AsyncLogAppender::OverflowPolicy)a.overflow);
+                }
                 if (a.level != LogLevel::UNKNOW) {
                     na["level"] = LogLevel::ToString(a.level);
                 }
@@ -871,12 +2594,15 @@ struct LogIniter {
                     logger = SYLAR_LOG_NAME(i.name);
                 }
                 else {
-                    if (!(i == *it)) {
-                        // 修改 logger
-                        logger = SYLAR_LOG_NAME(i.name);
+                    if (i == *it) {
+                        // 未修改的 logger 保持原样
+                        continue;
                     }
+                    // 修改 logger
+                    logger = SYLAR_LOG_NAME(i.name);
                 }
                 logger->setLevel(i.level);
+                logger->setSample(i.sample);
                 if (!i.formatter.empty()) {
                     logger->setFormatter(i.formatter);
                 }
@@ -884,18 +2610,36 @@ struct LogIniter {
                 logger->clearAppenders();
                 for (auto &a : i.appenders) {
                     sylar::LogAppender::ptr ap;
+                    auto policy = (AsyncLogAppender::OverflowPolicy)a.overflow;
                     if (a.type == 1) {
-                        ap.reset(new FileLogAppender(a.file));
+                        if (a.async) {
+                            ap.reset(new AsyncLogAppender(a.file, policy));
+                        }
+                        else {
+                            ap.reset(new FileLogAppender(a.file));
+                        }
                     }
                     else if (a.type == 2) {
                         // ap.reset(new StdoutLogAppender);
                         if (!sylar::EnvMgr::GetInstance()->has("d")) {
-                            ap.reset(new StdoutLogAppender);
+                            if (a.async) {
+                                ap.reset(new AsyncLogAppender("", policy));
+                            }
+                            else {
+                                ap.reset(new StdoutLogAppender);
+                            }
                         }
                         else {
                             continue;
                         }
                     }
+                    else if (a.type == 3) {
+                        ap.reset(new BinaryLogAppender(a.file));
+                    }
+                    else if (a.type == 4) {
+                        ap.reset(new MmapFileLogAppender(a.file, a.max_size,
+                                                         a.rotate_interval));
+                    }
                     ap->setLevel(a.level);
                     if (!a.formatter.empty()) {
                         LogFormatter::ptr fmt(new LogFormatter(a.formatter));
@@ -919,6 +2663,7 @@ struct LogIniter {
                     // 删除logger
                     auto logger = SYLAR_LOG_NAME(i.name);
                     logger->setLevel((LogLevel::Level)0);
+                    logger->setSample(LogSamplePolicy());
                     logger->clearAppenders();
                 }
             }
@@ -943,11 +2688,28 @@ std::string LoggerManager::toYamlString()
 
 LoggerManager::LoggerManager()
 {
+    for (auto &i : m_buckets) {
+        i.store(nullptr, std::memory_order_relaxed);
+    }
+
     // 一开始直接设置一个默认的 stdoutLogAppender
     m_root.reset(new Logger);
     m_root->addAppender(LogAppender::ptr(new StdoutLogAppender));
 
     m_loggers[m_root->m_name] = m_root;
+    insert(m_root, std::hash<std::string>()(m_root->m_name));
+}
+
+LoggerManager::~LoggerManager()
+{
+    for (auto &i : m_buckets) {
+        Node *node = i.load(std::memory_order_relaxed);
+        while (node) {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
 }
 
 } // namespace sylar
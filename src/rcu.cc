@@ -0,0 +1,128 @@
+#include "sylar/rcu.hh"
+#include "sylar/thread.hh"
+
+#include <assert.h>
+#include <linux/membarrier.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sylar {
+
+/**
+ * @brief 每个读线程一个槽位, 记录它进入临界区时的全局纪元, 0 表示不在临界区内
+ */
+struct RcuSlot {
+    std::atomic<uint64_t> epoch{0};
+    bool used = false;
+    char pad[64]; /**< 避免不同线程的槽位共享缓存行 */
+};
+
+/**
+ * @brief 已分配的槽位, 只在线程首次进入临界区、线程退出和写者等待时加锁
+ */
+struct RcuRegistry {
+    Mutex mutex;
+    std::vector<RcuSlot *> slots;
+};
+
+static RcuRegistry &GetRcuRegistry()
+{
+    // 线程退出时还会用到, 不析构
+    static RcuRegistry *s_registry = new RcuRegistry;
+    return *s_registry;
+}
+
+/**
+ * @brief 注册进程内的 membarrier, 内核不支持时返回 false
+ */
+static bool RegisterMembarrier()
+{
+    long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+        return false;
+    }
+    return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+}
+
+__thread RcuReadLock::ThreadState RcuReadLock::t_state;
+std::atomic<uint64_t> RcuReadLock::s_epoch{1};
+// 可用时由写者用 membarrier 让所有运行中的线程各执行一次内存屏障, 读者只需编译器屏障.
+// 静态初始化之前读到的是 false, 读写两侧都退回 seq_cst 屏障, 同样正确
+bool RcuReadLock::s_membarrier = RegisterMembarrier();
+
+static thread_local RcuSlot *t_rcu_slot = nullptr;
+
+/**
+ * @brief 线程退出时归还槽位
+ */
+struct RcuSlotHolder {
+    ~RcuSlotHolder()
+    {
+        if (!t_rcu_slot) {
+            return;
+        }
+        RcuRegistry &reg = GetRcuRegistry();
+        Mutex::Lock lock(reg.mutex);
+        t_rcu_slot->epoch.store(0, std::memory_order_release);
+        t_rcu_slot->used           = false;
+        t_rcu_slot                 = nullptr;
+        RcuReadLock::t_state.epoch = nullptr;
+    }
+};
+
+static RcuSlot *AcquireRcuSlot()
+{
+    static thread_local RcuSlotHolder t_holder;
+    (void)t_holder;
+
+    RcuRegistry &reg = GetRcuRegistry();
+    Mutex::Lock lock(reg.mutex);
+    for (auto slot : reg.slots) {
+        if (!slot->used) {
+            slot->used = true;
+            return slot;
+        }
+    }
+    RcuSlot *slot = new RcuSlot;
+    slot->used    = true;
+    reg.slots.push_back(slot);
+    return slot;
+}
+
+void RcuReadLock::RegisterThread()
+{
+    t_rcu_slot    = AcquireRcuSlot();
+    t_state.epoch = &t_rcu_slot->epoch;
+}
+
+void RcuSynchronize()
+{
+    assert(RcuReadLock::t_state.depth == 0);
+
+    // 新指针已发布, 之后进入临界区的读者一定读到新指针
+    if (!RcuReadLock::s_membarrier
+        || syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) != 0)
+    {
+        // 读者可能只用了编译器屏障, membarrier 失败时无法补救, 不应发生
+        assert(!RcuReadLock::s_membarrier);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    uint64_t target =
+        RcuReadLock::s_epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    RcuRegistry &reg = GetRcuRegistry();
+    Mutex::Lock lock(reg.mutex);
+    for (auto slot : reg.slots) {
+        for (;;) {
+            uint64_t epoch = slot->epoch.load(std::memory_order_acquire);
+            if (epoch == 0 || epoch >= target) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+} // namespace sylar
@@ -2,16 +2,136 @@
 #include "sylar/log.hh"
 #include "sylar/hook.hh"
 #include "sylar/macro.hh"
+#include "sylar/config.hh"
 
 namespace sylar {
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static ConfigVar<bool>::ptr g_scheduler_work_stealing =
+    Config::Lookup<bool>("scheduler.work_stealing", false,
+                         "scheduler per-thread run queues with work stealing");
+
+static ConfigVar<bool>::ptr g_scheduler_shared_stack_callbacks =
+    Config::Lookup<bool>("scheduler.shared_stack_callbacks", false,
+                         "run scheduled callbacks on shared stack fibers");
+
+static ConfigVar<uint32_t>::ptr g_scheduler_local_queue_size =
+    Config::Lookup<uint32_t>("scheduler.local_queue_size", 1024,
+                             "scheduler per-thread run queue capacity");
+
 static thread_local Scheduler *t_scheduler =
     nullptr; // 标记当前线程所属的调度器
 
 // 当前线程对应的协程对象
 static thread_local Fiber *t_scheduler_fiber = nullptr;
 
+// 当前正在执行的任务固定的线程, -1 表示任意线程
+static thread_local int t_task_thread = -1;
+
+/**
+ * @brief   工作线程本地任务队列
+ * @details 有界 Chase-Lev 双端队列, 只有所属线程在底部 push/pop,
+ *          其他线程从顶部 steal; 指定线程的任务放入加锁的收件箱
+ */
+struct Scheduler::WorkQueue {
+    WorkQueue(Scheduler *s, size_t capacity)
+        : owner(s), mask(capacity - 1),
+          buffer(new std::atomic<FiberAndThread *>[capacity])
+    {
+        for (size_t i = 0; i < capacity; ++i) {
+            buffer[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~WorkQueue()
+    {
+        FiberAndThread *ft = nullptr;
+        while ((ft = pop())) {
+            delete ft;
+        }
+    }
+
+    /**
+     * @brief 所属线程压入任务, 队列满时返回 false
+     */
+    bool push(FiberAndThread *ft)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > (int64_t)mask) {
+            return false;
+        }
+        buffer[b & mask].store(ft, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief 所属线程弹出最近压入的任务
+     */
+    FiberAndThread *pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        FiberAndThread *ft = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // 只剩最后一个任务, 与窃取者竞争
+            if (!top.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed))
+            {
+                ft = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return ft;
+    }
+
+    /**
+     * @brief 其他线程窃取最早压入的任务
+     */
+    FiberAndThread *steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+
+        FiberAndThread *ft = buffer[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return ft;
+    }
+
+    Scheduler *owner;                                   /**< 所属调度器 */
+    std::atomic<int> thread{-1};                        /**< 所属线程 ID */
+    size_t mask;                                        /**< 容量掩码 */
+    std::unique_ptr<std::atomic<FiberAndThread *>[]> buffer; /**< 环形缓冲 */
+    std::atomic<int64_t> top{0};                        /**< 窃取端 */
+    std::atomic<int64_t> bottom{0};                     /**< 所属线程端 */
+
+    MutexType inboxMutex;                 /**< 收件箱锁 */
+    std::list<FiberAndThread> inbox;      /**< 指定本线程执行的任务 */
+    std::atomic<size_t> inboxSize{0};     /**< 收件箱任务数, 供其他线程无锁查看 */
+};
+
+// 当前线程的本地任务队列(工作窃取模式)
+static thread_local Scheduler::WorkQueue *t_work_queue = nullptr;
+
 Scheduler::Scheduler(size_t threads, bool include_caller_thread, const std::string &name)
     : m_name(name)
 {
@@ -37,6 +157,7 @@ Scheduler::Scheduler(size_t threads, bool include_caller_thread, const std::stri
         m_rootThread = -1;
     }
     m_threadCount = threads;
+    m_workStealing = g_scheduler_work_stealing->getValue();
 }
 
 Scheduler::~Scheduler()
@@ -64,6 +185,16 @@ Scheduler *Scheduler::GetThis()
 
 Fiber *Scheduler::GetMainFiber() { return t_scheduler_fiber; }
 
+int Scheduler::GetTaskThread() { return t_task_thread; }
+
+void Scheduler::setWorkStealing(bool v)
+{
+    MutexType::Lock lock(m_mutex);
+    SYLAR_ASSERT2(m_stopping && m_threads.empty(),
+                  "setWorkStealing must be called before start");
+    m_workStealing = v;
+}
+
 void Scheduler::start()
 {
     {
@@ -76,10 +207,29 @@ void Scheduler::start()
 
         m_threads.resize(m_threadCount);
 
+        if (m_workStealing && m_queues.empty()) {
+            // 容量取 2 的幂, 每个工作线程一个队列, use_caller 线程排在最后
+            size_t capacity = 2;
+            while (capacity < g_scheduler_local_queue_size->getValue()) {
+                capacity <<= 1;
+            }
+            size_t count = m_threadCount + (m_rootThread != -1 ? 1 : 0);
+            for (size_t i = 0; i < count; ++i) {
+                m_queues.emplace_back(new WorkQueue(this, capacity));
+            }
+            if (m_rootThread != -1) {
+                m_queues.back()->thread = m_rootThread;
+            }
+        }
+
         // 线程池的创建, 绑定任务函数
         for (size_t i = 0; i < m_threadCount; ++i) {
             m_threads[i].reset(new Thread(
-                [this]() {
+                [this, i]() {
+                    if (m_workStealing) {
+                        t_work_queue = m_queues[i].get();
+                        t_work_queue->thread = sylar::GetThreadId();
+                    }
                     this->run();
                 },
                  "Thread_"));
@@ -159,6 +309,129 @@ void Scheduler::stop()
 
 void Scheduler::setThis() { t_scheduler = this; }
 
+void Scheduler::scheduleStealing(FiberAndThread &ft)
+{
+    // 指定了线程: 直接投递到目标线程的收件箱
+    if (ft.thread != -1) {
+        for (auto &q : m_queues) {
+            if (q->thread == ft.thread) {
+                {
+                    MutexType::Lock lock(q->inboxMutex);
+                    q->inbox.push_back(ft);
+                    ++q->inboxSize;
+                    ++m_queuedCount;
+                }
+                tickle();
+                return;
+            }
+        }
+    }
+    // 当前线程是本调度器的工作线程: 压入本线程队列
+    else if (t_scheduler == this && t_work_queue
+             && t_work_queue->owner == this)
+    {
+        bool was_empty = t_work_queue->bottom.load(std::memory_order_relaxed)
+                         == t_work_queue->top.load(std::memory_order_relaxed);
+        FiberAndThread *task = new FiberAndThread(std::move(ft));
+        ++m_queuedCount;
+        if (t_work_queue->push(task)) {
+            // 本线程队列原本为空时, 唤醒空闲线程来窃取
+            if (was_empty && hasIdleThreads()) {
+                tickle();
+            }
+            return;
+        }
+        --m_queuedCount;
+        ft = std::move(*task);
+        delete task;
+    }
+
+    // 非工作线程/队列已满/目标线程未知: 退回全局队列
+    bool need_tickle = false;
+    {
+        MutexType::Lock lock(m_mutex);
+        need_tickle = m_fibers.empty();
+        m_fibers.push_back(ft);
+    }
+    if (need_tickle) {
+        tickle();
+    }
+}
+
+bool Scheduler::takeStealing(FiberAndThread &ft, bool &tickle_me)
+{
+    WorkQueue *self = (t_work_queue && t_work_queue->owner == this)
+                          ? t_work_queue
+                          : nullptr;
+
+    FiberAndThread *task = nullptr;
+    // 1. 本线程队列(后进先出, 缓存友好)
+    if (self && (task = self->pop())) {
+        ++m_activeThreadCount; // 先计入活跃, 再移出排队计数, 避免 stopping() 误判
+        --m_queuedCount;
+        ft = std::move(*task);
+        delete task;
+        return true;
+    }
+
+    // 2. 本线程收件箱
+    if (self) {
+        MutexType::Lock lock(self->inboxMutex);
+        if (!self->inbox.empty()) {
+            ft = std::move(self->inbox.front());
+            self->inbox.pop_front();
+            --self->inboxSize;
+            ++m_activeThreadCount;
+            --m_queuedCount;
+            return true;
+        }
+    }
+
+    // 3. 全局队列
+    {
+        MutexType::Lock lock(m_mutex);
+        for (auto it = m_fibers.begin(); it != m_fibers.end(); ++it) {
+            if (it->thread != -1 && it->thread != sylar::GetThreadId()) {
+                tickle_me = true;
+                continue;
+            }
+            if (it->fiber && it->fiber->getState() == Fiber::EXEC) {
+                continue;
+            }
+            ft = std::move(*it);
+            m_fibers.erase(it);
+            ++m_activeThreadCount;
+            return true;
+        }
+    }
+
+    // 4. 从其他线程队列窃取(先进先出), 起点随机以分散竞争
+    size_t count = m_queues.size();
+    if (count > 1) {
+        static thread_local uint32_t s_seed = sylar::GetThreadId();
+        s_seed = s_seed * 1103515245 + 12345;
+        size_t start = (s_seed >> 16) % count;
+        for (size_t i = 0; i < count; ++i) {
+            WorkQueue *victim = m_queues[(start + i) % count].get();
+            if (victim == self) {
+                continue;
+            }
+            // 收件箱任务只能由所属线程执行, 唤醒一次以免其阻塞在 idle 中
+            if (victim->inboxSize > 0) {
+                tickle_me = true;
+            }
+            if ((task = victim->steal())) {
+                ++m_activeThreadCount;
+                --m_queuedCount;
+                ft = std::move(*task);
+                delete task;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void Scheduler::run()
 {
 
@@ -167,6 +440,9 @@ void Scheduler::run()
     if (sylar::GetThreadId() != m_rootThread) {
         t_scheduler_fiber = Fiber::GetThis().get();
     }
+    else if (m_workStealing && !m_queues.empty()) {
+        t_work_queue = m_queues.back().get();
+    }
 
     SYLAR_LOG_INFO(g_logger) << "run";
 
@@ -180,6 +456,7 @@ void Scheduler::run()
 
     // 创建回调的任务协程对象
     Fiber::ptr cb_fiber;
+    bool shared_stack_cb = g_scheduler_shared_stack_callbacks->getValue();
 
     FiberAndThread ft; // 临时任务对象
 
@@ -189,7 +466,18 @@ void Scheduler::run()
         bool tickle_me = false;
         bool is_active = false;
         // 挑选合适的执行者和合适的任务
-        {
+        if (m_workStealing) {
+            is_active = takeStealing(ft, tickle_me);
+            if (is_active && ft.fiber
+                && ft.fiber->getState() == Fiber::EXEC)
+            {
+                // 协程仍在其他线程上执行(尚未切出), 放回全局队列稍后再取
+                MutexType::Lock lock(m_mutex);
+                m_fibers.push_back(ft);
+                ft.reset();
+            }
+        }
+        else {
             MutexType::Lock lock(m_mutex);
             auto it = m_fibers.begin();
 
@@ -232,12 +520,14 @@ void Scheduler::run()
             && (ft.fiber->getState() != Fiber::TERM
                 && ft.fiber->getState() != Fiber::EXCEPT))
         { // 任务是协程对象
+            t_task_thread = ft.thread;
             ft.fiber->swapIn();
+            t_task_thread = -1;
             --m_activeThreadCount;
 
             if (ft.fiber->getState() == Fiber::READY) {
-                // 若未彻底执行结束, 例如 yield  --> 重新加入调度队列
-                schedule(ft.fiber);
+                // 若未彻底执行结束, 例如 yield  --> 重新加入调度队列, 仍固定在原线程
+                schedule(ft.fiber, ft.thread);
             }
             else if (ft.fiber->getState() != Fiber::TERM
                      && ft.fiber->getState() != Fiber::EXCEPT)
@@ -255,15 +545,18 @@ void Scheduler::run()
             }
             else {
                 // 创建回调协程函数对象
-                cb_fiber.reset(new Fiber(ft.cb));
+                cb_fiber.reset(new Fiber(ft.cb, 0, false, shared_stack_cb));
             }
+            int thread = ft.thread;
             ft.reset(); // 清空临时任务对象
 
+            t_task_thread = thread;
             cb_fiber->swapIn();
+            t_task_thread = -1;
             --m_activeThreadCount;
 
             if (cb_fiber->getState() == Fiber::READY) {
-                schedule(cb_fiber);
+                schedule(cb_fiber, thread);
                 cb_fiber.reset();
             }
             else if (cb_fiber->getState() == Fiber::EXCEPT
@@ -306,7 +599,7 @@ bool Scheduler::stopping()
     MutexType::Lock lock(m_mutex);
 
     return m_autoStop && m_stopping && m_fibers.empty()
-           && m_activeThreadCount == 0;
+           && m_queuedCount == 0 && m_activeThreadCount == 0;
 }
 
 void Scheduler::idle()
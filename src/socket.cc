@@ -73,7 +73,7 @@ Socket::~Socket() { close(); }
 
 int64_t Socket::getSendTimeout()
 {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    FdCtx *ctx = FdMgr::GetInstance()->get(m_sock);
     if (ctx) {
         return ctx->getTimeout(SO_SNDTIMEO);
     }
@@ -88,7 +88,7 @@ void Socket::setSendTimeout(int64_t v)
 
 int64_t Socket::getRecvTimeout()
 {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    FdCtx *ctx = FdMgr::GetInstance()->get(m_sock);
     if (ctx) {
         return ctx->getTimeout(SO_RCVTIMEO);
     }
@@ -131,10 +131,13 @@ Socket::ptr Socket::accept() {
 	int newsock = ::accept(m_sock, nullptr, nullptr);
 
 	if(newsock == -1) {
-		SYLAR_LOG_ERROR(g_logger)
-		 << "accept(" << m_sock << ") errno="
-			<< errno << " errstr=" << strerror(errno);
-			return nullptr;
+		// 设置了接收超时时, 超时是正常的返回
+		if(errno != ETIMEDOUT) {
+			SYLAR_LOG_ERROR(g_logger)
+			 << "accept(" << m_sock << ") errno="
+				<< errno << " errstr=" << strerror(errno);
+		}
+		return nullptr;
 	}
 
 	if(sock->init(newsock)) {
@@ -143,6 +146,17 @@ Socket::ptr Socket::accept() {
 	return nullptr;
 }
 
+bool Socket::setReusePort(bool v) {
+	if(!isVaild()) {
+		newSock();
+		if(SYLAR_UNLICKLY(!isVaild())) {
+			return false;
+		}
+	}
+	int val = v ? 1 : 0;
+	return setOption(SOL_SOCKET, SO_REUSEPORT, val);
+}
+
 bool Socket::bind(const Address::ptr addr) {
 	if(!isVaild()) {
 		newSock();
@@ -454,7 +468,7 @@ void Socket::newSock() {
 }
 
 bool Socket::init(int sock) {
-	FdCtx::ptr ctx = FdMgr::GetInstance()->get(sock);
+	FdCtx *ctx = FdMgr::GetInstance()->get(sock);
 	if(ctx && ctx->isSocket() && !ctx->isClose()) {
 		m_sock = sock;
 		m_isConnected = true;
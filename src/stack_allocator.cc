@@ -0,0 +1,295 @@
+#include "sylar/stack_allocator.hh"
+#include "sylar/config.hh"
+#include "sylar/log.hh"
+#include "sylar/macro.hh"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<std::string>::ptr g_fiber_stack_allocator =
+    Config::Lookup<std::string>("fiber.stack_allocator", "malloc",
+                                "fiber stack allocator: malloc/mmap/pool");
+
+static ConfigVar<uint32_t>::ptr g_stack_pool_max_cached =
+    Config::Lookup<uint32_t>("fiber.stack_pool.max_cached", 64,
+                             "max free stacks cached per thread");
+
+static ConfigVar<uint32_t>::ptr g_stack_pool_max_resident =
+    Config::Lookup<uint32_t>("fiber.stack_pool.max_resident", 16,
+                             "max cached stacks per thread kept resident");
+
+std::atomic<uint64_t> StackAllocator::s_allocated{0};
+std::atomic<uint64_t> StackAllocator::s_pooled{0};
+std::atomic<uint64_t> StackAllocator::s_resident{0};
+
+static std::atomic<StackAllocator *> s_default_allocator{nullptr};
+static std::atomic<uint32_t> s_max_cached{64};
+static std::atomic<uint32_t> s_max_resident{16};
+
+struct _StackAllocatorIniter {
+    _StackAllocatorIniter()
+    {
+        s_default_allocator = StackAllocator::Get(g_fiber_stack_allocator->getValue());
+        s_max_cached        = g_stack_pool_max_cached->getValue();
+        s_max_resident      = g_stack_pool_max_resident->getValue();
+
+        g_fiber_stack_allocator->addListener(
+            [](const std::string &old_value, const std::string &new_value) {
+                StackAllocator *allocator = StackAllocator::Get(new_value);
+                if (!allocator) {
+                    SYLAR_LOG_ERROR(g_logger)
+                        << "unknown fiber.stack_allocator " << new_value
+                        << ", keep " << old_value;
+                    return;
+                }
+                SYLAR_LOG_INFO(g_logger) << "fiber stack allocator changed from "
+                                         << old_value << " to " << new_value;
+                s_default_allocator = allocator;
+            });
+        g_stack_pool_max_cached->addListener(
+            [](const uint32_t &old_value, const uint32_t &new_value) {
+                s_max_cached = new_value;
+            });
+        g_stack_pool_max_resident->addListener(
+            [](const uint32_t &old_value, const uint32_t &new_value) {
+                s_max_resident = new_value;
+            });
+    }
+};
+
+static _StackAllocatorIniter s_stack_allocator_initer;
+
+StackAllocator *StackAllocator::Get(const std::string &name)
+{
+    // 分配器无状态且永不释放, 保证进程退出阶段析构的协程仍可归还栈
+    static StackAllocator *s_malloc = new MallocStackAllocator;
+    static StackAllocator *s_mmap   = new MmapStackAllocator;
+    static StackAllocator *s_pool   = new PooledStackAllocator;
+
+    if (name == "malloc") {
+        return s_malloc;
+    }
+    else if (name == "mmap") {
+        return s_mmap;
+    }
+    else if (name == "pool") {
+        return s_pool;
+    }
+    return nullptr;
+}
+
+StackAllocator *StackAllocator::GetDefault()
+{
+    StackAllocator *allocator = s_default_allocator;
+    return allocator ? allocator : Get("malloc");
+}
+
+StackAllocator::Stats StackAllocator::GetStats()
+{
+    Stats stats;
+    stats.allocated = s_allocated;
+    stats.pooled    = s_pooled;
+    stats.resident  = s_resident;
+    return stats;
+}
+
+void *MallocStackAllocator::alloc(size_t size)
+{
+    void *vp = malloc(size);
+    if (vp) {
+        ++s_allocated;
+        s_resident += size;
+    }
+    return vp;
+}
+
+void MallocStackAllocator::dealloc(void *vp, size_t size)
+{
+    free(vp);
+    --s_allocated;
+    s_resident -= size;
+}
+
+size_t MmapStackAllocator::RoundSize(size_t size)
+{
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    return (size + s_page_size - 1) & ~(s_page_size - 1);
+}
+
+void *MmapStackAllocator::Map(size_t size)
+{
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    size = RoundSize(size);
+
+    char *base = (char *)mmap(nullptr, size + s_page_size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) {
+        SYLAR_LOG_ERROR(g_logger) << "mmap fiber stack size=" << size
+                                  << " errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+
+    // 栈从高地址向低地址增长, 最低的一页作为保护页
+    if (mprotect(base, s_page_size, PROT_NONE)) {
+        SYLAR_LOG_ERROR(g_logger) << "mprotect fiber stack guard page errno="
+                                  << errno << " errstr=" << strerror(errno);
+        munmap(base, size + s_page_size);
+        return nullptr;
+    }
+    return base + s_page_size;
+}
+
+void MmapStackAllocator::Unmap(void *vp, size_t size)
+{
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    if (munmap((char *)vp - s_page_size, RoundSize(size) + s_page_size)) {
+        SYLAR_LOG_ERROR(g_logger) << "munmap fiber stack errno=" << errno
+                                  << " errstr=" << strerror(errno);
+    }
+}
+
+void *MmapStackAllocator::alloc(size_t size)
+{
+    void *vp = Map(size);
+    if (vp) {
+        ++s_allocated;
+        s_resident += RoundSize(size);
+    }
+    return vp;
+}
+
+void MmapStackAllocator::dealloc(void *vp, size_t size)
+{
+    Unmap(vp, size);
+    --s_allocated;
+    s_resident -= RoundSize(size);
+}
+
+/**
+ * @brief 线程本地的空闲栈链表, 只缓存同一种大小的栈
+ */
+struct StackPool {
+    size_t stacksize = 0;     /**< 缓存栈的大小(已按页取整) */
+    std::vector<void *> hot;  /**< 仍常驻内存的空闲栈 */
+    std::vector<void *> cold; /**< 已归还物理内存的空闲栈 */
+};
+
+static thread_local StackPool *t_stack_pool = nullptr;
+static thread_local bool t_stack_pool_closed = false; /**< 线程已进入退出清理阶段 */
+
+/**
+ * @brief 线程退出时释放线程本地栈池, 之后归还的栈直接 munmap
+ */
+struct StackPoolHolder {
+    ~StackPoolHolder()
+    {
+        PooledStackAllocator::Trim();
+        delete t_stack_pool;
+        t_stack_pool        = nullptr;
+        t_stack_pool_closed = true;
+    }
+};
+
+static thread_local StackPoolHolder t_stack_pool_holder;
+
+void *PooledStackAllocator::alloc(size_t size)
+{
+    size = MmapStackAllocator::RoundSize(size);
+
+    StackPool *pool = t_stack_pool;
+    if (pool && pool->stacksize == size) {
+        if (!pool->hot.empty()) {
+            void *vp = pool->hot.back();
+            pool->hot.pop_back();
+            --s_pooled;
+            ++s_allocated;
+            return vp;
+        }
+        if (!pool->cold.empty()) {
+            void *vp = pool->cold.back();
+            pool->cold.pop_back();
+            --s_pooled;
+            ++s_allocated;
+            s_resident += size;
+            return vp;
+        }
+    }
+
+    void *vp = MmapStackAllocator::Map(size);
+    if (vp) {
+        ++s_allocated;
+        s_resident += size;
+    }
+    return vp;
+}
+
+void PooledStackAllocator::dealloc(void *vp, size_t size)
+{
+    size = MmapStackAllocator::RoundSize(size);
+    --s_allocated;
+
+    StackPool *pool = t_stack_pool;
+    if (!pool && t_stack_pool_closed) {
+        MmapStackAllocator::Unmap(vp, size);
+        s_resident -= size;
+        return;
+    }
+    if (!pool) {
+        (void)&t_stack_pool_holder; // 注册线程退出时的清理
+        pool = t_stack_pool = new StackPool;
+        pool->stacksize = size;
+    }
+
+    if (pool->stacksize != size
+        || pool->hot.size() + pool->cold.size() >= s_max_cached)
+    {
+        MmapStackAllocator::Unmap(vp, size);
+        s_resident -= size;
+        return;
+    }
+
+    ++s_pooled;
+    if (pool->hot.size() < s_max_resident) {
+        pool->hot.push_back(vp);
+        return;
+    }
+
+    // 常驻的空闲栈已经足够, 归还物理页, 保留虚拟地址以便复用
+    if (madvise(vp, size, MADV_DONTNEED)) {
+        SYLAR_LOG_ERROR(g_logger) << "madvise fiber stack errno=" << errno
+                                  << " errstr=" << strerror(errno);
+    }
+    s_resident -= size;
+    pool->cold.push_back(vp);
+}
+
+void PooledStackAllocator::Trim()
+{
+    StackPool *pool = t_stack_pool;
+    if (!pool) {
+        return;
+    }
+
+    s_pooled -= pool->hot.size() + pool->cold.size();
+    s_resident -= pool->hot.size() * pool->stacksize;
+    for (auto vp : pool->hot) {
+        MmapStackAllocator::Unmap(vp, pool->stacksize);
+    }
+    for (auto vp : pool->cold) {
+        MmapStackAllocator::Unmap(vp, pool->stacksize);
+    }
+    pool->hot.clear();
+    pool->cold.clear();
+}
+
+} // namespace sylar
@@ -6,9 +6,9 @@ int Stream::readFixSize(void *buffer, size_t length)
 {
 	size_t offset = 0;
 	size_t left = length;
-	size_t read_size = 0;
+	int read_size = 0;
 	while(left > 0) {
-		read_size = read((char*)buffer+offset, length);
+		read_size = read((char*)buffer+offset, left);
 		if(read_size <= 0) {
 			return read_size;
 		}
@@ -23,9 +23,9 @@ int Stream::readFixSize(void *buffer, size_t length)
 int Stream::readFixSize(ByteArray::ptr ba, size_t length)
 {
 	size_t left = length;
-	size_t read_size = 0;
+	int read_size = 0;
 	while(left > 0) {
-		read_size = read(ba, length);
+		read_size = read(ba, left);
 		if(read_size <= 0) {
 			return read_size;
 		}
@@ -40,11 +40,11 @@ int Stream::readFixSize(ByteArray::ptr ba, size_t length)
 int Stream::writeFixSize(const void *buffer, size_t length)
 {
 	size_t offset = 0;
-	size_t write_size = 0;
+	int write_size = 0;
 	size_t left = length;
 
 	while(left > 0) {
-		write_size = write((char*)buffer+offset, length);
+		write_size = write((char*)buffer+offset, left);
 		if(write_size <= 0) {
 			return write_size;
 		}
@@ -58,11 +58,11 @@ int Stream::writeFixSize(const void *buffer, size_t length)
 
 int Stream::writeFixSize(ByteArray::ptr ba, size_t length)
 {
-	size_t write_size = 0;
+	int write_size = 0;
 	size_t left = length;
 
 	while(left > 0) {
-		write_size = write(ba, length);
+		write_size = write(ba, left);
 		if(write_size <= 0) {
 			return write_size;
 		}
@@ -1,6 +1,7 @@
 #include "http/tcp_server.hh"
 #include "sylar/log.hh"
 #include "sylar/config.hh"
+#include "sylar/util.hh"
 
 namespace sylar {
 
@@ -8,6 +9,11 @@ namespace sylar {
         sylar::Config::Lookup("tcp_server.read_timeout", (uint64_t)(60 * 1000 * 2),
                               "tcp server read timeout");
 
+    static sylar::ConfigVar<uint64_t>::ptr g_tcp_server_accept_timeout =
+        sylar::Config::Lookup("tcp_server.accept_timeout", (uint64_t)1000,
+                              "tcp server accept timeout in reuse_port mode, "
+                              "bounds how long an accept loop may miss stop()");
+
     static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
     TcpServer::TcpServer(sylar::IOManager *worker,
@@ -39,29 +45,48 @@ namespace sylar {
                       std::vector<Address::ptr>& fails)
     {
         for(auto& addr : addrs) {
-            Socket::ptr sock = Socket::CreateTCP(addr);
-            if(!sock->bind(addr)) {
-                SYLAR_LOG_ERROR(g_logger) << "bind fail error="
-                    << errno << " errstr=" << strerror(errno)
-                    << " addr=[" << addr->toString() << "]";
-                fails.push_back(addr);
+            // 分片监听时每个工作线程一个监听 socket, 否则只有一个, 不固定线程
+            std::vector<int> threads(1, -1);
+            if(m_reusePort && !m_worker->getThreadIds().empty()) {
+                threads = m_worker->getThreadIds();
             }
-            // SYLAR_LOG_DEBUG(g_logger) << "bind success, wait for listen";
-
-            if(!sock->listen()) {
-                SYLAR_LOG_ERROR(g_logger) << "listen fail errno="
-                    << errno << " errstr=" << strerror(errno)
-                    << " addr=[" << addr->toString() << "]";
-                fails.push_back(addr);
-                continue;
+
+            for(int thread : threads) {
+                Socket::ptr sock = Socket::CreateTCP(addr);
+                if(m_reusePort && !sock->setReusePort(true)) {
+                    SYLAR_LOG_ERROR(g_logger) << "set SO_REUSEPORT fail errno="
+                        << errno << " errstr=" << strerror(errno)
+                        << " addr=[" << addr->toString() << "]";
+                    fails.push_back(addr);
+                    break;
+                }
+
+                if(!sock->bind(addr)) {
+                    SYLAR_LOG_ERROR(g_logger) << "bind fail error="
+                        << errno << " errstr=" << strerror(errno)
+                        << " addr=[" << addr->toString() << "]";
+                    fails.push_back(addr);
+                    break;
+                }
+                // SYLAR_LOG_DEBUG(g_logger) << "bind success, wait for listen";
+
+                if(!sock->listen()) {
+                    SYLAR_LOG_ERROR(g_logger) << "listen fail errno="
+                        << errno << " errstr=" << strerror(errno)
+                        << " addr=[" << addr->toString() << "]";
+                    fails.push_back(addr);
+                    break;
+                }
+                // SYLAR_LOG_DEBUG(g_logger) << "listen success, "
+                //                               "wait for client connects";
+                m_socks.push_back(sock);
+                m_sockThreads.push_back(thread);
             }
-            // SYLAR_LOG_DEBUG(g_logger) << "listen success, "
-            //                               "wait for client connects";
-            m_socks.push_back(sock);
         }
 
         if(!fails.empty()) {
             m_socks.clear();
+            m_sockThreads.clear();
             return false;
         }
 
@@ -73,16 +98,25 @@ namespace sylar {
     }
 
     void TcpServer::startAccept(Socket::ptr sock) {
+        // 分片监听时 stop 在 worker 的任意线程上执行, 取消等待时其他线程上的本协程
+        // 可能还没挂起, 监听句柄随后被关闭并被复用, 这里的等待就再也不会被唤醒.
+        // 给 accept 加上超时, 保证能看到 m_isStop 退出. 单监听时 accept 协程在
+        // accept_worker 上, 保持原来的行为, 不加超时
+        if(m_reusePort) {
+            sock->setRecvTimeout(g_tcp_server_accept_timeout->getValue());
+        }
         while(!m_isStop) {
             Socket::ptr client = sock->accept();
             if(client) {
                 client->setRecvTimeout(m_recvTimeout);
 
                 auto self = shared_from_this();
+                // 分片监听时 accept 协程已固定在 worker 的线程上, 新连接留在本线程处理,
+                // 之后等待 IO 或定时器时也会回到本线程
                 m_worker->schedule([self, client](){
                     self->handleClient(client);
-                });
-            } else {
+                }, m_reusePort ? sylar::GetThreadId() : -1);
+            } else if(errno != ETIMEDOUT) {
                 SYLAR_LOG_ERROR(g_logger) << "accept errno=" << errno
                     << " errstr=" << strerror(errno);
             }
@@ -94,11 +128,18 @@ namespace sylar {
             return true;
         }
         m_isStop = false;
-        for(auto& sock : m_socks) {
+        for(size_t i = 0; i < m_socks.size(); ++i) {
             auto self = shared_from_this();
-            m_acceptWorker->schedule([self, sock](){
-                self->startAccept(sock);
-            });
+            Socket::ptr sock = m_socks[i];
+            if(m_reusePort) {
+                m_worker->schedule([self, sock](){
+                    self->startAccept(sock);
+                }, m_sockThreads[i]);
+            } else {
+                m_acceptWorker->schedule([self, sock](){
+                    self->startAccept(sock);
+                });
+            }
         }
         return true;
     }
@@ -106,12 +147,15 @@ namespace sylar {
     void TcpServer::stop() {
         m_isStop = true;
         auto self = shared_from_this();
-        m_acceptWorker->schedule([this, self](){
+        // 监听 socket 的事件注册在 accept 协程所在的调度器上
+        IOManager *iom = m_reusePort ? m_worker : m_acceptWorker;
+        iom->schedule([this, self](){
             for(auto& sock: m_socks) {
                 sock->cancelAll();
                 sock->close();
             }
             m_socks.clear();
+            m_sockThreads.clear();
         });
     }
 
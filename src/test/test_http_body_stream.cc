@@ -0,0 +1,411 @@
+#include "http/http_body_stream.hh"
+#include "http/http_connection.hh"
+#include "http/http_server.hh"
+#include "sylar/iomanager.hh"
+#include "sylar/log.hh"
+#include "sylar/macro.hh"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 每次最多交出 step 字节的数据来源, 模拟被拆成小段的网络读取
+ */
+struct StringSource {
+    std::string data;
+    size_t offset = 0;
+    size_t step   = 1;
+
+    int read(void *buffer, size_t length)
+    {
+        size_t n = std::min(std::min(length, step), data.size() - offset);
+        memcpy(buffer, &data[offset], n);
+        offset += n;
+        return n;
+    }
+};
+
+static sylar::http::HttpBodyStream::ptr
+make_stream(StringSource &src, bool chunked, uint64_t length = 0)
+{
+    return std::make_shared<sylar::http::HttpBodyStream>(
+        std::bind(&StringSource::read, &src, std::placeholders::_1,
+                  std::placeholders::_2),
+        chunked, length);
+}
+
+static int read_all(sylar::http::HttpBodyStream::ptr stream, std::string &out)
+{
+    char buf[5];
+    int rt;
+    while ((rt = stream->read(buf, sizeof(buf))) > 0) {
+        out.append(buf, rt);
+    }
+    return rt;
+}
+
+void test_content_length()
+{
+    for (size_t step : {1, 3, 64}) {
+        StringSource src;
+        src.data = "hello world" "GET /next HTTP/1.1\r\n\r\n";
+        src.step = step;
+        auto stream = make_stream(src, false, 11);
+
+        std::string body;
+        SYLAR_ASSERT(read_all(stream, body) == 0);
+        SYLAR_ASSERT(body == "hello world");
+        SYLAR_ASSERT(stream->isFinished() && !stream->hasError());
+        // 下一个请求的字节还在来源中
+        SYLAR_ASSERT(src.offset == 11);
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_content_length ok";
+}
+
+void test_chunked()
+{
+    for (size_t step : {1, 7, 64}) {
+        StringSource src;
+        src.data = "5\r\nhello\r\n"
+                   "1;name=value\r\n \r\n"
+                   "A\r\n0123456789\r\n"
+                   "0\r\n"
+                   "X-Checksum: abc\r\n"
+                   "\r\n"
+                   "next";
+        src.step = step;
+        auto stream = make_stream(src, true);
+
+        std::string body;
+        SYLAR_ASSERT(read_all(stream, body) == 0);
+        SYLAR_ASSERT(body == "hello 0123456789");
+        SYLAR_ASSERT(stream->isFinished() && stream->getReadSize() == 16);
+        SYLAR_ASSERT(src.data.substr(src.offset) == "next");
+    }
+
+    // 没读完的部分可以丢弃
+    StringSource src;
+    src.data    = "3\r\nabc\r\n3\r\ndef\r\n0\r\n\r\n";
+    auto stream = make_stream(src, true);
+    char c;
+    SYLAR_ASSERT(stream->read(&c, 1) == 1 && c == 'a');
+    stream->close();
+    SYLAR_ASSERT(stream->read(&c, 1) < 0);
+    SYLAR_ASSERT(stream->discard(1024) && stream->isFinished());
+
+    // 长度行不合法
+    src.data    = "zz\r\nabc\r\n";
+    src.offset  = 0;
+    stream      = make_stream(src, true);
+    SYLAR_ASSERT(stream->read(&c, 1) < 0 && stream->hasError());
+    SYLAR_LOG_INFO(g_logger) << "test_chunked ok";
+}
+
+void test_early_close()
+{
+    StringSource src;
+    src.data    = "only part of";
+    auto stream = make_stream(src, false, 100);
+    std::string body;
+    SYLAR_ASSERT(read_all(stream, body) < 0);
+    SYLAR_ASSERT(body == src.data && stream->hasError() && !stream->isFinished());
+
+    // chunk 数据中途断开, 以及缺少结束块
+    for (const char *data : {"a\r\n01234", "3\r\nabc\r\n"}) {
+        StringSource src;
+        src.data    = data;
+        auto stream = make_stream(src, true);
+        std::string body;
+        SYLAR_ASSERT(read_all(stream, body) < 0 && stream->hasError());
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_early_close ok";
+}
+
+/**
+ * @brief 服务端按需读取上传的请求体, 客户端按需读取 chunked 响应体
+ */
+void test_socket()
+{
+    sylar::Address::ptr addr = sylar::Address::LookupAny("127.0.0.1:8031");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true));
+    server->setStreamBody(true);
+    while (!server->bind(addr)) {
+        sleep(2);
+    }
+    server->getServletDispatcher()->addServlet(
+        "/upload", [](sylar::http::HttpRequest::ptr req,
+                      sylar::http::HttpResponse::ptr rsp,
+                      sylar::http::HttpSession::ptr session) {
+            // 只用一个小缓冲读完任意大小的请求体
+            char buf[4096];
+            uint64_t total = 0;
+            int rt;
+            while ((rt = req->getBodyStream()->read(buf, sizeof(buf))) > 0) {
+                total += rt;
+            }
+            rsp->setBody(std::to_string(total) + (rt < 0 ? " broken" : ""));
+            return 0;
+        });
+    server->start();
+
+    // 手写的服务端, 发送 chunked 响应
+    sylar::Address::ptr raw_addr = sylar::Address::LookupAny("127.0.0.1:8032");
+    sylar::Socket::ptr raw       = sylar::Socket::CreateTCP(raw_addr);
+    SYLAR_ASSERT(raw->bind(raw_addr) && raw->listen());
+    sylar::IOManager::GetThis()->schedule([raw]() {
+        sylar::Socket::ptr client = raw->accept();
+        std::string rsp = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (int i = 0; i < 1000; ++i) {
+            rsp += "400\r\n" + std::string(1024, 'a' + i % 26) + "\r\n";
+        }
+        rsp += "0\r\n\r\n";
+        sylar::SocketStream(client).writeFixSize(rsp.data(), rsp.size());
+    });
+
+    sylar::IOManager::GetThis()->schedule([addr, raw_addr, server, raw]() {
+        // 64MB 的上传, 超过 http.request.max_body_size 也能处理
+        sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        sylar::http::HttpConnection::ptr conn(
+            new sylar::http::HttpConnection(sock));
+        uint64_t size = 64ull * 1024 * 1024 + 1;
+        std::string head = "POST /upload HTTP/1.1\r\nConnection: keep-alive\r\n"
+                           "Content-Length: " + std::to_string(size) + "\r\n\r\n";
+        SYLAR_ASSERT(conn->writeFixSize(head.data(), head.size()) > 0);
+        std::string piece(1024 * 1024, 'x');
+        for (uint64_t left = size; left > 0;) {
+            size_t n = std::min<uint64_t>(left, piece.size());
+            SYLAR_ASSERT(conn->writeFixSize(piece.data(), n) > 0);
+            left -= n;
+        }
+        auto rsp = conn->recvResponse();
+        SYLAR_ASSERT(rsp && rsp->getBody() == std::to_string(size));
+
+        // 上传中途断开, 处理函数读到错误
+        std::string partial = "POST /upload HTTP/1.1\r\nContent-Length: 100\r\n\r\nabc";
+        SYLAR_ASSERT(conn->writeFixSize(partial.data(), partial.size()) > 0);
+        ::shutdown(sock->getSocket(), SHUT_WR);
+        rsp = conn->recvResponse();
+        SYLAR_ASSERT(rsp && rsp->getBody() == "3 broken");
+        server->stop();
+
+        // 按需读取 chunked 响应体
+        sock = sylar::Socket::CreateTCP(raw_addr);
+        SYLAR_ASSERT(sock->connect(raw_addr));
+        conn.reset(new sylar::http::HttpConnection(sock));
+        rsp = conn->recvResponseHead();
+        SYLAR_ASSERT(rsp && rsp->getBody().empty());
+        char buf[300];
+        uint64_t total = 0;
+        int rt;
+        while ((rt = rsp->getBodyStream()->read(buf, sizeof(buf))) > 0) {
+            SYLAR_ASSERT(buf[0] == (char)('a' + total / 1024 % 26));
+            total += rt;
+        }
+        SYLAR_ASSERT(rt == 0 && total == 1000 * 1024);
+        raw->close();
+        SYLAR_LOG_INFO(g_logger) << "test_socket ok";
+    });
+}
+
+static std::string recv_until_close(sylar::Socket::ptr sock)
+{
+    std::string data;
+    char buf[4096];
+    int rt;
+    while ((rt = sock->recv(buf, sizeof(buf))) > 0) {
+        data.append(buf, rt);
+    }
+    return data;
+}
+
+/**
+ * @brief chunked 请求体的解码和生成函数产生的 chunked 响应, 与长连接一起工作
+ */
+void test_chunked_server()
+{
+    sylar::Address::ptr addr = sylar::Address::LookupAny("127.0.0.1:8033");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true));
+    while (!server->bind(addr)) {
+        sleep(2);
+    }
+    auto sd = server->getServletDispatcher();
+    sd->addServlet("/echo", [](sylar::http::HttpRequest::ptr req,
+                               sylar::http::HttpResponse::ptr rsp,
+                               sylar::http::HttpSession::ptr session) {
+        std::string body = req->getBody();
+        rsp->setBodyProducer([body](sylar::Stream::ptr writer) {
+            // 每 4 字节一个 chunk
+            for (size_t i = 0; i < body.size(); i += 4) {
+                size_t n = std::min<size_t>(4, body.size() - i);
+                if (writer->writeFixSize(&body[i], n) <= 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        return 0;
+    });
+    sd->addServlet("/fail", [](sylar::http::HttpRequest::ptr req,
+                               sylar::http::HttpResponse::ptr rsp,
+                               sylar::http::HttpSession::ptr session) {
+        rsp->setBodyProducer([](sylar::Stream::ptr writer) {
+            writer->writeFixSize("partial", 7);
+            return false;
+        });
+        return 0;
+    });
+    sd->addServlet("/empty", [](sylar::http::HttpRequest::ptr req,
+                                sylar::http::HttpResponse::ptr rsp,
+                                sylar::http::HttpSession::ptr session) {
+        rsp->setStatus(sylar::http::HttpStatus::NO_CONTENT);
+        rsp->setBodyProducer([](sylar::Stream::ptr writer) {
+            writer->writeFixSize("partial", 7);
+            return true;
+        });
+        return 0;
+    });
+    server->start();
+
+    sylar::IOManager::GetThis()->schedule([addr, server]() {
+        // chunked 请求, 带扩展和 trailer, 后面紧跟管线化的第二个请求
+        sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        sylar::http::HttpConnection::ptr conn(
+            new sylar::http::HttpConnection(sock));
+        std::string req = "POST /echo HTTP/1.1\r\nConnection: keep-alive\r\n"
+                          "Transfer-Encoding: chunked\r\n\r\n"
+                          "6;ext=1\r\nhello \r\n5\r\nworld\r\n0\r\n"
+                          "X-Trailer: 1\r\n\r\n"
+                          "POST /echo HTTP/1.1\r\nConnection: keep-alive\r\n"
+                          "Content-Length: 3\r\n\r\nabc";
+        SYLAR_ASSERT(conn->writeFixSize(req.data(), req.size()) > 0);
+        auto rsp = conn->recvResponse();
+        SYLAR_ASSERT(rsp && rsp->getBody() == "hello world");
+        SYLAR_ASSERT(rsp->getHeaders("transfer-encoding") == "chunked");
+        rsp = conn->recvResponse();
+        SYLAR_ASSERT(rsp && rsp->getBody() == "abc");
+        SYLAR_ASSERT(rsp->getHeaders("connection") == "keep-alive");
+
+        // 生成失败时没有结束块, 连接被关闭
+        req = "GET /fail HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+        SYLAR_ASSERT(conn->writeFixSize(req.data(), req.size()) > 0);
+        SYLAR_ASSERT(!conn->recvResponse());
+
+        // 不支持的传输编码
+        sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        req = "POST /echo HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\nxx";
+        sock->send(req.data(), req.size());
+        SYLAR_ASSERT(recv_until_close(sock).empty());
+
+        // HTTP/1.0 不用 chunked, 以关闭连接结束响应体
+        sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        req = "POST /echo HTTP/1.0\r\nContent-Length: 6\r\n\r\nsylar!";
+        sock->send(req.data(), req.size());
+        std::string data = recv_until_close(sock);
+        SYLAR_ASSERT(data.find("transfer-encoding") == std::string::npos);
+        SYLAR_ASSERT(data.find("connection: close") != std::string::npos);
+        SYLAR_ASSERT(data.substr(data.size() - 10) == "\r\n\r\nsylar!");
+
+        // 同时带 Transfer-Encoding 和 Content-Length 时按 chunked, 响应后关闭连接
+        sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        req = "POST /echo HTTP/1.1\r\nConnection: keep-alive\r\n"
+              "Content-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n"
+              "3\r\nabc\r\n0\r\n\r\n";
+        sock->send(req.data(), req.size());
+        data = recv_until_close(sock);
+        SYLAR_ASSERT(data.find("connection: close") != std::string::npos);
+        std::string tail = "\r\n\r\n3\r\nabc\r\n0\r\n\r\n";
+        SYLAR_ASSERT(data.substr(data.size() - tail.size()) == tail);
+
+        // HEAD 请求和 204 响应只有响应头, 不调用生成函数, 连接继续复用
+        sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        req = "HEAD /fail HTTP/1.1\r\nConnection: keep-alive\r\n\r\n"
+              "GET /empty HTTP/1.1\r\n\r\n";
+        sock->send(req.data(), req.size());
+        data = recv_until_close(sock);
+        SYLAR_ASSERT(data.find("partial") == std::string::npos);
+        size_t second = data.find("HTTP/1.1 204");
+        SYLAR_ASSERT(data.compare(0, 15, "HTTP/1.1 200 OK") == 0 &&
+                     second != std::string::npos);
+        SYLAR_ASSERT(data.find("transfer-encoding", second) == std::string::npos);
+        SYLAR_ASSERT(data.substr(data.size() - 4) == "\r\n\r\n");
+
+        server->stop();
+        SYLAR_LOG_INFO(g_logger) << "test_chunked_server ok";
+    });
+}
+
+/**
+ * @brief 连接和会话析构后, 手里的消息体流读取失败, 不回调到已析构的对象
+ */
+void test_detached()
+{
+    sylar::Address::ptr addr = sylar::Address::LookupAny("127.0.0.1:8034");
+    sylar::Socket::ptr raw   = sylar::Socket::CreateTCP(addr);
+    SYLAR_ASSERT(raw->bind(addr) && raw->listen());
+
+    sylar::IOManager::GetThis()->schedule([raw]() {
+        // 响应体只发出一部分, 连接保持打开
+        sylar::Socket::ptr client = raw->accept();
+        std::string rsp = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nabc";
+        sylar::SocketStream(client).writeFixSize(rsp.data(), rsp.size());
+
+        // 请求体只收到一部分时会话被析构
+        client = raw->accept();
+        sylar::http::HttpSession::ptr session(
+            new sylar::http::HttpSession(client));
+        auto req = session->recvRequestHead();
+        SYLAR_ASSERT(req && req->getBodyStream());
+        auto body = std::static_pointer_cast<sylar::http::HttpBodyStream>(
+            req->getBodyStream());
+        char buf[16];
+        SYLAR_ASSERT(body->read(buf, 3) == 3);
+        session.reset();
+        SYLAR_ASSERT(body->read(buf, sizeof(buf)) == -1);
+        SYLAR_ASSERT(body->hasError() && !body->discard(1024));
+        raw->close();
+        SYLAR_LOG_INFO(g_logger) << "test_detached ok";
+    });
+
+    sylar::IOManager::GetThis()->schedule([addr]() {
+        sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        sylar::http::HttpConnection::ptr conn(
+            new sylar::http::HttpConnection(sock));
+        auto rsp = conn->recvResponseHead();
+        SYLAR_ASSERT(rsp && rsp->getBodyStream());
+        auto body = std::static_pointer_cast<sylar::http::HttpBodyStream>(
+            rsp->getBodyStream());
+        char buf[16];
+        SYLAR_ASSERT(body->read(buf, 3) == 3);
+        conn.reset();
+        SYLAR_ASSERT(body->read(buf, sizeof(buf)) == -1);
+        SYLAR_ASSERT(body->hasError() && !body->discard(1024));
+
+        sock = sylar::Socket::CreateTCP(addr);
+        SYLAR_ASSERT(sock->connect(addr));
+        std::string req = "POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\nabc";
+        SYLAR_ASSERT(sock->send(req.data(), req.size()) > 0);
+        // 等服务端检查完再断开
+        recv_until_close(sock);
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::ERROR);
+
+    test_content_length();
+    test_chunked();
+    test_early_close();
+
+    sylar::IOManager iom(1, true, "body");
+    iom.schedule(test_socket);
+    iom.schedule(test_chunked_server);
+    iom.schedule(test_detached);
+    return 0;
+}
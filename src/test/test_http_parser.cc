@@ -1,4 +1,5 @@
 #include "http/http_parser.hh"
+#include "http/http_request_view.hh"
 #include "sylar/log.hh"
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
@@ -40,6 +41,24 @@ void test_request() {
 	SYLAR_LOG_INFO(g_logger) << tmp;
 }
 
+void test_request_view() {
+	sylar::http::HttpRequestView view;
+	sylar::http::HttpRequestViewParser parser(&view);
+	std::string tmp = test_request_data;
+	size_t s = parser.execute(tmp.data(), tmp.size());
+	SYLAR_LOG_ERROR(g_logger) << "execute rt=" << s
+		<< " has_error=" << parser.hasError() << " is_finished="
+		<< parser.isFinished() << " total=" << tmp.size()
+		<<" conten_legth=" <<parser.getContentLength();
+
+	SYLAR_LOG_INFO(g_logger) << "path=" << view.getPath().toString()
+		<< " host=" << view.getHeader("HOST").toString()
+		<< " headers=" << view.getHeaders().size()
+		<< " close=" << view.isClose();
+	SYLAR_LOG_INFO(g_logger) << view.toRequest()->toString();
+	SYLAR_LOG_INFO(g_logger) << tmp.substr(s);
+}
+
 void test_response() {
 	sylar::http::HttpResponseParser parser;
 	std::string tmp = test_response_data;
@@ -61,6 +80,8 @@ int main(int argc, char *argv[]) {
 
 	test_request();
 
+	test_request_view();
+
 	test_response();
 	return 0;
 }
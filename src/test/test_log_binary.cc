@@ -0,0 +1,43 @@
+#include "sylar/sylar.hh"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 空指针字符串参数按 "(null)" 输出, 不能崩溃
+void test_null_string()
+{
+    const char *name = nullptr;
+    sylar::LogArg args[] = {name, 42, nullptr};
+
+    sylar::LogStream os;
+    sylar::LogRecord::FormatMessage(os, "name=%s id=%d peer=%s", args, 3);
+    SYLAR_LOG_INFO(g_logger) << "format: " << os.toString();
+    SYLAR_ASSERT(os.toString() == "name=(null) id=42 peer=(null)");
+
+    // 文本输出器
+    SYLAR_LOG_BIN_INFO(g_logger, "name=%s id=%d", name, 42);
+
+    // 二进制输出器, 编码时同样要读字符串内容
+    std::string path = "/tmp/test_log_binary.bin";
+    unlink(path.c_str());
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("test_log_binary");
+    sylar::BinaryLogAppender::ptr appender(new sylar::BinaryLogAppender(path));
+    logger->clearAppenders();
+    logger->addAppender(appender);
+    SYLAR_LOG_BIN_INFO(logger, "name=%s id=%d", name, 42);
+    appender->flush();
+    logger->clearAppenders();
+
+    struct stat st;
+    SYLAR_ASSERT(stat(path.c_str(), &st) == 0 && st.st_size > 0);
+    SYLAR_LOG_INFO(g_logger) << "binary file bytes=" << st.st_size;
+    unlink(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    test_null_string();
+    return 0;
+}
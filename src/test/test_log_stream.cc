@@ -0,0 +1,59 @@
+#include "sylar/sylar.hh"
+
+#include <iomanip>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+struct Point {
+    int x;
+    int y;
+};
+
+std::ostream &operator<<(std::ostream &os, const Point &p)
+{
+    return os << "(" << p.x << "," << p.y << ")";
+}
+
+// 同一串 << 分别写入 LogStream 和 std::ostringstream, 结果必须相同
+#define XX(...)                                                         \
+    {                                                                   \
+        sylar::LogStream ls;                                            \
+        std::ostringstream ss;                                          \
+        ls __VA_ARGS__;                                                 \
+        ss __VA_ARGS__;                                                 \
+        SYLAR_LOG_INFO(g_logger) << "[" << ls.toString() << "]";        \
+        SYLAR_ASSERT(ls.toString() == ss.str());                        \
+    }
+
+// 操纵符设置的格式与 std::ostream 一致, 并在本行内一直有效
+void test_manipulator()
+{
+    XX(<< std::hex << 255 << " " << 3.14159 << std::dec << " " << 255);
+    XX(<< std::setprecision(3) << 3.14159 << " " << 2.5f << " " << 1);
+    XX(<< std::setw(5) << 7 << "|" << 8 << "|" << std::setfill('0')
+       << std::setw(4) << 42 << "|" << std::left << std::setw(4) << "ab"
+       << "|");
+    XX(<< std::boolalpha << true << " " << std::noboolalpha << false << " "
+       << std::showbase << std::hex << (short)-1 << " " << std::fixed << 1.5
+       << std::endl);
+    XX(<< std::uppercase << std::hex << 0xabcULL << " " << Point{1, 2} << " "
+       << std::string("s") << 'c' << (long long)-3);
+
+    // 没有操纵符时仍走直接转换, 输出不变
+    XX(<< 255 << " " << -7 << " " << 3.14159 << " " << Point{3, 4} << " "
+       << 42u);
+
+    // 恢复默认格式后回到直接转换
+    sylar::LogStream ls;
+    ls << std::hex << 255 << std::dec << " " << 255;
+    SYLAR_ASSERT(ls.toString() == "ff 255");
+    ls.clear();
+    ls << 255;
+    SYLAR_ASSERT(ls.toString() == "255");
+}
+
+int main(int argc, char **argv)
+{
+    test_manipulator();
+    return 0;
+}
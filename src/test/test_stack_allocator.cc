@@ -0,0 +1,52 @@
+#include "sylar/sylar.hh"
+#include "sylar/stack_allocator.hh"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static void print_stats(const std::string &tag)
+{
+    sylar::StackAllocator::Stats stats = sylar::StackAllocator::GetStats();
+    SYLAR_LOG_INFO(g_logger) << tag << " allocated=" << stats.allocated
+                             << " pooled=" << stats.pooled
+                             << " resident=" << stats.resident;
+}
+
+static void run_in_fiber() { sylar::Fiber::YieldToHold(); }
+
+void test_allocator(const std::string &name)
+{
+    sylar::Config::Lookup<std::string>("fiber.stack_allocator", "")
+        ->setValue(name);
+    SYLAR_ASSERT(sylar::StackAllocator::GetDefault()->getName() == name);
+
+    std::vector<sylar::Fiber::ptr> fibers;
+    for (int i = 0; i < 32; ++i) {
+        fibers.emplace_back(new sylar::Fiber(&run_in_fiber));
+        fibers.back()->swapIn();
+    }
+    print_stats(name + " parked");
+    SYLAR_ASSERT(sylar::StackAllocator::GetStats().allocated >= 32);
+
+    for (auto &fiber : fibers) {
+        fiber->swapIn();
+        SYLAR_ASSERT(fiber->getState() == sylar::Fiber::TERM);
+    }
+    fibers.clear();
+    print_stats(name + " released");
+}
+
+int main(int argc, char **argv)
+{
+    sylar::Scheduler sc;
+
+    test_allocator("malloc");
+    test_allocator("mmap");
+    test_allocator("pool");
+
+    // 池中的栈被复用, 超出常驻上限的部分已归还物理内存
+    SYLAR_ASSERT(sylar::StackAllocator::GetStats().pooled > 0);
+    sylar::PooledStackAllocator::Trim();
+    print_stats("trimmed");
+    SYLAR_ASSERT(sylar::StackAllocator::GetStats().pooled == 0);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "sylar/sylar.hh"
+#include "sylar/timer.hh"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 时间由测试推进的时间轮定时器管理器
+ */
+class ManualTimerManager : public sylar::TimerManager {
+  public:
+    ManualTimerManager() : sylar::TimerManager(true), m_now(sylar::GetCurrentMS()) {}
+
+    uint64_t now() const { return m_now; }
+    void setNow(uint64_t ms) { m_now = ms; }
+
+    /**
+     * @brief 按当前时间处理到期定时器并执行回调
+     */
+    void runExpired()
+    {
+        std::vector<std::function<void()>> cbs;
+        listExpiredCb(cbs);
+        for (auto &cb : cbs) {
+            cb();
+        }
+    }
+
+  protected:
+    void onTimerInsertedAtFront() override {}
+    uint64_t getCurrentMS() const override { return m_now; }
+
+  private:
+    uint64_t m_now;
+};
+
+// 第 1 层的定时器刚好落在 256ms 圈首之后, 时间轮停在圈首时
+// getNextTimer 不能越过它, 定时器要准时触发
+void test_wheel_boundary()
+{
+    ManualTimerManager mgr;
+    uint64_t boundary = ((mgr.now() >> 8) + 2) << 8;
+    uint64_t expire   = boundary + 10;
+    uint64_t fired_at = 0;
+    mgr.addTimer(expire - mgr.now(), [&mgr, &fired_at]() { fired_at = mgr.now(); });
+
+    // 在圈首前 1ms 处理一次到期定时器, 时间轮停在圈首, 第 1 层尚未级联
+    mgr.setNow(boundary - 1);
+    mgr.runExpired();
+    SYLAR_ASSERT(fired_at == 0);
+    uint64_t next = mgr.getNextTimer();
+    SYLAR_LOG_INFO(g_logger) << "wheel next timer in " << next << "ms";
+    SYLAR_ASSERT(next <= expire - mgr.now());
+
+    // 按 getNextTimer 推进时间, 每次等待都不能越过触发时间
+    while (fired_at == 0) {
+        mgr.setNow(mgr.now() + std::max<uint64_t>(next, 1));
+        SYLAR_ASSERT(mgr.now() <= expire);
+        mgr.runExpired();
+        next = mgr.getNextTimer();
+    }
+    SYLAR_LOG_INFO(g_logger) << "wheel timer fired at boundary+"
+                             << fired_at - boundary << "ms";
+    SYLAR_ASSERT(fired_at == expire);
+    SYLAR_ASSERT(mgr.getNextTimer() == ~0ull);
+}
+
+int main(int argc, char **argv)
+{
+    test_wheel_boundary();
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "sylar/thread.hh"
 #include "sylar/log.hh"
 #include "sylar/util.hh"
+#include <errno.h>
+#include <time.h>
 
 namespace sylar {
 
@@ -28,6 +30,26 @@ auto Semaphore::wait() -> void {
     }
 }
 
+auto Semaphore::waitFor(uint64_t timeout_ms) -> bool {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(&m_semaphore, &ts)) {
+        if (errno == ETIMEDOUT) {
+            return false;
+        }
+        if (errno != EINTR) {
+            throw std::logic_error("sem_timedwait error");
+        }
+    }
+    return true;
+}
+
 auto Semaphore::notify() -> void {
     if(sem_post(&m_semaphore)) {
         throw std::logic_error("sem_post error");
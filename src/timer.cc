@@ -1,8 +1,35 @@
 #include "sylar/timer.hh"
+#include "sylar/config.hh"
 #include "sylar/util.hh"
 
 namespace sylar {
 
+static ConfigVar<bool>::ptr g_timer_use_wheel =
+    Config::Lookup<bool>("timer.use_wheel", false,
+                         "use hierarchical timing wheel in TimerManager");
+
+/**
+ * 时间轮精度 1ms, 共 4 层: 第 0 层 256 个槽, 其余每层 64 个槽,
+ * 覆盖 2^26ms(约 18.6 小时), 更远的定时器先放在最高层, 级联时重新计算位置
+ */
+static const size_t WHEEL_L0_BITS    = 8;
+static const size_t WHEEL_LN_BITS    = 6;
+static const size_t WHEEL_L0_SIZE    = 1 << WHEEL_L0_BITS;
+static const size_t WHEEL_LN_SIZE    = 1 << WHEEL_LN_BITS;
+static const size_t WHEEL_LN_LEVELS  = 3;
+static const uint64_t WHEEL_MAX_SPAN = 1ull << (WHEEL_L0_BITS + WHEEL_LN_LEVELS * WHEEL_LN_BITS);
+
+/**
+ * @brief 分层时间轮, 只在持有 mutex 时访问
+ */
+struct TimerManager::TimerWheel {
+    Mutex mutex;
+    uint64_t nextTick = 0; /**< 下一个待处理的毫秒时间戳 */
+    size_t count      = 0; /**< 挂在槽上的定时器数量 */
+    Timer *l0[WHEEL_L0_SIZE] = {};
+    Timer *ln[WHEEL_LN_LEVELS][WHEEL_LN_SIZE] = {};
+};
+
 auto Timer::Comparator::operator()(const Timer::ptr &lhs,
                                    const Timer::ptr &rhs) const -> bool
 {
@@ -32,13 +59,28 @@ Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring,
              TimerManager *manager)
     : m_recurring(recurring), m_ms(ms), m_cb(cb), m_manager(manager)
 {
-    m_next = sylar::GetCurrentMS() + m_ms;
+    m_next = manager->getCurrentMS() + m_ms;
 }
 
 Timer::Timer(uint64_t next) : m_next(next) {}
 
 auto Timer::cancel() -> bool
 {
+    if (m_manager->m_wheel) {
+        std::function<void()> cb;
+        Spinlock::Lock lock(m_lock);
+        if (!m_cb) {
+            return false;
+        }
+        // 回调在释放锁之后析构
+        cb.swap(m_cb);
+        // 从槽上摘除交给处理时间轮的线程
+        if (m_linked && !m_queued) {
+            m_manager->wheelPush(this);
+        }
+        return true;
+    }
+
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
 
     if (m_cb) {
@@ -53,6 +95,18 @@ auto Timer::cancel() -> bool
 
 auto Timer::refresh() -> bool
 {
+    if (m_manager->m_wheel) {
+        Spinlock::Lock lock(m_lock);
+        if (!m_cb) {
+            return false;
+        }
+        m_next = m_manager->getCurrentMS() + m_ms;
+        if (!m_queued) {
+            m_manager->wheelPush(this);
+        }
+        return true;
+    }
+
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
 
     if (!m_cb) {
@@ -65,13 +119,36 @@ auto Timer::refresh() -> bool
     }
 
     m_manager->m_timers.erase(it);
-    m_next = sylar::GetCurrentMS() + m_ms;
+    m_next = m_manager->getCurrentMS() + m_ms;
     m_manager->m_timers.insert(shared_from_this());
     return true;
 }
 
 auto Timer::reset(uint64_t ms, bool from_now) -> bool
 {
+    if (m_manager->m_wheel) {
+        uint64_t next = 0;
+        {
+            Spinlock::Lock lock(m_lock);
+            if (ms == m_ms && !from_now) {
+                return true;
+            }
+            if (!m_cb) {
+                return false;
+            }
+
+            uint64_t start = from_now ? m_manager->getCurrentMS() : m_next - m_ms;
+            m_ms   = ms;
+            m_next = start + m_ms;
+            next   = m_next;
+            if (!m_queued) {
+                m_manager->wheelPush(this);
+            }
+        }
+        m_manager->wheelNotify(next);
+        return true;
+    }
+
     if (ms == m_ms && !from_now) {
         return true;
     }
@@ -90,7 +167,7 @@ auto Timer::reset(uint64_t ms, bool from_now) -> bool
     uint64_t start = 0;
 
     if (from_now) {
-        start = sylar::GetCurrentMS();
+        start = m_manager->getCurrentMS();
     }
     else {
         start = m_next - m_ms;
@@ -131,15 +208,64 @@ bool TimerManager::detectClockRollover(uint64_t now_ms)
     return rollover;
 }
 
-TimerManager::TimerManager() { m_previousTime = sylar::GetCurrentMS(); }
+TimerManager::TimerManager() : TimerManager(g_timer_use_wheel->getValue()) {}
 
-TimerManager::~TimerManager() {}
+TimerManager::TimerManager(bool use_wheel)
+{
+    // 构造期间虚函数还不会派发到子类, 直接取系统时间
+    m_previousTime = sylar::GetCurrentMS();
+    if (use_wheel) {
+        m_wheel.reset(new TimerWheel);
+        m_wheel->nextTick = m_previousTime;
+    }
+}
+
+TimerManager::~TimerManager()
+{
+    if (!m_wheel) {
+        return;
+    }
+
+    // 释放时间轮中定时器持有的自身引用
+    std::vector<Timer::ptr> timers;
+    Mutex::Lock lock(m_wheel->mutex);
+    wheelDrain();
+    auto release = [&timers](Timer *head) {
+        while (head) {
+            Timer *next = head->m_slotNext;
+            Spinlock::Lock lock2(head->m_lock);
+            head->m_linked   = false;
+            head->m_slot     = nullptr;
+            head->m_slotPrev = nullptr;
+            head->m_slotNext = nullptr;
+            timers.push_back(std::move(head->m_self));
+            head = next;
+        }
+    };
+    for (auto head : m_wheel->l0) {
+        release(head);
+    }
+    for (auto &level : m_wheel->ln) {
+        for (auto head : level) {
+            release(head);
+        }
+    }
+}
 
 auto TimerManager::addTimer(uint64_t ms, std::function<void()> cb,
                             bool recurring)
     -> Timer::ptr
 {
     Timer::ptr timer(new Timer(ms, cb, recurring, this));
+    if (m_wheel) {
+        // 定时器入队前对其他线程不可见, 无需加锁
+        uint64_t next  = timer->m_next;
+        timer->m_self = timer;
+        wheelPush(timer.get());
+        wheelNotify(next);
+        return timer;
+    }
+
     RWMutexType::WriteLock lock(m_mutex);
     addTimer(timer, lock); // 在添加后释放锁
     return timer;
@@ -167,6 +293,26 @@ Timer::ptr TimerManager::addConditionTimer(uint64_t ms,
 
 uint64_t TimerManager::getNextTimer()
 {
+    if (m_wheel) {
+        uint64_t next = ~0ull;
+        {
+            Mutex::Lock lock(m_wheel->mutex);
+            // 先公布唤醒时间再检查队列: 与 wheelPush + wheelNotify 的顺序相反,
+            // 保证并发添加的定时器要么在这里被看到, 要么由添加方唤醒事件循环
+            do {
+                wheelDrain();
+                next          = wheelNextExpire();
+                m_wheelWakeup = next;
+            } while (m_pending.load());
+        }
+
+        if (next == ~0ull) {
+            return ~0ull;
+        }
+        uint64_t now_ms = getCurrentMS();
+        return now_ms >= next ? 0 : next - now_ms;
+    }
+
     RWMutexType::ReadLock lock(m_mutex);
 
     m_tickled = false;
@@ -176,7 +322,7 @@ uint64_t TimerManager::getNextTimer()
     }
 
     const Timer::ptr &next = *m_timers.begin();
-    uint64_t now_ms        = sylar::GetCurrentMS();
+    uint64_t now_ms        = getCurrentMS();
     if (now_ms >= next->m_next) {
         return 0;
     }
@@ -188,7 +334,12 @@ uint64_t TimerManager::getNextTimer()
 auto TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs)
     -> void
 {
-    uint64_t now_ms = sylar::GetCurrentMS();
+    if (m_wheel) {
+        wheelListExpiredCb(cbs);
+        return;
+    }
+
+    uint64_t now_ms = getCurrentMS();
     std::vector<Timer::ptr> expired;
     {
         RWMutexType::ReadLock lock(m_mutex);
@@ -238,4 +389,228 @@ auto TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs)
     }
 }
 
+void TimerManager::wheelPush(Timer *timer)
+{
+    timer->m_queued = true;
+    Timer *head     = m_pending.load(std::memory_order_relaxed);
+    do {
+        timer->m_pendingNext = head;
+    } while (!m_pending.compare_exchange_weak(head, timer));
+}
+
+void TimerManager::wheelNotify(uint64_t next)
+{
+    uint64_t wakeup = m_wheelWakeup.load();
+    while (next < wakeup) {
+        if (m_wheelWakeup.compare_exchange_weak(wakeup, next)) {
+            onTimerInsertedAtFront();
+            return;
+        }
+    }
+}
+
+void TimerManager::wheelDrain()
+{
+    Timer *timer = m_pending.exchange(nullptr);
+    while (timer) {
+        Timer *next = timer->m_pendingNext;
+        Timer::ptr self; // 不再被时间轮引用时在解锁后释放
+        {
+            Spinlock::Lock lock(timer->m_lock);
+            timer->m_queued      = false;
+            timer->m_pendingNext = nullptr;
+            if (timer->m_linked) {
+                wheelUnlink(timer);
+            }
+            if (timer->m_cb) {
+                wheelLink(timer);
+            }
+            else {
+                self.swap(timer->m_self);
+            }
+        }
+        timer = next;
+    }
+}
+
+void TimerManager::wheelLink(Timer *timer)
+{
+    TimerWheel &wheel = *m_wheel;
+    uint64_t expires  = timer->m_next < wheel.nextTick ? wheel.nextTick : timer->m_next;
+    uint64_t idx      = expires - wheel.nextTick;
+
+    Timer **slot = nullptr;
+    if (idx < WHEEL_L0_SIZE) {
+        slot = &wheel.l0[expires & (WHEEL_L0_SIZE - 1)];
+    }
+    else {
+        if (idx >= WHEEL_MAX_SPAN) {
+            expires = wheel.nextTick + WHEEL_MAX_SPAN - 1;
+        }
+        size_t level = 0;
+        while (level < WHEEL_LN_LEVELS - 1
+               && idx >= 1ull << (WHEEL_L0_BITS + (level + 1) * WHEEL_LN_BITS))
+        {
+            ++level;
+        }
+        size_t shift = WHEEL_L0_BITS + level * WHEEL_LN_BITS;
+        slot = &wheel.ln[level][(expires >> shift) & (WHEEL_LN_SIZE - 1)];
+    }
+
+    timer->m_slot     = slot;
+    timer->m_slotPrev = nullptr;
+    timer->m_slotNext = *slot;
+    if (*slot) {
+        (*slot)->m_slotPrev = timer;
+    }
+    *slot           = timer;
+    timer->m_linked = true;
+    ++wheel.count;
+}
+
+void TimerManager::wheelUnlink(Timer *timer)
+{
+    if (timer->m_slotPrev) {
+        timer->m_slotPrev->m_slotNext = timer->m_slotNext;
+    }
+    else {
+        *timer->m_slot = timer->m_slotNext;
+    }
+    if (timer->m_slotNext) {
+        timer->m_slotNext->m_slotPrev = timer->m_slotPrev;
+    }
+    timer->m_slot     = nullptr;
+    timer->m_slotPrev = nullptr;
+    timer->m_slotNext = nullptr;
+    timer->m_linked   = false;
+    --m_wheel->count;
+}
+
+size_t TimerManager::wheelCascade(size_t level, size_t index)
+{
+    Timer *timer = m_wheel->ln[level][index];
+    while (timer) {
+        Timer *next = timer->m_slotNext;
+        Timer::ptr self;
+        {
+            Spinlock::Lock lock(timer->m_lock);
+            wheelUnlink(timer);
+            if (timer->m_cb) {
+                wheelLink(timer);
+            }
+            else if (!timer->m_queued) {
+                self.swap(timer->m_self);
+            }
+        }
+        timer = next;
+    }
+    return index;
+}
+
+void TimerManager::wheelExpire(Timer *timer, uint64_t now_ms, bool all,
+                               std::vector<std::function<void()>> &cbs)
+{
+    while (timer) {
+        Timer *next = timer->m_slotNext;
+        Timer::ptr self;
+        {
+            Spinlock::Lock lock(timer->m_lock);
+            wheelUnlink(timer);
+            if (!timer->m_cb) {
+                // 已取消, 等待处理的取消请求会在 wheelDrain 中释放
+                if (!timer->m_queued) {
+                    self.swap(timer->m_self);
+                }
+            }
+            else if (!all && timer->m_next > now_ms) {
+                // 被延后的定时器或超出时间轮范围的定时器, 重新挂到槽上
+                wheelLink(timer);
+            }
+            else if (timer->m_recurring) {
+                cbs.push_back(timer->m_cb);
+                timer->m_next = now_ms + timer->m_ms;
+                wheelLink(timer);
+            }
+            else {
+                cbs.push_back(std::move(timer->m_cb));
+                timer->m_cb = nullptr;
+                if (!timer->m_queued) {
+                    self.swap(timer->m_self);
+                }
+            }
+        }
+        timer = next;
+    }
+}
+
+uint64_t TimerManager::wheelNextExpire()
+{
+    TimerWheel &wheel = *m_wheel;
+    if (!wheel.count) {
+        return ~0ull;
+    }
+
+    // 处在圈首时上层还没级联, 第 0 层看不到这一圈里从上层落下的定时器,
+    // 先在圈首醒来一次完成级联
+    if (!(wheel.nextTick & (WHEEL_L0_SIZE - 1))) {
+        return wheel.nextTick;
+    }
+
+    // 只扫描第 0 层的当前一圈, 之后的定时器需要先级联, 到圈末再算一次
+    uint64_t boundary = (wheel.nextTick | (WHEEL_L0_SIZE - 1)) + 1;
+    for (uint64_t tick = wheel.nextTick; tick < boundary; ++tick) {
+        if (wheel.l0[tick & (WHEEL_L0_SIZE - 1)]) {
+            return tick;
+        }
+    }
+    return boundary;
+}
+
+void TimerManager::wheelListExpiredCb(std::vector<std::function<void()>> &cbs)
+{
+    uint64_t now_ms   = getCurrentMS();
+    TimerWheel &wheel = *m_wheel;
+
+    Mutex::Lock lock(wheel.mutex);
+    wheelDrain();
+
+    if (detectClockRollover(now_ms)) {
+        // 系统时间回拨, 与 std::set 实现一样让全部定时器到期
+        for (auto &head : wheel.l0) {
+            wheelExpire(head, now_ms, true, cbs);
+        }
+        for (auto &level : wheel.ln) {
+            for (auto &head : level) {
+                wheelExpire(head, now_ms, true, cbs);
+            }
+        }
+        wheel.nextTick = now_ms + 1;
+        return;
+    }
+
+    while (wheel.nextTick <= now_ms) {
+        if (!wheel.count) {
+            wheel.nextTick = now_ms + 1;
+            break;
+        }
+
+        size_t index = wheel.nextTick & (WHEEL_L0_SIZE - 1);
+        if (!index) {
+            for (size_t level = 0; level < WHEEL_LN_LEVELS; ++level) {
+                size_t shift = WHEEL_L0_BITS + level * WHEEL_LN_BITS;
+                if (wheelCascade(level, (wheel.nextTick >> shift) & (WHEEL_LN_SIZE - 1))) {
+                    break;
+                }
+            }
+        }
+        ++wheel.nextTick;
+
+        // wheelExpire 先记下后继再处理, 周期定时器重新挂回同一个槽的头部时不会被重复处理
+        Timer *head = wheel.l0[index];
+        if (head) {
+            wheelExpire(head, now_ms, false, cbs);
+        }
+    }
+}
+
 }; // namespace sylar
@@ -0,0 +1,275 @@
+/**
+ * @file      sylar_logdecode.cc
+ * @brief     把 BinaryLogAppender 写出的二进制日志还原为文本
+ * @details   用法: sylar_logdecode [-p pattern] file...
+ *            默认使用文件中记录的格式器模式串, -p 指定时改用给定的模式串.
+ *            文件末尾不完整的记录(例如进程异常退出)会被忽略并给出提示
+ */
+#include "sylar/sylar.hh"
+
+#include <cstdio>
+#include <stdexcept>
+#include <unistd.h>
+
+/**
+ * @brief 一个 SESSION 内的定义
+ */
+struct Session {
+    struct Site {
+        sylar::LogLevel::Level level = sylar::LogLevel::UNKNOW;
+        int32_t line                 = 0;
+        std::string file;
+        std::string fmt;
+        std::string types; /**< 参数类型, 见 LogArg::Type */
+    };
+
+    sylar::LogFormatter::ptr formatter;
+    std::unordered_map<uint32_t, Site> sites;
+    std::unordered_map<uint32_t, std::string> threads;
+    std::unordered_map<uint32_t, sylar::Logger::ptr> loggers;
+    uint64_t time = 0;
+};
+
+class Decoder {
+  public:
+    Decoder(const std::string &pattern) : m_pattern(pattern) {}
+
+    /**
+     * @brief  解码一个文件, 输出到标准输出
+     * @return 文件完整且格式正确时返回 true
+     */
+    bool decode(const std::string &file)
+    {
+        sylar::ByteArray ba;
+        if (!ba.readFromFile(file)) {
+            return false;
+        }
+        ba.setPosition(0);
+
+        char magic[sizeof(sylar::BinaryLogAppender::MAGIC)];
+        if (ba.getSizeForRead() < sizeof(magic) + 1) {
+            fprintf(stderr, "%s: not a binary log file\n", file.c_str());
+            return false;
+        }
+        ba.read(magic, sizeof(magic));
+        uint8_t version = ba.readFuint8();
+        if (memcmp(magic, sylar::BinaryLogAppender::MAGIC, sizeof(magic)) != 0
+            || version != sylar::BinaryLogAppender::VERSION)
+        {
+            fprintf(stderr, "%s: not a binary log file or unsupported version\n",
+                    file.c_str());
+            return false;
+        }
+
+        m_session = Session();
+        size_t pos = ba.getPosition();
+        try {
+            while (ba.getSizeForRead() > 0) {
+                if (!decodeRecord(ba)) {
+                    fprintf(stderr, "%s: bad record at offset %zu\n",
+                            file.c_str(), pos);
+                    flushOut();
+                    return false;
+                }
+                pos = ba.getPosition();
+                if (m_out.size() >= 64 * 1024) {
+                    flushOut();
+                }
+            }
+        } catch (std::out_of_range &) {
+            fprintf(stderr, "%s: truncated record at offset %zu\n", file.c_str(),
+                    pos);
+            flushOut();
+            return false;
+        }
+        flushOut();
+        return true;
+    }
+
+  private:
+    bool decodeRecord(sylar::ByteArray &ba)
+    {
+        uint8_t type = ba.readFuint8();
+        if (type != sylar::BinaryLogAppender::SESSION && !m_session.formatter) {
+            return false;
+        }
+        switch (type) {
+            case sylar::BinaryLogAppender::SESSION: {
+                std::string pattern = ba.readStringFVint();
+                m_session           = Session();
+                if (!m_pattern.empty()) {
+                    pattern = m_pattern;
+                }
+                if (pattern.empty()) {
+                    m_session.formatter = sylar::Logger().getFormatter();
+                }
+                else {
+                    m_session.formatter.reset(new sylar::LogFormatter(pattern));
+                }
+                return true;
+            }
+            case sylar::BinaryLogAppender::SITE: {
+                uint32_t id    = ba.readUint32();
+                Session::Site &site = m_session.sites[id];
+                site.level = (sylar::LogLevel::Level)ba.readFuint8();
+                site.line  = ba.readUint32();
+                site.file  = ba.readStringFVint();
+                site.fmt   = ba.readStringFVint();
+                site.types = ba.readStringFVint();
+                return true;
+            }
+            case sylar::BinaryLogAppender::THREAD: {
+                uint32_t id = ba.readUint32();
+                m_session.threads[id] = ba.readStringFVint();
+                return true;
+            }
+            case sylar::BinaryLogAppender::LOGGER: {
+                uint32_t id = ba.readUint32();
+                m_session.loggers[id].reset(
+                    new sylar::Logger(ba.readStringFVint()));
+                return true;
+            }
+            case sylar::BinaryLogAppender::RECORD:
+                return decodeLog(ba);
+            case sylar::BinaryLogAppender::TEXT:
+                return decodeText(ba);
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief 读出 RECORD/TEXT 共用的头部
+     */
+    void readHead(sylar::ByteArray &ba, uint32_t &logger_id,
+                  uint32_t &thread_id, uint32_t &fiber_id)
+    {
+        logger_id = ba.readUint32();
+        m_session.time += ba.readInt64();
+        thread_id = ba.readUint32();
+        fiber_id  = ba.readUint32();
+    }
+
+    bool decodeLog(sylar::ByteArray &ba)
+    {
+        uint32_t site_id = ba.readUint32();
+        auto it          = m_session.sites.find(site_id);
+        if (it == m_session.sites.end()) {
+            return false;
+        }
+        const Session::Site &site = it->second;
+
+        uint32_t logger_id, thread_id, fiber_id;
+        readHead(ba, logger_id, thread_id, fiber_id);
+
+        size_t count = site.types.size();
+        m_strings.resize(count);
+        m_args.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            switch (site.types[i]) {
+                case sylar::LogArg::INT:
+                    m_args[i] = sylar::LogArg((long long)ba.readInt64());
+                    break;
+                case sylar::LogArg::UINT:
+                    m_args[i] =
+                        sylar::LogArg((unsigned long long)ba.readUint64());
+                    break;
+                case sylar::LogArg::DOUBLE:
+                    m_args[i] = sylar::LogArg(ba.readDouble());
+                    break;
+                case sylar::LogArg::STRING:
+                    m_strings[i] = ba.readStringFVint();
+                    m_args[i]    = sylar::LogArg(m_strings[i]);
+                    break;
+                default:
+                    return false;
+            }
+        }
+
+        sylar::LogLine line(site.level, site.file.c_str(), site.line, 0,
+                            thread_id, fiber_id, m_session.time,
+                            threadName(thread_id));
+        sylar::LogRecord::FormatMessage(line.getSS(), site.fmt.c_str(),
+                                        m_args.data(), count);
+        m_session.formatter->format(m_out, logger(logger_id), line);
+        return true;
+    }
+
+    bool decodeText(sylar::ByteArray &ba)
+    {
+        auto level = (sylar::LogLevel::Level)ba.readFuint8();
+        uint32_t logger_id, thread_id, fiber_id;
+        readHead(ba, logger_id, thread_id, fiber_id);
+        int32_t line_no     = ba.readUint32();
+        std::string file    = ba.readStringFVint();
+        std::string content = ba.readStringFVint();
+
+        sylar::LogLine line(level, file.c_str(), line_no, 0, thread_id,
+                            fiber_id, m_session.time, threadName(thread_id));
+        line.getSS().append(content);
+        m_session.formatter->format(m_out, logger(logger_id), line);
+        return true;
+    }
+
+    const std::string &threadName(uint32_t thread_id)
+    {
+        static const std::string s_unknown;
+        auto it = m_session.threads.find(thread_id);
+        return it == m_session.threads.end() ? s_unknown : it->second;
+    }
+
+    const sylar::Logger &logger(uint32_t logger_id)
+    {
+        sylar::Logger::ptr &logger = m_session.loggers[logger_id];
+        if (!logger) {
+            logger.reset(new sylar::Logger("unknown"));
+        }
+        return *logger;
+    }
+
+    void flushOut()
+    {
+        fwrite(m_out.data(), 1, m_out.size(), stdout);
+        m_out.clear();
+    }
+
+  private:
+    std::string m_pattern; /**< -p 指定的模式串 */
+    Session m_session;
+    sylar::LogStream m_out;
+    std::vector<std::string> m_strings; /**< 字符串参数, 供 m_args 引用 */
+    std::vector<sylar::LogArg> m_args;
+};
+
+int main(int argc, char **argv)
+{
+    std::string pattern;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                pattern = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-p pattern] file...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-p pattern] file...\n", argv[0]);
+        return 1;
+    }
+    if (!pattern.empty() && sylar::LogFormatter(pattern).isError()) {
+        fprintf(stderr, "invalid pattern: %s\n", pattern.c_str());
+        return 1;
+    }
+
+    Decoder decoder(pattern);
+    int rt = 0;
+    for (int i = optind; i < argc; ++i) {
+        if (!decoder.decode(argv[i])) {
+            rt = 1;
+        }
+    }
+    return rt;
+}